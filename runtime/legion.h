@@ -1847,6 +1847,9 @@ namespace Legion {
       const char                                    *file_name;
       LegionFileMode                                mode;
       std::vector<FieldID>                          file_fields; // normal files
+      // Normal files only: store the data in compressed chunks (the file
+      // must have been created with the same compression to be reattached)
+      LegionFileCompression                         compression;
       std::map<FieldID,/*file name*/const char*>    field_files; // hdf5 files
     public:
       // Data for external instances
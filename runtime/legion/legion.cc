@@ -2007,7 +2007,8 @@ namespace Legion {
     AttachLauncher::AttachLauncher(ExternalResource r, 
                                    LogicalRegion h, LogicalRegion p)
       : resource(r), handle(h), parent(p), 
-        file_name(NULL), mode(LEGION_FILE_READ_ONLY), static_dependences(NULL)
+        file_name(NULL), mode(LEGION_FILE_READ_ONLY), 
+        compression(LEGION_FILE_COMPRESS_NONE), static_dependences(NULL)
     //--------------------------------------------------------------------------
     {
     }
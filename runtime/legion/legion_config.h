@@ -814,6 +814,7 @@ typedef realm_reduction_op_id_t legion_reduction_op_id_t;
 typedef realm_custom_serdez_id_t legion_custom_serdez_id_t;
 typedef realm_address_space_t legion_address_space_t;
 typedef realm_file_mode_t legion_file_mode_t;
+typedef realm_file_compression_t legion_file_compression_t;
 typedef realm_id_t legion_proc_id_t;
 typedef realm_id_t legion_memory_id_t;
 typedef int legion_task_priority_t;
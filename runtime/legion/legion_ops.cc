@@ -13715,6 +13715,7 @@ namespace Legion {
                   launcher.file_fields.end(); it++)
               requirement.add_field(*it);
             file_mode = launcher.mode;       
+            file_compression = launcher.compression;
             break;
           }
         case EXTERNAL_HDF5_FILE:
@@ -13995,7 +13996,8 @@ namespace Legion {
 	      field_ids[idx] = *it;
             }
             result = node->create_file_instance(file_name, field_ids, sizes, 
-                                                file_mode, ready_event);
+                                                file_mode, file_compression,
+                                                ready_event);
             constraints.specialized_constraint = 
               SpecializedConstraint(GENERIC_FILE_SPECIALIZE);           
             constraints.field_constraint = 
@@ -2667,6 +2667,7 @@ namespace Legion {
       std::map<FieldID,const char*> field_map;
       std::map<FieldID,void*> field_pointers_map;
       LegionFileMode file_mode;
+      LegionFileCompression file_compression;
       PhysicalRegion region;
       unsigned parent_req_index;
       std::set<RtEvent> map_applied_conditions;
@@ -265,7 +265,8 @@ namespace Legion {
     //--------------------------------------------------------------------------
     void LegionProfInstance::process_copy(UniqueID op_id,
             const Realm::ProfilingMeasurements::OperationTimeline &timeline,
-            const Realm::ProfilingMeasurements::OperationMemoryUsage &usage)
+            const Realm::ProfilingMeasurements::OperationMemoryUsage &usage,
+            const Realm::ProfilingMeasurements::OperationTransferTimeline &xfers)
     //--------------------------------------------------------------------------
     {
 #ifdef DEBUG_LEGION
@@ -282,7 +283,28 @@ namespace Legion {
       info.start = timeline.start_time;
       // use complete_time instead of end_time to include async work
       info.stop = timeline.complete_time;
-      owner->update_footprint(sizeof(CopyInfo), this);
+      for (std::vector<Realm::ProfilingMeasurements::OperationTransferTimeline::
+            XferInterval>::const_iterator it = xfers.xfers.begin();
+            it != xfers.xfers.end(); it++)
+      {
+        copy_xfer_infos.push_back(CopyXferInfo());
+        CopyXferInfo &xfer = copy_xfer_infos.back();
+        xfer.op_id = op_id;
+        xfer.xd_id = it->guid;
+        xfer.kind = it->kind;
+        xfer.src = it->src_mem.id;
+        xfer.dst = it->dst_mem.id;
+        xfer.size = it->bytes;
+        xfer.enqueue = it->enqueue_time;
+        // an XferDes with nothing to move never sees its first byte
+        xfer.start = (it->first_byte_time == Realm::ProfilingMeasurements::
+                        OperationTransferTimeline::INVALID_TIMESTAMP) ?
+                      it->last_byte_time : it->first_byte_time;
+        xfer.stop = it->last_byte_time;
+        xfer.ib_wait = it->ib_wait_time;
+      }
+      owner->update_footprint(sizeof(CopyInfo) +
+                    xfers.xfers.size() * sizeof(CopyXferInfo), this);
     }
 
     //--------------------------------------------------------------------------
@@ -483,6 +505,11 @@ namespace Legion {
       {
         serializer->serialize(*it);
       }
+      for (std::deque<CopyXferInfo>::const_iterator it = 
+            copy_xfer_infos.begin(); it != copy_xfer_infos.end(); it++)
+      {
+        serializer->serialize(*it);
+      }
       for (std::deque<FillInfo>::const_iterator it = fill_infos.begin();
             it != fill_infos.end(); it++)
       {
@@ -537,6 +564,7 @@ namespace Legion {
       task_infos.clear();
       meta_infos.clear();
       copy_infos.clear();
+      copy_xfer_infos.clear();
       inst_create_infos.clear();
       inst_usage_infos.clear();
       inst_timeline_infos.clear();
@@ -647,6 +675,16 @@ namespace Legion {
         if (t_curr >= t_stop)
           return diff;
       }
+      while (!copy_xfer_infos.empty())
+      {
+        CopyXferInfo &front = copy_xfer_infos.front();
+        serializer->serialize(front);
+        diff += sizeof(front);
+        copy_xfer_infos.pop_front();
+        const long long t_curr = Realm::Clock::current_time_in_microseconds();
+        if (t_curr >= t_stop)
+          return diff;
+      }
       while (!fill_infos.empty())
       {
         FillInfo &front = fill_infos.front();
@@ -1009,6 +1047,8 @@ namespace Legion {
                 Realm::ProfilingMeasurements::OperationTimeline>();
       req.add_measurement<
                 Realm::ProfilingMeasurements::OperationMemoryUsage>();
+      req.add_measurement<
+                Realm::ProfilingMeasurements::OperationTransferTimeline>();
     }
 
     //--------------------------------------------------------------------------
@@ -1146,6 +1186,8 @@ namespace Legion {
                 Realm::ProfilingMeasurements::OperationTimeline>();
       req.add_measurement<
                 Realm::ProfilingMeasurements::OperationMemoryUsage>();
+      req.add_measurement<
+                Realm::ProfilingMeasurements::OperationTransferTimeline>();
     }
 
     //--------------------------------------------------------------------------
@@ -1314,10 +1356,15 @@ namespace Legion {
             Realm::ProfilingMeasurements::OperationMemoryUsage usage;
             const bool has_usage = response.get_measurement<
                   Realm::ProfilingMeasurements::OperationMemoryUsage>(usage);
+            // older/other DMA paths may not report per-hop timelines
+            Realm::ProfilingMeasurements::OperationTransferTimeline xfers;
+            response.get_measurement<
+                  Realm::ProfilingMeasurements::OperationTransferTimeline>(
+                                                                      xfers);
             // Ignore anything that was predicated false for now
             if (has_usage)
               thread_local_profiling_instance->process_copy(info->op_id,
-                                                            timeline, usage);
+                                                     timeline, usage, xfers);
             break;
           }
         case LEGION_PROF_FILL:
@@ -157,6 +157,18 @@ namespace Legion {
         unsigned long long size;
         timestamp_t create, ready, start, stop;
       };
+      // one hop (XferDes) of a copy - 'start' and 'stop' are the first
+      //  and last byte moved, and 'ib_wait' is the time spent stalled on
+      //  intermediate buffers
+      struct CopyXferInfo {
+      public:
+        UniqueID op_id;
+        unsigned long long xd_id;
+        unsigned kind;
+        MemID src, dst;
+        unsigned long long size;
+        timestamp_t enqueue, start, stop, ib_wait;
+      };
       struct FillInfo {
       public:
         UniqueID op_id;
@@ -244,7 +256,8 @@ namespace Legion {
             const Realm::ProfilingMeasurements::OperationEventWaits &waits);
       void process_copy(UniqueID op_id,
             const Realm::ProfilingMeasurements::OperationTimeline &timeline,
-            const Realm::ProfilingMeasurements::OperationMemoryUsage &usage);
+            const Realm::ProfilingMeasurements::OperationMemoryUsage &usage,
+            const Realm::ProfilingMeasurements::OperationTransferTimeline &xfers);
       void process_fill(UniqueID op_id,
             const Realm::ProfilingMeasurements::OperationTimeline &timeline,
             const Realm::ProfilingMeasurements::OperationMemoryUsage &usage);
@@ -283,6 +296,7 @@ namespace Legion {
       std::deque<TaskInfo> task_infos;
       std::deque<MetaInfo> meta_infos;
       std::deque<CopyInfo> copy_infos;
+      std::deque<CopyXferInfo> copy_xfer_infos;
       std::deque<FillInfo> fill_infos;
       std::deque<InstCreateInfo> inst_create_infos;
       std::deque<InstUsageInfo> inst_usage_infos;
@@ -177,6 +177,20 @@ namespace Legion {
          << "stop:timestamp_t:"        << sizeof(timestamp_t)
          << "}" << std::endl;
 
+      ss << "CopyXferInfo {"
+         << "id:" << COPY_XFER_INFO_ID                               << delim
+         << "op_id:UniqueID:"          << sizeof(UniqueID)           << delim
+         << "xd_id:unsigned long long:" << sizeof(unsigned long long) << delim
+         << "kind:unsigned:"           << sizeof(unsigned)           << delim
+         << "src:MemID:"               << sizeof(MemID)              << delim
+         << "dst:MemID:"               << sizeof(MemID)              << delim
+         << "size:unsigned long long:" << sizeof(unsigned long long) << delim
+         << "enqueue:timestamp_t:"     << sizeof(timestamp_t)        << delim
+         << "start:timestamp_t:"       << sizeof(timestamp_t)        << delim
+         << "stop:timestamp_t:"        << sizeof(timestamp_t)        << delim
+         << "ib_wait:timestamp_t:"     << sizeof(timestamp_t)
+         << "}" << std::endl;
+
       ss << "FillInfo {"
          << "id:" << FILL_INFO_ID                        << delim
          << "op_id:UniqueID:"     << sizeof(UniqueID)    << delim
@@ -488,6 +502,26 @@ namespace Legion {
       lp_fwrite(f, (char*)&(copy_info.stop),   sizeof(copy_info.stop));
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::serialize(
+                             const LegionProfInstance::CopyXferInfo& xfer_info)
+    //--------------------------------------------------------------------------
+    {
+      int ID = COPY_XFER_INFO_ID;
+      lp_fwrite(f, (char*)&ID, sizeof(ID));
+
+      lp_fwrite(f, (char*)&(xfer_info.op_id),   sizeof(xfer_info.op_id));
+      lp_fwrite(f, (char*)&(xfer_info.xd_id),   sizeof(xfer_info.xd_id));
+      lp_fwrite(f, (char*)&(xfer_info.kind),    sizeof(xfer_info.kind));
+      lp_fwrite(f, (char*)&(xfer_info.src),     sizeof(xfer_info.src));
+      lp_fwrite(f, (char*)&(xfer_info.dst),     sizeof(xfer_info.dst));
+      lp_fwrite(f, (char*)&(xfer_info.size),    sizeof(xfer_info.size));
+      lp_fwrite(f, (char*)&(xfer_info.enqueue), sizeof(xfer_info.enqueue));
+      lp_fwrite(f, (char*)&(xfer_info.start),   sizeof(xfer_info.start));
+      lp_fwrite(f, (char*)&(xfer_info.stop),    sizeof(xfer_info.stop));
+      lp_fwrite(f, (char*)&(xfer_info.ib_wait), sizeof(xfer_info.ib_wait));
+    }
+
     //--------------------------------------------------------------------------
     void LegionProfBinarySerializer::serialize(
                                   const LegionProfInstance::FillInfo& fill_info)
@@ -818,6 +852,18 @@ namespace Legion {
          copy_info.ready, copy_info.start, copy_info.stop);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfASCIISerializer::serialize(
+                             const LegionProfInstance::CopyXferInfo& xfer_info)
+    //--------------------------------------------------------------------------
+    {
+      log_prof.print("Prof Copy Xfer Info %llu %llu %u " IDFMT " " IDFMT
+         " %llu %llu %llu %llu %llu", xfer_info.op_id, xfer_info.xd_id,
+         xfer_info.kind, xfer_info.src, xfer_info.dst, xfer_info.size,
+         xfer_info.enqueue, xfer_info.start, xfer_info.stop,
+         xfer_info.ib_wait);
+    }
+
     //--------------------------------------------------------------------------
     void LegionProfASCIISerializer::serialize(
                                   const LegionProfInstance::FillInfo& fill_info)
@@ -62,6 +62,7 @@ namespace Legion {
       virtual void serialize(const LegionProfInstance::TaskInfo&) = 0;
       virtual void serialize(const LegionProfInstance::MetaInfo&) = 0;
       virtual void serialize(const LegionProfInstance::CopyInfo&) = 0;
+      virtual void serialize(const LegionProfInstance::CopyXferInfo&) = 0;
       virtual void serialize(const LegionProfInstance::FillInfo&) = 0;
       virtual void serialize(const LegionProfInstance::InstCreateInfo&) = 0;
       virtual void serialize(const LegionProfInstance::InstUsageInfo&) = 0;
@@ -104,6 +105,7 @@ namespace Legion {
       void serialize(const LegionProfInstance::TaskInfo&);
       void serialize(const LegionProfInstance::MetaInfo&);
       void serialize(const LegionProfInstance::CopyInfo&);
+      void serialize(const LegionProfInstance::CopyXferInfo&);
       void serialize(const LegionProfInstance::FillInfo&);
       void serialize(const LegionProfInstance::InstCreateInfo&);
       void serialize(const LegionProfInstance::InstUsageInfo&);
@@ -147,6 +149,7 @@ namespace Legion {
         MESSAGE_INFO_ID,
         MAPPER_CALL_INFO_ID,
         RUNTIME_CALL_INFO_ID,
+        COPY_XFER_INFO_ID,
 #ifdef LEGION_PROF_SELF_PROFILE
         PROFTASK_INFO_ID
 #endif
@@ -180,6 +183,7 @@ namespace Legion {
       void serialize(const LegionProfInstance::TaskInfo&);
       void serialize(const LegionProfInstance::MetaInfo&);
       void serialize(const LegionProfInstance::CopyInfo&);
+      void serialize(const LegionProfInstance::CopyXferInfo&);
       void serialize(const LegionProfInstance::FillInfo&);
       void serialize(const LegionProfInstance::InstCreateInfo&);
       void serialize(const LegionProfInstance::InstUsageInfo&);
@@ -66,6 +66,7 @@ namespace Legion {
   typedef ::legion_timing_measurement_t TimingMeasurement;
   typedef ::legion_dependence_type_t DependenceType;
   typedef ::legion_file_mode_t LegionFileMode;
+  typedef ::legion_file_compression_t LegionFileCompression;
   typedef ::legion_execution_constraint_t ExecutionConstraintKind;
   typedef ::legion_layout_constraint_t LayoutConstraintKind;
   typedef ::legion_equality_kind_t EqualityKind;
@@ -965,6 +965,7 @@ namespace Legion {
 				   const std::vector<Realm::FieldID> &field_ids,
                                    const std::vector<size_t> &field_sizes,
                                    legion_file_mode_t file_mode,
+                                   legion_file_compression_t compression,
                                    ApEvent &ready_event) = 0;
       virtual PhysicalInstance create_hdf5_instance(const char *file_name,
                                    const std::vector<Realm::FieldID> &field_ids,
@@ -1201,6 +1202,7 @@ namespace Legion {
                                    const std::vector<Realm::FieldID> &field_ids,
                                    const std::vector<size_t> &field_sizes,
                                    legion_file_mode_t file_mode, 
+                                   legion_file_compression_t compression,
                                    ApEvent &ready_event);
       virtual PhysicalInstance create_hdf5_instance(const char *file_name,
                                    const std::vector<Realm::FieldID> &field_ids,
@@ -2742,6 +2742,7 @@ namespace Legion {
                                          const std::vector<Realm::FieldID> &field_ids,
                                          const std::vector<size_t> &field_sizes,
                                          legion_file_mode_t file_mode,
+                                         legion_file_compression_t compression,
                                          ApEvent &ready_event)
     //--------------------------------------------------------------------------
     {
@@ -2753,7 +2754,8 @@ namespace Legion {
       Realm::ProfilingRequestSet requests;
       PhysicalInstance result;
       ready_event = ApEvent(PhysicalInstance::create_file_instance(result, 
-          file_name, local_space, field_ids, field_sizes, file_mode, requests));
+          file_name, local_space, field_ids, field_sizes, file_mode,
+          compression, requests));
       return result;
     }
 
@@ -56,6 +56,8 @@ static const void *ignore_gasnet_warning2 __attribute__((unused)) = (void *)_gas
 
 #include <queue>
 #include <assert.h>
+#include <unistd.h>
+#include <string.h>
 #ifdef REALM_PROFILE_AM_HANDLERS
 #include <math.h>
 #endif
@@ -67,7 +69,9 @@ static const void *ignore_gasnet_warning2 __attribute__((unused)) = (void *)_gas
 
 #include "realm/threads.h"
 #include "realm/timers.h"
+#include "realm/parking.h"
 #include "realm/logging.h"
+#include "realm/shm_transport.h"
 
 #define NO_DEBUG_AMREQUESTS
 
@@ -113,6 +117,14 @@ GASNetHSL::~GASNetHSL(void)
 
 void GASNetHSL::lock(void)
 {
+  // most critical sections are short, so spin (with backoff) for a little
+  //  while before blocking
+  if(Realm::Config::lock_spin_iterations > 0) {
+    Realm::SpinBackoff backoff;
+    for(int spun = 0; spun < Realm::Config::lock_spin_iterations; spun += backoff.pause())
+      if(gasnet_hsl_trylock(&mutex) == GASNET_OK)
+	return;
+  }
   gasnet_hsl_lock(&mutex);
 }
 
@@ -177,8 +189,20 @@ void record_activemsg_profiling(int msgid,
 }
 #endif
 
+// set up by init_endpoints if peers on the same host should exchange
+//  messages through shared memory (-ll:shm)
+static Realm::ShmTransport *shm_transport = 0;
+// messages delivered through shared memory get a fake token that points
+//  to the sender's entry in this array
+static char *shm_tokens = 0;
+
 NodeID get_message_source(token_t token)
 {
+  if(shm_tokens &&
+     (((char *)token) >= shm_tokens) &&
+     (((char *)token) < (shm_tokens + gasnet_nodes())))
+    return ((char *)token) - shm_tokens;
+
   gasnet_node_t src;
   CHECK_GASNET( gasnet_AMGetMsgSource(reinterpret_cast<gasnet_token_t>(token), &src) );
 #ifdef DEBUG_AMREQUESTS
@@ -873,6 +897,12 @@ static int num_lmbs = 2;
 static size_t lmb_size = 1 << 20; // 1 MB
 static bool force_long_messages = true;
 static int max_msgs_to_send = 8;
+static bool use_shm_transport = false;
+static size_t shm_ring_slots = 256;
+static size_t shm_arena_size = 4 << 20; // 4 MB per peer
+
+// room in node 0's segment for the name of the shared memory segments
+static const size_t SHM_KEY_SIZE = 256;
 
 // returns the largest payload that can be sent to a node (to a non-pinned
 //   address)
@@ -1514,6 +1544,15 @@ public:
     return was_empty;
   }
 
+  // true if there are messages still waiting to go out through GASNet
+  bool has_queued_messages(void)
+  {
+    gasnet_hsl_lock(&mutex);
+    bool queued = !(out_short_hdrs.empty() && out_long_hdrs.empty());
+    gasnet_hsl_unlock(&mutex);
+    return queued;
+  }
+
   // returns true if a message is enqueue AND we were empty before
   bool handle_long_msgptr(const void *ptr)
   {
@@ -2328,6 +2367,10 @@ public:
     if(was_empty)
       add_todo_entry(target);
   }
+  bool has_queued_messages(gasnet_node_t target)
+  {
+    return endpoints[target]->has_queued_messages();
+  }
   void handle_long_msgptr(gasnet_node_t source, const void *ptr)
   {
     bool was_empty = endpoints[source]->handle_long_msgptr(ptr);
@@ -2421,6 +2464,8 @@ static void handle_flip_ack(gasnet_token_t token,
 static const int MAX_HANDLERS = 128;
 static gasnet_handlerentry_t handlers[MAX_HANDLERS];
 static int hcount = 0;
+// the same handlers, indexed by message id, for the shared memory path
+static void (*shm_handlers[256])();
 
 void add_handler_entry(int msgid, void (*fnptr)())
 {
@@ -2428,6 +2473,183 @@ void add_handler_entry(int msgid, void (*fnptr)())
   handlers[hcount].index = msgid;
   handlers[hcount].fnptr = fnptr;
   hcount++;
+  assert((msgid >= 0) && (msgid < 256));
+  shm_handlers[msgid] = fnptr;
+}
+
+#define SHM_ARGS_1                  a[0]
+#define SHM_ARGS_2  SHM_ARGS_1,     a[1]
+#define SHM_ARGS_3  SHM_ARGS_2,     a[2]
+#define SHM_ARGS_4  SHM_ARGS_3,     a[3]
+#define SHM_ARGS_5  SHM_ARGS_4,     a[4]
+#define SHM_ARGS_6  SHM_ARGS_5,     a[5]
+#define SHM_ARGS_7  SHM_ARGS_6,     a[6]
+#define SHM_ARGS_8  SHM_ARGS_7,     a[7]
+#define SHM_ARGS_9  SHM_ARGS_8,     a[8]
+#define SHM_ARGS_10 SHM_ARGS_9,     a[9]
+#define SHM_ARGS_11 SHM_ARGS_10,    a[10]
+#define SHM_ARGS_12 SHM_ARGS_11,    a[11]
+#define SHM_ARGS_13 SHM_ARGS_12,    a[12]
+#define SHM_ARGS_14 SHM_ARGS_13,    a[13]
+#define SHM_ARGS_15 SHM_ARGS_14,    a[14]
+#define SHM_ARGS_16 SHM_ARGS_15,    a[15]
+
+#define SHM_DISPATCH_CASE(n) \
+  case n: \
+    if(has_payload) \
+      (*(void (*)(token_t, void *, size_t, HANDLERARG_PARAMS_ ## n))fnptr)(token, payload, payload_len, SHM_ARGS_ ## n); \
+    else \
+      (*(void (*)(token_t, HANDLERARG_PARAMS_ ## n))fnptr)(token, SHM_ARGS_ ## n); \
+    break
+
+// calls the same handlers GASNet would have, with a token that identifies
+//  the sender - medium payloads stay in the sender's arena until the
+//  message's handler has run (see handle_long_msgptr below)
+class ShmDelivery : public Realm::ShmTransport::MessageHandler {
+public:
+  virtual void handle_message(int sender, int msgid,
+			      const void *args, size_t arglen,
+			      void *payload, size_t payload_len,
+			      bool has_payload)
+  {
+    void (*fnptr)() = shm_handlers[msgid];
+    assert(fnptr != 0);
+    token_t token = shm_tokens + sender;
+
+    handlerarg_t a[Realm::ShmTransport::MAX_ARG_BYTES / sizeof(handlerarg_t)];
+    memcpy(a, args, arglen);
+    switch(arglen / sizeof(handlerarg_t)) {
+      SHM_DISPATCH_CASE(1);
+      SHM_DISPATCH_CASE(2);
+      SHM_DISPATCH_CASE(3);
+      SHM_DISPATCH_CASE(4);
+      SHM_DISPATCH_CASE(5);
+      SHM_DISPATCH_CASE(6);
+      SHM_DISPATCH_CASE(7);
+      SHM_DISPATCH_CASE(8);
+      SHM_DISPATCH_CASE(9);
+      SHM_DISPATCH_CASE(10);
+      SHM_DISPATCH_CASE(11);
+      SHM_DISPATCH_CASE(12);
+      SHM_DISPATCH_CASE(13);
+      SHM_DISPATCH_CASE(14);
+      SHM_DISPATCH_CASE(15);
+      SHM_DISPATCH_CASE(16);
+    default:
+      assert(0);
+    }
+  }
+};
+
+static ShmDelivery shm_delivery;
+
+// every node creates its segment, and then maps those of any other nodes
+//  on the same host - the segment names come from node 0's hostname and
+//  pid, which it leaves at 'key_base' in its GASNet segment
+static void init_shm_transport(char *key_base)
+{
+  gasnet_node_t my_node = gasnet_mynode();
+  char key[SHM_KEY_SIZE];
+  if(my_node == 0) {
+    char hostname[128];
+    gethostname(hostname, sizeof(hostname));
+    hostname[sizeof(hostname) - 1] = 0;
+    snprintf(key_base, SHM_KEY_SIZE, "%s-%d", hostname, (int)getpid());
+  }
+  gasnet_barrier_notify(0, GASNET_BARRIERFLAG_ANONYMOUS);
+  gasnet_barrier_wait(0, GASNET_BARRIERFLAG_ANONYMOUS);
+  if(my_node == 0) {
+    memcpy(key, key_base, SHM_KEY_SIZE);
+  } else {
+    // every node's segment has the same layout
+    size_t offset = key_base - ((char *)(segment_info[my_node].addr));
+    gasnet_get(key, 0, ((char *)(segment_info[0].addr)) + offset, SHM_KEY_SIZE);
+  }
+  key[SHM_KEY_SIZE - 1] = 0;
+
+  shm_transport = new Realm::ShmTransport(key, my_node, gasnet_nodes(),
+					  shm_ring_slots, shm_arena_size);
+  bool ok = shm_transport->create_segment();
+  gasnet_barrier_notify(0, GASNET_BARRIERFLAG_ANONYMOUS);
+  gasnet_barrier_wait(0, GASNET_BARRIERFLAG_ANONYMOUS);
+  // if we couldn't create ours, nobody could attach to us either
+  int peers = (ok ? shm_transport->attach_peers() : 0);
+  gasnet_barrier_notify(0, GASNET_BARRIERFLAG_ANONYMOUS);
+  gasnet_barrier_wait(0, GASNET_BARRIERFLAG_ANONYMOUS);
+  shm_transport->unlink_names();
+
+#ifdef GASNET_PSHM
+  // with PSHM, GASNet has already mapped the segments of nodes on our
+  //  host, so remote writes into them can be done by the sender
+  gasnet_nodeinfo_t *info = new gasnet_nodeinfo_t[gasnet_nodes()];
+  CHECK_GASNET( gasnet_getNodeInfo(info, gasnet_nodes()) );
+  for(gasnet_node_t i = 0; i < gasnet_nodes(); i++)
+    if((i != my_node) && shm_transport->is_colocated(i) &&
+       (info[i].supernode == info[my_node].supernode))
+      shm_transport->add_alias(i, segment_info[i].addr,
+			       ((char *)(segment_info[i].addr)) + info[i].offset,
+			       segment_info[i].size);
+  delete[] info;
+#endif
+
+  shm_tokens = new char[gasnet_nodes()];
+  log_amsg.info("shared memory transport: %d peers on this host", peers);
+}
+
+// sends a message through shared memory if the target is on our host -
+//  returns false if it has to go through GASNet instead (including when
+//  the shared memory path is backed up)
+// once a message to a target has fallen back to GASNet, later ones follow
+//  it there until that endpoint's queue drains, so that nothing sent
+//  through shared memory overtakes a message that's still queued
+static bool shm_enqueue(NodeID target, int msgid,
+			const void *args, size_t arg_size,
+			const SpanList& spans, size_t payload_size,
+			int payload_mode, void *dstptr)
+{
+  if(!shm_transport || !shm_transport->is_colocated(target))
+    return false;
+
+  if(endpoint_manager->has_queued_messages(target))
+    return false;
+
+  if(payload_mode == PAYLOAD_NONE)
+    payload_size = 0;
+
+  // big payloads need somewhere we can write them directly
+  if((payload_size > shm_transport->max_block_bytes()) &&
+     !((dstptr != 0) && shm_transport->translate(target, dstptr, payload_size)))
+    return false;
+
+  handlerarg_t a[Realm::ShmTransport::MAX_ARG_BYTES / sizeof(handlerarg_t)];
+  size_t num_args = (arg_size + sizeof(handlerarg_t) - 1) / sizeof(handlerarg_t);
+  if(num_args > (Realm::ShmTransport::MAX_ARG_BYTES / sizeof(handlerarg_t)))
+    return false;
+  if(num_args > 0)
+    a[num_args - 1] = 0;
+  memcpy(a, args, arg_size);
+
+  bool has_payload = (payload_mode != PAYLOAD_NONE);
+  if(has_payload) {
+    // same BaseMedium fields as send_long fills in, but always one chunk
+    //  and no srcptr to release
+    int message_id_start;
+    if(a[0] == BaseMedium::MESSAGE_ID_MAGIC) {
+      assert(a[1] == BaseMedium::MESSAGE_CHUNKS_MAGIC);
+      message_id_start = 0;
+    } else {
+      assert(a[2] == BaseMedium::MESSAGE_ID_MAGIC);
+      assert(a[3] == BaseMedium::MESSAGE_CHUNKS_MAGIC);
+      message_id_start = 2;
+    }
+    a[message_id_start] = 0;
+    a[message_id_start + 1] = 1;
+    a[message_id_start + 2] = 0;
+    a[message_id_start + 3] = 0;
+  }
+
+  return shm_transport->send(target, msgid, a, num_args * sizeof(handlerarg_t),
+			     spans, payload_size, has_payload, dstptr);
 }
 			   
 void init_endpoints(int gasnet_mem_size_in_mb,
@@ -2478,6 +2700,21 @@ void init_endpoints(int gasnet_mem_size_in_mb,
       SrcDataPool::max_spill_bytes = ((size_t)atoi(argv[++i])) << 20; // convert MB to bytes
       continue;
     }
+
+    if(!strcmp(argv[i], "-ll:shm")) {
+      use_shm_transport = atoi(argv[++i]) != 0;
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-ll:shm_ring")) {
+      shm_ring_slots = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-ll:shm_arena")) {
+      shm_arena_size = ((size_t)atoi(argv[++i])) << 10; // convert KB to bytes
+      continue;
+    }
   }
 
   size_t total_lmb_size = (gasnet_nodes() * 
@@ -2489,7 +2726,8 @@ void init_endpoints(int gasnet_mem_size_in_mb,
 			(((size_t)registered_mem_size_in_mb) << 20) +
 			(((size_t)registered_ib_mem_size_in_mb) << 20) +
 			srcdatapool_size +
-			total_lmb_size);
+			total_lmb_size +
+			(use_shm_transport ? SHM_KEY_SIZE : 0));
 
   if(gasnet_mynode() == 0) {
     log_amsg.info("Pinned Memory Usage: GASNET=%d, RMEM=%d, IBRMEM=%d, LMB=%zd, SDP=%zd, total=%zd\n",
@@ -2559,6 +2797,7 @@ void init_endpoints(int gasnet_mem_size_in_mb,
   /*char *reg_ib_mem_base = my_segment;*/ my_segment += (registered_ib_mem_size_in_mb << 20);
   char *srcdatapool_base = my_segment;  my_segment += srcdatapool_size;
   /*char *lmb_base = my_segment;*/  my_segment += total_lmb_size;
+  char *shm_key_base = my_segment; if(use_shm_transport) my_segment += SHM_KEY_SIZE;
   assert(my_segment <= ((char *)(segment_info[gasnet_mynode()].addr) + segment_info[gasnet_mynode()].size)); 
 
 #ifndef NO_SRCDATAPOOL
@@ -2568,6 +2807,9 @@ void init_endpoints(int gasnet_mem_size_in_mb,
 
   endpoint_manager = new EndpointManager(gasnet_nodes(), crs);
 
+  if(use_shm_transport)
+    init_shm_transport(shm_key_base);
+
   init_deferred_frees();
 }
 
@@ -2578,6 +2820,9 @@ void do_some_polling(void)
   endpoint_manager->push_messages(max_msgs_to_send);
 
   CHECK_GASNET( gasnet_AMPoll() );
+
+  if(shm_transport)
+    shm_transport->poll(&shm_delivery);
 }
 
 void EndpointManager::start_polling_threads(int count)
@@ -2639,6 +2884,9 @@ void EndpointManager::polling_worker_loop(void)
 
     CHECK_GASNET( gasnet_AMPoll() );
 
+    if(shm_transport)
+      shm_transport->poll(&shm_delivery);
+
 #ifdef TRACE_MESSAGES
     // see if it's time to write out another update
     int now = (int)(Realm::Clock::current_time());
@@ -2699,6 +2947,18 @@ void enqueue_message(NodeID target, int msgid,
 {
   assert((gasnet_node_t)target != gasnet_mynode());
 
+  if(shm_transport) {
+    SpanList spans;
+    if(payload_size > 0)
+      spans.push_back(SpanListEntry(payload, payload_size));
+    if(shm_enqueue(target, msgid, args, arg_size,
+		   spans, payload_size, payload_mode, dstptr)) {
+      if(payload_mode == PAYLOAD_FREE)
+	free((void *)payload);
+      return;
+    }
+  }
+
   OutgoingMessage *hdr = new OutgoingMessage(msgid, 
 					     (arg_size + sizeof(int) - 1) / sizeof(int),
 					     args);
@@ -2730,6 +2990,20 @@ void enqueue_message(NodeID target, int msgid,
 {
   assert((gasnet_node_t)target != gasnet_mynode());
 
+  if(shm_transport) {
+    SpanList spans;
+    if(payload_mode != PAYLOAD_NONE)
+      for(size_t i = 0; i < line_count; i++)
+	spans.push_back(SpanListEntry(((const char *)payload) + (i * line_stride),
+				      line_size));
+    if(shm_enqueue(target, msgid, args, arg_size,
+		   spans, line_size * line_count, payload_mode, dstptr)) {
+      if(payload_mode == PAYLOAD_FREE)
+	free((void *)payload);
+      return;
+    }
+  }
+
   OutgoingMessage *hdr = new OutgoingMessage(msgid, 
 					     (arg_size + sizeof(int) - 1) / sizeof(int),
 					     args);
@@ -2755,6 +3029,12 @@ void enqueue_message(NodeID target, int msgid,
 {
   assert((gasnet_node_t)target != gasnet_mynode());
 
+  // the spans aren't a single allocation, so there's nothing to free here
+  //  for PAYLOAD_FREE (SpanPayload doesn't free them either)
+  if(shm_enqueue(target, msgid, args, arg_size,
+		 spans, payload_size, payload_mode, dstptr))
+    return;
+
   OutgoingMessage *hdr = new OutgoingMessage(msgid, 
   					     (arg_size + sizeof(int) - 1) / sizeof(int),
   					     args);
@@ -2776,6 +3056,10 @@ void handle_long_msgptr(NodeID source, const void *ptr)
 {
   assert((gasnet_node_t)source != gasnet_mynode());
 
+  // payloads that came through shared memory go back to the sender
+  if(shm_transport && shm_transport->release_payload(source, ptr))
+    return;
+
   endpoint_manager->handle_long_msgptr(source, ptr);
 }
 
@@ -2885,6 +3169,14 @@ GASNetHSL::~GASNetHSL(void)
 
 void GASNetHSL::lock(void)
 {
+  // most critical sections are short, so spin (with backoff) for a little
+  //  while before blocking
+  if(Realm::Config::lock_spin_iterations > 0) {
+    Realm::SpinBackoff backoff;
+    for(int spun = 0; spun < Realm::Config::lock_spin_iterations; spun += backoff.pause())
+      if(pthread_mutex_trylock(&mutex) == 0)
+	return;
+  }
   pthread_mutex_lock(&mutex);
 }
 
@@ -73,6 +73,7 @@
       XFERDES_CREATE_MSGID,
       XFERDES_DESTROY_MSGID,
       XFERDES_NOTIFY_COMPLETION_MSGID,
+      XFERDES_NOTIFY_TIMELINE_MSGID,
       XFERDES_UPDATE_BYTES_WRITE_MSGID,
       XFERDES_UPDATE_BYTES_READ_MSGID,
       REGISTER_TASK_MSGID,
@@ -20,6 +20,7 @@
 #include "realm/deppart/deppart_config.h"
 #include "realm/deppart/rectlist.h"
 #include "realm/deppart/inst_helper.h"
+#include "realm/deppart/scan_kernels.h"
 #include "realm/logging.h"
 
 namespace Realm {
@@ -53,6 +54,58 @@ namespace Realm {
     return e;
   }
 
+  template <int N, typename T>
+  template <typename FT>
+  Event IndexSpace<N,T>::update_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,FT> >& field_data,
+						    const std::vector<FT>& colors,
+						    const std::vector<IndexSpace<N,T> >& prev_subspaces,
+						    const IndexSpace<N,T>& changed,
+						    std::vector<IndexSpace<N,T> >& subspaces,
+						    const ProfilingRequestSet &reqs,
+						    Event wait_on /*= Event::NO_EVENT*/) const
+  {
+    // output vector should start out empty
+    assert(subspaces.empty());
+    assert(prev_subspaces.size() == colors.size());
+
+    // record the start time of the potentially-inline operation if any
+    //  profiling has been requested
+    long long inline_start_time = reqs.empty() ? 0 : Clock::current_time_in_nanoseconds();
+
+    // nothing changed - the old subspaces are still correct
+    if(changed.empty()) {
+      subspaces = prev_subspaces;
+      PartitioningOperation::do_inline_profiling(reqs, inline_start_time);
+      return wait_on;
+    }
+
+    // only changed points in our space can end up in a subspace
+    IndexSpace<N,T> delta = changed;
+    Event e = wait_on;
+    if(!dense() || !bounds.contains(changed.bounds))
+      e = compute_intersection(changed, *this, delta, ProfilingRequestSet(), wait_on);
+
+    // the changed points are colored by a by-field over just them (so only
+    //  their part of the field data is read), and everything else keeps its
+    //  old color - differences with 'changed' leave subspaces that don't
+    //  overlap it untouched
+    std::vector<IndexSpace<N,T> > added, kept;
+    Event e1 = delta.create_subspaces_by_field(field_data, colors, added,
+						ProfilingRequestSet(), e);
+    Event e2 = compute_differences(prev_subspaces,
+				   std::vector<IndexSpace<N,T> >(1, changed),
+				   kept, ProfilingRequestSet(), wait_on);
+    Event e3 = compute_unions(kept, added, subspaces, reqs,
+			      Event::merge_events(e1, e2));
+
+    for(size_t i = 0; i < colors.size(); i++)
+      log_dpops.info() << "byfield update: " << *this << ", " << colors[i] << ": " << prev_subspaces[i]
+		       << " + " << changed << " -> " << subspaces[i] << " (" << e3 << ")";
+
+    return e3;
+  }
+
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -105,21 +158,63 @@ namespace Realm {
     sparsity_outputs[_val] = _sparsity;
   }
 
+  template <int N, typename T, typename FT>
+  void ByFieldMicroOp<N,T,FT>::get_pieces(std::vector<Rect<N,T> >& pieces,
+					  size_t& volume) const
+  {
+    volume = 0;
+    // double iteration - use the instance's space first, since it's probably smaller
+    for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step())
+      for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
+	pieces.push_back(it2.rect);
+	volume += it2.rect.volume();
+      }
+  }
+
   template <int N, typename T, typename FT>
   template <typename BM>
-  void ByFieldMicroOp<N,T,FT>::populate_bitmasks(std::map<FT, BM *>& bitmasks)
+  void ByFieldMicroOp<N,T,FT>::populate_bitmasks(const std::vector<Rect<N,T> >& pieces,
+						 std::map<FT, BM *>& bitmasks)
   {
     // for now, one access for the whole instance
     AffineAccessor<FT,N,T> a_data(inst, field_offset);
 
-    // double iteration - use the instance's space first, since it's probably smaller
-    for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
-      for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
-	const Rect<N,T>& r = it2.rect;
-	Point<N,T> p = r.lo;
-	while(true) {
+    // if the values along each line are packed, the strips of equal values
+    //  can be found with the run kernels instead of a read per point
+    bool use_runs = ((ScanKernels::get_level() >= ScanKernels::LEVEL_SCALAR) &&
+		     (a_data.strides[0] == (ptrdiff_t)sizeof(FT)));
+    // the bitmask of the last run, so that a color that carries on into
+    //  the next line (or piece) doesn't need another map lookup
+    FT last_val = FT();
+    BM *last_bmp = 0;
+
+    for(typename std::vector<Rect<N,T> >::const_iterator it = pieces.begin();
+	it != pieces.end();
+	++it) {
+      const Rect<N,T>& r = *it;
+      Point<N,T> p = r.lo;
+      while(true) {
+	Point<N,T> p2 = p;
+	if(use_runs) {
+	  const FT *vals = a_data.ptr(p);
+	  size_t count = size_t(r.hi.x - r.lo.x) + 1;
+	  size_t i = 0;
+	  while(i < count) {
+	    size_t len = ScanKernels::equal_run(vals + i, count - i);
+	    p.x = r.lo.x + T(i);
+	    p2.x = r.lo.x + T(i + len - 1);
+	    if(!last_bmp || !(vals[i] == last_val)) {
+	      BM *&bmp = bitmasks[vals[i]];
+	      if(!bmp) bmp = new BM;
+	      last_val = vals[i];
+	      last_bmp = bmp;
+	    }
+	    last_bmp->add_rect(Rect<N,T>(p,p2));
+	    i += len;
+	  }
+	  p.x = r.lo.x;
+	} else {
 	  FT val = a_data.read(p);
-	  Point<N,T> p2 = p;
 	  while(p2.x < r.hi.x) {
 	    Point<N,T> p3 = p2;
 	    p3.x++;
@@ -140,32 +235,58 @@ namespace Realm {
 	  if(!bmp) bmp = new BM;
 	  bmp->add_rect(Rect<N,T>(p,p2));
 	  //std::cout << val << ": " << p << ".." << p2 << std::endl;
+	}
 
-	  // are we done?
-	  if(p2 == r.hi) break;
+	// are we done?
+	if(p2 == r.hi) break;
 
-	  // now go to the next span, if there is one (can't be in 1-D)
-	  assert(N > 1);
-	  for(int i = 0; i < (N - 1); i++) {
-	    p[i] = r.lo[i];
-	    if(p[i + 1] < r.hi[i+1]) {
-	      p[i + 1] += 1;
-	      break;
-	    }
+	// now go to the next span, if there is one (can't be in 1-D)
+	assert(N > 1);
+	for(int i = 0; i < (N - 1); i++) {
+	  p[i] = r.lo[i];
+	  if(p[i + 1] < r.hi[i+1]) {
+	    p[i + 1] += 1;
+	    break;
 	  }
 	}
       }
     }
   }
 
+  // each chunk of work scans one chunk of the instance's pieces into its own
+  //  set of lists
+  template <int N, typename T, typename FT>
+  class ByFieldMicroOp<N,T,FT>::ChunkScanner : public PartitioningChunkedWork {
+  public:
+    ChunkScanner(ByFieldMicroOp<N,T,FT> *_uop,
+		 const std::vector<std::vector<Rect<N,T> > >& _chunks,
+		 std::vector<std::map<FT, DenseRectangleList<N,T> *> >& _chunk_lists)
+      : uop(_uop), chunks(_chunks), chunk_lists(_chunk_lists) {}
+
+    virtual void execute_chunk(size_t index)
+    {
+      uop->populate_bitmasks(chunks[index], chunk_lists[index]);
+    }
+
+  protected:
+    ByFieldMicroOp<N,T,FT> *uop;
+    const std::vector<std::vector<Rect<N,T> > >& chunks;
+    std::vector<std::map<FT, DenseRectangleList<N,T> *> >& chunk_lists;
+  };
+
   template <int N, typename T, typename FT>
   void ByFieldMicroOp<N,T,FT>::execute(void)
   {
     TimeStamp ts("ByFieldMicroOp::execute", true, &log_uop_timing);
+
+    std::vector<Rect<N,T> > pieces;
+    size_t volume;
+    get_pieces(pieces, volume);
+
 #ifdef DEBUG_PARTITIONING
     std::map<FT, CoverageCounter<N,T> *> values_present;
 
-    populate_bitmasks(values_present);
+    populate_bitmasks(pieces, values_present);
 
     std::cout << values_present.size() << " values present in instance " << inst << std::endl;
     for(typename std::map<FT, CoverageCounter<N,T> *>::const_iterator it = values_present.begin();
@@ -174,9 +295,39 @@ namespace Realm {
       std::cout << "  " << it->first << " = " << it->second->get_count() << std::endl;
 #endif
 
-    std::map<FT, DenseRectangleList<N,T> *> rect_map;
+    // a big enough instance is split into chunks that several workers scan
+    //  at once, each into its own lists, which are then merged
+    std::vector<std::vector<Rect<N,T> > > chunks;
+    size_t num_chunks = PartitioningOpQueue::choose_chunk_count(volume);
+    if(num_chunks > 1)
+      split_into_chunks(pieces, num_chunks, chunks);
+    else
+      chunks.push_back(pieces);
+    std::vector<std::map<FT, DenseRectangleList<N,T> *> > chunk_lists(chunks.size());
+
+    // the lists for values we're looking for are created up front so that
+    //  they can turn into bitmaps if they get big
+    Rect<N,T> limits = parent_space.bounds.intersection(inst_space.bounds);
+    for(size_t i = 0; i < chunk_lists.size(); i++)
+      for(typename std::map<FT, SparsityMap<N,T> >::const_iterator it = sparsity_outputs.begin();
+	  it != sparsity_outputs.end();
+	  it++) {
+	DenseRectangleList<N,T> *drl = new DenseRectangleList<N,T>;
+	drl->enable_bitmap(limits);
+	chunk_lists[i][it->first] = drl;
+      }
 
-    populate_bitmasks(rect_map);
+    std::map<FT, DenseRectangleList<N,T> *> rect_map;
+    if(chunks.size() > 1) {
+      ChunkScanner scanner(this, chunks, chunk_lists);
+      PartitioningOpQueue::execute_chunks(scanner, chunks.size());
+      ChunkListMerger<FT, DenseRectangleList<N,T> > merger(chunk_lists);
+      merger.merge();
+      log_part.info() << "byfield: " << volume << " points scanned in " << chunks.size() << " chunks";
+    } else if(!chunks.empty())
+      populate_bitmasks(chunks[0], chunk_lists[0]);
+    if(!chunk_lists.empty())
+      rect_map.swap(chunk_lists[0]);
 
 #ifdef DEBUG_PARTITIONING
     std::cout << values_present.size() << " values present in instance " << inst << std::endl;
@@ -193,11 +344,15 @@ namespace Realm {
 	it++) {
       SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(it->second);
       typename std::map<FT, DenseRectangleList<N,T> *>::const_iterator it2 = rect_map.find(it->first);
-      if(it2 != rect_map.end()) {
-	impl->contribute_dense_rect_list(it2->second->rects);
+      if((it2 != rect_map.end()) &&
+	 (!it2->second->rects.empty() || it2->second->bitmap)) {
+	impl->contribute_dense_rect_list(*(it2->second));
 	delete it2->second;
-      } else
+      } else {
+	if(it2 != rect_map.end())
+	  delete it2->second;
 	impl->contribute_nothing();
+      }
     }
   }
 
@@ -334,6 +489,13 @@ namespace Realm {
 							     const std::vector<F>&, \
 							     std::vector<IndexSpace<N,T> >&, \
 							     const ProfilingRequestSet &, \
+							     Event) const; \
+  template Event IndexSpace<N,T>::update_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,F> >&, \
+							     const std::vector<F>&, \
+							     const std::vector<IndexSpace<N,T> >&, \
+							     const IndexSpace<N,T>&, \
+							     std::vector<IndexSpace<N,T> >&, \
+							     const ProfilingRequestSet &, \
 							     Event) const;
   FOREACH_NTF(DOIT)
 
@@ -54,8 +54,14 @@ namespace Realm {
     template <typename S>
     ByFieldMicroOp(NodeID _requestor, AsyncMicroOp *_async_microop, S& s);
 
+    // the pieces of the instance's space that are also in the parent space
+    void get_pieces(std::vector<Rect<N,T> >& pieces, size_t& volume) const;
+
     template <typename BM>
-    void populate_bitmasks(std::map<FT, BM *>& bitmasks);
+    void populate_bitmasks(const std::vector<Rect<N,T> >& pieces,
+			   std::map<FT, BM *>& bitmasks);
+
+    class ChunkScanner;
 
     IndexSpace<N,T> parent_space, inst_space;
     RegionInstance inst;
@@ -27,6 +27,11 @@ namespace Realm {
     extern int cfg_max_rects_in_approximation;
     extern size_t cfg_max_bytes_per_packet;
     extern bool cfg_worker_threads_sleep;
+    extern int cfg_bitmap_min_rects;
+    extern int cfg_bitmap_max_bits_per_rect;
+    extern int cfg_max_chunks_per_microop;
+    extern size_t cfg_min_points_per_chunk;
+    extern int cfg_scan_kernels;
 
   };
 
@@ -21,6 +21,7 @@
 #include "realm/deppart/rectlist.h"
 #include "realm/deppart/inst_helper.h"
 #include "realm/deppart/preimage.h"
+#include "realm/deppart/scan_kernels.h"
 #include "realm/logging.h"
 
 namespace Realm {
@@ -105,6 +106,187 @@ namespace Realm {
     return e;
   }
 
+  // a conservative overlap test that doesn't block - it's precise only if
+  //  the sparsity data for both spaces is already available
+  template <int N, typename T>
+  static bool may_overlap(const IndexSpace<N,T>& a, const IndexSpace<N,T>& b)
+  {
+    if(!a.bounds.overlaps(b.bounds))
+      return false;
+    if(a.is_valid(true /*precise*/) && b.is_valid(true /*precise*/))
+      return a.overlaps(b);
+    return true;
+  }
+
+  template <int N, typename T>
+  template <int N2, typename T2>
+  Event IndexSpace<N,T>::update_subspaces_by_image(const std::vector<FieldDataDescriptor<IndexSpace<N2,T2>,Point<N,T> > >& field_data,
+						    const std::vector<IndexSpace<N2,T2> >& prev_sources,
+						    const std::vector<IndexSpace<N,T> >& prev_images,
+						    const std::vector<IndexSpace<N2,T2> >& sources,
+						    const IndexSpace<N2,T2>& changed,
+						    std::vector<IndexSpace<N,T> >& images,
+						    const ProfilingRequestSet &reqs,
+						    Event wait_on /*= Event::NO_EVENT*/) const
+  {
+    // output vector should start out empty
+    assert(images.empty());
+
+    size_t n = sources.size();
+    assert((prev_sources.size() == n) && (prev_images.size() == n));
+    images.resize(n);
+
+    // record the start time of the potentially-inline operation if any
+    //  profiling has been requested
+    long long inline_start_time = reqs.empty() ? 0 : Clock::current_time_in_nanoseconds();
+
+    // sort the sources by how much work they need - this can't wait for any
+    //  sparsity data, so a source that might have lost (or repointed) a point
+    //  is always recomputed
+    std::vector<size_t> grown_idxs, redo_idxs;
+    std::vector<IndexSpace<N2,T2> > grown_sources, redo_sources;
+    std::vector<IndexSpace<N,T> > grown_prevs;
+    for(size_t i = 0; i < n; i++) {
+      if(may_overlap(prev_sources[i], changed)) {
+	redo_idxs.push_back(i);
+	redo_sources.push_back(sources[i]);
+      } else if(may_overlap(sources[i], changed)) {
+	grown_idxs.push_back(i);
+	grown_sources.push_back(sources[i]);
+	grown_prevs.push_back(prev_images[i]);
+      } else {
+	images[i] = prev_images[i];
+	log_dpops.info() << "image update: " << *this << " src=" << sources[i] << " -> " << images[i] << " (unchanged)";
+      }
+    }
+
+    if(grown_idxs.empty() && redo_idxs.empty()) {
+      PartitioningOperation::do_inline_profiling(reqs, inline_start_time);
+      return wait_on;
+    }
+
+    // every image that changes comes out of one final union (a recomputed
+    //  one is just unioned with an empty space, which passes it through),
+    //  so that 'reqs' gets exactly one response
+    std::vector<IndexSpace<N,T> > lhss, rhss;
+    std::vector<Event> events;
+
+    // sources that only gained points add the image of just those points
+    if(!grown_idxs.empty()) {
+      std::vector<IndexSpace<N2,T2> > gained;
+      std::vector<IndexSpace<N,T> > added;
+      Event e1 = IndexSpace<N2,T2>::compute_intersections(grown_sources,
+							   std::vector<IndexSpace<N2,T2> >(1, changed),
+							   gained, ProfilingRequestSet(), wait_on);
+      Event e2 = create_subspaces_by_image(field_data, gained, added,
+					   ProfilingRequestSet(), e1);
+      lhss.insert(lhss.end(), grown_prevs.begin(), grown_prevs.end());
+      rhss.insert(rhss.end(), added.begin(), added.end());
+      events.push_back(e2);
+    }
+
+    // the rest start over
+    if(!redo_idxs.empty()) {
+      std::vector<IndexSpace<N,T> > redone;
+      Event e = create_subspaces_by_image(field_data, redo_sources, redone,
+					  ProfilingRequestSet(), wait_on);
+      lhss.insert(lhss.end(), redo_idxs.size(), IndexSpace<N,T>::make_empty());
+      rhss.insert(rhss.end(), redone.begin(), redone.end());
+      events.push_back(e);
+    }
+
+    std::vector<IndexSpace<N,T> > results;
+    Event e = compute_unions(lhss, rhss, results, reqs,
+			     Event::merge_events(events));
+    for(size_t i = 0; i < grown_idxs.size(); i++) {
+      images[grown_idxs[i]] = results[i];
+      log_dpops.info() << "image update: " << *this << " src=" << grown_sources[i] << " -> " << results[i] << " (" << e << ")";
+    }
+    for(size_t i = 0; i < redo_idxs.size(); i++) {
+      images[redo_idxs[i]] = results[grown_idxs.size() + i];
+      log_dpops.info() << "image update: " << *this << " src=" << redo_sources[i] << " -> " << results[grown_idxs.size() + i] << " (" << e << ")";
+    }
+    return e;
+  }
+
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // run scans for image micro-ops
+
+  // steps 'p' to the start of the next line (i.e. run along the first
+  //  dimension) of 'r' - returns false once there are no more
+  template <int N, typename T>
+  static bool next_line(const Rect<N,T>& r, Point<N,T>& p)
+  {
+    for(int d = 1; d < N; d++) {
+      if(p[d] < r.hi[d]) {
+	p[d]++;
+	return true;
+      }
+      p[d] = r.lo[d];
+    }
+    return false;
+  }
+
+  // adds the image of the points in 'r' a run of consecutive pointers at a
+  //  time - only pointers into a 1-D space can do that, so anything else
+  //  declines and gets handled point by point
+  template <int N, typename T>
+  struct PointerRunScanner {
+    template <int N2, typename T2, typename BM>
+    static bool scan(const AffineAccessor<Point<N,T>,N2,T2>& a_data,
+		     const Rect<N2,T2>& r,
+		     const IndexSpace<N,T>& parent_space,
+		     const IndexSpace<N,T> *diff_rhs,
+		     BM *&bmp)
+    {
+      return false;
+    }
+  };
+
+  template <typename T>
+  struct PointerRunScanner<1,T> {
+    template <int N2, typename T2, typename BM>
+    static bool scan(const AffineAccessor<Point<1,T>,N2,T2>& a_data,
+		     const Rect<N2,T2>& r,
+		     const IndexSpace<1,T>& parent_space,
+		     const IndexSpace<1,T> *diff_rhs,
+		     BM *&bmp)
+    {
+      if((ScanKernels::get_level() < ScanKernels::LEVEL_SCALAR) ||
+	 (a_data.strides[0] != (ptrdiff_t)sizeof(Point<1,T>)))
+	return false;
+
+      size_t count = size_t(r.hi[0] - r.lo[0]) + 1;
+      Point<N2,T2> p = r.lo;
+      do {
+	const T *ptrs = reinterpret_cast<const T *>(a_data.ptr(p));
+	size_t i = 0;
+	while(i < count) {
+	  size_t len = ScanKernels::affine_run(ptrs + i, count - i);
+	  Rect<1,T> targets(ptrs[i], ptrs[i] + T(len - 1));
+	  i += len;
+
+	  // only the parts in the parent space (and not in the optional
+	  //  filter) are part of the image
+	  for(IndexSpaceIterator<1,T> it(parent_space, targets); it.valid; it.step()) {
+	    if(!bmp) bmp = new BM;
+	    if(!diff_rhs) {
+	      bmp->add_rect(it.rect);
+	      continue;
+	    }
+	    for(PointInRectIterator<1,T> pir(it.rect); pir.valid; pir.step())
+	      if(!diff_rhs->contains(pir.p))
+		bmp->add_point(pir.p);
+	  }
+	}
+      } while(next_line(r, p));
+      return true;
+    }
+  };
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -163,17 +345,37 @@ namespace Realm {
 
   template <int N, typename T, int N2, typename T2>
   template <typename BM>
-  void ImageMicroOp<N,T,N2,T2>::populate_bitmasks_ptrs(std::map<int, BM *>& bitmasks)
+  void ImageMicroOp<N,T,N2,T2>::populate_bitmasks_ptrs(const std::vector<Rect<N2,T2> >& pieces,
+						       std::map<int, BM *>& bitmasks)
   {
     // for now, one access for the whole instance
     AffineAccessor<Point<N,T>,N2,T2> a_data(inst, field_offset);
+    bool use_runs = (N == 1);
+
+    // only visit the sources that actually overlap each piece of the instance
+    SpaceIndex<N2,T2> source_index(sources);
+    std::vector<int> found;
 
     // double iteration - use the instance's space first, since it's probably smaller
-    for(IndexSpaceIterator<N2,T2> it(inst_space); it.valid; it.step()) {
-      for(size_t i = 0; i < sources.size(); i++) {
-	for(IndexSpaceIterator<N2,T2> it2(sources[i], it.rect); it2.valid; it2.step()) {
+    for(typename std::vector<Rect<N2,T2> >::const_iterator it = pieces.begin();
+	it != pieces.end();
+	++it) {
+      found.clear();
+      source_index.find_rect(*it, found);
+      for(size_t j = 0; j < found.size(); j++) {
+	int i = found[j];
+	for(IndexSpaceIterator<N2,T2> it2(sources[i], *it); it2.valid; it2.step()) {
 	  BM **bmpp = 0;
 
+	  // consecutive pointers can be handled a whole run at a time
+	  if(use_runs) {
+	    bmpp = &bitmasks[i];
+	    if(PointerRunScanner<N,T>::scan(a_data, it2.rect, parent_space,
+					    (diff_rhss.empty() ? 0 : &diff_rhss[i]),
+					    *bmpp))
+	      continue;
+	  }
+
 	  // iterate over each point in the source and see if it points into the parent space	  
 	  for(PointInRectIterator<N2,T2> pir(it2.rect); pir.valid; pir.step()) {
 	    Point<N,T> ptr = a_data.read(pir.p);
@@ -198,17 +400,55 @@ namespace Realm {
 
   template <int N, typename T, int N2, typename T2>
   template <typename BM>
-  void ImageMicroOp<N,T,N2,T2>::populate_bitmasks_ranges(std::map<int, BM *>& bitmasks)
+  void ImageMicroOp<N,T,N2,T2>::populate_bitmasks_ranges(const std::vector<Rect<N2,T2> >& pieces,
+							 std::map<int, BM *>& bitmasks)
   {
     // for now, one access for the whole instance
     AffineAccessor<Rect<N,T>,N2,T2> a_data(inst, field_offset);
 
+    // if the ranges along each line are packed, repeats of the same range
+    //  can be found with the run kernels and tested just once
+    bool use_runs = ((ScanKernels::get_level() >= ScanKernels::LEVEL_SCALAR) &&
+		     (a_data.strides[0] == (ptrdiff_t)sizeof(Rect<N,T>)));
+
+    // only visit the sources that actually overlap each piece of the instance
+    SpaceIndex<N2,T2> source_index(sources);
+    std::vector<int> found;
+
     // double iteration - use the instance's space first, since it's probably smaller
-    for(IndexSpaceIterator<N2,T2> it(inst_space); it.valid; it.step()) {
-      for(size_t i = 0; i < sources.size(); i++) {
-	for(IndexSpaceIterator<N2,T2> it2(sources[i], it.rect); it2.valid; it2.step()) {
+    for(typename std::vector<Rect<N2,T2> >::const_iterator it = pieces.begin();
+	it != pieces.end();
+	++it) {
+      found.clear();
+      source_index.find_rect(*it, found);
+      for(size_t j = 0; j < found.size(); j++) {
+	int i = found[j];
+	for(IndexSpaceIterator<N2,T2> it2(sources[i], *it); it2.valid; it2.step()) {
 	  BM **bmpp = 0;
 
+	  if(use_runs) {
+	    size_t count = size_t(it2.rect.hi[0] - it2.rect.lo[0]) + 1;
+	    Point<N2,T2> p = it2.rect.lo;
+	    do {
+	      const Rect<N,T> *rngs = a_data.ptr(p);
+	      size_t k = 0;
+	      while(k < count) {
+		const Rect<N,T>& rng = rngs[k];
+		k += ScanKernels::equal_run(rngs + k, count - k);
+
+		if(!parent_space.contains_any(rng))
+		  continue;
+		// optional filter
+		if(!diff_rhss.empty() && diff_rhss[i].contains_all(rng))
+		  continue;
+		if(!bmpp) bmpp = &bitmasks[i];
+		if(!*bmpp) *bmpp = new BM;
+		(*bmpp)->add_rect(rng);
+	      }
+	    } while(next_line(it2.rect, p));
+	    continue;
+	  }
+
 	  // iterate over each point in the source and see if it points into the parent space	  
 	  for(PointInRectIterator<N2,T2> pir(it2.rect); pir.valid; pir.step()) {
 	    Rect<N,T> rng = a_data.read(pir.p);
@@ -269,19 +509,79 @@ namespace Realm {
     }
   }
 
+  // each chunk of work scans one chunk of the instance's pieces into its own
+  //  set of lists
+  template <int N, typename T, int N2, typename T2>
+  class ImageMicroOp<N,T,N2,T2>::ChunkScanner : public PartitioningChunkedWork {
+  public:
+    ChunkScanner(ImageMicroOp<N,T,N2,T2> *_uop,
+		 const std::vector<std::vector<Rect<N2,T2> > >& _chunks,
+		 std::vector<std::map<int, HybridRectangleList<N,T> *> >& _chunk_lists)
+      : uop(_uop), chunks(_chunks), chunk_lists(_chunk_lists) {}
+
+    virtual void execute_chunk(size_t index)
+    {
+      if(uop->is_ranged)
+	uop->populate_bitmasks_ranges(chunks[index], chunk_lists[index]);
+      else
+	uop->populate_bitmasks_ptrs(chunks[index], chunk_lists[index]);
+    }
+
+  protected:
+    ImageMicroOp<N,T,N2,T2> *uop;
+    const std::vector<std::vector<Rect<N2,T2> > >& chunks;
+    std::vector<std::map<int, HybridRectangleList<N,T> *> >& chunk_lists;
+  };
+
   template <int N, typename T, int N2, typename T2>
   void ImageMicroOp<N,T,N2,T2>::execute(void)
   {
     TimeStamp ts("ImageMicroOp::execute", true, &log_uop_timing);
 
     if(!sparsity_outputs.empty()) {
+      // a big enough instance is split into chunks that several workers scan
+      //  at once, each into its own lists, which are then merged
+      std::vector<Rect<N2,T2> > pieces;
+      size_t volume = 0;
+      for(IndexSpaceIterator<N2,T2> it(inst_space); it.valid; it.step()) {
+	pieces.push_back(it.rect);
+	volume += it.rect.volume();
+      }
+      std::vector<std::vector<Rect<N2,T2> > > chunks;
+      size_t num_chunks = PartitioningOpQueue::choose_chunk_count(volume);
+      if(num_chunks > 1)
+	split_into_chunks(pieces, num_chunks, chunks);
+      else
+	chunks.push_back(pieces);
+      std::vector<std::map<int, HybridRectangleList<N,T> *> > chunk_lists(chunks.size());
+
+      // point images land in the parent's bounds, so the lists can be
+      //  created up front and allowed to turn into bitmaps - ranges aren't
+      //  clipped to the parent, so they stay as rectangles
+      if(!is_ranged)
+	for(size_t c = 0; c < chunk_lists.size(); c++)
+	  for(size_t i = 0; i < sparsity_outputs.size(); i++) {
+	    HybridRectangleList<N,T> *hrl = new HybridRectangleList<N,T>;
+	    hrl->enable_bitmap(parent_space.bounds);
+	    chunk_lists[c][i] = hrl;
+	  }
+
       //std::map<int, DenseRectangleList<N,T> *> rect_map;
       std::map<int, HybridRectangleList<N,T> *> rect_map;
-
-      if(is_ranged)
-	populate_bitmasks_ranges(rect_map);
-      else
-	populate_bitmasks_ptrs(rect_map);
+      if(chunks.size() > 1) {
+	ChunkScanner scanner(this, chunks, chunk_lists);
+	PartitioningOpQueue::execute_chunks(scanner, chunks.size());
+	ChunkListMerger<int, HybridRectangleList<N,T> > merger(chunk_lists);
+	merger.merge();
+	log_part.info() << "image: " << volume << " points scanned in " << chunks.size() << " chunks";
+      } else if(!chunks.empty()) {
+	if(is_ranged)
+	  populate_bitmasks_ranges(chunks[0], chunk_lists[0]);
+	else
+	  populate_bitmasks_ptrs(chunks[0], chunk_lists[0]);
+      }
+      if(!chunk_lists.empty())
+	rect_map.swap(chunk_lists[0]);
 
 #ifdef DEBUG_PARTITIONING
       std::cout << rect_map.size() << " non-empty images present in instance " << inst << std::endl;
@@ -297,7 +597,13 @@ namespace Realm {
 	SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(sparsity_outputs[i]);
 	typename std::map<int, HybridRectangleList<N,T> *>::const_iterator it2 = rect_map.find(i);
 	if(it2 != rect_map.end()) {
-	  impl->contribute_dense_rect_list(it2->second->convert_to_vector());
+	  HierarchicalBitMap<N,T> *bitmap = it2->second->take_bitmap();
+	  if(bitmap)
+	    impl->contribute_bitmap(bitmap);
+	  else if(!it2->second->convert_to_vector().empty())
+	    impl->contribute_dense_rect_list(it2->second->convert_to_vector());
+	  else
+	    impl->contribute_nothing();
 	  delete it2->second;
 	} else
 	  impl->contribute_nothing();
@@ -655,7 +961,14 @@ namespace Realm {
 									       const std::vector<IndexSpace<N1,T1> >&,	\
 									       std::vector<IndexSpace<N1,T1> >&, \
 									       const ProfilingRequestSet&, \
-									       Event) const;
-
+									       Event) const; \
+  template Event IndexSpace<N1,T1>::update_subspaces_by_image(const std::vector<FieldDataDescriptor<IndexSpace<N2,T2>,Point<N1,T1> > >&, \
+							       const std::vector<IndexSpace<N2,T2> >&, \
+							       const std::vector<IndexSpace<N1,T1> >&, \
+							       const std::vector<IndexSpace<N2,T2> >&, \
+							       const IndexSpace<N2,T2>&, \
+							       std::vector<IndexSpace<N1,T1> >&, \
+							       const ProfilingRequestSet&, \
+							       Event) const;
   FOREACH_NTNT(DOIT)
 };
@@ -58,10 +58,14 @@ namespace Realm {
     ImageMicroOp(NodeID _requestor, AsyncMicroOp *_async_microop, S& s);
 
     template <typename BM>
-    void populate_bitmasks_ptrs(std::map<int, BM *>& bitmasks);
+    void populate_bitmasks_ptrs(const std::vector<Rect<N2,T2> >& pieces,
+				std::map<int, BM *>& bitmasks);
 
     template <typename BM>
-    void populate_bitmasks_ranges(std::map<int, BM *>& bitmasks);
+    void populate_bitmasks_ranges(const std::vector<Rect<N2,T2> >& pieces,
+				  std::map<int, BM *>& bitmasks);
+
+    class ChunkScanner;
 
     template <typename BM>
     void populate_approx_bitmask_ptrs(BM& bitmask);
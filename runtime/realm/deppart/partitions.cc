@@ -48,6 +48,18 @@ namespace Realm {
     int cfg_max_rects_in_approximation = 32;
     size_t cfg_max_bytes_per_packet = 2048;//32768;
     bool cfg_worker_threads_sleep = false;
+    // sparsity maps with at least this many rectangles (0 = never) are stored
+    //  as a bitmap instead, as long as the bounding box has no more than this
+    //  many points per rectangle
+    int cfg_bitmap_min_rects = 256;
+    int cfg_bitmap_max_bits_per_rect = 512;
+    // micro-ops with enough local data split it into chunks that the
+    //  partitioning workers scan in parallel - no more than this many chunks
+    //  (0 = one per worker), each with at least this many points
+    int cfg_max_chunks_per_microop = 0;
+    size_t cfg_min_points_per_chunk = 65536;
+    // highest ScanKernels::Level to use for finding runs in field data
+    int cfg_scan_kernels = 3;
   };
 
   // TODO: C++11 has type_traits and std::make_unsigned
@@ -240,48 +252,133 @@ namespace Realm {
   void OverlapTester<N,T>::add_index_space(int label, const IndexSpace<N,T>& space,
 					   bool use_approx /*= true*/)
   {
-    labels.push_back(label);
-    spaces.push_back(space);
-    approxs.push_back(use_approx);
+    if(use_approx) {
+      if(space.dense())
+	rtree.add_rect(space.bounds, label);
+      else {
+	SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(space.sparsity);
+	const std::vector<Rect<N,T> >& approx_rects = impl->get_approx_rects();
+	for(size_t i = 0; i < approx_rects.size(); i++)
+	  rtree.add_rect(space.bounds.intersection(approx_rects[i]), label);
+      }
+    } else {
+      for(IndexSpaceIterator<N,T> it(space); it.valid; it.step())
+	rtree.add_rect(it.rect, label);
+    }
   }
 
   template <int N, typename T>
   void OverlapTester<N,T>::construct(void)
   {
-    // nothing special yet
+    rtree.construct_tree();
   }
 
   template <int N, typename T>
   void OverlapTester<N,T>::test_overlap(const Rect<N,T> *rects, size_t count, std::set<int>& overlaps)
   {
-    for(size_t i = 0; i < labels.size(); i++)
-      if(approxs[i]) {
-	for(size_t j = 0; j < count; j++)
-	  if(spaces[i].overlaps_approx(rects[j])) {
-	    overlaps.insert(labels[i]);
-	    break;
-	  }
-      } else {
-	for(size_t j = 0; j < count; j++)
-	  if(spaces[i].overlaps(rects[j])) {
-	    overlaps.insert(labels[i]);
-	    break;
-	  }
-      }
+    for(size_t i = 0; i < count; i++)
+      rtree.test_rect(rects[i], overlaps);
   }
 
   template <int N, typename T>
   void OverlapTester<N,T>::test_overlap(const IndexSpace<N,T>& space, std::set<int>& overlaps,
 					bool approx)
   {
-    for(size_t i = 0; i < labels.size(); i++)
-      if(approxs[i] && approx) {
-	if(space.overlaps_approx(spaces[i]))
-	  overlaps.insert(labels[i]);
+    if(space.dense()) {
+      rtree.test_rect(space.bounds, overlaps);
+    } else {
+      if(approx) {
+	SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(space.sparsity);
+	const std::vector<Rect<N,T> >& approx_rects = impl->get_approx_rects();
+	for(size_t i = 0; i < approx_rects.size(); i++)
+	  rtree.test_rect(space.bounds.intersection(approx_rects[i]), overlaps);
       } else {
-	if(space.overlaps(spaces[i]))
-	  overlaps.insert(labels[i]);
+	for(IndexSpaceIterator<N,T> it(space); it.valid; it.step())
+	  rtree.test_rect(it.rect, overlaps);
       }
+    }
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SpaceIndex<N,T>
+
+  template <int N, typename T>
+  SpaceIndex<N,T>::SpaceIndex(const std::vector<IndexSpace<N,T> >& spaces)
+    : last_found(spaces.size(), 0)
+    , query_count(0)
+  {
+    for(size_t i = 0; i < spaces.size(); i++) {
+      if(spaces[i].empty())
+	continue;
+
+      if(spaces[i].dense()) {
+	rtree.add_rect(spaces[i].bounds, piece_spaces.size());
+	piece_spaces.push_back(i);
+	piece_bitmaps.push_back(0);
+	continue;
+      }
+
+      SparsityMapPublicImpl<N,T> *impl = spaces[i].sparsity.impl();
+      const std::vector<SparsityMapEntry<N,T> >& entries = impl->get_entries();
+      for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = entries.begin();
+	  it != entries.end();
+	  it++) {
+	assert(!it->sparsity.exists());
+	Rect<N,T> isect = spaces[i].bounds.intersection(it->bounds);
+	if(isect.empty())
+	  continue;
+	rtree.add_rect(isect, piece_spaces.size());
+	piece_spaces.push_back(i);
+	piece_bitmaps.push_back(it->bitmap);
+      }
+    }
+    rtree.construct_tree();
+  }
+
+  template <int N, typename T>
+  class SpaceIndex<N,T>::PieceMarker {
+  public:
+    PieceMarker(SpaceIndex<N,T>& _index, const Rect<N,T>& _query,
+		std::vector<int>& _found)
+      : index(_index), query(_query), found(_found) {}
+
+    bool mark_overlap(const Rect<N,T>& r, size_t piece)
+    {
+      int space = index.piece_spaces[piece];
+      if(index.last_found[space] == index.query_count)
+	return false;
+      const HierarchicalBitMap<N,T> *bitmap = index.piece_bitmaps[piece];
+      if(bitmap != 0) {
+	size_t pos = 0;
+	Rect<N,T> run;
+	if(!bitmap->next_run(query.intersection(r), pos, run))
+	  return false;
+      }
+      index.last_found[space] = index.query_count;
+      found.push_back(space);
+      return false;
+    }
+
+  protected:
+    SpaceIndex<N,T>& index;
+    Rect<N,T> query;
+    std::vector<int>& found;
+  };
+
+  template <int N, typename T>
+  void SpaceIndex<N,T>::find_point(const Point<N,T>& p, std::vector<int>& found)
+  {
+    find_rect(Rect<N,T>(p, p), found);
+  }
+
+  template <int N, typename T>
+  void SpaceIndex<N,T>::find_rect(const Rect<N,T>& r, std::vector<int>& found)
+  {
+    query_count++;
+    PieceMarker marker(*this, r, found);
+    rtree.test_rect(r, marker);
   }
 
 
@@ -359,6 +456,69 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // split_into_chunks
+
+  template <int N, typename T>
+  void split_into_chunks(const std::vector<Rect<N,T> >& rects, size_t num_chunks,
+			 std::vector<std::vector<Rect<N,T> > >& chunks)
+  {
+    chunks.clear();
+    size_t total = 0;
+    for(typename std::vector<Rect<N,T> >::const_iterator it = rects.begin();
+	it != rects.end();
+	++it)
+      total += it->volume();
+    if(total == 0)
+      return;
+    if(num_chunks < 1)
+      num_chunks = 1;
+    size_t target = (total + num_chunks - 1) / num_chunks;
+
+    chunks.resize(1);
+    size_t filled = 0;  // points in the last chunk so far
+    for(typename std::vector<Rect<N,T> >::const_iterator it = rects.begin();
+	it != rects.end();
+	++it) {
+      Rect<N,T> rest = *it;
+      while(!rest.empty()) {
+	size_t vol = rest.volume();
+	if(((filled + vol) <= target) || (chunks.size() == num_chunks)) {
+	  chunks.back().push_back(rest);
+	  filled += vol;
+	  break;
+	}
+
+	// fill up the current chunk with whole slices along the last
+	//  dimension (always at least one, if the chunk is still empty)
+	size_t num_slices = size_t(rest.hi[N - 1] - rest.lo[N - 1]) + 1;
+	size_t slice_vol = vol / num_slices;
+	size_t slices = ((filled < target) ? ((target - filled) / slice_vol) : 0);
+	if((slices == 0) && (filled == 0))
+	  slices = 1;
+	if(slices >= num_slices) {
+	  chunks.back().push_back(rest);
+	  filled += vol;
+	  break;
+	}
+	if(slices > 0) {
+	  Rect<N,T> piece = rest;
+	  piece.hi[N - 1] = rest.lo[N - 1] + T(slices - 1);
+	  chunks.back().push_back(piece);
+	  rest.lo[N - 1] = piece.hi[N - 1] + 1;
+	}
+
+	// the rest goes in the next chunk
+	chunks.resize(chunks.size() + 1);
+	filled = 0;
+      }
+    }
+    if(chunks.back().empty())
+      chunks.pop_back();
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class AsyncMicroOp
@@ -769,7 +929,7 @@ namespace Realm {
   // class PartitioningOpQueue
 
   PartitioningOpQueue::PartitioningOpQueue( CoreReservation *_rsrv)
-    : shutdown_flag(false), rsrv(_rsrv), condvar(mutex)
+    : shutdown_flag(false), rsrv(_rsrv), condvar(mutex), chunk_condvar(mutex)
   {}
   
   PartitioningOpQueue::~PartitioningOpQueue(void)
@@ -784,6 +944,11 @@ namespace Realm {
 
     cp.add_option_int("-dp:workers", DeppartConfig::cfg_num_partitioning_workers);
     cp.add_option_bool("-dp:noisectopt", DeppartConfig::cfg_disable_intersection_optimization);
+    cp.add_option_int("-dp:bitmaprects", DeppartConfig::cfg_bitmap_min_rects);
+    cp.add_option_int("-dp:bitmapdensity", DeppartConfig::cfg_bitmap_max_bits_per_rect);
+    cp.add_option_int("-dp:chunks", DeppartConfig::cfg_max_chunks_per_microop);
+    cp.add_option_int("-dp:chunksize", DeppartConfig::cfg_min_points_per_chunk);
+    cp.add_option_int("-dp:scankernels", DeppartConfig::cfg_scan_kernels);
 
     cp.parse_command_line(cmdline);
   }
@@ -843,6 +1008,88 @@ namespace Realm {
     op_queue->condvar.broadcast();
   }
 
+  /*static*/ size_t PartitioningOpQueue::choose_chunk_count(size_t volume)
+  {
+    size_t max_chunks = ((DeppartConfig::cfg_max_chunks_per_microop > 0) ?
+			   DeppartConfig::cfg_max_chunks_per_microop :
+			   DeppartConfig::cfg_num_partitioning_workers);
+    if((op_queue == 0) || (max_chunks <= 1) ||
+       (DeppartConfig::cfg_min_points_per_chunk == 0))
+      return 1;
+    size_t num_chunks = volume / DeppartConfig::cfg_min_points_per_chunk;
+    if(num_chunks > max_chunks)
+      num_chunks = max_chunks;
+    return ((num_chunks > 1) ? num_chunks : 1);
+  }
+
+  /*static*/ void PartitioningOpQueue::execute_chunks(PartitioningChunkedWork& work,
+						      size_t num_chunks)
+  {
+    if(num_chunks == 0)
+      return;
+
+    // no point in involving anybody else for a single chunk
+    if((num_chunks == 1) || (op_queue == 0)) {
+      for(size_t i = 0; i < num_chunks; i++)
+	work.execute_chunk(i);
+      return;
+    }
+
+    ChunkSet chunks;
+    chunks.work = &work;
+    chunks.num_chunks = num_chunks;
+    chunks.next_chunk = 0;
+    chunks.chunks_done = 0;
+
+    {
+      AutoHSLLock al(op_queue->mutex);
+      op_queue->chunk_sets.push_back(&chunks);
+      op_queue->condvar.broadcast();
+    }
+
+    // work on our own chunks until they've all been claimed
+    while(true) {
+      size_t index;
+      {
+	AutoHSLLock al(op_queue->mutex);
+	if(chunks.next_chunk == chunks.num_chunks)
+	  break;
+	index = op_queue->claim_chunk(&chunks);
+      }
+      work.execute_chunk(index);
+      op_queue->finish_chunk(&chunks);
+    }
+
+    // and then wait for any that others are still working on - 'chunks'
+    //  lives on our stack, so this has to be done under the lock
+    AutoHSLLock al(op_queue->mutex);
+    while(chunks.chunks_done < chunks.num_chunks)
+      op_queue->chunk_condvar.wait();
+  }
+
+  size_t PartitioningOpQueue::claim_chunk(ChunkSet *chunks)
+  {
+    assert(chunks->next_chunk < chunks->num_chunks);
+    size_t index = chunks->next_chunk++;
+    if(chunks->next_chunk == chunks->num_chunks) {
+      // nothing left for anybody else to pick up
+      std::deque<ChunkSet *>::iterator it = std::find(chunk_sets.begin(),
+						      chunk_sets.end(),
+						      chunks);
+      assert(it != chunk_sets.end());
+      chunk_sets.erase(it);
+    }
+    return index;
+  }
+
+  void PartitioningOpQueue::finish_chunk(ChunkSet *chunks)
+  {
+    AutoHSLLock al(mutex);
+    chunks->chunks_done++;
+    if(chunks->chunks_done == chunks->num_chunks)
+      chunk_condvar.broadcast();
+  }
+
   void PartitioningOpQueue::worker_thread_loop(void)
   {
     log_part.info() << "worker " << Thread::self() << " started for op queue " << this;
@@ -850,8 +1097,17 @@ namespace Realm {
     while(!shutdown_flag) {
       void *op = 0;
       int priority;
-      while(!op && !shutdown_flag) {
+      ChunkSet *chunks = 0;
+      size_t chunk_index = 0;
+      while(!op && !chunks && !shutdown_flag) {
 	AutoHSLLock al(mutex);
+	// chunks of a running micro-op come first, as it can't finish
+	//  without them
+	if(!chunk_sets.empty()) {
+	  chunks = chunk_sets.front();
+	  chunk_index = claim_chunk(chunks);
+	  break;
+	}
 	op = queued_ops.get(&priority);
 	if(!op && !shutdown_flag) {
           if(DeppartConfig::cfg_worker_threads_sleep) {
@@ -863,6 +1119,11 @@ namespace Realm {
           }
         }
       }
+      if(chunks) {
+	chunks->work->execute_chunk(chunk_index);
+	finish_chunk(chunks);
+	continue;
+      }
       if(op) {
 	switch(priority) {
 	case OPERATION_PRIORITY:
@@ -897,7 +1158,10 @@ namespace Realm {
   template struct IndexSpace<N,T>; \
   template void PartitioningMicroOp::sparsity_map_ready(SparsityMapImpl<N,T>*, bool); \
   template class OverlapTester<N,T>; \
-  template class ComputeOverlapMicroOp<N,T>;
+  template class SpaceIndex<N,T>; \
+  template class ComputeOverlapMicroOp<N,T>; \
+  template void split_into_chunks(const std::vector<Rect<N,T> >&, size_t, \
+				  std::vector<std::vector<Rect<N,T> > >&);
   FOREACH_NT(DOIT)
 
 #define DOIT2(N1,T1,N2,T2) \
@@ -28,6 +28,7 @@
 #include "realm/pri_queue.h"
 #include "realm/nodeset.h"
 #include "realm/interval_tree.h"
+#include "realm/rtree.h"
 #include "realm/dynamic_templates.h"
 #include "realm/deppart/sparsity_impl.h"
 #include "realm/deppart/inst_helper.h"
@@ -53,9 +54,7 @@ namespace Realm {
     void test_overlap(const SparsityMapImpl<N,T> *sparsity, std::set<int>& overlaps, bool approx);
 
   protected:
-    std::vector<int> labels;
-    std::vector<IndexSpace<N,T> > spaces;
-    std::vector<bool> approxs;
+    PackedRTree<N,T,int> rtree;
   };
 
   template <typename T>
@@ -77,6 +76,40 @@ namespace Realm {
   };
 
 
+  // finds which of a list of index spaces contain a point or overlap a rectangle,
+  //  using a PackedRTree over the pieces (i.e. sparsity map entries) of every
+  //  space rather than testing each space in turn - bitmap entries are indexed by
+  //  their bounds and then checked bit by bit
+  template <int N, typename T>
+  class SpaceIndex {
+  public:
+    SpaceIndex(const std::vector<IndexSpace<N,T> >& spaces);
+
+    // these append the index of each matching space to 'found' (just once, even
+    //  if several of its pieces match)
+    void find_point(const Point<N,T>& p, std::vector<int>& found);
+    void find_rect(const Rect<N,T>& r, std::vector<int>& found);
+
+  protected:
+    class PieceMarker;
+
+    PackedRTree<N,T,size_t> rtree;
+    std::vector<int> piece_spaces;
+    std::vector<const HierarchicalBitMap<N,T> *> piece_bitmaps;
+    // the last query that found each space, to avoid duplicates
+    std::vector<size_t> last_found;
+    size_t query_count;
+  };
+
+
+  // splits a list of rectangles into at most 'num_chunks' lists with roughly
+  //  equal numbers of points (keeping the input order), cutting rectangles
+  //  along their last (i.e. slowest-varying) dimension where needed
+  template <int N, typename T>
+  void split_into_chunks(const std::vector<Rect<N,T> >& rects, size_t num_chunks,
+			 std::vector<std::vector<Rect<N,T> > >& chunks);
+
+
   /////////////////////////////////////////////////////////////////////////
 
   class AsyncMicroOp : public Operation::AsyncWorkItem {
@@ -144,6 +177,16 @@ namespace Realm {
     std::vector<SparsityMapImpl<N,T> *> extra_deps;
   };
 
+  // a micro-op with a lot of local data to get through can split it into
+  //  independent chunks that the partitioning workers process in parallel -
+  //  see PartitioningOpQueue::execute_chunks
+  class PartitioningChunkedWork {
+  public:
+    virtual ~PartitioningChunkedWork(void) {}
+
+    virtual void execute_chunk(size_t index) = 0;
+  };
+
   ////////////////////////////////////////
   //
   
@@ -186,14 +229,38 @@ namespace Realm {
     void enqueue_partitioning_operation(PartitioningOperation *op);
     void enqueue_partitioning_microop(PartitioningMicroOp *uop);
 
+    // how many chunks a micro-op should split 'volume' points of local data
+    //  into (1 means it's not worth splitting)
+    static size_t choose_chunk_count(size_t volume);
+
+    // calls 'work.execute_chunk' for each chunk index in [0, num_chunks) -
+    //  idle workers pick up chunks ahead of any queued (micro-)ops, and the
+    //  calling thread processes chunks too, so this never waits on a worker
+    //  that is busy with something else
+    static void execute_chunks(PartitioningChunkedWork& work, size_t num_chunks);
+
     void worker_thread_loop(void);
 
   protected:
+    struct ChunkSet {
+      PartitioningChunkedWork *work;
+      size_t num_chunks;
+      size_t next_chunk;  // protected by mutex
+      size_t chunks_done;  // protected by mutex
+    };
+
+    // claims the next chunk of a set (and retires the set once every chunk
+    //  has been claimed) - must hold mutex
+    size_t claim_chunk(ChunkSet *chunks);
+    void finish_chunk(ChunkSet *chunks);
+
     bool shutdown_flag;
     CoreReservation *rsrv;
     PriorityQueue<void *, DummyLock> queued_ops;
+    std::deque<ChunkSet *> chunk_sets;
     GASNetHSL mutex;
     GASNetCondVar condvar;
+    GASNetCondVar chunk_condvar;
     std::vector<Thread *> workers;
   };
 
@@ -123,20 +123,26 @@ namespace Realm {
     // for now, one access for the whole instance
     AffineAccessor<Point<N2,T2>,N,T> a_data(inst, field_offset);
 
+    // look up the targets of each pointer in an index rather than testing
+    //  every target
+    SpaceIndex<N2,T2> target_index(targets);
+    std::vector<int> found;
+
     // double iteration - use the instance's space first, since it's probably smaller
     for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
       for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
 	// now iterate over each point
 	for(PointInRectIterator<N,T> pir(it2.rect); pir.valid; pir.step()) {
-	  // fetch the pointer and test it against every possible target (ugh)
+	  // fetch the pointer and find the targets that contain it
 	  Point<N2,T2> ptr = a_data.read(pir.p);
 
-	  for(size_t i = 0; i < targets.size(); i++)
-	    if(targets[i].contains(ptr)) {
-	      BM *&bmp = bitmasks[i];
-	      if(!bmp) bmp = new BM;
-	      bmp->add_point(pir.p);
-	    }
+	  found.clear();
+	  target_index.find_point(ptr, found);
+	  for(size_t j = 0; j < found.size(); j++) {
+	    BM *&bmp = bitmasks[found[j]];
+	    if(!bmp) bmp = new BM;
+	    bmp->add_point(pir.p);
+	  }
 	}
       }
     }
@@ -149,20 +155,26 @@ namespace Realm {
     // for now, one access for the whole instance
     AffineAccessor<Rect<N2,T2>,N,T> a_data(inst, field_offset);
 
+    // look up the targets of each range in an index rather than testing
+    //  every target
+    SpaceIndex<N2,T2> target_index(targets);
+    std::vector<int> found;
+
     // double iteration - use the instance's space first, since it's probably smaller
     for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
       for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
 	// now iterate over each point
 	for(PointInRectIterator<N,T> pir(it2.rect); pir.valid; pir.step()) {
-	  // fetch the pointer and test it against every possible target (ugh)
+	  // fetch the range and find the targets that overlap it
 	  Rect<N2,T2> rng = a_data.read(pir.p);
 
-	  for(size_t i = 0; i < targets.size(); i++)
-	    if(targets[i].contains_any(rng)) {
-	      BM *&bmp = bitmasks[i];
-	      if(!bmp) bmp = new BM;
-	      bmp->add_point(pir.p);
-	    }
+	  found.clear();
+	  target_index.find_rect(rng, found);
+	  for(size_t j = 0; j < found.size(); j++) {
+	    BM *&bmp = bitmasks[found[j]];
+	    if(!bmp) bmp = new BM;
+	    bmp->add_point(pir.p);
+	  }
 	}
       }
     }
@@ -174,6 +186,15 @@ namespace Realm {
     TimeStamp ts("PreimageMicroOp::execute", true, &log_uop_timing);
     std::map<int, DenseRectangleList<N,T> *> rect_map;
 
+    // create the lists up front so that they can turn into bitmaps if they
+    //  get big
+    Rect<N,T> limits = parent_space.bounds.intersection(inst_space.bounds);
+    for(size_t i = 0; i < sparsity_outputs.size(); i++) {
+      DenseRectangleList<N,T> *drl = new DenseRectangleList<N,T>;
+      drl->enable_bitmap(limits);
+      rect_map[i] = drl;
+    }
+
     if(is_ranged)
       populate_bitmasks_ranges(rect_map);
     else
@@ -193,10 +214,13 @@ namespace Realm {
     for(size_t i = 0; i < sparsity_outputs.size(); i++) {
       SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(sparsity_outputs[i]);
       typename std::map<int, DenseRectangleList<N,T> *>::const_iterator it2 = rect_map.find(i);
-      if(it2 != rect_map.end()) {
-	impl->contribute_dense_rect_list(it2->second->rects);
+      if((it2 != rect_map.end()) &&
+	 (!it2->second->rects.empty() || it2->second->bitmap)) {
+	impl->contribute_dense_rect_list(*(it2->second));
 	delete it2->second;
       } else {
+	if(it2 != rect_map.end())
+	  delete it2->second;
 	impl->contribute_nothing();
 	empty_count++;
       }
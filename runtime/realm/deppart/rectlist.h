@@ -19,6 +19,7 @@
 #define REALM_DEPPART_RECTLIST_H
 
 #include "realm/indexspace.h"
+#include "realm/deppart/partitions.h"
 
 namespace Realm {
 
@@ -46,6 +47,7 @@ namespace Realm {
   class DenseRectangleList {
   public:
     DenseRectangleList(size_t _max_rects = 0);
+    ~DenseRectangleList(void);
 
     void add_point(const Point<N,T>& p);
 
@@ -53,8 +55,34 @@ namespace Realm {
 
     void merge_rects(size_t upper_bound);
 
+    // adds everything in 'other' (whose bitmap limits, if any, must match
+    //  ours), which may be left in any state afterwards
+    void merge_from(DenseRectangleList<N,T>& other);
+
+    // allows the list to switch to a bitmap over 'limits' (which must cover
+    //  every point added) once it holds enough rectangles for that to pay off
+    //  (see DeppartConfig::cfg_bitmap_*) - afterwards, 'rects' is empty and
+    //  'bitmap' holds the points instead
+    void enable_bitmap(const Rect<N,T>& limits);
+
+    // hands over the bitmap (if any) to the caller
+    HierarchicalBitMap<N,T> *take_bitmap(void);
+
     std::vector<Rect<N,T> > rects;
     size_t max_rects;
+    HierarchicalBitMap<N,T> *bitmap;
+
+  protected:
+    void check_bitmap(void);
+
+    Rect<N,T> bitmap_limits;
+    // the rect count at which a bitmap is next considered (0 = never)
+    size_t bitmap_check;
+
+  private:
+    // not copyable, as we might own a bitmap
+    DenseRectangleList(const DenseRectangleList<N,T>&);
+    DenseRectangleList<N,T>& operator=(const DenseRectangleList<N,T>&);
   };
 
   template <int N, typename T>
@@ -72,6 +100,15 @@ namespace Realm {
 
     void add_rect(const Rect<N,T>& r);
 
+    // see DenseRectangleList::enable_bitmap - a list that turns into a
+    //  bitmap has nothing to convert to a vector
+    // (the 1-D version switches to a map long before a bitmap would pay off,
+    //  so these have no effect there)
+    void enable_bitmap(const Rect<N,T>& limits);
+    HierarchicalBitMap<N,T> *take_bitmap(void);
+
+    void merge_from(HybridRectangleList<N,T>& other);
+
     const std::vector<Rect<N,T> >& convert_to_vector(void);
 
     //std::vector<Rect<N,T> > as_vector;
@@ -82,6 +119,24 @@ namespace Realm {
   template <int N, typename T>
   std::ostream& operator<<(std::ostream& os, const HybridRectangleList<N,T>& hrl);
 
+  // merges the per-chunk lists of a chunked scan (see
+  //  PartitioningOpQueue::execute_chunks) into the first chunk's lists, which
+  //  are then the result - keys are independent, so each one is a chunk of
+  //  work of its own
+  template <typename K, typename L>
+  class ChunkListMerger : public PartitioningChunkedWork {
+  public:
+    ChunkListMerger(std::vector<std::map<K, L *> >& _chunk_lists);
+
+    void merge(void);
+
+    virtual void execute_chunk(size_t index);
+
+  protected:
+    std::vector<std::map<K, L *> >& chunk_lists;
+    std::vector<K> keys;
+  };
+
 };
 
 #endif // REALM_DEPPART_RECTLIST_H
@@ -19,6 +19,7 @@
 #define REALM_DEPPART_RECTLIST_INL
 
 #include "realm/deppart/rectlist.h"
+#include "realm/deppart/deppart_config.h"
 
 namespace Realm {
 
@@ -56,9 +57,52 @@ namespace Realm {
 
   template <int N, typename T>
   inline DenseRectangleList<N,T>::DenseRectangleList(size_t _max_rects /*= 0*/)
-    : max_rects(_max_rects)
+    : max_rects(_max_rects), bitmap(0), bitmap_check(0)
   {}
 
+  template <int N, typename T>
+  inline DenseRectangleList<N,T>::~DenseRectangleList(void)
+  {
+    delete bitmap;
+  }
+
+  template <int N, typename T>
+  inline void DenseRectangleList<N,T>::enable_bitmap(const Rect<N,T>& limits)
+  {
+    // an approximation has to stay a list of rectangles
+    if((max_rects > 0) || (DeppartConfig::cfg_bitmap_min_rects <= 0) ||
+       limits.empty())
+      return;
+    bitmap_limits = limits;
+    bitmap_check = DeppartConfig::cfg_bitmap_min_rects;
+  }
+
+  template <int N, typename T>
+  inline HierarchicalBitMap<N,T> *DenseRectangleList<N,T>::take_bitmap(void)
+  {
+    HierarchicalBitMap<N,T> *result = bitmap;
+    bitmap = 0;
+    bitmap_check = 0;
+    return result;
+  }
+
+  template <int N, typename T>
+  inline void DenseRectangleList<N,T>::check_bitmap(void)
+  {
+    if(bitmap_limits.volume() <= (rects.size() *
+				  DeppartConfig::cfg_bitmap_max_bits_per_rect)) {
+      bitmap = new HierarchicalBitMap<N,T>(bitmap_limits);
+      for(typename std::vector<Rect<N,T> >::const_iterator it = rects.begin();
+	  it != rects.end();
+	  ++it)
+	bitmap->set_rect(*it);
+      std::vector<Rect<N,T> >().swap(rects);
+    } else {
+      // still too sparse - look again once the list has doubled
+      bitmap_check *= 2;
+    }
+  }
+
   template <int N, typename T>
   inline void DenseRectangleList<N,T>::merge_rects(size_t upper_bound)
   {
@@ -83,6 +127,15 @@ namespace Realm {
   template <int N, typename T>
   inline void DenseRectangleList<N,T>::add_point(const Point<N,T>& p)
   {
+    if(bitmap_check > 0) {
+      if(!bitmap && (rects.size() >= bitmap_check))
+	check_bitmap();
+      if(bitmap) {
+	bitmap->set_point(p);
+	return;
+      }
+    }
+
     if(rects.empty()) {
       rects.push_back(Rect<N,T>(p, p));
       return;
@@ -210,6 +263,15 @@ namespace Realm {
   template <int N, typename T>
   inline void DenseRectangleList<N,T>::add_rect(const Rect<N,T>& _r)
   {
+    if(bitmap_check > 0) {
+      if(!bitmap && (rects.size() >= bitmap_check))
+	check_bitmap();
+      if(bitmap) {
+	bitmap->set_rect(_r);
+	return;
+      }
+    }
+
     if(rects.empty()) {
       rects.push_back(_r);
       return;
@@ -375,6 +437,30 @@ namespace Realm {
 #endif
   }
 
+  template <int N, typename T>
+  inline void DenseRectangleList<N,T>::merge_from(DenseRectangleList<N,T>& other)
+  {
+    if(other.bitmap) {
+      if(!bitmap) {
+	// the other list already decided that a bitmap pays off, so we switch
+	//  right away too
+	assert(bitmap_check > 0);
+	bitmap = new HierarchicalBitMap<N,T>(bitmap_limits);
+	for(typename std::vector<Rect<N,T> >::const_iterator it = rects.begin();
+	    it != rects.end();
+	    ++it)
+	  bitmap->set_rect(*it);
+	std::vector<Rect<N,T> >().swap(rects);
+      }
+      bitmap->union_with(*other.bitmap, other.bitmap->get_bounds());
+    } else {
+      for(typename std::vector<Rect<N,T> >::const_iterator it = other.rects.begin();
+	  it != other.rects.end();
+	  ++it)
+	add_rect(*it);
+    }
+  }
+
   template <int N, typename T>
   std::ostream& operator<<(std::ostream& os, const DenseRectangleList<N,T>& drl)
   {
@@ -415,9 +501,28 @@ namespace Realm {
     //as_vector.push_back(r);
   }
 
+  template <int N, typename T>
+  inline void HybridRectangleList<N,T>::enable_bitmap(const Rect<N,T>& limits)
+  {
+    as_vector.enable_bitmap(limits);
+  }
+
+  template <int N, typename T>
+  inline HierarchicalBitMap<N,T> *HybridRectangleList<N,T>::take_bitmap(void)
+  {
+    return as_vector.take_bitmap();
+  }
+
+  template <int N, typename T>
+  inline void HybridRectangleList<N,T>::merge_from(HybridRectangleList<N,T>& other)
+  {
+    as_vector.merge_from(other.as_vector);
+  }
+
   template <int N, typename T>
   inline const std::vector<Rect<N,T> >& HybridRectangleList<N,T>::convert_to_vector(void)
   {
+    assert(!as_vector.bitmap);
     return as_vector.rects;
   }
 
@@ -456,6 +561,8 @@ namespace Realm {
 
     void add_rect(const Rect<1,T>& r);
 
+    void merge_from(HybridRectangleList<1,T>& other);
+
     const std::vector<Rect<1,T> >& convert_to_vector(void);
     void convert_to_map(void);
 
@@ -566,7 +673,7 @@ namespace Realm {
       }
 
       if(it->first <= r.lo.x) {
-	assert(it->second >= r.lo.x); // it had better overlap
+	assert(it->second >= (r.lo.x - 1)); // it had better overlap or abut
 
 	if(it->second < r.hi.x)
 	  it->second = r.hi.x;
@@ -603,6 +710,24 @@ namespace Realm {
     is_vector = false;
   }
 
+  template <typename T>
+  void HybridRectangleList<1,T>::merge_from(HybridRectangleList<1,T>& other)
+  {
+    if(other.bitmap) {
+      // (only possible if bitmaps are allowed below HIGH_WATER_MARK rects)
+      size_t pos = 0;
+      Rect<1,T> run;
+      while(other.bitmap->next_run(other.bitmap->get_bounds(), pos, run))
+	add_rect(run);
+      return;
+    }
+    const std::vector<Rect<1,T> >& v = other.convert_to_vector();
+    for(typename std::vector<Rect<1,T> >::const_iterator it = v.begin();
+	it != v.end();
+	++it)
+      add_rect(*it);
+  }
+
   template <typename T>
   const std::vector<Rect<1,T> >& HybridRectangleList<1,T>::convert_to_vector(void)
   {
@@ -649,6 +774,62 @@ namespace Realm {
     }
     return os;
   }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ChunkListMerger<K,L>
+
+  template <typename K, typename L>
+  ChunkListMerger<K,L>::ChunkListMerger(std::vector<std::map<K, L *> >& _chunk_lists)
+    : chunk_lists(_chunk_lists)
+  {
+    // a key that the first chunk didn't see just takes the list of the first
+    //  chunk that did
+    for(size_t i = 1; i < chunk_lists.size(); i++)
+      for(typename std::map<K, L *>::iterator it = chunk_lists[i].begin();
+	  it != chunk_lists[i].end();
+	  ++it) {
+	L *&dst = chunk_lists[0][it->first];
+	if(!dst) {
+	  dst = it->second;
+	  it->second = 0;
+	}
+      }
+    for(typename std::map<K, L *>::const_iterator it = chunk_lists[0].begin();
+	it != chunk_lists[0].end();
+	++it)
+      keys.push_back(it->first);
+  }
+
+  template <typename K, typename L>
+  void ChunkListMerger<K,L>::merge(void)
+  {
+    if(chunk_lists.size() > 1)
+      PartitioningOpQueue::execute_chunks(*this, keys.size());
+    chunk_lists.resize(1);
+  }
+
+  template <typename K, typename L>
+  void ChunkListMerger<K,L>::execute_chunk(size_t index)
+  {
+    // only the list pointers for our own key get touched here, so there's no
+    //  need to lock anything
+    const K& key = keys[index];
+    L *dst = chunk_lists[0].find(key)->second;
+    for(size_t i = 1; i < chunk_lists.size(); i++) {
+      typename std::map<K, L *>::iterator it = chunk_lists[i].find(key);
+      if((it == chunk_lists[i].end()) || !it->second)
+	continue;
+      if(dst) {
+	dst->merge_from(*(it->second));
+	delete it->second;
+      } else
+	dst = it->second;
+      it->second = 0;
+    }
+    chunk_lists[0].find(key)->second = dst;
+  }
     
 };
 
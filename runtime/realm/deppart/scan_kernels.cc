@@ -0,0 +1,328 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// run-finding scans over field data for Realm dependent partitioning
+
+#include "realm/deppart/scan_kernels.h"
+
+#include "realm/deppart/deppart_config.h"
+#include "realm/logging.h"
+
+#include <stdint.h>
+#include <limits>
+
+// the vector kernels use per-function target attributes, so the rest of
+//  the runtime doesn't need to be built with -mavx2/-mavx512f
+#if defined(__x86_64__) && defined(__GNUC__)
+#define REALM_SCAN_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace Realm {
+
+  extern Logger log_part;
+
+  namespace ScanKernels {
+
+    static volatile int active_level = -1;
+
+    Level get_level(void)
+    {
+      int level = active_level;
+      if(level >= 0)
+	return (Level)level;
+
+      level = DeppartConfig::cfg_scan_kernels;
+      if(level < LEVEL_NONE) level = LEVEL_NONE;
+      if(level > LEVEL_AVX512) level = LEVEL_AVX512;
+#ifdef REALM_SCAN_KERNELS_X86
+      if((level >= LEVEL_AVX512) && !__builtin_cpu_supports("avx512f"))
+	level = LEVEL_AVX2;
+      if((level >= LEVEL_AVX2) && !__builtin_cpu_supports("avx2"))
+	level = LEVEL_SCALAR;
+#else
+      if(level > LEVEL_SCALAR)
+	level = LEVEL_SCALAR;
+#endif
+      // racing initializers all compute the same answer
+      active_level = level;
+      log_part.info() << "scan kernels: " << level_name((Level)level);
+      return (Level)level;
+    }
+
+    const char *level_name(Level level)
+    {
+      switch(level) {
+      case LEVEL_NONE: return "none";
+      case LEVEL_SCALAR: return "scalar";
+      case LEVEL_AVX2: return "avx2";
+      case LEVEL_AVX512: return "avx512";
+      }
+      return "unknown";
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // scalar kernels - these also finish off whatever is left over after
+    //  the last full vector
+
+    template <typename U>
+    static size_t equal_run_scalar(const U *data, size_t start, size_t count)
+    {
+      size_t i = start;
+      while((i < count) && (data[i] == data[0]))
+	i++;
+      return i;
+    }
+
+    // 'count' has already been limited so that data[0] + i can't overflow
+    template <typename U>
+    static size_t affine_run_scalar(const U *data, size_t start, size_t count)
+    {
+      size_t i = start;
+      while((i < count) && (data[i] == U(data[0] + U(i))))
+	i++;
+      return i;
+    }
+
+#ifdef REALM_SCAN_KERNELS_X86
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // vector kernels - each compares a vector's worth of elements against
+    //  what a continuing run would hold and stops at the first lane that
+    //  doesn't match
+
+    __attribute__((target("avx2")))
+    static size_t equal_run_avx2(const uint32_t *data, size_t count)
+    {
+      const __m256i v = _mm256_set1_epi32(data[0]);
+      size_t i = 0;
+      for(; (i + 8) <= count; i += 8) {
+	__m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+	unsigned match = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(d, v)));
+	if(match != 0xFF)
+	  return i + __builtin_ctz(~match);
+      }
+      return equal_run_scalar(data, i, count);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t equal_run_avx2(const uint64_t *data, size_t count)
+    {
+      const __m256i v = _mm256_set1_epi64x(data[0]);
+      size_t i = 0;
+      for(; (i + 4) <= count; i += 4) {
+	__m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+	unsigned match = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(d, v)));
+	if(match != 0xF)
+	  return i + __builtin_ctz(~match);
+      }
+      return equal_run_scalar(data, i, count);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t affine_run_avx2(const uint32_t *data, size_t count)
+    {
+      __m256i expect = _mm256_add_epi32(_mm256_set1_epi32(data[0]),
+					_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+      const __m256i step = _mm256_set1_epi32(8);
+      size_t i = 0;
+      for(; (i + 8) <= count; i += 8) {
+	__m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+	unsigned match = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(d, expect)));
+	if(match != 0xFF)
+	  return i + __builtin_ctz(~match);
+	expect = _mm256_add_epi32(expect, step);
+      }
+      return affine_run_scalar(data, i, count);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t affine_run_avx2(const uint64_t *data, size_t count)
+    {
+      __m256i expect = _mm256_add_epi64(_mm256_set1_epi64x(data[0]),
+					_mm256_setr_epi64x(0, 1, 2, 3));
+      const __m256i step = _mm256_set1_epi64x(4);
+      size_t i = 0;
+      for(; (i + 4) <= count; i += 4) {
+	__m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+	unsigned match = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(d, expect)));
+	if(match != 0xF)
+	  return i + __builtin_ctz(~match);
+	expect = _mm256_add_epi64(expect, step);
+      }
+      return affine_run_scalar(data, i, count);
+    }
+
+    __attribute__((target("avx512f")))
+    static size_t equal_run_avx512(const uint32_t *data, size_t count)
+    {
+      const __m512i v = _mm512_set1_epi32(data[0]);
+      size_t i = 0;
+      for(; (i + 16) <= count; i += 16) {
+	__m512i d = _mm512_loadu_si512((const void *)(data + i));
+	__mmask16 mismatch = _mm512_cmpneq_epi32_mask(d, v);
+	if(mismatch)
+	  return i + __builtin_ctz(mismatch);
+      }
+      return equal_run_scalar(data, i, count);
+    }
+
+    __attribute__((target("avx512f")))
+    static size_t equal_run_avx512(const uint64_t *data, size_t count)
+    {
+      const __m512i v = _mm512_set1_epi64(data[0]);
+      size_t i = 0;
+      for(; (i + 8) <= count; i += 8) {
+	__m512i d = _mm512_loadu_si512((const void *)(data + i));
+	__mmask8 mismatch = _mm512_cmpneq_epi64_mask(d, v);
+	if(mismatch)
+	  return i + __builtin_ctz(mismatch);
+      }
+      return equal_run_scalar(data, i, count);
+    }
+
+    __attribute__((target("avx512f")))
+    static size_t affine_run_avx512(const uint32_t *data, size_t count)
+    {
+      __m512i expect = _mm512_add_epi32(_mm512_set1_epi32(data[0]),
+					_mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8,
+							 7, 6, 5, 4, 3, 2, 1, 0));
+      const __m512i step = _mm512_set1_epi32(16);
+      size_t i = 0;
+      for(; (i + 16) <= count; i += 16) {
+	__m512i d = _mm512_loadu_si512((const void *)(data + i));
+	__mmask16 mismatch = _mm512_cmpneq_epi32_mask(d, expect);
+	if(mismatch)
+	  return i + __builtin_ctz(mismatch);
+	expect = _mm512_add_epi32(expect, step);
+      }
+      return affine_run_scalar(data, i, count);
+    }
+
+    __attribute__((target("avx512f")))
+    static size_t affine_run_avx512(const uint64_t *data, size_t count)
+    {
+      __m512i expect = _mm512_add_epi64(_mm512_set1_epi64(data[0]),
+					_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0));
+      const __m512i step = _mm512_set1_epi64(8);
+      size_t i = 0;
+      for(; (i + 8) <= count; i += 8) {
+	__m512i d = _mm512_loadu_si512((const void *)(data + i));
+	__mmask8 mismatch = _mm512_cmpneq_epi64_mask(d, expect);
+	if(mismatch)
+	  return i + __builtin_ctz(mismatch);
+	expect = _mm512_add_epi64(expect, step);
+      }
+      return affine_run_scalar(data, i, count);
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // dispatch by element size and level
+
+    template <typename U>
+    static size_t equal_run_bits(const U *data, size_t count)
+    {
+#ifdef REALM_SCAN_KERNELS_X86
+      switch(get_level()) {
+      case LEVEL_AVX512: return equal_run_avx512(data, count);
+      case LEVEL_AVX2: return equal_run_avx2(data, count);
+      default: break;
+      }
+#endif
+      return equal_run_scalar(data, 1, count);
+    }
+
+    // 'T' is the actual type, 'U' an unsigned integer of the same size
+    template <typename T, typename U>
+    static size_t affine_run_bits(const T *data, size_t count)
+    {
+      // a run can't go past the largest value of T, and stopping there
+      //  also keeps the vector adds (which wrap) honest
+      size_t limit = size_t(U(std::numeric_limits<T>::max()) - U(data[0])) + 1;
+      if((limit > 0) && (count > limit))
+	count = limit;
+      const U *udata = reinterpret_cast<const U *>(data);
+#ifdef REALM_SCAN_KERNELS_X86
+      switch(get_level()) {
+      case LEVEL_AVX512: return affine_run_avx512(udata, count);
+      case LEVEL_AVX2: return affine_run_avx2(udata, count);
+      default: break;
+      }
+#endif
+      return affine_run_scalar(udata, 1, count);
+    }
+
+    template <>
+    size_t equal_run<int>(const int *data, size_t count)
+    {
+      return equal_run_bits(reinterpret_cast<const uint32_t *>(data), count);
+    }
+
+    template <>
+    size_t equal_run<unsigned>(const unsigned *data, size_t count)
+    {
+      return equal_run_bits(reinterpret_cast<const uint32_t *>(data), count);
+    }
+
+    template <>
+    size_t equal_run<long long>(const long long *data, size_t count)
+    {
+      return equal_run_bits(reinterpret_cast<const uint64_t *>(data), count);
+    }
+
+    template <>
+    size_t equal_run<unsigned long long>(const unsigned long long *data, size_t count)
+    {
+      return equal_run_bits(reinterpret_cast<const uint64_t *>(data), count);
+    }
+
+    // a 1-D rectangle of 4-byte coordinates is compared as a single 8-byte
+    //  value
+    template <>
+    size_t equal_run<Rect<1,int> >(const Rect<1,int> *data, size_t count)
+    {
+      return equal_run_bits(reinterpret_cast<const uint64_t *>(data), count);
+    }
+
+    template <>
+    size_t equal_run<Rect<1,unsigned> >(const Rect<1,unsigned> *data, size_t count)
+    {
+      return equal_run_bits(reinterpret_cast<const uint64_t *>(data), count);
+    }
+
+    template <>
+    size_t affine_run<int>(const int *data, size_t count)
+    {
+      return affine_run_bits<int, uint32_t>(data, count);
+    }
+
+    template <>
+    size_t affine_run<unsigned>(const unsigned *data, size_t count)
+    {
+      return affine_run_bits<unsigned, uint32_t>(data, count);
+    }
+
+    template <>
+    size_t affine_run<long long>(const long long *data, size_t count)
+    {
+      return affine_run_bits<long long, uint64_t>(data, count);
+    }
+
+  }; // namespace ScanKernels
+
+}; // namespace Realm
@@ -0,0 +1,83 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// run-finding scans over field data for Realm dependent partitioning
+
+#ifndef REALM_DEPPART_SCAN_KERNELS_H
+#define REALM_DEPPART_SCAN_KERNELS_H
+
+#include "realm/indexspace.h"
+
+#include <stddef.h>
+
+namespace Realm {
+
+  // by-field and image operations spend most of their time walking field
+  //  data looking for runs of equal colors (or pointers that count up by
+  //  one) - these kernels find the end of such a run in a contiguous array,
+  //  so that the caller can emit a rectangle per run rather than a point per
+  //  element
+  namespace ScanKernels {
+
+    // which instruction sets the scans are allowed to use - set via
+    //  -dp:scankernels, and further limited by what the CPU supports
+    enum Level {
+      LEVEL_NONE   = 0,  // no run scans - read the field point by point
+      LEVEL_SCALAR = 1,  // run scans with plain loops
+      LEVEL_AVX2   = 2,
+      LEVEL_AVX512 = 3,
+    };
+
+    // the level actually in use - determined on first use
+    Level get_level(void);
+    const char *level_name(Level level);
+
+    // returns the number of elements at the start of 'data' (at least 1 -
+    //  'count' must be nonzero) that are equal to data[0]
+    // 4- and 8-byte integers (and rectangles of 4-byte coordinates) are
+    //  compared a vector at a time, anything else with operator==
+    template <typename FT>
+    size_t equal_run(const FT *data, size_t count);
+
+    // returns the number of elements at the start of 'data' (at least 1)
+    //  that count up by one from data[0] (i.e. data[i] == data[0] + i)
+    template <typename T>
+    size_t affine_run(const T *data, size_t count);
+
+    template <> size_t equal_run<int>(const int *data, size_t count);
+    template <> size_t equal_run<unsigned>(const unsigned *data, size_t count);
+    template <> size_t equal_run<long long>(const long long *data, size_t count);
+    template <> size_t equal_run<unsigned long long>(const unsigned long long *data, size_t count);
+    template <> size_t equal_run<Rect<1,int> >(const Rect<1,int> *data, size_t count);
+    template <> size_t equal_run<Rect<1,unsigned> >(const Rect<1,unsigned> *data, size_t count);
+
+    template <> size_t affine_run<int>(const int *data, size_t count);
+    template <> size_t affine_run<unsigned>(const unsigned *data, size_t count);
+    template <> size_t affine_run<long long>(const long long *data, size_t count);
+
+    template <typename FT>
+    inline size_t equal_run(const FT *data, size_t count)
+    {
+      size_t i = 1;
+      while((i < count) && (data[i] == data[0]))
+	i++;
+      return i;
+    }
+
+  }; // namespace ScanKernels
+
+}; // namespace Realm
+
+#endif // REALM_DEPPART_SCAN_KERNELS_H
@@ -654,6 +654,157 @@ namespace Realm {
     std::cout << "]]\n";
   }
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // bitmap set operations
+
+  // when inputs are held as bitmaps, set operations are done a word at a
+  //  time into a bitmap result rather than a rectangle at a time - the
+  //  sparsity map decides in the end whether to keep it as a bitmap
+
+  // returns the bitmap if 'space' is described by a single bitmap entry
+  template <int N, typename T>
+  static HierarchicalBitMap<N,T> *input_bitmap(const IndexSpace<N,T>& space)
+  {
+    if(space.dense())
+      return 0;
+    SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(space.sparsity);
+    const std::vector<SparsityMapEntry<N,T> >& entries = impl->get_entries();
+    if((entries.size() == 1) && (entries[0].bitmap != 0))
+      return entries[0].bitmap;
+    return 0;
+  }
+
+  // the bounding box of the points that might actually be in 'space'
+  template <int N, typename T>
+  static Rect<N,T> input_extent(const IndexSpace<N,T>& space)
+  {
+    if(space.dense())
+      return space.bounds;
+    SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(space.sparsity);
+    const std::vector<SparsityMapEntry<N,T> >& entries = impl->get_entries();
+    Rect<N,T> bbox = Rect<N,T>::make_empty();
+    for(size_t i = 0; i < entries.size(); i++)
+      bbox = bbox.union_bbox(entries[i].bounds);
+    return space.bounds.intersection(bbox);
+  }
+
+  // the number of bits 'space' could reasonably claim for a bitmap - its
+  //  volume if dense, or what a sparsity map of that many rectangles would
+  //  be allowed
+  template <int N, typename T>
+  static size_t input_bit_budget(const IndexSpace<N,T>& space)
+  {
+    if(space.dense())
+      return space.bounds.volume();
+    HierarchicalBitMap<N,T> *bitmap = input_bitmap(space);
+    if(bitmap)
+      return bitmap->get_bounds().volume();
+    SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(space.sparsity);
+    return (impl->get_entries().size() *
+	    DeppartConfig::cfg_bitmap_max_bits_per_rect);
+  }
+
+  // sets the bits for every point of 'space' that's within 'within'
+  template <int N, typename T>
+  static void fill_bitmap(HierarchicalBitMap<N,T>& bitmap,
+			  const IndexSpace<N,T>& space, const Rect<N,T>& within)
+  {
+    Rect<N,T> clip = space.bounds.intersection(within);
+    HierarchicalBitMap<N,T> *input = input_bitmap(space);
+    if(input) {
+      bitmap.union_with(*input, clip);
+    } else {
+      for(IndexSpaceIterator<N,T> it(space, clip); it.valid; it.step())
+	bitmap.set_rect(it.rect);
+    }
+  }
+
+  template <int N, typename T>
+  static HierarchicalBitMap<N,T> *bitmap_union(const std::vector<IndexSpace<N,T> >& inputs)
+  {
+    if(DeppartConfig::cfg_bitmap_min_rects <= 0)
+      return 0;
+    bool any_bitmaps = false;
+    size_t budget = 0;
+    Rect<N,T> bbox = Rect<N,T>::make_empty();
+    for(size_t i = 0; i < inputs.size(); i++) {
+      if(input_bitmap(inputs[i]))
+	any_bitmaps = true;
+      budget += input_bit_budget(inputs[i]);
+      bbox = bbox.union_bbox(input_extent(inputs[i]));
+    }
+    if(!any_bitmaps || bbox.empty() || (bbox.volume() > budget))
+      return 0;
+
+    HierarchicalBitMap<N,T> *result = new HierarchicalBitMap<N,T>(bbox);
+    for(size_t i = 0; i < inputs.size(); i++)
+      fill_bitmap(*result, inputs[i], bbox);
+    return result;
+  }
+
+  template <int N, typename T>
+  static HierarchicalBitMap<N,T> *bitmap_intersection(const std::vector<IndexSpace<N,T> >& inputs)
+  {
+    if((DeppartConfig::cfg_bitmap_min_rects <= 0) || (inputs.size() != 2))
+      return 0;
+    HierarchicalBitMap<N,T> *lbmp = input_bitmap(inputs[0]);
+    HierarchicalBitMap<N,T> *rbmp = input_bitmap(inputs[1]);
+    if(!lbmp && !rbmp)
+      return 0;
+
+    // the result is no bigger than either bitmap input
+    Rect<N,T> bbox = input_extent(inputs[0]).intersection(input_extent(inputs[1]));
+    if(bbox.empty())
+      return 0;
+
+    HierarchicalBitMap<N,T> *result = new HierarchicalBitMap<N,T>(bbox);
+    fill_bitmap(*result, inputs[0], bbox);
+    if(rbmp) {
+      result->intersect_with(*rbmp, inputs[1].bounds);
+    } else if(!inputs[1].dense()) {
+      HierarchicalBitMap<N,T> mask(bbox);
+      fill_bitmap(mask, inputs[1], bbox);
+      result->intersect_with(mask, bbox);
+    }
+    // (a dense rhs contains everything in 'bbox' already)
+    return result;
+  }
+
+  template <int N, typename T>
+  static HierarchicalBitMap<N,T> *bitmap_difference(const IndexSpace<N,T>& lhs,
+						    const IndexSpace<N,T>& rhs)
+  {
+    if(DeppartConfig::cfg_bitmap_min_rects <= 0)
+      return 0;
+    HierarchicalBitMap<N,T> *rbmp = input_bitmap(rhs);
+    if(!input_bitmap(lhs) && !rbmp)
+      return 0;
+
+    Rect<N,T> bbox = input_extent(lhs);
+    if(bbox.empty() ||
+       (bbox.volume() > (input_bit_budget(lhs) + input_bit_budget(rhs))))
+      return 0;
+
+    HierarchicalBitMap<N,T> *result = new HierarchicalBitMap<N,T>(bbox);
+    fill_bitmap(*result, lhs, bbox);
+    if(rbmp) {
+      result->subtract(*rbmp, rhs.bounds);
+    } else if(rhs.dense()) {
+      result->clear_rect(rhs.bounds);
+      result->rebuild_summary();
+    } else {
+      Rect<N,T> clip = bbox.intersection(rhs.bounds);
+      if(!clip.empty()) {
+	HierarchicalBitMap<N,T> mask(clip);
+	fill_bitmap(mask, rhs, clip);
+	result->subtract(mask, clip);
+      }
+    }
+    return result;
+  }
+
+
   template <int N, typename T>
   class Fast1DUnion {
   public:
@@ -986,7 +1137,13 @@ namespace Realm {
 	  if(isect.empty())
 	    continue;
 	  assert(!it2->sparsity.exists());
-	  assert(it2->bitmap == 0);
+	  if(it2->bitmap != 0) {
+	    size_t pos = 0;
+	    Rect<N,T> run;
+	    while(it2->bitmap->next_run(isect, pos, run))
+	      bitmask.add_rect(run);
+	    continue;
+	  }
 	  bitmask.add_rect(isect);
 	}
       }
@@ -1003,11 +1160,27 @@ namespace Realm {
       std::cout << " + " << inputs[i];
     std::cout << std::endl;
 #endif
+    HierarchicalBitMap<N,T> *bitmap = bitmap_union(inputs);
+    if(bitmap) {
+      if(sparsity_output.exists()) {
+	SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(sparsity_output);
+	impl->contribute_bitmap(bitmap);
+      } else
+	delete bitmap;
+      return;
+    }
+
     DenseRectangleList<N,T> drl;
+    {
+      Rect<N,T> limits = Rect<N,T>::make_empty();
+      for(size_t i = 0; i < inputs.size(); i++)
+	limits = limits.union_bbox(inputs[i].bounds);
+      drl.enable_bitmap(limits);
+    }
     populate_bitmask(drl);
     if(sparsity_output.exists()) {
       SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(sparsity_output);
-      impl->contribute_dense_rect_list(drl.rects);
+      impl->contribute_dense_rect_list(drl);
     }
   }
 
@@ -1173,11 +1346,27 @@ namespace Realm {
       std::cout << " & " << inputs[i];
     std::cout << std::endl;
 #endif
+    HierarchicalBitMap<N,T> *bitmap = bitmap_intersection(inputs);
+    if(bitmap) {
+      if(sparsity_output.exists()) {
+	SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(sparsity_output);
+	impl->contribute_bitmap(bitmap);
+      } else
+	delete bitmap;
+      return;
+    }
+
     DenseRectangleList<N,T> drl;
+    {
+      Rect<N,T> limits = inputs[0].bounds;
+      for(size_t i = 1; i < inputs.size(); i++)
+	limits = limits.intersection(inputs[i].bounds);
+      drl.enable_bitmap(limits);
+    }
     populate_bitmask(drl);
     if(sparsity_output.exists()) {
       SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(sparsity_output);
-      impl->contribute_dense_rect_list(drl.rects);
+      impl->contribute_dense_rect_list(drl);
     }
   }
 
@@ -1312,38 +1501,38 @@ namespace Realm {
 	  break;
 	}
 
-	// consume lhs rectangles until we get one that overlaps
-	while(it_lhs.rect.hi.x < it_rhs.rect.lo.x) {
+	// an lhs rectangle entirely before this rhs one is copied as is - the
+	//  next one may lie past this rhs rectangle too, so go around again
+	if(it_lhs.rect.hi.x < it_rhs.rect.lo.x) {
 	  bitmask.add_rect(it_lhs.rect);
-	  if(!it_lhs.step()) break;
+	  it_lhs.step();
+	  continue;
 	}
 
 	// last case - partial overlap - subtract out rhs rect(s)
-	if(it_lhs.valid) {
-	  Point<N,T> p = it_lhs.rect.lo;
-	  while(it_rhs.valid) {
-	    if(p.x < it_rhs.rect.lo.x) {
-	      // add a partial rect below the rhs
-	      Point<N,T> p2 = it_rhs.rect.lo;
-	      p2.x -= 1;
-	      bitmask.add_rect(Rect<N,T>(p, p2));
-	    }
+	Point<N,T> p = it_lhs.rect.lo;
+	while(it_rhs.valid) {
+	  if(p.x < it_rhs.rect.lo.x) {
+	    // add a partial rect below the rhs
+	    Point<N,T> p2 = it_rhs.rect.lo;
+	    p2.x -= 1;
+	    bitmask.add_rect(Rect<N,T>(p, p2));
+	  }
 
-	    // if the rhs ends after the lhs, we're done
-	    if(it_rhs.rect.hi.x >= it_lhs.rect.hi.x)
-	      break;
-
-	    // otherwise consume the rhs and update p
-	    p = it_rhs.rect.hi;
-	    p.x += 1;
-	    if(!it_rhs.step() || (it_lhs.rect.hi.x < it_rhs.rect.lo.x)) {
-	      // no rhs left in this lhs piece - emit the rest and break out
-	      bitmask.add_rect(Rect<N,T>(p, it_lhs.rect.hi));
-	      break;
-	    }
+	  // if the rhs ends after the lhs, we're done
+	  if(it_rhs.rect.hi.x >= it_lhs.rect.hi.x)
+	    break;
+
+	  // otherwise consume the rhs and update p
+	  p = it_rhs.rect.hi;
+	  p.x += 1;
+	  if(!it_rhs.step() || (it_lhs.rect.hi.x < it_rhs.rect.lo.x)) {
+	    // no rhs left in this lhs piece - emit the rest and break out
+	    bitmask.add_rect(Rect<N,T>(p, it_lhs.rect.hi));
+	    break;
 	  }
-	  it_lhs.step();
 	}
+	it_lhs.step();
       }
       return;
     }
@@ -1364,7 +1553,13 @@ namespace Realm {
 	if(isect.empty())
 	  continue;
 	assert(!it->sparsity.exists());
-	assert(it->bitmap == 0);
+	if(it->bitmap != 0) {
+	  size_t pos = 0;
+	  Rect<N,T> run;
+	  while(it->bitmap->next_run(isect, pos, run))
+	    todo.push_back(run);
+	  continue;
+	}
 	todo.push_back(isect);
       }
     }
@@ -1413,11 +1608,22 @@ namespace Realm {
 #ifdef DEBUG_PARTITIONING
     std::cout << "calc difference: " << lhs << " - " << rhs << std::endl;
 #endif
+    HierarchicalBitMap<N,T> *bitmap = bitmap_difference(lhs, rhs);
+    if(bitmap) {
+      if(sparsity_output.exists()) {
+	SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(sparsity_output);
+	impl->contribute_bitmap(bitmap);
+      } else
+	delete bitmap;
+      return;
+    }
+
     DenseRectangleList<N,T> drl;
+    drl.enable_bitmap(lhs.bounds);
     populate_bitmask(drl);
     if(sparsity_output.exists()) {
       SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(sparsity_output);
-      impl->contribute_dense_rect_list(drl.rects);
+      impl->contribute_dense_rect_list(drl);
     }
   }
 
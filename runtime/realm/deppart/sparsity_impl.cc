@@ -154,7 +154,7 @@ namespace Realm {
 
   template <int N, typename T>
   SparsityMapPublicImpl<N,T>::SparsityMapPublicImpl(void)
-    : entries_valid(false), approx_valid(false)
+    : entries_valid(false), approx_valid(false), entry_index(0)
   {}
 
   // call actual implementation - inlining makes this cheaper than a virtual method
@@ -316,6 +316,15 @@ namespace Realm {
     contribute_raw_rects(&rects[0], rects.size(), true);
   }
 
+  template <int N, typename T>
+  void SparsityMapImpl<N,T>::contribute_dense_rect_list(DenseRectangleList<N,T>& drl)
+  {
+    if(drl.bitmap)
+      contribute_bitmap(drl.take_bitmap());
+    else
+      contribute_dense_rect_list(drl.rects);
+  }
+
   template <int N, typename T>
   void SparsityMapImpl<N,T>::contribute_raw_rects(const Rect<N,T>* rects,
 						  size_t count, bool last)
@@ -477,6 +486,35 @@ namespace Realm {
     }
   }
 
+  template <int N, typename T>
+  void SparsityMapImpl<N,T>::contribute_bitmap(HierarchicalBitMap<N,T> *bitmap)
+  {
+    NodeID owner = ID(me).sparsity.creator_node;
+
+    if(owner != my_node_id) {
+      // bitmaps have no wire format, so send the owner the runs instead
+      std::vector<Rect<N,T> > runs;
+      size_t pos = 0;
+      Rect<N,T> run;
+      while(bitmap->next_run(bitmap->get_bounds(), pos, run))
+	runs.push_back(run);
+      delete bitmap;
+      contribute_dense_rect_list(runs);
+      return;
+    }
+
+    // bitmaps are merged at finalization time, once we know how much data
+    //  there is
+    {
+      AutoHSLLock al(mutex);
+      pending_bitmaps.push_back(bitmap);
+    }
+
+    int left = __sync_sub_and_fetch(&remaining_contributor_count, 1);
+    if(left == 0)
+      finalize();
+  }
+
   // adds a microop as a waiter for valid sparsity map data - returns true
   //  if the uop is added to the list (i.e. will be getting a callback at some point),
   //  or false if the sparsity map became valid before this call (i.e. no callback)
@@ -583,8 +621,12 @@ namespace Realm {
 	  it != this->entries.end();
 	  it++) {
 	if(it->bitmap) {
-	  // TODO: send bitmap
-	  assert(0);
+	  // bitmaps are sent as their runs - the receiver will make its own
+	  //  choice of representation
+	  size_t pos = 0;
+	  Rect<N,T> run;
+	  while(it->bitmap->next_run(it->bounds, pos, run))
+	    rects.push_back(run);
 	}
 	else if(it->sparsity.exists()) {
 	  // TODO: ?
@@ -693,9 +735,71 @@ namespace Realm {
     // std::cout << " ]]]\n";
   }
 
+  template <int N, typename T>
+  void SparsityMapImpl<N,T>::choose_representation(void)
+  {
+    std::vector<HierarchicalBitMap<N,T> *> bitmaps;
+    {
+      AutoHSLLock al(mutex);
+      bitmaps.swap(pending_bitmaps);
+    }
+
+    // count the rectangles we'd need and the bounding box they'd cover
+    size_t rect_count = this->entries.size();
+    Rect<N,T> bbox = Rect<N,T>::make_empty();
+    for(size_t i = 0; i < this->entries.size(); i++)
+      bbox = bbox.union_bbox(this->entries[i].bounds);
+    for(size_t i = 0; i < bitmaps.size(); i++) {
+      size_t pos = 0;
+      Rect<N,T> run;
+      while(bitmaps[i]->next_run(bitmaps[i]->get_bounds(), pos, run)) {
+	rect_count++;
+	bbox = bbox.union_bbox(run);
+      }
+    }
+
+    bool use_bitmap = ((DeppartConfig::cfg_bitmap_min_rects > 0) &&
+		       (rect_count >= (size_t)DeppartConfig::cfg_bitmap_min_rects) &&
+		       (bbox.volume() <= (rect_count *
+					  DeppartConfig::cfg_bitmap_max_bits_per_rect)));
+
+    if(use_bitmap) {
+      HierarchicalBitMap<N,T> *bitmap = new HierarchicalBitMap<N,T>(bbox);
+      for(size_t i = 0; i < this->entries.size(); i++) {
+	assert(!this->entries[i].sparsity.exists());
+	assert(this->entries[i].bitmap == 0);
+	bitmap->set_rect(this->entries[i].bounds);
+      }
+      for(size_t i = 0; i < bitmaps.size(); i++) {
+	bitmap->union_with(*bitmaps[i], bitmaps[i]->get_bounds());
+	delete bitmaps[i];
+      }
+      log_part.info() << "using bitmap: sparsity=" << me << " rects=" << rect_count
+		      << " bounds=" << bbox << " bytes=" << bitmap->bytes_used();
+      this->entries.resize(1);
+      this->entries[0].bounds = bbox;
+      this->entries[0].sparsity.id = 0; // no sparsity map
+      this->entries[0].bitmap = bitmap;
+    } else {
+      // too sparse - turn any bitmaps back into rectangles
+      for(size_t i = 0; i < bitmaps.size(); i++) {
+	std::vector<Rect<N,T> > runs;
+	size_t pos = 0;
+	Rect<N,T> run;
+	while(bitmaps[i]->next_run(bitmaps[i]->get_bounds(), pos, run))
+	  runs.push_back(run);
+	if(!runs.empty())
+	  contribute_raw_rects(&runs[0], runs.size(), false /*!last*/);
+	delete bitmaps[i];
+      }
+    }
+  }
+
   template <int N, typename T>
   void SparsityMapImpl<N,T>::finalize(void)
   {
+    choose_representation();
+
     {
       LoggerMessage msg = log_part.info();
       if(msg.is_active()) {
@@ -28,6 +28,7 @@
 namespace Realm {
 
   class PartitioningMicroOp;
+  template <int N, typename T> class DenseRectangleList;
 
   template <int N, typename T>
   class SparsityMapImpl : public SparsityMapPublicImpl<N,T> {
@@ -49,7 +50,11 @@ namespace Realm {
 
     void contribute_nothing(void);
     void contribute_dense_rect_list(const std::vector<Rect<N,T> >& rects);
+    // contributes whichever of rectangles or bitmap 'drl' ended up with
+    void contribute_dense_rect_list(DenseRectangleList<N,T>& drl);
     void contribute_raw_rects(const Rect<N,T>* rects, size_t count, bool last);
+    // takes ownership of 'bitmap'
+    void contribute_bitmap(HierarchicalBitMap<N,T> *bitmap);
 
     // adds a microop as a waiter for valid sparsity map data - returns true
     //  if the uop is added to the list (i.e. will be getting a callback at some point),
@@ -63,6 +68,9 @@ namespace Realm {
 
   protected:
     void finalize(void);
+    // folds any contributed bitmaps into the entry list, switching over to a
+    //  single bitmap entry if the data is dense enough to warrant it
+    void choose_representation(void);
     
     int remaining_contributor_count;
     GASNetHSL mutex;
@@ -72,6 +80,7 @@ namespace Realm {
     NodeSet remote_precise_waiters, remote_approx_waiters;
     NodeSet remote_sharers;
     size_t sizeof_precise;
+    std::vector<HierarchicalBitMap<N,T> *> pending_bitmaps;
   };
 
   // we need a type-erased wrapper to store in the runtime's lookup table
@@ -21,6 +21,9 @@
 #include "realm/threads.h"
 #include "realm/profiling.h"
 
+#include <algorithm>
+#include <pthread.h>
+
 namespace Realm {
 
   Logger log_event("event");
@@ -358,6 +361,15 @@ namespace Realm {
     // if non-zero, eagerly checks deferred user event triggers for loops up to the
     //  specified limit
     int event_loop_detection_limit = 0;
+
+    // background workers that help wake events' waiters, and how many
+    //  waiters an event needs before they're used
+    int event_fanout_threads = 0;
+    int event_fanout_min_waiters = 256;
+
+    // merges of more than this many events build a tree of mergers with
+    //  at most this many inputs each (0 = always a single merger)
+    int event_merge_fanout = 0;
   };
 
   void UserEvent::trigger(Event wait_on) const
@@ -549,15 +561,8 @@ namespace Realm {
 	  if(impl->generation >= id.event.generation) {
 	    // already triggered!?
 	    assert(0);
-	  } else if((impl->generation + 1) == id.event.generation) {
-	    // current generation
-	    waiters_copy.assign(impl->current_local_waiters.begin(),
-				impl->current_local_waiters.end());
-	  } else {
-	    std::map<EventImpl::gen_t, std::vector<EventWaiter *> >::const_iterator it = impl->future_local_waiters.find(id.event.generation);
-	    if(it != impl->future_local_waiters.end())
-	      waiters_copy.assign(it->second.begin(), it->second.end());
-	  }
+	  } else
+	    impl->get_local_waiters(id.event.generation, waiters_copy);
 	}
       } else if(id.is_barrier()) {
 	assert(0);
@@ -632,6 +637,114 @@ namespace Realm {
   // class GenEventImpl
   //
 
+  // waiter stack nodes are recycled through a small per-thread cache - a
+  //  node is usually freed by a different thread than the one that
+  //  allocated it, but that just moves it between caches
+  // a thread's cache goes back to a shared list when the thread exits, and
+  //  a thread that runs dry takes a batch from there before using new
+  static const int WAITER_NODE_CACHE_MAX = 1024;
+  static const int WAITER_NODE_BATCH = 32;
+  static __thread GenEventImpl::WaiterNode *waiter_node_cache = 0;
+  static __thread int waiter_node_cache_size = 0;
+  static __thread bool waiter_node_exit_hook_set = false;
+
+  static GASNetHSL waiter_node_shared_mutex;
+  static GenEventImpl::WaiterNode *waiter_node_shared = 0;
+
+  // the only point of this key is its destructor, which runs at thread
+  //  exit for any thread that has given it a non-null value
+  static pthread_key_t waiter_node_exit_key;
+  static pthread_once_t waiter_node_exit_key_once = PTHREAD_ONCE_INIT;
+
+  static void flush_waiter_node_cache(void *)
+  {
+    if(waiter_node_cache) {
+      GenEventImpl::WaiterNode *tail = waiter_node_cache;
+      while(tail->next)
+	tail = tail->next;
+
+      AutoHSLLock al(waiter_node_shared_mutex);
+      tail->next = waiter_node_shared;
+      waiter_node_shared = waiter_node_cache;
+    }
+    waiter_node_cache = 0;
+    waiter_node_cache_size = 0;
+  }
+
+  static void create_waiter_node_exit_key(void)
+  {
+#ifndef NDEBUG
+    int ret =
+#endif
+      pthread_key_create(&waiter_node_exit_key, flush_waiter_node_cache);
+    assert(ret == 0);
+  }
+
+  static void set_waiter_node_exit_hook(void)
+  {
+    pthread_once(&waiter_node_exit_key_once, create_waiter_node_exit_key);
+    pthread_setspecific(waiter_node_exit_key, &waiter_node_exit_key);
+    waiter_node_exit_hook_set = true;
+  }
+
+  // takes up to a batch of nodes from the shared list
+  static void refill_waiter_node_cache(void)
+  {
+    AutoHSLLock al(waiter_node_shared_mutex);
+    while(waiter_node_shared &&
+	  (waiter_node_cache_size < WAITER_NODE_BATCH)) {
+      GenEventImpl::WaiterNode *node = waiter_node_shared;
+      waiter_node_shared = node->next;
+      node->next = waiter_node_cache;
+      waiter_node_cache = node;
+      waiter_node_cache_size++;
+    }
+  }
+
+  static GenEventImpl::WaiterNode *alloc_waiter_node(void)
+  {
+    if(!waiter_node_exit_hook_set)
+      set_waiter_node_exit_hook();
+    if(!waiter_node_cache && waiter_node_shared)
+      refill_waiter_node_cache();
+    GenEventImpl::WaiterNode *node = waiter_node_cache;
+    if(node) {
+      waiter_node_cache = node->next;
+      waiter_node_cache_size--;
+    } else {
+      node = new GenEventImpl::WaiterNode;
+      // the node pointer has to fit under the generation tag
+      assert((reinterpret_cast<uint64_t>(node) & ~GenEventImpl::WAITER_STACK_PTR_MASK) == 0);
+    }
+    return node;
+  }
+
+  static void free_waiter_node(GenEventImpl::WaiterNode *node)
+  {
+    if(waiter_node_cache_size < WAITER_NODE_CACHE_MAX) {
+      if(!waiter_node_exit_hook_set)
+	set_waiter_node_exit_hook();
+      node->next = waiter_node_cache;
+      waiter_node_cache = node;
+      waiter_node_cache_size++;
+    } else
+      delete node;
+  }
+
+  // wakes every waiter on a list, freeing the nodes as it goes
+  static void wake_waiter_list(GenEventImpl::WaiterNode *list, Event e, bool poisoned)
+  {
+    while(list) {
+      GenEventImpl::WaiterNode *next = list->next;
+      EventWaiter *waiter = list->waiter;
+      free_waiter_node(list);
+      bool nuke = waiter->event_triggered(e, poisoned);
+      if(nuke)
+	delete waiter;
+      list = next;
+    }
+  }
+
   GenEventImpl::GenEventImpl(void)
     : me((ID::IDType)-1), owner(-1)
   {
@@ -641,6 +754,7 @@ namespace Realm {
     num_poisoned_generations = 0;
     poisoned_generations = 0;
     has_local_triggers = false;
+    waiter_stack = waiter_stack_tag(1);
   }
 
   void GenEventImpl::init(ID _me, unsigned _init_owner)
@@ -653,6 +767,7 @@ namespace Realm {
     num_poisoned_generations = 0;
     poisoned_generations = 0;
     has_local_triggers = false;
+    waiter_stack = waiter_stack_tag(1);
   }
 
 
@@ -664,9 +779,25 @@ namespace Realm {
 	, ignore_faults(_ignore_faults)
 	, count_needed(1)
 	, faults_observed(0)
+	, root(this)
+	, parent(0)
       {
       }
 
+      // an interior node of a merge tree - instead of triggering an event,
+      //  it counts as one input of its parent, and any faults are recorded
+      //  by the root
+      EventMerger(EventMerger *_parent)
+	: finish_event(_parent->finish_event)
+	, ignore_faults(_parent->ignore_faults)
+	, count_needed(1)
+	, faults_observed(0)
+	, root(_parent->root)
+	, parent(_parent)
+      {
+	__sync_fetch_and_add(&parent->count_needed, 1);
+      }
+
       virtual ~EventMerger(void)
       {
       }
@@ -677,7 +808,7 @@ namespace Realm {
 	if(wait_for.has_triggered_faultaware(poisoned)) {
 	  if(poisoned) {
 	    // always count faults, but don't necessarily propagate
-	    bool first_fault = (__sync_fetch_and_add(&faults_observed, 1) == 0);
+	    bool first_fault = (__sync_fetch_and_add(&root->faults_observed, 1) == 0);
 	    if(first_fault && !ignore_faults) {
 	      log_poison.info() << "event merger early poison: after=" << finish_event;
 	      GenEventImpl::trigger(finish_event, true /*poisoned*/);
@@ -693,6 +824,14 @@ namespace Realm {
 	EventImpl::add_waiter(wait_for, this);
       }
 
+      // same as add_event, for an event the caller has already seen to be
+      //  untriggered (if it has since triggered, add_waiter handles it)
+      void add_pending_event(Event wait_for)
+      {
+        __sync_fetch_and_add(&count_needed, 1);
+	EventImpl::add_waiter(wait_for, this);
+      }
+
       // arms the merged event once you're done adding input events - just
       //  decrements the count for the implicit 'init done' event
       // return a boolean saying whether it triggered upon arming (which
@@ -707,7 +846,7 @@ namespace Realm {
       {
 	// if the input is poisoned, we propagate that poison eagerly
 	if(poisoned) {
-	  bool first_fault = (__sync_fetch_and_add(&faults_observed, 1) == 0);
+	  bool first_fault = (__sync_fetch_and_add(&root->faults_observed, 1) == 0);
 	  if(first_fault && !ignore_faults) {
 	    log_poison.info() << "event merger poisoned: after=" << finish_event;
 	    GenEventImpl::trigger(finish_event, true /*poisoned*/);
@@ -722,9 +861,16 @@ namespace Realm {
 	// count is the value before the decrement, so it was 1, it's now 0
 	bool last_trigger = (count_left == 1);
 
-	// trigger on the last input event, unless we did an early poison propagation
-	if(last_trigger && (ignore_faults || (faults_observed == 0))) {
-	  GenEventImpl::trigger(finish_event, false /*!poisoned*/);
+	if(last_trigger) {
+	  if(parent) {
+	    // a subtree just tells its parent it's done - if that finishes
+	    //  the parent, it's ours to delete
+	    if(parent->event_triggered(Event::NO_EVENT, false /*!poisoned*/))
+	      delete parent;
+	  } else if(ignore_faults || (faults_observed == 0)) {
+	    // trigger on the last input event, unless we did an early poison propagation
+	    GenEventImpl::trigger(finish_event, false /*!poisoned*/);
+	  }
 	}
 
         // caller can delete us if this was the last trigger
@@ -734,6 +880,8 @@ namespace Realm {
       virtual void print(std::ostream& os) const
       {
 	os << "event merger: " << finish_event << " left=" << count_needed;
+	if(parent)
+	  os << " (subtree)";
       }
 
       virtual Event get_finish_event(void) const
@@ -746,14 +894,88 @@ namespace Realm {
       bool ignore_faults;
       int count_needed;
       int faults_observed;
+      EventMerger *root, *parent;
     };
 
+    // adds 'count' (untriggered, distinct) events to a merger, building a
+    //  tree of child mergers below it if there are more than 'fanout' of them
+    //  so that no one merger's counter is hit by too many triggers
+    static void add_events_to_merger(EventMerger *m, const Event *events,
+				     size_t count, size_t fanout)
+    {
+      if(count <= fanout) {
+	for(size_t i = 0; i < count; i++)
+	  m->add_pending_event(events[i]);
+	return;
+      }
+
+      size_t per_child = (count + fanout - 1) / fanout;
+      for(size_t i = 0; i < count; i += per_child) {
+	EventMerger *child = new EventMerger(m);
+	add_events_to_merger(child, events + i, std::min(per_child, count - i),
+			     fanout);
+	if(child->arm())
+	  delete child;
+      }
+    }
+
+    // the tree version of merge_events - every input is checked up front,
+    //  so triggered and duplicate inputs never get a waiter, and a merge of
+    //  inputs that have all triggered costs no event at all
+    static Event merge_events_tree(std::vector<Event>& pending, bool ignore_faults,
+				   bool maybe_duplicates)
+    {
+      size_t num_pending = 0;
+      for(size_t i = 0; i < pending.size(); i++) {
+	bool poisoned = false;
+	if(!pending[i].exists())
+	  continue;
+	if(pending[i].has_triggered_faultaware(poisoned)) {
+	  if(poisoned && !ignore_faults) {
+	    log_poison.info() << "merging events - " << pending[i] << " already poisoned";
+	    return pending[i];
+	  }
+	} else
+	  pending[num_pending++] = pending[i];
+      }
+      pending.resize(num_pending);
+      if(maybe_duplicates) {
+	std::sort(pending.begin(), pending.end());
+	pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+      }
+
+      log_event.debug() << "merging events - " << pending.size() << " not triggered";
+
+      if(pending.empty()) return Event::NO_EVENT;
+      if((pending.size() == 1) && !ignore_faults) return pending[0];
+
+      Event finish_event = GenEventImpl::create_genevent()->current_event();
+      EventMerger *m = new EventMerger(finish_event, ignore_faults);
+      log_event.info() << "event merging: event=" << finish_event
+		       << " inputs=" << pending.size()
+		       << " fanout=" << Config::event_merge_fanout;
+      add_events_to_merger(m, &pending[0], pending.size(),
+			   Config::event_merge_fanout);
+      if(m->arm())
+	delete m;
+      return finish_event;
+    }
+
     // creates an event that won't trigger until all input events have
     /*static*/ Event GenEventImpl::merge_events(const std::set<Event>& wait_for,
 						bool ignore_faults)
     {
       if (wait_for.empty())
         return Event::NO_EVENT;
+#ifndef EVENT_GRAPH_TRACE
+      // wide merges are done as a tree if requested
+      if((Config::event_merge_fanout > 1) &&
+	 (wait_for.size() > (size_t)Config::event_merge_fanout)) {
+	std::vector<Event> pending(wait_for.begin(), wait_for.end());
+	return merge_events_tree(pending, ignore_faults,
+				 false /*set is unique*/);
+      }
+#endif
       // scan through events to see how many exist/haven't fired - we're
       //  interested in counts of 0, 1, or 2+ - also remember the first
       //  event we saw for the count==1 case
@@ -824,6 +1046,15 @@ namespace Realm {
     {
       if (wait_for.empty())
         return Event::NO_EVENT;
+#ifndef EVENT_GRAPH_TRACE
+      // wide merges are done as a tree if requested
+      if((Config::event_merge_fanout > 1) &&
+	 (wait_for.size() > (size_t)Config::event_merge_fanout)) {
+	std::vector<Event> pending(wait_for.begin(), wait_for.end());
+	return merge_events_tree(pending, ignore_faults,
+				 true /*maybe duplicates*/);
+      }
+#endif
       // scan through events to see how many exist/haven't fired - we're
       //  interested in counts of 0, 1, or 2+ - also remember the first
       //  event we saw for the count==1 case
@@ -1066,7 +1297,30 @@ namespace Realm {
 
       int subscribe_owner = -1;
       gen_t previous_subscribe_gen = 0;
-      {
+      if(owner == my_node_id) {
+	// the owner only ever has waiters for the current generation, and
+	//  those go on the lock-free stack
+	if(needed_gen > generation) {
+	  WaiterNode *node = alloc_waiter_node();
+	  node->waiter = waiter;
+	  uint64_t tag = waiter_stack_tag(needed_gen);
+	  while(true) {
+	    uint64_t head = waiter_stack;
+	    if((head & ~WAITER_STACK_PTR_MASK) != tag)
+	      break;  // the stack has moved on to the next generation
+	    node->next = reinterpret_cast<WaiterNode *>(head & WAITER_STACK_PTR_MASK);
+	    if(__sync_bool_compare_and_swap(&waiter_stack, head,
+					    (reinterpret_cast<uint64_t>(node) | tag)))
+	      return true;
+	  }
+	  free_waiter_node(node);
+	  // the trigger updates the generation before swapping the stack
+	  __sync_synchronize();
+	}
+	assert(needed_gen <= generation);
+	trigger_now = true;
+	trigger_poisoned = is_generation_poisoned(needed_gen);
+      } else {
 	AutoHSLLock a(mutex);
 
 	// three cases below
@@ -1477,6 +1731,7 @@ namespace Realm {
     public:
       PthreadCondWaiter(GASNetCondVar &_cv)
         : cv(_cv)
+	, triggered(false)
 	, poisoned(false)
       {
       }
@@ -1486,11 +1741,14 @@ namespace Realm {
 
       virtual bool event_triggered(Event e, bool _poisoned)
       {
+        // Need to hold the lock to avoid the race
+        AutoHSLLock al(cv.mutex);
+
 	// record whether event was poisoned - owner will inspect once awake
 	poisoned = _poisoned;
-
-        // Need to hold the lock to avoid the race
-        AutoHSLLock(cv.mutex);
+	// the waiter can't return (and destroy us) until this is set, even
+	//  if it sees the new generation first
+	triggered = true;
 	cv.signal();
         // we're allocated on caller's stack, so deleting would be bad
         return false;
@@ -1508,6 +1766,7 @@ namespace Realm {
 
     public:
       GASNetCondVar &cv;
+      bool triggered;
       bool poisoned;
     };
 
@@ -1520,7 +1779,7 @@ namespace Realm {
 	AutoHSLLock a(mutex);
 
 	// re-check condition before going to sleep
-	while(gen_needed > generation) {
+	while(!w.triggered) {
 	  // now just sleep on the condition variable - hope we wake up
 	  cv.wait();
 	}
@@ -1544,6 +1803,7 @@ namespace Realm {
 #endif
 
       std::vector<EventWaiter *> to_wake;
+      WaiterNode *stacked = 0;
 
       if(my_node_id == owner) {
 	// we own this event
@@ -1575,6 +1835,18 @@ namespace Realm {
 	  __sync_synchronize();
 	  generation = gen_triggered;
 
+	  // now take the waiter stack, leaving an empty one for the next
+	  //  generation - any push that loses the race to this will see
+	  //  the new generation
+	  uint64_t new_head = waiter_stack_tag(gen_triggered + 1);
+	  while(true) {
+	    uint64_t old_head = waiter_stack;
+	    if(__sync_bool_compare_and_swap(&waiter_stack, old_head, new_head)) {
+	      stacked = reinterpret_cast<WaiterNode *>(old_head & WAITER_STACK_PTR_MASK);
+	      break;
+	    }
+	  }
+
 	  // we'll free the event unless it's maxed out on poisoned generations
 	  //  or generation count
 	  free_event = ((num_poisoned_generations < POISONED_GENERATION_LIMIT) &&
@@ -1664,6 +1936,8 @@ namespace Realm {
       }
 
       // finally, trigger any local waiters
+      if(stacked)
+	notify_waiters(stacked, make_event(gen_triggered), poisoned);
       if(!to_wake.empty()) {
 	Event e = make_event(gen_triggered);
 	for(std::vector<EventWaiter *>::iterator it = to_wake.begin();
@@ -1678,6 +1952,167 @@ namespace Realm {
       }
     }
 
+    void GenEventImpl::get_local_waiters(gen_t gen,
+					 std::vector<EventWaiter *>& waiters) const
+    {
+      if(gen == (generation + 1)) {
+	waiters.insert(waiters.end(),
+		       current_local_waiters.begin(), current_local_waiters.end());
+	// the stack can't be detached while we hold the mutex, and nodes
+	//  pushed after we read the head don't change the ones below it
+	uint64_t head = waiter_stack;
+	if((head & ~WAITER_STACK_PTR_MASK) == waiter_stack_tag(gen))
+	  for(const WaiterNode *n = reinterpret_cast<const WaiterNode *>(head & WAITER_STACK_PTR_MASK);
+	      n;
+	      n = n->next)
+	    waiters.push_back(n->waiter);
+      } else {
+	std::map<gen_t, std::vector<EventWaiter *> >::const_iterator it = future_local_waiters.find(gen);
+	if(it != future_local_waiters.end())
+	  waiters.insert(waiters.end(), it->second.begin(), it->second.end());
+      }
+    }
+
+    /*static*/ void GenEventImpl::notify_waiters(WaiterNode *list, Event e, bool poisoned)
+    {
+      // the stack is newest-first - put the waiters back in the order they
+      //  were added, counting them as we go
+      WaiterNode *reversed = 0;
+      size_t count = 0;
+      while(list) {
+	WaiterNode *next = list->next;
+	list->next = reversed;
+	reversed = list;
+	list = next;
+	count++;
+      }
+
+      if((Config::event_fanout_threads > 0) &&
+	 (count >= (size_t)Config::event_fanout_min_waiters)) {
+	// split into one piece per worker plus one for this thread, which
+	//  takes the first piece so the oldest waiters go first
+	size_t pieces = Config::event_fanout_threads + 1;
+	size_t per_piece = (count + pieces - 1) / pieces;
+	WaiterNode *mine = reversed;
+	WaiterNode *tail = reversed;
+	for(size_t i = 1; i < per_piece; i++)
+	  tail = tail->next;
+	WaiterNode *rest = tail->next;
+	tail->next = 0;
+	while(rest) {
+	  WaiterNode *piece = rest;
+	  tail = rest;
+	  for(size_t i = 1; (i < per_piece) && tail->next; i++)
+	    tail = tail->next;
+	  rest = tail->next;
+	  tail->next = 0;
+	  if(!EventFanoutWorkers::enqueue(piece, e, poisoned))
+	    wake_waiter_list(piece, e, poisoned);
+	}
+	wake_waiter_list(mine, e, poisoned);
+      } else
+	wake_waiter_list(reversed, e, poisoned);
+    }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class EventFanoutWorkers
+  //
+
+  static EventFanoutWorkers *fanout_workers = 0;
+
+  EventFanoutWorkers::EventFanoutWorkers(CoreReservation *_rsrv)
+    : shutdown_flag(false), rsrv(_rsrv), condvar(mutex)
+  {}
+
+  EventFanoutWorkers::~EventFanoutWorkers(void)
+  {
+    assert(shutdown_flag);
+    assert(batches.empty());
+    delete rsrv;
+  }
+
+  /*static*/ void EventFanoutWorkers::start_worker_threads(CoreReservationSet& crs)
+  {
+    assert(fanout_workers == 0);
+    CoreReservation *rsrv = new CoreReservation("event fanout", crs,
+						CoreReservationParameters());
+    fanout_workers = new EventFanoutWorkers(rsrv);
+    ThreadLaunchParameters tlp;
+    for(int i = 0; i < Config::event_fanout_threads; i++) {
+      Thread *t = Thread::create_kernel_thread<EventFanoutWorkers,
+					       &EventFanoutWorkers::worker_thread_loop>(fanout_workers,
+											tlp,
+											*rsrv);
+      fanout_workers->workers.push_back(t);
+    }
+  }
+
+  /*static*/ void EventFanoutWorkers::stop_worker_threads(void)
+  {
+    assert(fanout_workers != 0);
+
+    // workers wake anything that's already queued before they exit, and
+    //  triggers from here on wake their own waiters
+    {
+      AutoHSLLock al(fanout_workers->mutex);
+      fanout_workers->shutdown_flag = true;
+      fanout_workers->condvar.broadcast();
+    }
+    for(size_t i = 0; i < fanout_workers->workers.size(); i++) {
+      fanout_workers->workers[i]->join();
+      delete fanout_workers->workers[i];
+    }
+    fanout_workers->workers.clear();
+
+    delete fanout_workers;
+    fanout_workers = 0;
+  }
+
+  /*static*/ bool EventFanoutWorkers::enqueue(GenEventImpl::WaiterNode *list,
+					      Event e, bool poisoned)
+  {
+    if(!fanout_workers)
+      return false;
+
+    Batch b;
+    b.list = list;
+    b.event = e;
+    b.poisoned = poisoned;
+
+    AutoHSLLock al(fanout_workers->mutex);
+    if(fanout_workers->shutdown_flag)
+      return false;
+    fanout_workers->batches.push_back(b);
+    fanout_workers->condvar.signal();
+    return true;
+  }
+
+  void EventFanoutWorkers::worker_thread_loop(void)
+  {
+    while(true) {
+      Batch b;
+      {
+	AutoHSLLock al(mutex);
+	while(batches.empty() && !shutdown_flag)
+	  condvar.wait();
+	if(batches.empty())
+	  break;
+	b = batches.front();
+	batches.pop_front();
+      }
+
+      wake_waiter_list(b.list, b.event, b.poisoned);
+    }
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class BarrierImpl
+  //
+
     /*static*/ BarrierImpl *BarrierImpl::create_barrier(unsigned expected_arrivals,
 							ReductionOpID redopid,
 							const void *initial_value /*= 0*/,
@@ -2245,7 +2680,7 @@ static void *bytedup(const void *data, size_t datalen)
 	AutoHSLLock a(mutex);
 
 	// re-check condition before going to sleep
-	while(needed_gen > generation) {
+	while(!w.triggered) {
 	  // now just sleep on the condition variable - hope we wake up
 	  cv.wait();
 	}
@@ -27,9 +27,15 @@
 
 #include <vector>
 #include <map>
+#include <deque>
+#include <stdint.h>
 
 namespace Realm {
 
+    class CoreReservation;
+    class CoreReservationSet;
+    class Thread;
+
 #ifdef EVENT_TRACING
     // For event tracing
     struct EventTraceItem {
@@ -119,6 +125,22 @@ namespace Realm {
 			  const gen_t *new_poisoned_generations,
 			  int new_poisoned_count);
 
+      // appends the local waiters for generation 'gen' to 'waiters' - caller
+      //  must hold the mutex
+      void get_local_waiters(gen_t gen, std::vector<EventWaiter *>& waiters) const;
+
+      // a single EventWaiter can be waiting on several events at once (e.g.
+      //  an EventMerger), so the lock-free waiter stack links these small
+      //  nodes rather than the waiters themselves
+      struct WaiterNode {
+	EventWaiter *waiter;
+	WaiterNode *next;
+      };
+
+      // wakes a list of waiters (which is consumed), splitting long lists
+      //  across the fan-out workers if there are any
+      static void notify_waiters(WaiterNode *list, Event e, bool poisoned);
+
     public: //protected:
       ID me;
       NodeID owner;
@@ -144,6 +166,22 @@ namespace Realm {
       std::vector<EventWaiter *> current_local_waiters;
       std::map<gen_t, std::vector<EventWaiter *> > future_local_waiters;
 
+      // on the owner, local waiters for the current generation are instead
+      //  pushed (without taking the mutex) onto this stack - the low bits
+      //  are the top WaiterNode and the upper bits are the low bits of the
+      //  generation being waited for, so a push that races with the
+      //  trigger (which swaps in an empty stack tagged with the next
+      //  generation) fails and the waiter sees the event as triggered
+      // the stack is only detached with the mutex held, so anything holding
+      //  the mutex can safely walk it
+      static const int WAITER_STACK_TAG_SHIFT = 48;
+      static const uint64_t WAITER_STACK_PTR_MASK = (((uint64_t)1) << WAITER_STACK_TAG_SHIFT) - 1;
+      static uint64_t waiter_stack_tag(gen_t gen)
+      {
+	return ((uint64_t)gen) << WAITER_STACK_TAG_SHIFT;
+      }
+      volatile uint64_t waiter_stack;
+
       // remote waiters are kept in a bitmask for the current generation - this is
       //  only maintained on the owner, who never has to worry about more than one
       //  generation
@@ -167,6 +205,38 @@ namespace Realm {
       std::map<gen_t, bool> local_triggers;
     };
 
+    // triggers of events with lots of local waiters can hand most of the
+    //  waiters to a pool of background workers (-ll:event_fanout) instead of
+    //  waking all of them on the triggering thread
+    class EventFanoutWorkers {
+    public:
+      static void start_worker_threads(CoreReservationSet& crs);
+      static void stop_worker_threads(void);
+
+      // returns false if there are no workers (or they've been stopped), in
+      //  which case the caller must wake the waiters itself
+      static bool enqueue(GenEventImpl::WaiterNode *list, Event e, bool poisoned);
+
+    protected:
+      EventFanoutWorkers(CoreReservation *_rsrv);
+      ~EventFanoutWorkers(void);
+
+      struct Batch {
+	GenEventImpl::WaiterNode *list;
+	Event event;
+	bool poisoned;
+      };
+
+      void worker_thread_loop(void);
+
+      bool shutdown_flag;
+      CoreReservation *rsrv;
+      GASNetHSL mutex;
+      GASNetCondVar condvar;
+      std::deque<Batch> batches;
+      std::vector<Thread *> workers;
+    };
+
     class BarrierImpl : public EventImpl {
     public:
       static const ID::ID_Types ID_TYPE = ID::ID_BARRIER;
@@ -54,13 +54,17 @@ namespace Realm {
   public:
   CopySrcDstField(void) 
     : inst(RegionInstance::NO_INST), field_id(FieldID(-1)), size(0), 
-      serdez_id(0), subfield_offset(0) { }
+      serdez_id(0), subfield_offset(0), red_exclusive(false) { }
   public:
     RegionInstance inst;
     FieldID field_id;
     size_t size;
     CustomSerdezID serdez_id;
     size_t subfield_offset;
+    // for the destination of a reduction copy: nothing else reads or
+    //  updates the destination while the copy runs, so the reduction can
+    //  be applied non-atomically (and vectorized for the built-in ops)
+    bool red_exclusive;
   };
 
   // new stuff here - the "Z" prefix will go away once we delete the old stuff
@@ -330,6 +334,9 @@ namespace Realm {
 
     bool overlaps_approx(const IndexSpace<N,T>& other) const;
 
+    // the both-sparse case of overlaps (or overlaps_approx if !precise)
+    bool overlaps_sparse(const IndexSpace<N,T>& other, bool precise) const;
+
     // approximage number of points in index space (may be less than volume of bounding box, but larger than
     //   actual volume)
     size_t volume_approx(void) const;
@@ -405,6 +412,29 @@ namespace Realm {
 				    const ProfilingRequestSet &reqs,
 				    Event wait_on = Event::NO_EVENT) const;
 
+    // recomputes a by-field partition after some of the field data has changed -
+    //  'prev_subspaces' must be the subspaces (for the same colors) computed from the
+    //  old field data, and 'changed' must cover every point of this space whose color
+    //  may have changed - only the field data of the changed points is read, and the
+    //  rest of each old subspace is carried over as is
+    template <typename FT>
+    Event update_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,FT> >& field_data,
+				    const std::vector<FT>& colors,
+				    const std::vector<IndexSpace<N,T> >& prev_subspaces,
+				    const IndexSpace<N,T>& changed,
+				    std::vector<IndexSpace<N,T> >& subspaces,
+				    const ProfilingRequestSet &reqs,
+				    Event wait_on = Event::NO_EVENT) const;
+
+    template <typename FT>
+    Event update_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,FT> >& field_data,
+				    const std::vector<FT>& colors,
+				    const std::vector<IndexSpace<N,T> >& prev_subspaces,
+				    const std::vector<Point<N,T> >& changed_points,
+				    std::vector<IndexSpace<N,T> >& subspaces,
+				    const ProfilingRequestSet &reqs,
+				    Event wait_on = Event::NO_EVENT) const;
+
     // this version allows the "function" described by the field to be composed with a
     //  second (computable) function before matching the colors - the second function
     //  is provided via a CodeDescriptor object and should have the type FT->FT2
@@ -457,6 +487,34 @@ namespace Realm {
 				    const ProfilingRequestSet &reqs,
 				    Event wait_on = Event::NO_EVENT) const;
 
+    // recomputes images after some sources and/or pointers have changed - 'changed'
+    //  must cover every source point whose pointer changed or that moved between
+    //  sources, and 'prev_images' must be the images of 'prev_sources'
+    // an image whose source only gained points is the old image plus the image of the
+    //  new points, and one whose source didn't change at all is reused as is - only
+    //  the images of sources that lost points have to be recomputed in full (the old
+    //  image doesn't say which other source points also pointed at a lost point's
+    //  target)
+    template <int N2, typename T2>
+    Event update_subspaces_by_image(const std::vector<FieldDataDescriptor<IndexSpace<N2,T2>,Point<N,T> > >& field_data,
+				    const std::vector<IndexSpace<N2,T2> >& prev_sources,
+				    const std::vector<IndexSpace<N,T> >& prev_images,
+				    const std::vector<IndexSpace<N2,T2> >& sources,
+				    const IndexSpace<N2,T2>& changed,
+				    std::vector<IndexSpace<N,T> >& images,
+				    const ProfilingRequestSet &reqs,
+				    Event wait_on = Event::NO_EVENT) const;
+
+    template <int N2, typename T2>
+    Event update_subspaces_by_image(const std::vector<FieldDataDescriptor<IndexSpace<N2,T2>,Point<N,T> > >& field_data,
+				    const std::vector<IndexSpace<N2,T2> >& prev_sources,
+				    const std::vector<IndexSpace<N,T> >& prev_images,
+				    const std::vector<IndexSpace<N2,T2> >& sources,
+				    const std::vector<Point<N2,T2> >& changed_points,
+				    std::vector<IndexSpace<N,T> >& images,
+				    const ProfilingRequestSet &reqs,
+				    Event wait_on = Event::NO_EVENT) const;
+
     // a common case that is worth optimizing is when the computed image is
     //  going to be restricted by an intersection or difference operation - it
     //  can often be much faster to filter the projected points before stuffing
@@ -689,6 +747,8 @@ namespace Realm {
     // for iterating over SparsityMap's
     SparsityMapPublicImpl<N,T> *s_impl;
     size_t cur_entry;
+    // position within the current entry's bitmap (if it has one)
+    size_t cur_bit;
 
     IndexSpaceIterator(void);
     IndexSpaceIterator(const IndexSpace<N,T>& _space);
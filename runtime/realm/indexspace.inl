@@ -861,6 +861,33 @@ namespace Realm {
     return lo;
   }   
 
+  // a PackedRTree marker for a sparsity map's entry index that stops at the
+  //  first entry with any points in the query rectangle
+  template <int N, typename T>
+  class SparsityEntryMatcher {
+  public:
+    SparsityEntryMatcher(const std::vector<SparsityMapEntry<N,T> >& _entries,
+			 const Rect<N,T>& _query)
+      : entries(_entries), query(_query) {}
+
+    bool mark_overlap(const Rect<N,T>& r, size_t idx)
+    {
+      const SparsityMapEntry<N,T>& e = entries[idx];
+      if(e.sparsity.exists()) {
+	assert(0);
+      }
+      if(e.bitmap == 0)
+	return true;
+      size_t pos = 0;
+      Rect<N,T> run;
+      return e.bitmap->next_run(query, pos, run);
+    }
+
+  protected:
+    const std::vector<SparsityMapEntry<N,T> >& entries;
+    Rect<N,T> query;
+  };
+
   // queries for individual points or rectangles
   template <int N, typename T>
   inline bool IndexSpace<N,T>::contains(const Point<N,T>& p) const
@@ -890,11 +917,16 @@ namespace Realm {
       if(e.sparsity.exists()) {
 	assert(0);
       }
-      if(e.bitmap != 0) {
-	assert(0);
-      }
+      if(e.bitmap != 0)
+	return e.bitmap->is_set(p);
       return true;
     } else {
+      const PackedRTree<N,T,size_t> *index = impl->get_entry_index();
+      if(index != 0) {
+	SparsityEntryMatcher<N,T> matcher(entries, Rect<N,T>(p, p));
+	return index->test_point(p, matcher);
+      }
+
       for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = entries.begin();
 	  it != entries.end();
 	  it++) {
@@ -902,7 +934,8 @@ namespace Realm {
 	if(it->sparsity.exists()) {
 	  assert(0);
 	} else if(it->bitmap != 0) {
-	  assert(0);
+	  if(it->bitmap->is_set(p))
+	    return true;
 	} else {
 	  return true;
 	}
@@ -939,14 +972,25 @@ namespace Realm {
       // test against sparsity map too
       SparsityMapPublicImpl<N,T> *impl = sparsity.impl();
       const std::vector<SparsityMapEntry<N,T> >& entries = impl->get_entries();
+      Rect<N,T> clipped = bounds.intersection(r);
+      const PackedRTree<N,T,size_t> *index = impl->get_entry_index();
+      if(index != 0) {
+	SparsityEntryMatcher<N,T> matcher(entries, clipped);
+	return index->test_rect(clipped, matcher);
+      }
+
       for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = entries.begin();
 	  it != entries.end();
 	  it++) {
-	if(!it->bounds.overlaps(r)) continue;
+	if(!it->bounds.overlaps(clipped)) continue;
 	if(it->sparsity.exists()) {
 	  assert(0);
 	} else if(it->bitmap != 0) {
-	  assert(0);
+	  // any run at all within 'r' will do
+	  size_t pos = 0;
+	  Rect<N,T> run;
+	  if(it->bitmap->next_run(clipped, pos, run))
+	    return true;
 	} else {
 	  return true;
 	}
@@ -973,11 +1017,49 @@ namespace Realm {
       if(other.dense()) {
 	return contains_any(other.bounds);
       } else {
-	// nasty case - both sparse
-	assert(0);
-	return true;
+	return overlaps_sparse(other, true /*precise*/);
+      }
+    }
+  }
+
+  // nasty case of overlaps/overlaps_approx - both sparse - walk the pieces
+  //  of whichever has fewer of them and test each against the other
+  template <int N, typename T>
+  inline bool IndexSpace<N,T>::overlaps_sparse(const IndexSpace<N,T>& other,
+					      bool precise) const
+  {
+    Rect<N,T> common = bounds.intersection(other.bounds);
+    if(common.empty())
+      return false;
+    SparsityMapPublicImpl<N,T> *impl = sparsity.impl();
+    SparsityMapPublicImpl<N,T> *other_impl = other.sparsity.impl();
+
+    if(precise) {
+      const IndexSpace<N,T> *walk = this;
+      const IndexSpace<N,T> *test = &other;
+      if(impl->get_entries().size() > other_impl->get_entries().size()) {
+	walk = &other;
+	test = this;
+      }
+      for(IndexSpaceIterator<N,T> it(*walk, common); it.valid; it.step())
+	if(test->contains_any(it.rect))
+	  return true;
+    } else {
+      const std::vector<Rect<N,T> > *walk = &impl->get_approx_rects();
+      const IndexSpace<N,T> *test = &other;
+      if(walk->size() > other_impl->get_approx_rects().size()) {
+	walk = &other_impl->get_approx_rects();
+	test = this;
+      }
+      for(typename std::vector<Rect<N,T> >::const_iterator it = walk->begin();
+	  it != walk->end();
+	  it++) {
+	Rect<N,T> isect = it->intersection(common);
+	if(!isect.empty() && test->contains_any_approx(isect))
+	  return true;
       }
     }
+    return false;
   }
 
   // actual number of points in index space (may be less than volume of bounding box)
@@ -999,7 +1081,14 @@ namespace Realm {
       if(it->sparsity.exists()) {
 	assert(0);
       } else if(it->bitmap != 0) {
-	assert(0);
+	if(isect == it->bounds) {
+	  total += it->bitmap->count();
+	} else {
+	  size_t pos = 0;
+	  Rect<N,T> run;
+	  while(it->bitmap->next_run(isect, pos, run))
+	    total += run.volume();
+	}
       } else {
 	total += isect.volume();
       }
@@ -1098,9 +1187,7 @@ namespace Realm {
       if(other.dense()) {
 	return contains_any_approx(other.bounds);
       } else {
-	// nasty case - both sparse
-	assert(0);
-	return true;
+	return overlaps_sparse(other, false /*!precise*/);
       }
     }
   }
@@ -1155,6 +1242,22 @@ namespace Realm {
     return e;
   }
 
+  // list-of-points wrapper for the index space version
+  template <int N, typename T>
+  template <typename FT>
+  inline Event IndexSpace<N,T>::update_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,FT> >& field_data,
+							   const std::vector<FT>& colors,
+							   const std::vector<IndexSpace<N,T> >& prev_subspaces,
+							   const std::vector<Point<N,T> >& changed_points,
+							   std::vector<IndexSpace<N,T> >& subspaces,
+							   const ProfilingRequestSet &reqs,
+							   Event wait_on /*= Event::NO_EVENT*/) const
+  {
+    return update_subspaces_by_field(field_data, colors, prev_subspaces,
+				     IndexSpace<N,T>(changed_points),
+				     subspaces, reqs, wait_on);
+  }
+
   // simple wrapper for the multiple subspace version
   template <int N, typename T>
   template <int N2, typename T2>
@@ -1187,6 +1290,23 @@ namespace Realm {
     return e;
   }
 
+  // list-of-points wrapper for the index space version
+  template <int N, typename T>
+  template <int N2, typename T2>
+  inline Event IndexSpace<N,T>::update_subspaces_by_image(const std::vector<FieldDataDescriptor<IndexSpace<N2,T2>,Point<N,T> > >& field_data,
+							   const std::vector<IndexSpace<N2,T2> >& prev_sources,
+							   const std::vector<IndexSpace<N,T> >& prev_images,
+							   const std::vector<IndexSpace<N2,T2> >& sources,
+							   const std::vector<Point<N2,T2> >& changed_points,
+							   std::vector<IndexSpace<N,T> >& images,
+							   const ProfilingRequestSet &reqs,
+							   Event wait_on /*= Event::NO_EVENT*/) const
+  {
+    return update_subspaces_by_image(field_data, prev_sources, prev_images, sources,
+				     IndexSpace<N2,T2>(changed_points),
+				     images, reqs, wait_on);
+  }
+
   // simple wrapper for the multiple subspace version
   template <int N, typename T>
   template <int N2, typename T2>
@@ -1404,7 +1524,14 @@ namespace Realm {
 	rect = restriction.intersection(e.bounds);
 	if(!rect.empty()) {
 	  assert(!e.sparsity.exists());
-	  assert(e.bitmap == 0);
+	  if(e.bitmap != 0) {
+	    // start with the bitmap's first run, if it has any in range
+	    cur_bit = 0;
+	    if(!e.bitmap->next_run(restriction, cur_bit, rect)) {
+	      cur_entry++;
+	      continue;
+	    }
+	  }
 	  valid = true;
 	  return;
 	}
@@ -1444,7 +1571,14 @@ namespace Realm {
 	rect = restriction.intersection(e.bounds);
 	if(!rect.empty()) {
 	  assert(!e.sparsity.exists());
-	  assert(e.bitmap == 0);
+	  if(e.bitmap != 0) {
+	    // start with the bitmap's first run, if it has any in range
+	    cur_bit = 0;
+	    if(!e.bitmap->next_run(restriction, cur_bit, rect)) {
+	      cur_entry++;
+	      continue;
+	    }
+	  }
 	  valid = true;
 	  return;
 	}
@@ -1467,10 +1601,14 @@ namespace Realm {
       return false;
     }
 
-    // TODO: handle iteration within a sparsity entry
+    // a bitmap entry is walked one run at a time
+    const std::vector<SparsityMapEntry<N,T> >& entries = s_impl->get_entries();
+    if(entries[cur_entry].bitmap != 0) {
+      if(entries[cur_entry].bitmap->next_run(restriction, cur_bit, rect))
+	return true;
+    }
 
     // move onto the next sparsity entry (that overlaps our restriction)
-    const std::vector<SparsityMapEntry<N,T> >& entries = s_impl->get_entries();
     for(cur_entry++; cur_entry < entries.size(); cur_entry++) {
       const SparsityMapEntry<N,T>& e = entries[cur_entry];
       rect = restriction.intersection(e.bounds);
@@ -1484,7 +1622,11 @@ namespace Realm {
       }
 
       assert(!e.sparsity.exists());
-      assert(e.bitmap == 0);
+      if(e.bitmap != 0) {
+	cur_bit = 0;
+	if(!e.bitmap->next_run(restriction, cur_bit, rect))
+	  continue;
+      }
       return true;
     }
 
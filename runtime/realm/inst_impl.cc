@@ -85,54 +85,12 @@ namespace Realm {
       return i_impl->memory;
     }
 
-    /*static*/ Event RegionInstance::create_instance(RegionInstance& inst,
-						     Memory memory,
-						     InstanceLayoutGeneric *ilg,
-						     const ProfilingRequestSet& prs,
-						     Event wait_on)
+    // returns the event that triggers once an instance's storage has been
+    //  allocated - 'immediate' is what allocate_instance_storage returned
+    static Event allocation_ready_event(RegionInstanceImpl *impl, bool immediate)
     {
-      MemoryImpl *m_impl = get_runtime()->get_memory_impl(memory);
-      RegionInstanceImpl *impl = m_impl->new_instance();
-      // we can fail to get a valid pointer if we are out of instance slots
-      if(!impl) {
-	inst = RegionInstance::NO_INST;
-	// import the profiling requests to see if anybody is paying attention to
-	//  failure
-	ProfilingMeasurementCollection pmc;
-	pmc.import_requests(prs);
-	if(pmc.wants_measurement<ProfilingMeasurements::InstanceStatus>()) {
-	  ProfilingMeasurements::InstanceStatus stat;
-	  stat.result = ProfilingMeasurements::InstanceStatus::INSTANCE_COUNT_EXCEEDED;
-	  stat.error_code = 0;
-	  pmc.add_measurement(stat);
-	} else {
-	  // fatal error
-	  log_inst.fatal() << "FATAL: instance count exceeded for memory " << memory;
-	  assert(0);
-	}
-	// generate a poisoned event for completion
-	GenEventImpl *ev = GenEventImpl::create_genevent();
-	Event ready_event = ev->current_event();
-	GenEventImpl::trigger(ready_event, true /*poisoned*/);
-	return ready_event;
-      }
-
-      impl->metadata.layout = ilg;
-      
-      if (!prs.empty()) {
-        impl->requests = prs;
-        impl->measurements.import_requests(impl->requests);
-        if(impl->measurements.wants_measurement<ProfilingMeasurements::InstanceTimeline>())
-          impl->timeline.record_create_time();
-      }
-
-      // request allocation of storage - a true response means it was serviced right
-      //  away
       Event ready_event;
-      if(m_impl->allocate_instance_storage(impl->me,
-					   ilg->bytes_used,
-					   ilg->alignment_reqd,
-					   wait_on)) {
+      if(immediate) {
 	assert(impl->metadata.inst_offset != (size_t)-1);
 	if(impl->metadata.inst_offset != (size_t)-2) {
 	  // successful allocation
@@ -176,6 +134,57 @@ namespace Realm {
 	  }
 	}
       }
+      return ready_event;
+    }
+
+    /*static*/ Event RegionInstance::create_instance(RegionInstance& inst,
+						     Memory memory,
+						     InstanceLayoutGeneric *ilg,
+						     const ProfilingRequestSet& prs,
+						     Event wait_on)
+    {
+      MemoryImpl *m_impl = get_runtime()->get_memory_impl(memory);
+      RegionInstanceImpl *impl = m_impl->new_instance();
+      // we can fail to get a valid pointer if we are out of instance slots
+      if(!impl) {
+	inst = RegionInstance::NO_INST;
+	// import the profiling requests to see if anybody is paying attention to
+	//  failure
+	ProfilingMeasurementCollection pmc;
+	pmc.import_requests(prs);
+	if(pmc.wants_measurement<ProfilingMeasurements::InstanceStatus>()) {
+	  ProfilingMeasurements::InstanceStatus stat;
+	  stat.result = ProfilingMeasurements::InstanceStatus::INSTANCE_COUNT_EXCEEDED;
+	  stat.error_code = 0;
+	  pmc.add_measurement(stat);
+	} else {
+	  // fatal error
+	  log_inst.fatal() << "FATAL: instance count exceeded for memory " << memory;
+	  assert(0);
+	}
+	// generate a poisoned event for completion
+	GenEventImpl *ev = GenEventImpl::create_genevent();
+	Event ready_event = ev->current_event();
+	GenEventImpl::trigger(ready_event, true /*poisoned*/);
+	return ready_event;
+      }
+
+      impl->metadata.layout = ilg;
+      
+      if (!prs.empty()) {
+        impl->requests = prs;
+        impl->measurements.import_requests(impl->requests);
+        if(impl->measurements.wants_measurement<ProfilingMeasurements::InstanceTimeline>())
+          impl->timeline.record_create_time();
+      }
+
+      // request allocation of storage - a true response means it was serviced right
+      //  away
+      bool immediate = m_impl->allocate_instance_storage(impl->me,
+							 ilg->bytes_used,
+							 ilg->alignment_reqd,
+							 wait_on);
+      Event ready_event = allocation_ready_event(impl, immediate);
 
       inst = impl->me;
       log_inst.info() << "instance created: inst=" << inst << " bytes=" << ilg->bytes_used << " ready=" << ready_event;
@@ -209,20 +218,19 @@ namespace Realm {
       unsigned char *impl_base = 
         (unsigned char*)m_impl->get_direct_ptr(0/*offset*/, 0/*size*/);
       size_t inst_offset = (size_t)(((unsigned char*)base) - impl_base);
-#ifndef NDEBUG
-      bool ok = 
-#endif
-        m_impl->allocate_instance_storage(impl->me,
-					  ilg->bytes_used,
-					  ilg->alignment_reqd,
-					  wait_on, 
-                                          inst_offset);
-      assert(ok);
+      // this may be answered asynchronously (e.g. if the defragmenter has to
+      //  make room first)
+      bool immediate = m_impl->allocate_instance_storage(impl->me,
+							 ilg->bytes_used,
+							 ilg->alignment_reqd,
+							 wait_on, 
+							 inst_offset);
+      Event ready_event = allocation_ready_event(impl, immediate);
 
       inst = impl->me;
-      log_inst.info() << "external instance created: inst=" << inst;
+      log_inst.info() << "external instance created: inst=" << inst << " ready=" << ready_event;
       log_inst.debug() << "external instance layout: inst=" << inst << " layout=" << *ilg;
-      return Event::NO_EVENT;
+      return ready_event;
     }
 
     void RegionInstance::destroy(Event wait_on /*= Event::NO_EVENT*/) const
@@ -404,6 +412,39 @@ namespace Realm {
       stride = orig_stride;
     }
 
+    // accessors that hold on to pointers into an instance pin it so that the
+    //  memory's defragmenter won't move it out from under them
+    bool RegionInstance::increment_accessor_count(void)
+    {
+      RegionInstanceImpl *r_impl = get_runtime()->get_instance_impl(*this);
+      while(true) {
+	Event e = r_impl->try_pin();
+	if(!e.exists())
+	  return true;
+	// being moved - wait for that to finish and try again
+	e.wait();
+      }
+    }
+
+    bool RegionInstance::decrement_accessor_count(void)
+    {
+      RegionInstanceImpl *r_impl = get_runtime()->get_instance_impl(*this);
+      return r_impl->unpin();
+    }
+
+    void RegionInstance::set_relocatable(bool relocatable) const
+    {
+      // the defragmenter only considers instances created on its own node,
+      //  so that's the only place the mark means anything
+      if(NodeID(ID(*this).instance.creator_node) != my_node_id) {
+	log_inst.warning() << "set_relocatable ignored for remote instance: inst=" << *this;
+	return;
+      }
+      RegionInstanceImpl *r_impl = get_runtime()->get_instance_impl(*this);
+      AutoHSLLock al(r_impl->mutex);
+      r_impl->relocatable = relocatable;
+    }
+
     void RegionInstance::report_instance_fault(int reason,
 					       const void *reason_data,
 					       size_t reason_size) const
@@ -426,6 +467,11 @@ namespace Realm {
       metadata.inst_offset = (size_t)-1;
       metadata.ready_event = Event::NO_EVENT;
       metadata.layout = 0;
+      metadata.file_compression = LEGION_FILE_COMPRESS_NONE;
+
+      pin_count = 0;
+      relocatable = false;
+      relocation_done = Event::NO_EVENT;
     }
 
     RegionInstanceImpl::~RegionInstanceImpl(void)
@@ -561,6 +607,8 @@ namespace Realm {
 
       // set the offset back to the "unallocated" value
       metadata.inst_offset = size_t(-1);
+      relocatable = false;
+      metadata.file_compression = LEGION_FILE_COMPRESS_NONE;
 
       measurements.clear();
 
@@ -568,6 +616,22 @@ namespace Realm {
       m_impl->release_instance(me);
     }
 
+    Event RegionInstanceImpl::try_pin(void)
+    {
+      AutoHSLLock al(mutex);
+      if(relocation_done.exists())
+	return relocation_done;
+      pin_count++;
+      return Event::NO_EVENT;
+    }
+
+    bool RegionInstanceImpl::unpin(void)
+    {
+      AutoHSLLock al(mutex);
+      assert(pin_count > 0);
+      return (--pin_count == 0);
+    }
+
     // helper function to figure out which field we're in
     void find_field_start(const std::vector<size_t>& field_sizes, off_t byte_offset,
 			  size_t size, off_t& field_start, int& field_size)
@@ -665,6 +729,7 @@ namespace Realm {
 		 (dbs << parent_inst) &&
 		 (dbs << inst_offset) &&
 		 (dbs << filename) &&
+		 (dbs << file_compression) &&
 		 (dbs << *layout));
       assert(ok);
 
@@ -686,7 +751,8 @@ namespace Realm {
 		 (fbd >> field_sizes) &&
 		 (fbd >> parent_inst) &&
 		 (fbd >> inst_offset) &&
-		 (fbd >> filename));
+		 (fbd >> filename) &&
+		 (fbd >> file_compression));
       if(ok)
 	layout = InstanceLayoutGeneric::deserialize_new(fbd);
       assert(ok && (layout != 0) && (fbd.bytes_left() == 0));
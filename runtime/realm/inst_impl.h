@@ -67,6 +67,14 @@ namespace Realm {
       // called once storage has been released and all remote metadata is invalidated
       void recycle_instance(void);
 
+      // an instance that is pinned (by an accessor or a DMA request that
+      //  uses it) will not be moved by the memory's defragmenter - try_pin
+      //  returns NO_EVENT on success, or an event to wait on before trying
+      //  again if the instance is being moved right now
+      Event try_pin(void);
+      // returns true if that was the last pin
+      bool unpin(void);
+
     public: //protected:
       friend class RegionInstance;
 
@@ -95,12 +103,20 @@ namespace Realm {
 	Event ready_event;
 	InstanceLayoutGeneric *layout;
 	std::string filename; // temp hack for attached files
+	int file_compression; // realm_file_compression_t
       };
 
       // used for atomic access to metadata
       GASNetHSL mutex;
       Metadata metadata;
 
+      // protected by 'mutex' - relocation_done exists while the instance's
+      //  storage is being moved, which is only ever done to instances that
+      //  the application has marked as relocatable
+      int pin_count;
+      bool relocatable;
+      Event relocation_done;
+
       // used for serialized application access to contents of instance
       ReservationImpl lock;
     };
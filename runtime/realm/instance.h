@@ -163,6 +163,20 @@ namespace Realm {
 				      const ProfilingRequestSet& prs,
 				      Event wait_on = Event::NO_EVENT);
 
+    // as above, but the file holds the instance's data in compressed
+    //  chunks - it must have been created with the same compression, and
+    //  can only be accessed through copies
+    template <int N, typename T>
+    static Event create_file_instance(RegionInstance& inst,
+				      const char *file_name,
+				      const IndexSpace<N,T>& space,
+				      const std::vector<FieldID> &field_ids,
+				      const std::vector<size_t> &field_sizes,
+				      realm_file_mode_t file_mode,
+				      realm_file_compression_t compression,
+				      const ProfilingRequestSet& prs,
+				      Event wait_on = Event::NO_EVENT);
+
 #ifdef USE_HDF
     template <int N, typename T>
     static Event create_hdf5_instance(RegionInstance& inst,
@@ -196,10 +210,20 @@ namespace Realm {
 
     LegionRuntime::Accessor::RegionAccessor<LegionRuntime::Accessor::AccessorType::Generic> get_accessor(void) const;
 
-    // used for accessor construction
+    // used for accessor construction - an instance with a nonzero accessor
+    //  count is never relocated by memory defragmentation (-ll:defrag), so
+    //  code that holds raw pointers into an instance across tasks or copies
+    //  should bracket their use with these
     bool increment_accessor_count(void);
     bool decrement_accessor_count(void);
 
+    // the defragmenter only ever moves instances that have been marked as
+    //  relocatable - nothing tracks the raw pointers that tasks get from
+    //  accessors, so an instance should only be marked if every such use is
+    //  bracketed by the accessor count calls above
+    // must be called on the node that created the instance
+    void set_relocatable(bool relocatable) const;
+
     struct DestroyedField {
     public:
       DestroyedField(void);
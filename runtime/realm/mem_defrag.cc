@@ -0,0 +1,370 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// defragmentation of instance memories
+
+#include "realm/mem_defrag.h"
+
+#include "realm/mem_impl.h"
+#include "realm/inst_impl.h"
+#include "realm/runtime_impl.h"
+#include "realm/threads.h"
+#include "realm/logging.h"
+
+namespace Realm {
+
+  Logger log_defrag("defrag");
+
+  namespace Config {
+    int mem_defrag_threshold = 0;
+  };
+
+  static MemoryDefragmenter *defragmenter = 0;
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class MemoryDefragmenter
+  //
+
+  MemoryDefragmenter::MemoryDefragmenter(CoreReservation *_rsrv)
+    : shutdown_flag(false), rsrv(_rsrv), worker(0), condvar(mutex)
+  {}
+
+  MemoryDefragmenter::~MemoryDefragmenter(void)
+  {
+    assert(shutdown_flag);
+    assert(requests.empty());
+    delete rsrv;
+  }
+
+  /*static*/ void MemoryDefragmenter::start_worker_thread(CoreReservationSet& crs)
+  {
+    assert(defragmenter == 0);
+    CoreReservation *rsrv = new CoreReservation("defragmenter", crs,
+						CoreReservationParameters());
+    defragmenter = new MemoryDefragmenter(rsrv);
+    ThreadLaunchParameters tlp;
+    defragmenter->worker = Thread::create_kernel_thread<MemoryDefragmenter,
+							&MemoryDefragmenter::worker_thread_loop>(defragmenter,
+												 tlp,
+												 *rsrv);
+  }
+
+  /*static*/ void MemoryDefragmenter::stop_worker_thread(void)
+  {
+    assert(defragmenter != 0);
+
+    // the worker finishes any queued requests before it exits
+    {
+      AutoHSLLock al(defragmenter->mutex);
+      defragmenter->shutdown_flag = true;
+      defragmenter->condvar.broadcast();
+    }
+    defragmenter->worker->join();
+    delete defragmenter->worker;
+
+    delete defragmenter;
+    defragmenter = 0;
+  }
+
+  /*static*/ bool MemoryDefragmenter::enabled_for(const MemoryImpl *mem)
+  {
+    if(!defragmenter)
+      return false;
+
+    // only memories that this node manages and that the dma system can
+    //  copy within
+    if(NodeID(ID(mem->me).memory.owner_node) != my_node_id)
+      return false;
+
+    switch(mem->kind) {
+    case MemoryImpl::MKIND_SYSMEM:
+    case MemoryImpl::MKIND_ZEROCOPY:
+    case MemoryImpl::MKIND_GPUFB:
+      return true;
+
+    default:
+      return false;
+    }
+  }
+
+  /*static*/ void MemoryDefragmenter::request_compaction(MemoryImpl *mem,
+							 RegionInstance inst /*= NO_INST*/,
+							 size_t bytes /*= 0*/,
+							 size_t alignment /*= 0*/)
+  {
+    assert(defragmenter != 0);
+
+    Request req;
+    req.mem = mem;
+    req.inst = inst;
+    req.bytes = bytes;
+    req.alignment = alignment;
+
+    AutoHSLLock al(defragmenter->mutex);
+    // a pass that's already queued for the memory covers a plain request
+    if(!inst.exists())
+      for(std::deque<Request>::const_iterator it = defragmenter->requests.begin();
+	  it != defragmenter->requests.end();
+	  ++it)
+	if(it->mem == mem)
+	  return;
+    defragmenter->requests.push_back(req);
+    defragmenter->condvar.broadcast();
+  }
+
+  void MemoryDefragmenter::worker_thread_loop(void)
+  {
+    log_defrag.info() << "defragmenter started";
+
+    while(true) {
+      Request req;
+      {
+	AutoHSLLock al(mutex);
+	while(requests.empty() && !shutdown_flag)
+	  condvar.wait();
+	if(requests.empty())
+	  break;
+	req = requests.front();
+	requests.pop_front();
+      }
+
+      size_t offset = 0;
+      bool ok = compact(req, offset);
+
+      // report the retried allocation (whichever way it went)
+      if(req.inst.exists())
+	req.mem->notify_allocation_result(req.inst, ok, offset);
+    }
+
+    log_defrag.info() << "defragmenter stopped";
+  }
+
+  bool MemoryDefragmenter::compact(const Request& req, size_t& offset)
+  {
+    MemoryImpl *mem = req.mem;
+
+    // everything currently allocated, in address order
+    std::vector<std::pair<size_t, RegionInstance> > allocs;
+    {
+      AutoHSLLock al(mem->allocator_mutex);
+      // first see if anything has been freed since the request was made
+      if(req.inst.exists() &&
+	 mem->allocator.allocate(req.inst, req.bytes, req.alignment, offset)) {
+	mem->update_allocator_gauges();
+	return true;
+      }
+      mem->allocator.get_allocated(allocs);
+    }
+
+    mem->defrag_passes += 1;
+    size_t moves = 0, moved_bytes = 0;
+    bool ok = false;
+
+    // move instances toward the start of the memory, lowest first, so each
+    //  one that moves opens up space for the ones above it
+    for(std::vector<std::pair<size_t, RegionInstance> >::const_iterator it = allocs.begin();
+	it != allocs.end();
+	++it) {
+      size_t inst_bytes = 0;
+      {
+	AutoHSLLock al(mem->allocator_mutex);
+	std::map<RegionInstance, BasicRangeAllocator<size_t, RegionInstance>::Range *>::const_iterator it2 = mem->allocator.allocated.find(it->second);
+	// skip instances that have been freed (or moved) since we looked
+	if((it2 == mem->allocator.allocated.end()) || !it2->second ||
+	   (it2->second->first != it->first))
+	  continue;
+	inst_bytes = it2->second->last - it2->second->first;
+      }
+
+      if(!relocate(mem, it->second, it->first))
+	continue;
+
+      moves++;
+      moved_bytes += inst_bytes;
+
+      if(req.inst.exists()) {
+	AutoHSLLock al(mem->allocator_mutex);
+	if(mem->allocator.allocate(req.inst, req.bytes, req.alignment, offset)) {
+	  mem->update_allocator_gauges();
+	  ok = true;
+	  break;
+	}
+      }
+    }
+
+    {
+      AutoHSLLock al(mem->allocator_mutex);
+      // the next pass is triggered by fragmentation rising above the
+      //  threshold again, not by it still being above
+      mem->check_fragmentation();
+    }
+
+    mem->defrag_moves += moves;
+    mem->defrag_bytes += moved_bytes;
+    log_defrag.info() << "compaction: mem=" << mem->me << " moves=" << moves
+		      << " bytes=" << moved_bytes
+		      << (req.inst.exists() ? (ok ? " alloc=ok" : " alloc=failed") : "");
+    return ok;
+  }
+
+  // creates a stand-in instance that treats 'bytes' bytes of the memory
+  //  (starting wherever the caller points it) as a 1-D array of bytes, so
+  //  the dma system can copy between two locations in the memory
+  static RegionInstanceImpl *create_byte_view(MemoryImpl *mem, size_t bytes)
+  {
+    RegionInstanceImpl *impl = mem->new_instance();
+    if(!impl)
+      return 0;
+
+    IndexSpace<1,long long> is(Rect<1,long long>(0, bytes - 1));
+    std::vector<size_t> field_sizes(1, 1);
+    InstanceLayoutConstraints ilc(field_sizes, 0);
+    int dim_order[1] = { 0 };
+    impl->metadata.layout = InstanceLayoutGeneric::choose_instance_layout<1,long long>(is, ilc, dim_order);
+    // nobody else should touch these, including the defragmenter
+    impl->pin_count = 1;
+    return impl;
+  }
+
+  static void destroy_byte_view(RegionInstanceImpl *impl)
+  {
+    impl->pin_count = 0;
+    if(impl->metadata.is_valid()) {
+      bool recycle_now = impl->metadata.initiate_cleanup(impl->me.id);
+      assert(recycle_now);
+    }
+    impl->recycle_instance();
+  }
+
+  bool MemoryDefragmenter::relocate(MemoryImpl *mem, RegionInstance inst,
+				    size_t old_offset)
+  {
+    // the metadata for an instance lives with its creator, so that's the
+    //  only place it can be changed
+    if(NodeID(ID(inst).instance.creator_node) != my_node_id)
+      return false;
+
+    RegionInstanceImpl *impl = mem->get_instance(inst);
+    size_t bytes, alignment;
+    {
+      AutoHSLLock al(impl->mutex);
+      if(!impl->relocatable || (impl->pin_count > 0) ||
+	 impl->relocation_done.exists() ||
+	 (impl->metadata.inst_offset != old_offset) || !impl->metadata.layout)
+	return false;
+      bytes = impl->metadata.layout->bytes_used;
+      alignment = impl->metadata.layout->alignment_reqd;
+    }
+    if(bytes == 0)
+      return false;
+
+    RegionInstanceImpl *dst_impl = create_byte_view(mem, bytes);
+    if(!dst_impl)
+      return false;
+
+    // reserve the new location and mark the instance as moving - lock
+    //  order is allocator then instance, same as release_instance_storage
+    size_t new_offset = 0;
+    Event done = Event::NO_EVENT;
+    {
+      AutoHSLLock al(mem->allocator_mutex);
+      if(mem->allocator.allocate_below(dst_impl->me, bytes, alignment,
+				       old_offset, new_offset)) {
+	AutoHSLLock al2(impl->mutex);
+	if(impl->relocatable && (impl->pin_count == 0) &&
+	   !impl->relocation_done.exists() &&
+	   (impl->metadata.inst_offset == old_offset) &&
+	   mem->allocator.allocated.count(inst) &&
+	   impl->metadata.begin_local_update()) {
+	  done = GenEventImpl::create_genevent()->current_event();
+	  impl->relocation_done = done;
+	} else
+	  mem->allocator.deallocate(dst_impl->me);
+      }
+    }
+    if(!done.exists()) {
+      destroy_byte_view(dst_impl);
+      return false;
+    }
+
+    RegionInstanceImpl *src_impl = create_byte_view(mem, bytes);
+    bool poisoned = false;
+    if(src_impl) {
+      src_impl->metadata.inst_offset = old_offset;
+      dst_impl->metadata.inst_offset = new_offset;
+      NodeSet early_reqs;
+      src_impl->metadata.mark_valid(early_reqs);
+      dst_impl->metadata.mark_valid(early_reqs);
+
+      std::vector<CopySrcDstField> srcs(1), dsts(1);
+      srcs[0].inst = src_impl->me;
+      srcs[0].field_id = 0;
+      srcs[0].size = 1;
+      dsts[0].inst = dst_impl->me;
+      dsts[0].field_id = 0;
+      dsts[0].size = 1;
+      IndexSpace<1,long long> is(Rect<1,long long>(0, bytes - 1));
+      Event e = is.copy(srcs, dsts, ProfilingRequestSet());
+      e.external_wait_faultaware(poisoned);
+    } else
+      poisoned = true;  // out of instance slots - give up on this one
+
+    // switch the instance over to its new storage and release the old
+    {
+      AutoHSLLock al(mem->allocator_mutex);
+      {
+	AutoHSLLock al2(impl->mutex);
+	if(!poisoned)
+	  impl->metadata.inst_offset = new_offset;
+	impl->relocation_done = Event::NO_EVENT;
+      }
+      if(!poisoned) {
+	mem->allocator.deallocate(inst);
+	mem->allocator.rename(dst_impl->me, inst);
+      } else
+	mem->allocator.deallocate(dst_impl->me);
+      mem->update_allocator_gauges();
+    }
+
+    // requests for the metadata that arrived during the move get the new
+    //  version
+    NodeSet early_reqs;
+    impl->metadata.end_local_update(early_reqs);
+    if(!early_reqs.empty()) {
+      size_t datalen = 0;
+      void *data = impl->metadata.serialize(datalen);
+      MetadataResponseMessage::broadcast_request(early_reqs, ID(inst).id, data, datalen);
+      free(data);
+    }
+
+    GenEventImpl::trigger(done, false /*!poisoned*/);
+
+    if(src_impl)
+      destroy_byte_view(src_impl);
+    destroy_byte_view(dst_impl);
+
+    if(poisoned) {
+      log_defrag.warning() << "relocation copy failed: inst=" << inst;
+      return false;
+    }
+
+    log_defrag.debug() << "relocated: inst=" << inst << " bytes=" << bytes
+		       << " offset=" << old_offset << " -> " << new_offset;
+    return true;
+  }
+
+}; // namespace Realm
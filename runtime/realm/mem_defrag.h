@@ -0,0 +1,93 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// defragmentation of instance memories
+
+#ifndef REALM_MEM_DEFRAG_H
+#define REALM_MEM_DEFRAG_H
+
+#include "realm/instance.h"
+#include "realm/activemsg.h"
+
+#include <deque>
+
+namespace Realm {
+
+  class MemoryImpl;
+  class Thread;
+  class CoreReservation;
+  class CoreReservationSet;
+
+  // the defragmenter compacts a memory by moving instances that the
+  //  application has marked as relocatable (see
+  //  RegionInstance::set_relocatable) and that nobody is using (i.e. that
+  //  aren't pinned - see RegionInstanceImpl::try_pin)
+  //  into the lowest free range below them that will hold them, copying
+  //  the contents with the dma system and then switching the instance's
+  //  metadata over to the new location
+  // only instances created on the memory's owner node whose metadata has
+  //  not been sent anywhere else are candidates, so the switch is purely
+  //  local - remote requests for the metadata that arrive during a move
+  //  are held until it's done
+  // a memory asks for a pass when an allocation fails (the allocation is
+  //  retried by the defragmenter afterward, so the instance's creator
+  //  just sees a late response) or when its fragmentation rises above
+  //  -ll:defrag percent
+  class MemoryDefragmenter {
+  public:
+    static void start_worker_thread(CoreReservationSet& crs);
+    static void stop_worker_thread(void);
+
+    // true if the defragmenter may move instances in this memory
+    static bool enabled_for(const MemoryImpl *mem);
+
+    // queues a compaction pass for 'mem' - if 'inst' is given, it's an
+    //  instance whose allocation failed, and the pass stops as soon as the
+    //  allocation succeeds (or can't be helped)
+    static void request_compaction(MemoryImpl *mem,
+				   RegionInstance inst = RegionInstance::NO_INST,
+				   size_t bytes = 0, size_t alignment = 0);
+
+  protected:
+    MemoryDefragmenter(CoreReservation *_rsrv);
+    ~MemoryDefragmenter(void);
+
+    struct Request {
+      MemoryImpl *mem;
+      RegionInstance inst;
+      size_t bytes, alignment;
+    };
+
+    void worker_thread_loop(void);
+
+    // returns true if the request's allocation (if any) succeeded, along
+    //  with the offset it was given
+    bool compact(const Request& req, size_t& offset);
+
+    // moves one instance lower in the memory - returns false if it can't
+    //  be moved right now
+    bool relocate(MemoryImpl *mem, RegionInstance inst, size_t old_offset);
+
+    bool shutdown_flag;
+    CoreReservation *rsrv;
+    Thread *worker;
+    GASNetHSL mutex;
+    GASNetCondVar condvar;
+    std::deque<Request> requests;
+  };
+
+}; // namespace Realm
+
+#endif // ifndef REALM_MEM_DEFRAG_H
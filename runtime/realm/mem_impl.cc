@@ -14,6 +14,7 @@
  */
 
 #include "realm/mem_impl.h"
+#include "realm/mem_defrag.h"
 
 #include "realm/proc_impl.h"
 #include "realm/logging.h"
@@ -22,6 +23,7 @@
 #include "realm/runtime_impl.h"
 #include "realm/profiling.h"
 #include "realm/utils.h"
+#include "realm/transfer/lowlevel_dma.h"
 
 #ifdef USE_GASNET
 #ifndef GASNET_PAR
@@ -49,6 +51,11 @@ namespace Realm {
   Logger log_copy("copy");
   extern Logger log_inst; // in inst_impl.cc
 
+  namespace Config {
+    int mem_alloc_policy = BasicRangeAllocator<size_t, RegionInstance>::FIRST_FIT;
+    unsigned mem_first_fit_kinds = 0;
+    unsigned mem_best_fit_kinds = 0;
+  };
 
 
   ////////////////////////////////////////////////////////////////////////
@@ -98,8 +105,40 @@ namespace Realm {
       , usage(stringbuilder() << "realm/mem " << _me << "/usage")
       , peak_usage(stringbuilder() << "realm/mem " << _me << "/peak_usage")
       , peak_footprint(stringbuilder() << "realm/mem " << _me << "/peak_footprint")
+      , free_ranges(stringbuilder() << "realm/mem " << _me << "/free_ranges")
+      , largest_free(stringbuilder() << "realm/mem " << _me << "/largest_free")
+      , frag_over_threshold(false)
+      , defrag_passes(stringbuilder() << "realm/mem " << _me << "/defrag_passes")
+      , defrag_moves(stringbuilder() << "realm/mem " << _me << "/defrag_moves")
+      , defrag_bytes(stringbuilder() << "realm/mem " << _me << "/defrag_bytes")
     {
+      typedef BasicRangeAllocator<size_t, RegionInstance> Allocator;
+      Allocator::Policy policy = (Allocator::Policy)Config::mem_alloc_policy;
+      if(Config::mem_first_fit_kinds & (1U << _lowlevel_kind))
+	policy = Allocator::FIRST_FIT;
+      if(Config::mem_best_fit_kinds & (1U << _lowlevel_kind))
+	policy = Allocator::BEST_FIT;
+      allocator.set_policy(policy);
       allocator.add_range(0, _size);
+      update_allocator_gauges();
+    }
+
+    void MemoryImpl::update_allocator_gauges(void)
+    {
+      BasicRangeAllocator<size_t, RegionInstance>::Stats stats;
+      allocator.get_stats(stats);
+      free_ranges = stats.free_ranges;
+      largest_free = stats.largest_free;
+    }
+
+    bool MemoryImpl::check_fragmentation(void)
+    {
+      BasicRangeAllocator<size_t, RegionInstance>::Stats stats;
+      allocator.get_stats(stats);
+      bool over = (stats.fragmentation() * 100) > Config::mem_defrag_threshold;
+      bool crossed = over && !frag_over_threshold;
+      frag_over_threshold = over;
+      return crossed;
     }
 
     MemoryImpl::~MemoryImpl(void)
@@ -421,8 +460,32 @@ namespace Realm {
       {
 	AutoHSLLock al(allocator_mutex);
 	ok = allocator.allocate(i, bytes, alignment, offset);
+	update_allocator_gauges();
       }
 
+      // intermediate buffers the dma system is holding on to for reuse
+      //  mustn't keep an instance from being created
+      if(!ok && trim_ib_buffer_pool(me)) {
+	AutoHSLLock al(allocator_mutex);
+	ok = allocator.allocate(i, bytes, alignment, offset);
+	update_allocator_gauges();
+      }
+
+      if(!ok && MemoryDefragmenter::enabled_for(this)) {
+	// moving other instances may make room - the defragmenter retries
+	//  the allocation and reports the result
+	MemoryDefragmenter::request_compaction(this, i, bytes, alignment);
+	return false /*asynchronous notification*/;
+      }
+
+      notify_allocation_result(i, ok, offset);
+
+      return true /*immediate notification*/;
+    }
+
+    void MemoryImpl::notify_allocation_result(RegionInstance i, bool ok,
+					      size_t offset)
+    {
       if(ID(i).instance.creator_node == my_node_id) {
 	// local notification of result
 	get_instance(i)->notify_allocation(ok, offset);
@@ -433,10 +496,37 @@ namespace Realm {
 					      offset,
 					      ok);
       }
-
-      return true /*immediate notification*/;
     }
 
+    // storage release that has to wait for the defragmenter to finish
+    //  moving the instance
+    class DeferredStorageRelease : public EventWaiter {
+    public:
+      DeferredStorageRelease(MemoryImpl *_mem, RegionInstance _inst)
+	: mem(_mem), inst(_inst) { }
+      virtual ~DeferredStorageRelease(void) { }
+    public:
+      virtual bool event_triggered(Event e, bool poisoned)
+      {
+	mem->release_instance_storage(inst, Event::NO_EVENT);
+	return true;
+      }
+
+      virtual void print(std::ostream& os) const
+      {
+	os << "deferred storage release: inst=" << inst;
+      }
+
+      virtual Event get_finish_event(void) const
+      {
+	return Event::NO_EVENT;
+      }
+
+    protected:
+      MemoryImpl *mem;
+      RegionInstance inst;
+    };
+
     // release storage associated with an instance
     void MemoryImpl::release_instance_storage(RegionInstance i,
 					      Event precondition)
@@ -454,11 +544,35 @@ namespace Realm {
       // TODO: memory needs to handle non-ready releases
       assert(precondition.has_triggered());
 
+      bool defrag = MemoryDefragmenter::enabled_for(this);
+      bool compact = false;
+      Event relocation_done = Event::NO_EVENT;
       {
 	AutoHSLLock al(allocator_mutex);
-	allocator.deallocate(i);
+	if(defrag && (ID(i).instance.creator_node == my_node_id)) {
+	  // an instance that's being moved can't be released until the move
+	  //  is done
+	  RegionInstanceImpl *impl = get_instance(i);
+	  AutoHSLLock al2(impl->mutex);
+	  relocation_done = impl->relocation_done;
+	}
+	if(!relocation_done.exists()) {
+	  allocator.deallocate(i);
+	  update_allocator_gauges();
+	  if(defrag)
+	    compact = check_fragmentation();
+	}
       }
 
+      if(relocation_done.exists()) {
+	EventImpl::add_waiter(relocation_done,
+			      new DeferredStorageRelease(this, i));
+	return;
+      }
+
+      if(compact)
+	MemoryDefragmenter::request_compaction(this);
+
       if(ID(i).instance.creator_node == my_node_id) {
 	// local notification of result
 	get_instance(i)->notify_deallocation();
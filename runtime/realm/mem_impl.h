@@ -39,10 +39,19 @@ namespace Realm {
 
   // manages a basic free list of ranges (using range type RT) and allocated
   //  ranges, which are tagged (tag type TT)
+  // free ranges are also indexed by size - each power-of-two size class
+  //  holds a tree ordered by (size, first), so a best-fit search only has
+  //  to look at the first few entries of the first non-empty class(es)
+  //  instead of walking every free range
   // NOT thread-safe - must be protected from outside
   template <typename RT, typename TT>
   class BasicRangeAllocator {
   public:
+    enum Policy {
+      FIRST_FIT,  // lowest-addressed free range that fits
+      BEST_FIT,   // smallest free range that fits (lowest address on ties)
+    };
+
     struct Range {
       Range(RT _first, RT _last);
 
@@ -51,17 +60,64 @@ namespace Realm {
       Range *prev_free, *next_free;  // double-linked list of just free ranges
     };
 
+    struct Stats {
+      size_t free_ranges, allocated_ranges;
+      RT free_bytes, largest_free;
+
+      // 0 when all the free space is in one range, approaching 1 as it's
+      //  split into smaller and smaller pieces
+      double fragmentation(void) const;
+    };
+
+    static const int NUM_SIZE_CLASSES = sizeof(RT) * 8;
+    // key is (size, first)
+    typedef std::map<std::pair<RT, RT>, Range *> SizeClass;
+
     std::map<TT, Range *> allocated;  // direct lookup of allocated ranges by tag
     std::map<RT, Range *> by_first;   // direct lookup of all ranges by first
     Range sentinel;
-    // TODO: sized-based lookup of free ranges
+    SizeClass free_by_size[NUM_SIZE_CLASSES];
+    Policy policy;
+    // the free list is kept in address order only for FIRST_FIT
+    size_t free_count;
+    RT free_bytes;
 
-    BasicRangeAllocator(void);
+    BasicRangeAllocator(Policy _policy = FIRST_FIT);
     ~BasicRangeAllocator(void);
 
+    void set_policy(Policy _policy);
+
     void add_range(RT first, RT last);
     bool allocate(TT tag, RT size, RT alignment, RT& first);
     void deallocate(TT tag);
+
+    // allocates from the lowest-addressed free range in which the whole
+    //  allocation fits below 'limit' (used to compact allocations toward
+    //  the start of the memory)
+    bool allocate_below(TT tag, RT size, RT alignment, RT limit, RT& first);
+
+    // transfers an allocated range to a different tag
+    void rename(TT old_tag, TT new_tag);
+
+    // lists the (first, tag) of each non-empty allocation in address order
+    void get_allocated(std::vector<std::pair<RT, TT> >& ranges) const;
+
+    void get_stats(Stats& stats) const;
+
+  protected:
+    static int size_class(RT size);
+
+    // add/remove a free range to/from the size index
+    void index_free(Range *r);
+    void unindex_free(Range *r);
+
+    // return the chosen free range (or null) and the padding needed at
+    //  its start to satisfy the alignment
+    Range *find_first_fit(RT size, RT alignment, RT& ofs);
+    Range *find_best_fit(RT size, RT alignment, RT& ofs);
+
+    // takes [r->first + ofs, r->first + ofs + size) out of free range 'r'
+    void carve(TT tag, Range *r, RT ofs, RT size, RT& alloc_first);
   };
   
     class MemoryImpl {
@@ -160,6 +216,20 @@ namespace Realm {
       GASNetHSL allocator_mutex;
       BasicRangeAllocator<size_t, RegionInstance> allocator;
       ProfilingGauges::AbsoluteGauge<size_t> usage, peak_usage, peak_footprint;
+      // allocator fragmentation - must hold allocator_mutex to update
+      ProfilingGauges::AbsoluteGauge<size_t> free_ranges, largest_free;
+      void update_allocator_gauges(void);
+
+      // reports the outcome of allocate_instance_storage to the instance's
+      //  creator (used directly when the outcome isn't known right away)
+      void notify_allocation_result(RegionInstance i, bool ok, size_t offset);
+
+      // memory defragmentation (see mem_defrag.h) - check_fragmentation
+      //  must be called with allocator_mutex held, and returns true when
+      //  fragmentation has just risen above the threshold
+      bool check_fragmentation(void);
+      bool frag_over_threshold;
+      ProfilingGauges::AbsoluteGauge<size_t> defrag_passes, defrag_moves, defrag_bytes;
     };
 
     class LocalCPUMemory : public MemoryImpl {
@@ -21,6 +21,8 @@
 // nop, but helpful for IDEs
 #include "realm/mem_impl.h"
 
+#include <algorithm>
+
 namespace Realm {
 
   ////////////////////////////////////////////////////////////////////////
@@ -36,8 +38,19 @@ namespace Realm {
   {}
 
   template <typename RT, typename TT>
-  inline BasicRangeAllocator<RT,TT>::BasicRangeAllocator(void)
+  inline double BasicRangeAllocator<RT,TT>::Stats::fragmentation(void) const
+  {
+    if(free_bytes == 0)
+      return 0;
+    return 1.0 - ((double)largest_free / (double)free_bytes);
+  }
+
+  template <typename RT, typename TT>
+  inline BasicRangeAllocator<RT,TT>::BasicRangeAllocator(Policy _policy /*= FIRST_FIT*/)
     : sentinel((RT)-1,0)
+    , policy(_policy)
+    , free_count(0)
+    , free_bytes(0)
   {
     // sentinel is the start and end of both dllists
     sentinel.prev = sentinel.next = &sentinel;
@@ -56,6 +69,106 @@ namespace Realm {
     }
   }
 
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::set_policy(Policy _policy)
+  {
+    if(_policy == policy)
+      return;
+    policy = _policy;
+    if(policy == FIRST_FIT) {
+      // best fit doesn't care about the order of the free list, but first
+      //  fit does - relink the free ranges in address order
+      Range *prev_free = &sentinel;
+      for(Range *r = sentinel.next; r != &sentinel; r = r->next) {
+	if(!r->next_free) continue;  // allocated
+	prev_free->next_free = r;
+	r->prev_free = prev_free;
+	prev_free = r;
+      }
+      prev_free->next_free = &sentinel;
+      sentinel.prev_free = prev_free;
+    }
+  }
+
+  template <typename RT, typename TT>
+  inline /*static*/ int BasicRangeAllocator<RT,TT>::size_class(RT size)
+  {
+    // floor(log2(size))
+    assert(size > 0);
+    return (63 - __builtin_clzll((unsigned long long)size));
+  }
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::index_free(Range *r)
+  {
+    RT size = r->last - r->first;
+    free_by_size[size_class(size)].insert(std::make_pair(std::make_pair(size, r->first), r));
+    free_count++;
+    free_bytes += size;
+  }
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::unindex_free(Range *r)
+  {
+    RT size = r->last - r->first;
+#ifndef NDEBUG
+    size_t count =
+#endif
+      free_by_size[size_class(size)].erase(std::make_pair(size, r->first));
+    assert(count == 1);
+    free_count--;
+    free_bytes -= size;
+  }
+
+  template <typename RT, typename TT>
+  inline typename BasicRangeAllocator<RT,TT>::Range *BasicRangeAllocator<RT,TT>::find_first_fit(RT size, RT alignment, RT& ofs)
+  {
+    // walk free ranges and just take the first that fits
+    Range *r = sentinel.next_free;
+    while(r != &sentinel) {
+      ofs = 0;
+      if(alignment) {
+	RT rem = r->first % alignment;
+	if(rem > 0)
+	  ofs = alignment - rem;
+      }
+      // do we have enough space?
+      if((r->last - r->first) >= (size + ofs))
+	return r;
+
+      // no, go to next one
+      r = r->next_free;
+    }
+    return 0;
+  }
+
+  template <typename RT, typename TT>
+  inline typename BasicRangeAllocator<RT,TT>::Range *BasicRangeAllocator<RT,TT>::find_best_fit(RT size, RT alignment, RT& ofs)
+  {
+    // the first class that can hold 'size' is the only one where we have to
+    //  skip ranges that are too small - after that, the first range in the
+    //  class is the best fit unless alignment padding pushes it over
+    for(int c = size_class(size); c < NUM_SIZE_CLASSES; c++) {
+      SizeClass& sc = free_by_size[c];
+      if(sc.empty())
+	continue;
+      for(typename SizeClass::const_iterator it = sc.lower_bound(std::make_pair(size, (RT)0));
+	  it != sc.end();
+	  ++it) {
+	Range *r = it->second;
+	ofs = 0;
+	if(alignment) {
+	  RT rem = r->first % alignment;
+	  if(rem > 0)
+	    ofs = alignment - rem;
+	}
+	if(it->first.first >= (size + ofs))
+	  return r;
+      }
+    }
+    return 0;
+  }
+
   template <typename RT, typename TT>
   inline void BasicRangeAllocator<RT,TT>::add_range(RT first, RT last)
   {
@@ -76,6 +189,7 @@ namespace Realm {
       // free block list
       newr->prev_free = prev_free; newr->next_free = prev_free->next_free;
       prev_free->next_free = newr->next_free->prev_free = newr;
+      index_free(newr);
       return;
     }
 
@@ -91,85 +205,112 @@ namespace Realm {
       return true;
     }
 
-    // walk free ranges and just take the first that fits
-    Range *r = sentinel.next_free;
-    while(r != &sentinel) {
+    RT ofs = 0;
+    Range *r = ((policy == BEST_FIT) ?
+		  find_best_fit(size, alignment, ofs) :
+		  find_first_fit(size, alignment, ofs));
+    if(!r) {
+      // allocation failed
+      return false;
+    }
+
+    carve(tag, r, ofs, size, alloc_first);
+    return true;
+  }
+
+  template <typename RT, typename TT>
+  inline bool BasicRangeAllocator<RT,TT>::allocate_below(TT tag, RT size, RT alignment,
+							 RT limit, RT& alloc_first)
+  {
+    assert(size > 0);
+
+    // walk all ranges in address order, stopping at the limit
+    for(Range *r = sentinel.next;
+	(r != &sentinel) && (r->first < limit);
+	r = r->next) {
+      if(!r->next_free) continue;  // allocated
+
       RT ofs = 0;
       if(alignment) {
 	RT rem = r->first % alignment;
 	if(rem > 0)
 	  ofs = alignment - rem;
       }
-      // do we have enough space?
-      if((r->last - r->first) >= (size + ofs)) {
-	// yes, but we may need chop things up to make the exact range we want
-	alloc_first = r->first + ofs;
-	RT alloc_last = alloc_first + size;
-
-        // do we need to carve off a new (free) block before us?
-        if(alloc_first != r->first) {
-          Range *new_prev = new Range(r->first, alloc_first);
-          r->first = alloc_first;
-          new_prev->prev = r->prev; new_prev->prev->next = new_prev;
-          new_prev->next = r;
-          r->prev = new_prev;
-          new_prev->prev_free = r->prev_free;
-          new_prev->prev_free->next_free = new_prev;
-          new_prev->next_free = r;
-          r->prev_free = new_prev;
-        }
-
-	// four cases to deal with
-	if(alloc_last == r->last) {
-	  if(alloc_first == r->first) {
-	    // case 1 - exact fit
-	    //
-	    // all we have to do here is remove this range from the free range dlist
-	    //  and add to the allocated lookup map
-	    r->prev_free->next_free = r->next_free;
-	    r->next_free->prev_free = r->prev_free;
-	    r->prev_free = r->next_free = 0;
-
-	    allocated[tag] = r;
-	    return true;
-	  } else {
-	    // case 2 - leftover at beginning
-	    assert(0);
-	  }
-	} else {
-	  if(alloc_first == r->first) {
-	    // case 3 - leftover at end
-	    Range *r_after = new Range(alloc_last, r->last);
-	    by_first[alloc_last] = r_after;
-	    r->last = alloc_last;
-
-	    // r_after goes after r in all block list
-	    r_after->prev = r; r_after->next = r->next;
-	    r->next->prev = r_after; r->next = r_after;
-
-	    // r_after replaces r in the free block list
-	    r_after->prev_free = r->prev_free;
-	    r_after->next_free = r->next_free;
-	    r->prev_free->next_free = r_after;
-	    r->next_free->prev_free = r_after;
-	    r->prev_free = r->next_free = 0;
-
-	    allocated[tag] = r;
-	    return true;
-	  } else {
-	    // case 4 - leftover on both sides
-	    assert(0);
-	  }
-	}
+      if(((r->first + ofs + size) <= r->last) &&
+	 ((r->first + ofs + size) <= limit)) {
+	carve(tag, r, ofs, size, alloc_first);
+	return true;
       }
-
-      // no, go to next one
-      r = r->next_free;
     }
-    // allocation failed
     return false;
   }
 
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::carve(TT tag, Range *r, RT ofs, RT size,
+						RT& alloc_first)
+  {
+    // we may need chop things up to make the exact range we want
+    unindex_free(r);
+    alloc_first = r->first + ofs;
+    RT alloc_last = alloc_first + size;
+
+    // do we need to carve off a new (free) block before us?
+    if(alloc_first != r->first) {
+      Range *new_prev = new Range(r->first, alloc_first);
+      r->first = alloc_first;
+      new_prev->prev = r->prev; new_prev->prev->next = new_prev;
+      new_prev->next = r;
+      r->prev = new_prev;
+      new_prev->prev_free = r->prev_free;
+      new_prev->prev_free->next_free = new_prev;
+      new_prev->next_free = r;
+      r->prev_free = new_prev;
+      index_free(new_prev);
+    }
+
+    // four cases to deal with
+    if(alloc_last == r->last) {
+      if(alloc_first == r->first) {
+	// case 1 - exact fit
+	//
+	// all we have to do here is remove this range from the free range dlist
+	//  and add to the allocated lookup map
+	r->prev_free->next_free = r->next_free;
+	r->next_free->prev_free = r->prev_free;
+	r->prev_free = r->next_free = 0;
+
+	allocated[tag] = r;
+      } else {
+	// case 2 - leftover at beginning
+	assert(0);
+      }
+    } else {
+      if(alloc_first == r->first) {
+	// case 3 - leftover at end
+	Range *r_after = new Range(alloc_last, r->last);
+	by_first[alloc_last] = r_after;
+	r->last = alloc_last;
+
+	// r_after goes after r in all block list
+	r_after->prev = r; r_after->next = r->next;
+	r->next->prev = r_after; r->next = r_after;
+
+	// r_after replaces r in the free block list
+	r_after->prev_free = r->prev_free;
+	r_after->next_free = r->next_free;
+	r->prev_free->next_free = r_after;
+	r->next_free->prev_free = r_after;
+	r->prev_free = r->next_free = 0;
+	index_free(r_after);
+
+	allocated[tag] = r;
+      } else {
+	// case 4 - leftover on both sides
+	assert(0);
+      }
+    }
+  }
+
   template <typename RT, typename TT>
   inline void BasicRangeAllocator<RT,TT>::deallocate(TT tag)
   {
@@ -183,33 +324,37 @@ namespace Realm {
     if(!r)
       return;
 
-    // need to add ourselves back to the free list - find previous and next
-    //  free entries (which have non-null prev_free/next_free pointers)
-    Range *prev_free = r->prev;
-    while(!prev_free->next_free) {
-      prev_free = prev_free->prev;
-      assert(prev_free != r);  // wrapping around would be bad
-    }
-    Range *next_free = r->next;
-    while(!next_free->prev_free) {
-      next_free = next_free->next;
-      assert(next_free != r);
-    }
-
-    // do we need to merge?
-    bool merge_prev = (prev_free == r->prev) && (prev_free != &sentinel);
-    bool merge_next = (next_free == r->next) && (next_free != &sentinel);
+    // do we need to merge?  (free ranges are the ones with non-null
+    //  prev_free/next_free pointers)
+    bool merge_prev = (r->prev != &sentinel) && (r->prev->next_free != 0);
+    bool merge_next = (r->next != &sentinel) && (r->next->next_free != 0);
 
     // four cases - ordered to match the allocation cases
     if(!merge_next) {
       if(!merge_prev) {
 	// case 1 - no merging (exact match)
+	Range *prev_free, *next_free;
+	if(policy == FIRST_FIT) {
+	  // keep the free list in address order - find previous and next
+	  //  free entries
+	  prev_free = r->prev;
+	  while(!prev_free->next_free) {
+	    prev_free = prev_free->prev;
+	    assert(prev_free != r);  // wrapping around would be bad
+	  }
+	  next_free = prev_free->next_free;
+	} else {
+	  // order doesn't matter - put it at the front
+	  prev_free = &sentinel;
+	  next_free = sentinel.next_free;
+	}
 	r->prev_free = prev_free; r->next_free = next_free;
 	prev_free->next_free = next_free->prev_free = r;
       } else {
 	// case 2 - merge before
 	Range *old_prev = r->prev;
 	assert(r->first == old_prev->last);
+	unindex_free(old_prev);
 	by_first.erase(r->first);
 	r->first = old_prev->first;
 	by_first[r->first] = r;
@@ -232,6 +377,7 @@ namespace Realm {
 	// case 3 - merge after
 	Range *old_next = r->next;
 	assert(r->last == old_next->first);
+	unindex_free(old_next);
 	r->last = old_next->last;
 	by_first.erase(old_next->first);
 
@@ -251,12 +397,14 @@ namespace Realm {
 	
 	Range *old_prev = r->prev;
 	assert(r->first == old_prev->last);
+	unindex_free(old_prev);
 	by_first.erase(r->first);
 	r->first = old_prev->first;
 	by_first[r->first] = r;
 
 	Range *old_next = r->next;
 	assert(r->last == old_next->first);
+	unindex_free(old_next);
 	r->last = old_next->last;
 	by_first.erase(old_next->first);
 
@@ -264,14 +412,57 @@ namespace Realm {
 	r->prev = old_prev->prev;  r->prev->next = r;
 	r->next = old_next->next;  r->next->prev = r;
 
+	// old_next drops out of the free list and we take old_prev's place
+	//  (in an address-ordered list they were adjacent anyway)
+	old_next->prev_free->next_free = old_next->next_free;
+	old_next->next_free->prev_free = old_next->prev_free;
 	r->prev_free = old_prev->prev_free; r->prev_free->next_free = r;
-	r->next_free = old_next->next_free; r->next_free->prev_free = r;
+	r->next_free = old_prev->next_free; r->next_free->prev_free = r;
 
 	delete old_prev;
 	delete old_next;
       }
     }
+
+    index_free(r);
   };
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::rename(TT old_tag, TT new_tag)
+  {
+    typename std::map<TT, Range *>::iterator it = allocated.find(old_tag);
+    assert(it != allocated.end());
+    assert(allocated.count(new_tag) == 0);
+    Range *r = it->second;
+    allocated.erase(it);
+    allocated[new_tag] = r;
+  }
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::get_allocated(std::vector<std::pair<RT, TT> >& ranges) const
+  {
+    ranges.clear();
+    for(typename std::map<TT, Range *>::const_iterator it = allocated.begin();
+	it != allocated.end();
+	++it)
+      if(it->second)
+	ranges.push_back(std::make_pair(it->second->first, it->first));
+    std::sort(ranges.begin(), ranges.end());
+  }
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::get_stats(Stats& stats) const
+  {
+    stats.free_ranges = free_count;
+    stats.allocated_ranges = allocated.size();
+    stats.free_bytes = free_bytes;
+    stats.largest_free = 0;
+    for(int c = NUM_SIZE_CLASSES - 1; c >= 0; c--)
+      if(!free_by_size[c].empty()) {
+	stats.largest_free = free_by_size[c].rbegin()->first.first;
+	break;
+      }
+  }
   
     
 }; // namespace Realm
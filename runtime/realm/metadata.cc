@@ -31,7 +31,7 @@ namespace Realm {
   //
 
     MetadataBase::MetadataBase(void)
-      : state(STATE_INVALID), valid_event(Event::NO_EVENT)
+      : state(STATE_INVALID), local_update(false), valid_event(Event::NO_EVENT)
     {}
 
     MetadataBase::~MetadataBase(void)
@@ -56,7 +56,28 @@ namespace Realm {
       assert(!remote_copies.contains(requestor));
       remote_copies.add(requestor);
 
-      return is_valid();
+      return is_valid() && !local_update;
+    }
+
+    bool MetadataBase::begin_local_update(void)
+    {
+      AutoHSLLock a(mutex);
+
+      if((state != STATE_VALID) || local_update || !remote_copies.empty())
+	return false;
+
+      local_update = true;
+      return true;
+    }
+
+    void MetadataBase::end_local_update(NodeSet& early_reqs)
+    {
+      AutoHSLLock a(mutex);
+
+      assert(local_update);
+      local_update = false;
+      // nobody had a copy when the update began
+      early_reqs = remote_copies;
     }
 
     void MetadataBase::handle_response(void)
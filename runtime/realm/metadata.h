@@ -57,9 +57,16 @@ namespace Realm {
       bool initiate_cleanup(ID::IDType id);
       bool handle_inval_ack(int sender);
 
+      // used by owner to change valid data in place - fails if any other
+      //  node has a copy, otherwise remote requests are held (like early
+      //  requests) until the update ends
+      bool begin_local_update(void);
+      void end_local_update(NodeSet& early_reqs);
+
     protected:
       GASNetHSL mutex;
       State state;  // current state
+      bool local_update;
       Event valid_event;
       NodeSet remote_copies;
     };
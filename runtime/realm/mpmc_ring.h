@@ -0,0 +1,84 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// templated bounded lock-free ring buffer
+
+#ifndef REALM_MPMC_RING_H
+#define REALM_MPMC_RING_H
+
+#include <stddef.h>
+
+namespace Realm {
+
+  // a bounded ring that supports any number of concurrent producers and
+  //  consumers without taking a lock - each slot carries a sequence number
+  //  that tells producers/consumers whether it is free or full for the
+  //  current lap around the ring
+  // the capacity is rounded up to a power of two and fixed at construction
+  //  time - a push into a full ring or a pop from an empty ring fails
+  //  immediately rather than waiting
+  // T is copied with operator= and should be cheap to copy (e.g. a pointer)
+  template <typename T>
+  class MPMCRing {
+  public:
+    MPMCRing(size_t _capacity);
+    ~MPMCRing(void);
+
+    typedef T ITEMTYPE;
+
+    size_t capacity(void) const;
+
+    // both of these are racy snapshots - only useful as hints
+    bool empty(void) const;
+    size_t size(void) const;
+
+    // returns false if the ring was full
+    bool try_push(const T& val);
+
+    // returns false if the ring was empty
+    bool try_pop(T& val);
+
+    // copies the oldest item without removing it - returns false if the
+    //  ring was empty (with more than one consumer, the item may be gone by
+    //  the time the caller looks at it)
+    bool try_peek(T& val) const;
+
+  protected:
+    // not copyable
+    MPMCRing(const MPMCRing<T>& copy_from);
+    MPMCRing<T>& operator=(const MPMCRing<T>& copy_from);
+
+    struct Slot {
+      volatile size_t seq;
+      T value;
+    };
+
+    // keep producer and consumer counters on separate cache lines
+    static const size_t PAD_BYTES = 64;
+
+    Slot *slots;
+    size_t mask;
+    char pad0[PAD_BYTES];
+    volatile size_t enqueue_pos;
+    char pad1[PAD_BYTES - sizeof(size_t)];
+    volatile size_t dequeue_pos;
+    char pad2[PAD_BYTES - sizeof(size_t)];
+  };
+
+}; // namespace Realm
+
+#include "realm/mpmc_ring.inl"
+
+#endif // ifndef REALM_MPMC_RING_H
@@ -0,0 +1,134 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// templated bounded lock-free ring buffer
+
+// nop, but helps IDEs
+#include "realm/mpmc_ring.h"
+
+#include <stdint.h>
+
+namespace Realm {
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class MPMCRing<T>
+
+  template <typename T>
+  inline MPMCRing<T>::MPMCRing(size_t _capacity)
+    : enqueue_pos(0), dequeue_pos(0)
+  {
+    // round up to a power of two (and at least 2 so that the "full" and
+    //  "empty" sequence numbers can't be confused)
+    size_t cap = 2;
+    while(cap < _capacity) cap <<= 1;
+    mask = cap - 1;
+    slots = new Slot[cap];
+    for(size_t i = 0; i < cap; i++)
+      slots[i].seq = i;
+  }
+
+  template <typename T>
+  inline MPMCRing<T>::~MPMCRing(void)
+  {
+    delete[] slots;
+  }
+
+  template <typename T>
+  inline size_t MPMCRing<T>::capacity(void) const
+  {
+    return mask + 1;
+  }
+
+  template <typename T>
+  inline bool MPMCRing<T>::empty(void) const
+  {
+    return (dequeue_pos == enqueue_pos);
+  }
+
+  template <typename T>
+  inline size_t MPMCRing<T>::size(void) const
+  {
+    // read the consumer side first so we never report a negative size
+    size_t deq = dequeue_pos;
+    size_t enq = enqueue_pos;
+    return ((enq > deq) ? (enq - deq) : 0);
+  }
+
+  template <typename T>
+  inline bool MPMCRing<T>::try_push(const T& val)
+  {
+    size_t pos = enqueue_pos;
+    while(true) {
+      Slot& s = slots[pos & mask];
+      intptr_t diff = (intptr_t)s.seq - (intptr_t)pos;
+      if(diff == 0) {
+	// slot is free for this lap - try to claim it (the CAS is also the
+	//  barrier that orders our write of the value after the seq check)
+	if(__sync_bool_compare_and_swap(&enqueue_pos, pos, pos + 1)) {
+	  s.value = val;
+	  __sync_synchronize();
+	  s.seq = pos + 1;
+	  return true;
+	}
+	pos = enqueue_pos;
+      } else if(diff < 0) {
+	// consumers haven't drained this slot from the previous lap - full
+	return false;
+      } else {
+	// another producer got here first
+	pos = enqueue_pos;
+      }
+    }
+  }
+
+  template <typename T>
+  inline bool MPMCRing<T>::try_pop(T& val)
+  {
+    size_t pos = dequeue_pos;
+    while(true) {
+      Slot& s = slots[pos & mask];
+      intptr_t diff = (intptr_t)s.seq - (intptr_t)(pos + 1);
+      if(diff == 0) {
+	if(__sync_bool_compare_and_swap(&dequeue_pos, pos, pos + 1)) {
+	  val = s.value;
+	  __sync_synchronize();
+	  // hand the slot back to producers for the next lap
+	  s.seq = pos + mask + 1;
+	  return true;
+	}
+	pos = dequeue_pos;
+      } else if(diff < 0) {
+	// producer hasn't filled this slot yet - empty
+	return false;
+      } else {
+	// another consumer got here first
+	pos = dequeue_pos;
+      }
+    }
+  }
+
+  template <typename T>
+  inline bool MPMCRing<T>::try_peek(T& val) const
+  {
+    size_t pos = dequeue_pos;
+    const Slot& s = slots[pos & mask];
+    if(s.seq != (pos + 1))
+      return false;
+    val = s.value;
+    return true;
+  }
+
+}; // namespace Realm
@@ -22,6 +22,7 @@
 #include "realm/threads.h"
 #include "realm/runtime_impl.h"
 #include "realm/utils.h"
+#include "realm/transfer/channel.h"
 
 namespace Realm {
 
@@ -310,6 +311,13 @@ namespace Realm {
     void NumaModule::create_dma_channels(RuntimeImpl *runtime)
     {
       Module::create_dma_channels(runtime);
+
+      // let the DMA system know where our memories live so that copies
+      //  into them can be done by memcpy workers in the same domain
+      for(std::map<int, MemoryImpl *>::const_iterator it = memories.begin();
+	  it != memories.end();
+	  ++it)
+	register_numa_mem_in_dma_systems(it->second->me, it->first);
     }
 
     // create any code translators provided by the module (default == do nothing)
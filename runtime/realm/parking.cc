@@ -0,0 +1,157 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// spin-then-park primitives for threads that wait often but not for long
+
+#include "realm/parking.h"
+
+#include <assert.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace Realm {
+
+  namespace Config {
+    int lock_spin_iterations = 100;
+    int idle_spin_iterations = 1000;
+  };
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SpinBackoff
+  //
+
+  SpinBackoff::SpinBackoff(void)
+    : pauses(1)
+  {}
+
+  /*static*/ void SpinBackoff::cpu_relax(void)
+  {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+  }
+
+  int SpinBackoff::pause(void)
+  {
+    int used = pauses;
+    for(int i = 0; i < used; i++)
+      cpu_relax();
+    if(pauses < MAX_PAUSES_PER_STEP)
+      pauses <<= 1;
+    return used;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // namespace FutexWord
+  //
+
+  namespace FutexWord {
+
+#ifdef __linux__
+    void wait(volatile int *addr, int expected)
+    {
+      // EAGAIN (value already changed) and EINTR are both fine - callers
+      //  recheck their condition
+      syscall(SYS_futex, (int *)addr, FUTEX_WAIT_PRIVATE, expected, 0, 0, 0);
+    }
+
+    void wake(volatile int *addr, int count)
+    {
+      syscall(SYS_futex, (int *)addr, FUTEX_WAKE_PRIVATE, count, 0, 0, 0);
+    }
+#else
+    // without futexes, everybody shares one mutex/condvar - wakers change
+    //  the word before calling wake(), and sleepers check it while holding
+    //  the mutex, so no wakeup is lost
+    static pthread_mutex_t fallback_mutex = PTHREAD_MUTEX_INITIALIZER;
+    static pthread_cond_t fallback_cond = PTHREAD_COND_INITIALIZER;
+
+    void wait(volatile int *addr, int expected)
+    {
+      pthread_mutex_lock(&fallback_mutex);
+      if(*addr == expected)
+	pthread_cond_wait(&fallback_cond, &fallback_mutex);
+      pthread_mutex_unlock(&fallback_mutex);
+    }
+
+    void wake(volatile int *addr, int count)
+    {
+      pthread_mutex_lock(&fallback_mutex);
+      pthread_cond_broadcast(&fallback_cond);
+      pthread_mutex_unlock(&fallback_mutex);
+    }
+#endif
+
+  };
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ThreadParker
+  //
+
+  ThreadParker::ThreadParker(void)
+    : state(EMPTY)
+  {}
+
+  bool ThreadParker::park(int spin_limit)
+  {
+    // spin first - an unpark that arrives in the meantime is just consumed
+    SpinBackoff backoff;
+    for(int spun = 0; spun < spin_limit; spun += backoff.pause())
+      if((state == NOTIFIED) &&
+	 __sync_bool_compare_and_swap(&state, NOTIFIED, EMPTY))
+	return false;
+
+    // EMPTY -> PARKED, unless an unpark got here first
+    if(!__sync_bool_compare_and_swap(&state, EMPTY, PARKED)) {
+#ifndef NDEBUG
+      bool ok =
+#endif
+	__sync_bool_compare_and_swap(&state, NOTIFIED, EMPTY);
+      assert(ok);
+      return false;
+    }
+
+    while(true) {
+      FutexWord::wait(&state, PARKED);
+      if(__sync_bool_compare_and_swap(&state, NOTIFIED, EMPTY))
+	return true;
+    }
+  }
+
+  void ThreadParker::unpark(void)
+  {
+    // only a sleeping thread needs the syscall
+    int old_state = __sync_lock_test_and_set(&state, NOTIFIED);
+    if(old_state == PARKED)
+      FutexWord::wake(&state, 1);
+  }
+
+}; // namespace Realm
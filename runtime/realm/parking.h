@@ -0,0 +1,75 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// spin-then-park primitives for threads that wait often but not for long
+
+#ifndef REALM_PARKING_H
+#define REALM_PARKING_H
+
+namespace Realm {
+
+  // bounded exponential backoff for spin loops - each pause() waits about
+  //  twice as long as the last one (up to a cap) and returns the number of
+  //  cpu pause instructions it used, so callers can bound their total spin
+  class SpinBackoff {
+  public:
+    SpinBackoff(void);
+
+    int pause(void);
+
+    // a single cpu-friendly spin-wait hint
+    static void cpu_relax(void);
+
+  protected:
+    static const int MAX_PAUSES_PER_STEP = 64;
+    int pauses;
+  };
+
+  // sleeping and waking on a 32-bit word - a futex on Linux, and a global
+  //  mutex/condvar elsewhere
+  namespace FutexWord {
+    // sleeps until woken, but only if *addr still equals 'expected' (may
+    //  also return spuriously)
+    void wait(volatile int *addr, int expected);
+
+    // wakes up to 'count' threads sleeping on 'addr'
+    void wake(volatile int *addr, int count);
+
+    static const int WAKE_ALL = 0x7fffffff;
+  };
+
+  // a parking spot for one thread - park() blocks the caller until another
+  //  thread calls unpark() (or returns right away if an unpark happened
+  //  since the last park), spinning for up to 'spin_limit' pause
+  //  instructions before going to sleep in the kernel
+  // unlike a condition variable, each thread has its own spot, so a wake
+  //  goes to exactly the thread that should run and nobody else
+  class ThreadParker {
+  public:
+    ThreadParker(void);
+
+    // returns true if the caller had to sleep in the kernel
+    bool park(int spin_limit);
+
+    void unpark(void);
+
+  protected:
+    enum { EMPTY = 0, NOTIFIED = 1, PARKED = 2 };
+    volatile int state;
+  };
+
+}; // namespace Realm
+
+#endif // ifndef REALM_PARKING_H
@@ -20,8 +20,10 @@
 
 #include <deque>
 #include <map>
+#include <stdint.h>
 
 #include "realm/sampling.h"
+#include "realm/mpmc_ring.h"
 
 namespace Realm {
 
@@ -104,6 +106,89 @@ namespace Realm {
     ProfilingGauges::AbsoluteRangeGauge<int> *entries_in_queue;
   };
 
+  // an alternative to PriorityQueue with the same interface, for queues that
+  //  see a lot of single-item traffic from many threads - each priority in
+  //  a small window around zero gets its own lock-free MPMCRing (created on
+  //  first use), and a bitmap of the non-empty rings finds the highest
+  //  priority with a single bit scan
+  // puts and gets at those priorities don't take the lock - it's only used
+  //  for priorities outside the window, "unget"s (which go to the front of
+  //  their priority), items that don't fit in a full ring, and to walk the
+  //  subscription list when a put makes a new highest priority available
+  // unlike PriorityQueue, a notification callback for an item that went
+  //  into a ring is made after the item is visible to getters, so the
+  //  callback's return value is ignored (no callback in Realm consumes
+  //  items), and callbacks may occasionally see an item that was already
+  //  taken by a racing get
+  // items that spill out of a full ring may come out ahead of older items
+  //  of the same priority
+  template <typename T, typename LT>
+  class BucketedPriorityQueue {
+  public:
+    BucketedPriorityQueue(void);
+    ~BucketedPriorityQueue(void);
+
+    typedef T ITEMTYPE;
+
+    typedef typename PriorityQueue<T, LT>::priority_t priority_t;
+    static const priority_t PRI_MAX_FINITE = PriorityQueue<T, LT>::PRI_MAX_FINITE;
+    static const priority_t PRI_MIN_FINITE = PriorityQueue<T, LT>::PRI_MIN_FINITE;
+    static const priority_t PRI_POS_INF = PriorityQueue<T, LT>::PRI_POS_INF;
+    static const priority_t PRI_NEG_INF = PriorityQueue<T, LT>::PRI_NEG_INF;
+
+    // priorities in [BUCKET_MIN_PRIORITY, BUCKET_MIN_PRIORITY + NUM_BUCKETS)
+    //  use the lock-free rings
+    static const int NUM_BUCKETS = 64;
+    static const priority_t BUCKET_MIN_PRIORITY = -(NUM_BUCKETS / 2);
+    static const size_t BUCKET_CAPACITY = 1024;
+
+    void put(T item, priority_t priority, bool add_to_back = true);
+
+    T get(priority_t *item_priority, priority_t higher_than = PRI_NEG_INF);
+
+    T peek(priority_t *item_priority, priority_t higher_than = PRI_NEG_INF) const;
+
+    // lock-free (and a racy snapshot, as with PriorityQueue)
+    bool empty(priority_t higher_than = PRI_NEG_INF) const;
+
+    typedef typename PriorityQueue<T, LT>::NotificationCallback NotificationCallback;
+
+    void add_subscription(NotificationCallback *callback, priority_t higher_than = PRI_NEG_INF);
+    void remove_subscription(NotificationCallback *callback);
+
+    void set_gauge(ProfilingGauges::AbsoluteRangeGauge<int> *new_gauge);
+
+  protected:
+    // not copyable
+    BucketedPriorityQueue(const BucketedPriorityQueue<T, LT>& copy_from);
+    BucketedPriorityQueue<T, LT>& operator=(const BucketedPriorityQueue<T, LT>& copy_from);
+
+    // highest priority in the rings (PRI_NEG_INF if none) and overall
+    priority_t highest_bucket_priority(void) const;
+    priority_t highest_available(void) const;
+
+    MPMCRing<T> *get_bucket(int index);
+
+    // lock must be held
+    bool perform_notifications(T item, priority_t item_priority);
+    T take_from_overflow(priority_t *item_priority, priority_t higher_than,
+			 bool remove);
+
+    MPMCRing<T> * volatile buckets[NUM_BUCKETS];
+    volatile uint64_t nonempty_buckets;
+
+    // everything else is protected by the lock (but the highest priority
+    //  in the overflow and the number of subscriptions may be read without
+    //  it)
+    mutable LT lock;
+    std::map<priority_t, std::deque<T> > overflow;  // negated priorities
+    volatile priority_t overflow_highest;
+    std::map<NotificationCallback *, priority_t> subscriptions;
+    volatile int num_subscriptions;
+
+    ProfilingGauges::AbsoluteRangeGauge<int> *entries_in_queue;
+  };
+
 }; // namespace Realm
 
 #include "realm/pri_queue.inl"
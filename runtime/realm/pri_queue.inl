@@ -233,4 +233,273 @@ namespace Realm {
     entries_in_queue = new_gauge;
   }
 
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class BucketedPriorityQueue<T, LT>
+
+  template <typename T, typename LT>
+  inline BucketedPriorityQueue<T, LT>::BucketedPriorityQueue(void)
+    : nonempty_buckets(0)
+    , overflow_highest(PRI_NEG_INF)
+    , num_subscriptions(0)
+    , entries_in_queue(0)
+  {
+    for(int i = 0; i < NUM_BUCKETS; i++)
+      buckets[i] = 0;
+  }
+
+  template <typename T, typename LT>
+  inline BucketedPriorityQueue<T, LT>::~BucketedPriorityQueue(void)
+  {
+    for(int i = 0; i < NUM_BUCKETS; i++)
+      delete buckets[i];
+  }
+
+  template <typename T, typename LT>
+  inline typename BucketedPriorityQueue<T, LT>::priority_t BucketedPriorityQueue<T, LT>::highest_bucket_priority(void) const
+  {
+    uint64_t bits = nonempty_buckets;
+    if(bits == 0)
+      return PRI_NEG_INF;
+    return (BUCKET_MIN_PRIORITY + 63 - __builtin_clzll(bits));
+  }
+
+  template <typename T, typename LT>
+  inline typename BucketedPriorityQueue<T, LT>::priority_t BucketedPriorityQueue<T, LT>::highest_available(void) const
+  {
+    priority_t b = highest_bucket_priority();
+    priority_t o = overflow_highest;
+    return ((b > o) ? b : o);
+  }
+
+  template <typename T, typename LT>
+  inline MPMCRing<T> *BucketedPriorityQueue<T, LT>::get_bucket(int index)
+  {
+    MPMCRing<T> *ring = buckets[index];
+    if(ring)
+      return ring;
+
+    // first use - whoever loses the race deletes their copy
+    MPMCRing<T> *new_ring = new MPMCRing<T>(BUCKET_CAPACITY);
+    if(__sync_bool_compare_and_swap(&buckets[index], (MPMCRing<T> *)0, new_ring))
+      return new_ring;
+    delete new_ring;
+    return buckets[index];
+  }
+
+  template <typename T, typename LT>
+  inline void BucketedPriorityQueue<T, LT>::put(T item,
+						priority_t priority,
+						bool add_to_back /*= true*/)
+  {
+    // clamp the priority to the "finite" range
+    if(priority > PRI_MAX_FINITE)
+      priority = PRI_MAX_FINITE;
+    else if(priority < PRI_MIN_FINITE)
+      priority = PRI_MIN_FINITE;
+
+    // increase the entry count, if we care
+    if(entries_in_queue)
+      (*entries_in_queue) += 1;
+
+    // fast path: FIFO put at a priority that has a ring
+    int index = priority - BUCKET_MIN_PRIORITY;
+    if(add_to_back && (index >= 0) && (index < NUM_BUCKETS) &&
+       get_bucket(index)->try_push(item)) {
+      uint64_t bit = ((uint64_t)1) << index;
+      uint64_t old_bits = __sync_fetch_and_or(&nonempty_buckets, bit);
+
+      // notify only if nothing at this priority or higher was available
+      //  when the item became visible - the check has to come after the
+      //  item is visible, or a getter that takes the last item that was
+      //  ahead of it could go to sleep without being told about it
+      if(num_subscriptions && ((old_bits >> index) == 0) &&
+	 (priority > overflow_highest)) {
+	lock.lock();
+	perform_notifications(item, priority);
+	lock.unlock();
+      }
+      return;
+    }
+
+    // slow path - same as PriorityQueue::put
+    lock.lock();
+
+    if(priority > highest_available()) {
+      if(perform_notifications(item, priority)) {
+	lock.unlock();
+	if(entries_in_queue)
+	  (*entries_in_queue) -= 1;
+	return;
+      }
+    }
+
+    std::deque<T>& dq = overflow[-priority]; // remember negation...
+    if(add_to_back)
+      dq.push_back(item);
+    else
+      dq.push_front(item);
+    if(priority > overflow_highest)
+      overflow_highest = priority;
+
+    lock.unlock();
+  }
+
+  // lock must be held
+  template <typename T, typename LT>
+  inline T BucketedPriorityQueue<T, LT>::take_from_overflow(priority_t *item_priority,
+							    priority_t higher_than,
+							    bool remove)
+  {
+    if(overflow.empty())
+      return 0; // TODO - EMPTY_VAL
+
+    typename std::map<priority_t, std::deque<T> >::iterator it = overflow.begin();
+    priority_t priority = -(it->first);
+    if(priority <= higher_than)
+      return 0; // TODO - EMPTY_VAL
+
+    T item = it->second.front();
+    if(remove) {
+      it->second.pop_front();
+      if(it->second.empty()) {
+	overflow.erase(it);
+	overflow_highest = (overflow.empty() ?
+			      PRI_NEG_INF :
+			      -(overflow.begin()->first));
+      }
+      if(entries_in_queue)
+	(*entries_in_queue) -= 1;
+    }
+
+    if(item_priority)
+      *item_priority = priority;
+    return item;
+  }
+
+  template <typename T, typename LT>
+  inline T BucketedPriorityQueue<T, LT>::get(priority_t *item_priority,
+					     priority_t higher_than /*= PRI_NEG_INF*/)
+  {
+    while(true) {
+      priority_t bucket_pri = highest_bucket_priority();
+      priority_t overflow_pri = overflow_highest;
+
+      // ties go to the overflow, which is where "unget"s are
+      if((overflow_pri >= bucket_pri) && (overflow_pri > higher_than)) {
+	lock.lock();
+	// the overflow may have changed since we looked
+	if(overflow_highest >= highest_bucket_priority()) {
+	  T item = take_from_overflow(item_priority, higher_than, true /*remove*/);
+	  lock.unlock();
+	  return item;
+	}
+	lock.unlock();
+	continue;
+      }
+
+      if(bucket_pri <= higher_than)
+	return 0; // TODO - EMPTY_VAL
+
+      int index = bucket_pri - BUCKET_MIN_PRIORITY;
+      MPMCRing<T> *ring = buckets[index];
+      T item;
+      bool found = ring->try_pop(item);
+
+      // if the ring looks empty now, clear its bit so that empty() is
+      //  accurate - if a put slipped in before we did that, its bit has to
+      //  go back
+      if(ring->empty()) {
+	uint64_t bit = ((uint64_t)1) << index;
+	__sync_fetch_and_and(&nonempty_buckets, ~bit);
+	if(!ring->empty())
+	  __sync_fetch_and_or(&nonempty_buckets, bit);
+      }
+
+      if(found) {
+	if(entries_in_queue)
+	  (*entries_in_queue) -= 1;
+	if(item_priority)
+	  *item_priority = bucket_pri;
+	return item;
+      }
+    }
+  }
+
+  template <typename T, typename LT>
+  inline T BucketedPriorityQueue<T, LT>::peek(priority_t *item_priority,
+					      priority_t higher_than /*= PRI_NEG_INF*/) const
+  {
+    priority_t bucket_pri = highest_bucket_priority();
+    priority_t overflow_pri = overflow_highest;
+
+    if((overflow_pri >= bucket_pri) && (overflow_pri > higher_than)) {
+      lock.lock();
+      T item = const_cast<BucketedPriorityQueue<T, LT> *>(this)->take_from_overflow(item_priority,
+										    higher_than,
+										    false /*!remove*/);
+      lock.unlock();
+      return item;
+    }
+
+    if(bucket_pri <= higher_than)
+      return 0; // TODO - EMPTY_VAL
+
+    T item;
+    if(!buckets[bucket_pri - BUCKET_MIN_PRIORITY]->try_peek(item))
+      return 0; // TODO - EMPTY_VAL
+    if(item_priority)
+      *item_priority = bucket_pri;
+    return item;
+  }
+
+  template <typename T, typename LT>
+  inline bool BucketedPriorityQueue<T, LT>::empty(priority_t higher_than /*= PRI_NEG_INF*/) const
+  {
+    return(highest_available() <= higher_than);
+  }
+
+  template <typename T, typename LT>
+  inline void BucketedPriorityQueue<T, LT>::add_subscription(NotificationCallback *callback,
+							     priority_t higher_than /*= PRI_NEG_INF*/)
+  {
+    lock.lock();
+    subscriptions[callback] = higher_than;
+    num_subscriptions = subscriptions.size();
+    lock.unlock();
+  }
+
+  template <typename T, typename LT>
+  inline void BucketedPriorityQueue<T, LT>::remove_subscription(NotificationCallback *callback)
+  {
+    lock.lock();
+    subscriptions.erase(callback);
+    num_subscriptions = subscriptions.size();
+    lock.unlock();
+  }
+
+  // lock must be held
+  template <typename T, typename LT>
+  inline bool BucketedPriorityQueue<T, LT>::perform_notifications(T item, priority_t item_priority)
+  {
+    for(typename std::map<NotificationCallback *, priority_t>::const_iterator it = subscriptions.begin();
+	it != subscriptions.end();
+	it++) {
+      if(item_priority <= it->second)
+	continue;
+
+      if(it->first->item_available(item, item_priority))
+	return true;
+    }
+
+    return false;
+  }
+
+  template <typename T, typename LT>
+  inline void BucketedPriorityQueue<T, LT>::set_gauge(ProfilingGauges::AbsoluteRangeGauge<int> *new_gauge)
+  {
+    entries_in_queue = new_gauge;
+  }
+
 }; // namespace Realm
@@ -441,12 +441,13 @@ namespace Realm {
     ProcessorGroup::ProcessorGroup(void)
       : ProcessorImpl(Processor::NO_PROC, Processor::PROC_GROUP),
 	members_valid(false), members_requested(false), next_free(0)
-      , ready_task_count(0)
+      , ready_task_count(0), next_member_queue(0)
     {
     }
 
     ProcessorGroup::~ProcessorGroup(void)
     {
+      // member_queues belong to the members' schedulers by now
       delete ready_task_count;
     }
 
@@ -468,19 +469,44 @@ namespace Realm {
 
       for(std::vector<Processor>::const_iterator it = member_list.begin();
 	  it != member_list.end();
-	  it++) {
-	ProcessorImpl *m_impl = get_runtime()->get_processor_impl(*it);
-	members.push_back(m_impl);
-	m_impl->add_to_group(this);
-      }
-
-      members_requested = true;
-      members_valid = true;
+	  it++)
+	members.push_back(get_runtime()->get_processor_impl(*it));
 
       // now that we exist, profile our queue depth
       std::string gname = stringbuilder() << "realm/proc " << me << "/ready tasks";
       ready_task_count = new ProfilingGauges::AbsoluteRangeGauge<int>(gname);
       task_queue.set_gauge(ready_task_count);
+
+      // work stealing only works with a flat list of local task processors -
+      //  anything else uses the shared queue
+      if(Config::task_stealing) {
+	for(std::vector<ProcessorImpl *>::const_iterator it = members.begin();
+	    it != members.end();
+	    it++) {
+	  LocalTaskProcessor *ltp = dynamic_cast<LocalTaskProcessor *>(*it);
+	  if(!ltp) {
+	    delete_container_contents(member_queues);
+	    break;
+	  }
+	  StealableTaskQueue *q = ltp->create_stealable_queue();
+	  q->set_gauge(ready_task_count);
+	  member_queues.push_back(q);
+	}
+
+	// every queue's peers must be known before any scheduler sees it
+	for(size_t i = 0; i < member_queues.size(); i++)
+	  for(size_t j = 0; j < member_queues.size(); j++)
+	    if(i != j)
+	      member_queues[i]->peers.push_back(member_queues[j]);
+      }
+
+      for(std::vector<ProcessorImpl *>::const_iterator it = members.begin();
+	  it != members.end();
+	  it++)
+	(*it)->add_to_group(this);
+
+      members_requested = true;
+      members_valid = true;
     }
 
     void ProcessorGroup::get_group_members(std::vector<Processor>& member_list)
@@ -496,9 +522,15 @@ namespace Realm {
     void ProcessorGroup::enqueue_task(Task *task)
     {
       // put it into the task queue - one of the member procs will eventually grab it
-      if(task->mark_ready())
-	task_queue.put(task, task->priority);
-      else
+      if(task->mark_ready()) {
+	if(!member_queues.empty()) {
+	  // members that run dry steal from the others, so the initial
+	  //  placement only needs to be roughly even
+	  unsigned idx = __sync_fetch_and_add(&next_member_queue, 1) % member_queues.size();
+	  member_queues[idx]->put(task);
+	} else
+	  task_queue.put(task, task->priority);
+      } else
 	task->mark_finished(false /*!successful*/);
     }
 
@@ -806,6 +838,7 @@ namespace Realm {
                                          int _num_cores)
     : ProcessorImpl(_me, _kind, _num_cores)
     , sched(0)
+    , ready_queue(0)
     , ready_task_count(stringbuilder() << "realm/proc " << me << "/ready tasks")
   {
     task_queue.set_gauge(&ready_task_count);
@@ -813,15 +846,25 @@ namespace Realm {
 
   LocalTaskProcessor::~LocalTaskProcessor(void)
   {
+    // the scheduler refers to its queues until it's gone
     delete sched;
+    delete ready_queue;
+    delete_container_contents(group_queues);
   }
 
   void LocalTaskProcessor::set_scheduler(ThreadedTaskScheduler *_sched)
   {
     sched = _sched;
 
+    sched->create_idle_gauges(stringbuilder() << "realm/proc " << me);
+
     // add our task queue to the scheduler
-    sched->add_task_queue(&task_queue);
+    if(Config::task_stealing) {
+      ready_queue = new StealableTaskQueue(sched);
+      ready_queue->set_gauge(&ready_task_count);
+      sched->add_stealable_queue(ready_queue);
+    } else
+      sched->add_task_queue(&task_queue);
 
     // this should be requested from outside now
 #if 0
@@ -844,16 +887,34 @@ namespace Realm {
 
   void LocalTaskProcessor::add_to_group(ProcessorGroup *group)
   {
+    // in work-stealing mode, the group has made a queue just for us
+    for(std::vector<StealableTaskQueue *>::const_iterator it = group->member_queues.begin();
+	it != group->member_queues.end();
+	++it)
+      if((*it)->owner == sched) {
+	sched->add_stealable_queue(*it);
+	group_queues.push_back(*it);
+	return;
+      }
+
     // add the group's task queue to our scheduler too
     sched->add_task_queue(&group->task_queue);
   }
 
+  StealableTaskQueue *LocalTaskProcessor::create_stealable_queue(void)
+  {
+    return new StealableTaskQueue(sched);
+  }
+
   void LocalTaskProcessor::enqueue_task(Task *task)
   {
     // just jam it into the task queue
-    if(task->mark_ready())
-      task_queue.put(task, task->priority);
-    else
+    if(task->mark_ready()) {
+      if(ready_queue)
+	ready_queue->put(task);
+      else
+	task_queue.put(task, task->priority);
+    } else
       task->mark_finished(false /*!successful*/);
   }
 
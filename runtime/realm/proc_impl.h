@@ -36,6 +36,7 @@
 namespace Realm {
 
     class ProcessorGroup;
+    class StealableTaskQueue;
 
     class ProcessorImpl {
     public:
@@ -96,11 +97,20 @@ namespace Realm {
 
       virtual void add_to_group(ProcessorGroup *group);
 
+      // a new queue owned by our scheduler, for a group we're joining in
+      //  work-stealing mode
+      StealableTaskQueue *create_stealable_queue(void);
+
     protected:
       void set_scheduler(ThreadedTaskScheduler *_sched);
 
       ThreadedTaskScheduler *sched;
-      PriorityQueue<Task *, GASNetHSL> task_queue;
+      ThreadedTaskScheduler::TaskQueue task_queue;
+      // used instead of task_queue in work-stealing mode
+      StealableTaskQueue *ready_queue;
+      // queues made for us by groups we've joined - our scheduler holds on
+      //  to them, so we free them once it's gone
+      std::vector<StealableTaskQueue *> group_queues;
       ProfilingGauges::AbsoluteRangeGauge<int> ready_task_count;
 
       struct TaskTableEntry {
@@ -201,8 +211,15 @@ namespace Realm {
 
       void request_group_members(void);
 
-      PriorityQueue<Task *, GASNetHSL> task_queue;
+      ThreadedTaskScheduler::TaskQueue task_queue;
       ProfilingGauges::AbsoluteRangeGauge<int> *ready_task_count;
+
+      // in work-stealing mode, a group whose members are all local task
+      //  processors gives each member its own queue and deals tasks out to
+      //  them in turn (the queues share the ready_task_count gauge) - each
+      //  member frees its queue after its scheduler
+      std::vector<StealableTaskQueue *> member_queues;
+      unsigned next_member_queue;
     };
     
     // this is generally useful to all processor implementations, so put it here
@@ -51,6 +51,7 @@ namespace Realm {
     PMID_PCTRS_IPC,  // instructions/clocks performance counters
     PMID_PCTRS_TLB,  // TLB miss counters
     PMID_PCTRS_BP,   // branch predictor performance counters
+    PMID_OP_XFER_TIMELINE, // per-transfer (XferDes) timelines of a copy
 
     // as the name suggests, this should always be last, allowing apps/runtimes
     // sitting on top of Realm to use some of the ID space
@@ -150,6 +151,29 @@ namespace Realm {
       size_t size;
     };
 
+    // records the timeline of each of the transfers (XferDes) that make up
+    //  a copy - a copy through intermediate buffers has one transfer per hop
+    struct OperationTransferTimeline {
+      static const ProfilingMeasurementID ID = PMID_OP_XFER_TIMELINE;
+
+      typedef long long timestamp_t;
+      static const timestamp_t INVALID_TIMESTAMP = LLONG_MIN;
+
+      struct XferInterval {
+	unsigned long long guid;  // XferDes id
+	int kind;                 // XferDes::XferKind (i.e. the channel used)
+	Memory src_mem;
+	Memory dst_mem;
+	timestamp_t enqueue_time;    // when was it handed to its channel?
+	timestamp_t first_byte_time; // when did the first request go out?
+	timestamp_t last_byte_time;  // when did the last request complete?
+	size_t bytes;                // how many bytes were moved?
+	timestamp_t ib_wait_time;    // time spent stalled on intermediate buffers
+      };
+
+      std::vector<XferInterval> xfers;
+    };
+
     // Track the status of an instance
     struct InstanceStatus {
       static const ProfilingMeasurementID ID = PMID_INST_STATUS;
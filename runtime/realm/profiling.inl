@@ -23,6 +23,7 @@ TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurementID);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationTimeline);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationEventWaits::WaitInterval);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationMemoryUsage);
+TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationTransferTimeline::XferInterval);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationProcessorUsage);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::InstanceAllocResult);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::InstanceMemoryUsage);
@@ -124,6 +125,18 @@ namespace Realm {
     }
 
 
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // struct OperationTransferTimeline
+    //
+
+    template <typename S>
+    bool serdez(S& serdez, const OperationTransferTimeline& t)
+    {
+      return (serdez & t.xfers);
+    }
+
+
     ////////////////////////////////////////////////////////////////////////
     //
     // struct OperationEventWaits::WaitInterval
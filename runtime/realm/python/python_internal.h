@@ -167,7 +167,7 @@ namespace Realm {
 
     std::map<Processor::TaskFuncID, TaskTableEntry> task_table;
 
-    PriorityQueue<Task *, GASNetHSL> task_queue;
+    ThreadedTaskScheduler::TaskQueue task_queue;
     ProfilingGauges::AbsoluteRangeGauge<int> ready_task_count;
   };
 
@@ -581,6 +581,7 @@ namespace Realm {
     core_rsrv = new CoreReservation(name, crs, params);
 
     sched = new PythonThreadTaskScheduler(this, *core_rsrv);
+    sched->create_idle_gauges(stringbuilder() << "realm/proc " << me);
     sched->add_task_queue(&task_queue);
     sched->start();
   }
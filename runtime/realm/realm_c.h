@@ -84,6 +84,13 @@ typedef enum realm_file_mode_t {
   LEGION_FILE_CREATE
 } realm_file_mode_t;
 
+// compression applied to file instances - a compressed file is only
+//  accessible through copies, not direct reads and writes
+typedef enum realm_file_compression_t {
+  LEGION_FILE_COMPRESS_NONE,
+  LEGION_FILE_COMPRESS_ZLIB  // requires USE_ZLIB
+} realm_file_compression_t;
+
 // Prototype for a Realm task
 typedef
   void (*realm_task_pointer_t)(
@@ -23,6 +23,8 @@
 #include "realm/realm_defines.h"
 #endif
 
+#include <stddef.h>
+
 // if set, uses ucontext.h for user level thread switching, otherwise falls
 //  back to POSIX threads
 #if !defined(REALM_USE_NATIVE_THREADS) && !defined(__MACH__)
@@ -37,6 +39,14 @@
 //define REALM_USE_KERNEL_AIO
 #endif
 
+// if set, Linux's io_uring interface is available as an async file I/O
+//  backend (selected at runtime with -ll:aio uring)
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define REALM_USE_IO_URING
+#endif
+#endif
+
 // dynamic loading via dlfcn and a not-completely standard dladdr extension
 #ifdef USE_LIBDL
 #define REALM_USE_DLFCN
@@ -66,9 +76,101 @@ namespace Realm {
     //  specified limit
     extern int event_loop_detection_limit;
 
+    // number of background threads that share the work of waking an
+    //  event's local waiters (0 = the triggering thread wakes them all),
+    //  and the minimum number of waiters before a trigger splits them up
+    extern int event_fanout_threads;
+    extern int event_fanout_min_waiters;
+
+    // merge_events calls with more than this many inputs filter out
+    //  triggered and duplicate inputs up front and then wait on the rest
+    //  with a tree of mergers that each take at most this many (0 = one
+    //  flat merger, regardless of width)
+    extern int event_merge_fanout;
+
     // if true, worker threads that might have used user-level thread switching
     //  fall back to kernel threading
     extern bool force_kernel_threads;
+
+    // default stack size (in KB) of user-level worker threads, the number
+    //  of guard pages below every thread stack (-1 = leave kernel threads
+    //  with the pthreads default), and how many freed user thread stacks of
+    //  each size are kept for reuse
+    extern int user_thread_stack_kb;
+    extern int stack_guard_pages;
+    extern int stack_pool_size;
+
+    // how long (in cpu pause instructions) a GASNetHSL spins before
+    //  blocking, and how long an idle worker spins waiting for work before
+    //  going to sleep
+    extern int lock_spin_iterations;
+    extern int idle_spin_iterations;
+
+    // if true, local processors use lock-free ready queues, and the members
+    //  of a processor group steal the group's tasks from each other
+    extern bool task_stealing;
+
+    // number of dedicated memcpy worker threads - if zero, the DMA thread
+    //  performs local memcpys itself
+    extern int dma_memcpy_threads;
+
+    // number of additional memcpy workers to run in each NUMA domain that
+    //  has a NUMA memory - copies into that memory are given to them (if
+    //  zero, those copies are handled like any other)
+    extern int dma_numa_memcpy_threads;
+
+    // number of requests each memcpy worker's lock-free ring can hold
+    extern int dma_memcpy_ring_depth;
+
+    // if non-zero, a DMA priority bucket that is passed over this many times
+    //  in a row has its oldest transfer promoted to the next bucket
+    extern int dma_xd_aging_passes;
+
+    // async file I/O backend (see AsyncFileIOContext::Backend) and the
+    //  maximum number of file I/O requests in flight
+    extern int aio_backend;
+    extern int aio_queue_depth;
+
+    // io_uring only: use a kernel thread to poll the submission queue, and
+    //  register local CPU memories as fixed buffers
+    extern bool aio_uring_sqpoll;
+    extern bool aio_uring_fixed_buffers;
+
+    // if true, freed intermediate buffers are cached per IB memory and size
+    //  class for reuse by later copies
+    extern bool dma_ib_pool;
+
+    // if true, the memory path and channels chosen for a copy are cached
+    //  per (source memory, destination memory, serdez op)
+    extern bool dma_path_cache;
+
+    // highest instruction set the strided copy kernels may use (see
+    //  CopyKernels::Level) - 0 falls back to a memcpy per contiguous line
+    extern int dma_copy_kernels;
+
+    // fills of at least this many bytes use non-temporal stores (0 = never)
+    extern size_t dma_fill_stream_threshold;
+
+    // compressed file instances: uncompressed bytes per chunk (for newly
+    //  created files), zlib compression level, and the number of worker
+    //  threads per direction that (de)compress chunks - with no workers,
+    //  the DMA thread does it
+    extern size_t file_compress_chunk;
+    extern int file_compress_level;
+    extern int file_compress_threads;
+
+    // instance allocation policy (see BasicRangeAllocator::Policy) for all
+    //  memories (first fit unless changed with -ll:alloc), and bitmasks (by
+    //  Memory::Kind) of the kinds of memory that override it with first fit
+    //  or best fit
+    extern int mem_alloc_policy;
+    extern unsigned mem_first_fit_kinds;
+    extern unsigned mem_best_fit_kinds;
+
+    // memory defragmentation: 0 disables it, otherwise unpinned instances
+    //  that are marked relocatable are moved to make room when an allocation fails, and also whenever a
+    //  memory's fragmentation (as a percentage) rises above this value
+    extern int mem_defrag_threshold;
   };
 };
 #endif
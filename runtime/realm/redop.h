@@ -19,6 +19,8 @@
 #define REALM_REDOP_H
 
 #include <sys/types.h>
+#include <stdint.h>
+#include <limits>
 
 namespace Realm {
 
@@ -45,6 +47,26 @@ namespace Realm {
       bool has_identity;
       bool is_foldable;
 
+      // the common arithmetic reductions on primitive types can say what
+      //  they are (see ReductionOpTraits) so that the DMA system can apply
+      //  them with vectorized kernels instead of the callbacks below
+      enum BuiltinOp {
+	BUILTIN_NONE,
+	BUILTIN_SUM,
+	BUILTIN_PROD,
+	BUILTIN_MIN,
+	BUILTIN_MAX,
+      };
+      enum BuiltinType {
+	BUILTIN_TYPE_NONE,
+	BUILTIN_FLOAT,
+	BUILTIN_DOUBLE,
+	BUILTIN_INT32,
+	BUILTIN_INT64,
+      };
+      BuiltinOp builtin_op;
+      BuiltinType builtin_type;
+
       template <class REDOP>
 	static ReductionOpUntyped *create_reduction_op(void);
 
@@ -75,10 +97,22 @@ namespace Realm {
     protected:
       ReductionOpUntyped(size_t _sizeof_lhs, size_t _sizeof_rhs,
 			 size_t _sizeof_list_entry,
-			 bool _has_identity, bool _is_foldable)
+			 bool _has_identity, bool _is_foldable,
+			 BuiltinOp _builtin_op = BUILTIN_NONE,
+			 BuiltinType _builtin_type = BUILTIN_TYPE_NONE)
 	: sizeof_lhs(_sizeof_lhs), sizeof_rhs(_sizeof_rhs),
 	  sizeof_list_entry(_sizeof_list_entry),
-  	  has_identity(_has_identity), is_foldable(_is_foldable) {}
+  	  has_identity(_has_identity), is_foldable(_is_foldable),
+	  builtin_op(_builtin_op), builtin_type(_builtin_type) {}
+    };
+
+    // by default a reduction op is opaque - specialize this (as is done for
+    //  the built-in ops below) for an op whose LHS and RHS are the same
+    //  primitive type and whose apply and fold are both the given operator
+    template <class REDOP>
+    struct ReductionOpTraits {
+      static const ReductionOpUntyped::BuiltinOp builtin_op = ReductionOpUntyped::BUILTIN_NONE;
+      static const ReductionOpUntyped::BuiltinType builtin_type = ReductionOpUntyped::BUILTIN_TYPE_NONE;
     };
 
 #ifdef NEED_TO_FIX_REDUCTION_LISTS_FOR_DEPPART
@@ -101,7 +135,9 @@ namespace Realm {
 #else
 			     0,
 #endif
-			     true, true) {}
+			     true, true,
+			     ReductionOpTraits<REDOP>::builtin_op,
+			     ReductionOpTraits<REDOP>::builtin_type) {}
 
       virtual ReductionOpUntyped *clone(void) const
       {
@@ -235,6 +271,136 @@ namespace Realm {
       return redop;
     }
 
+    // built-in reduction ops - these are ordinary REDOP classes (register
+    //  them with Runtime::register_reduction as usual) for float, double,
+    //  int32_t and int64_t, which the DMA system recognizes and applies with
+    //  vectorized kernels when it has exclusive access to the destination
+    //  (see CopySrcDstField::red_exclusive)
+
+    // non-exclusive updates are done with a compare-and-swap loop on the
+    //  bits of the value
+    template <size_t BYTES> struct ReductionAtomicWord;
+    template <> struct ReductionAtomicWord<4> { typedef uint32_t T; };
+    template <> struct ReductionAtomicWord<8> { typedef uint64_t T; };
+
+    template <class T, class COMBINE>
+    inline void reduction_atomic_update(T& lhs, T rhs)
+    {
+      typedef typename ReductionAtomicWord<sizeof(T)>::T W;
+      union { T val; W bits; } oldv, newv;
+      volatile W *ptr = reinterpret_cast<volatile W *>(&lhs);
+      do {
+	oldv.bits = *ptr;
+	newv.val = COMBINE::combine(oldv.val, rhs);
+      } while(!__sync_bool_compare_and_swap(ptr, oldv.bits, newv.bits));
+    }
+
+    template <class T, class COMBINE>
+    struct BuiltinReduction {
+      typedef T LHS;
+      typedef T RHS;
+
+      template <bool EXCL>
+      static void apply(LHS& lhs, RHS rhs)
+      {
+	if(EXCL)
+	  lhs = COMBINE::combine(lhs, rhs);
+	else
+	  reduction_atomic_update<T, COMBINE>(lhs, rhs);
+      }
+
+      template <bool EXCL>
+      static void fold(RHS& rhs1, RHS rhs2)
+      {
+	apply<EXCL>(rhs1, rhs2);
+      }
+    };
+
+    template <class T>
+    struct SumCombine {
+      static T combine(T a, T b) { return a + b; }
+      static T identity(void) { return 0; }
+    };
+
+    template <class T>
+    struct ProdCombine {
+      static T combine(T a, T b) { return a * b; }
+      static T identity(void) { return 1; }
+    };
+
+    // written so that the result matches the x86 min/max instructions
+    //  (i.e. 'a' is kept if the comparison fails)
+    template <class T>
+    struct MinCombine {
+      static T combine(T a, T b) { return ((b < a) ? b : a); }
+      static T identity(void)
+      {
+	return (std::numeric_limits<T>::has_infinity ?
+		  std::numeric_limits<T>::infinity() :
+		  std::numeric_limits<T>::max());
+      }
+    };
+
+    template <class T>
+    struct MaxCombine {
+      static T combine(T a, T b) { return ((b > a) ? b : a); }
+      static T identity(void)
+      {
+	return (std::numeric_limits<T>::has_infinity ?
+		  -std::numeric_limits<T>::infinity() :
+		  std::numeric_limits<T>::min());
+      }
+    };
+
+    template <class T>
+    struct SumReduction : public BuiltinReduction<T, SumCombine<T> > {
+      static const T identity;
+    };
+
+    template <class T>
+    struct ProdReduction : public BuiltinReduction<T, ProdCombine<T> > {
+      static const T identity;
+    };
+
+    template <class T>
+    struct MinReduction : public BuiltinReduction<T, MinCombine<T> > {
+      static const T identity;
+    };
+
+    template <class T>
+    struct MaxReduction : public BuiltinReduction<T, MaxCombine<T> > {
+      static const T identity;
+    };
+
+    template <class T>
+    /*static*/ const T SumReduction<T>::identity = SumCombine<T>::identity();
+    template <class T>
+    /*static*/ const T ProdReduction<T>::identity = ProdCombine<T>::identity();
+    template <class T>
+    /*static*/ const T MinReduction<T>::identity = MinCombine<T>::identity();
+    template <class T>
+    /*static*/ const T MaxReduction<T>::identity = MaxCombine<T>::identity();
+
+#define REALM_BUILTIN_REDOP_TRAITS(redop, op, type, btype) \
+    template <> \
+    struct ReductionOpTraits<redop<type> > { \
+      static const ReductionOpUntyped::BuiltinOp builtin_op = ReductionOpUntyped::op; \
+      static const ReductionOpUntyped::BuiltinType builtin_type = ReductionOpUntyped::btype; \
+    }
+#define REALM_BUILTIN_REDOP_TRAITS_ALL_TYPES(redop, op) \
+    REALM_BUILTIN_REDOP_TRAITS(redop, op, float, BUILTIN_FLOAT); \
+    REALM_BUILTIN_REDOP_TRAITS(redop, op, double, BUILTIN_DOUBLE); \
+    REALM_BUILTIN_REDOP_TRAITS(redop, op, int32_t, BUILTIN_INT32); \
+    REALM_BUILTIN_REDOP_TRAITS(redop, op, int64_t, BUILTIN_INT64)
+
+    REALM_BUILTIN_REDOP_TRAITS_ALL_TYPES(SumReduction, BUILTIN_SUM);
+    REALM_BUILTIN_REDOP_TRAITS_ALL_TYPES(ProdReduction, BUILTIN_PROD);
+    REALM_BUILTIN_REDOP_TRAITS_ALL_TYPES(MinReduction, BUILTIN_MIN);
+    REALM_BUILTIN_REDOP_TRAITS_ALL_TYPES(MaxReduction, BUILTIN_MAX);
+
+#undef REALM_BUILTIN_REDOP_TRAITS_ALL_TYPES
+#undef REALM_BUILTIN_REDOP_TRAITS
+
 }; // namespace Realm
 
 //include "redop.inl"
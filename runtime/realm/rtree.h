@@ -0,0 +1,109 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// templated N-dimensional packed R-tree
+
+#ifndef REALM_RTREE_H
+#define REALM_RTREE_H
+
+#include "realm/indexspace.h"
+
+#include <vector>
+#include <set>
+
+namespace Realm {
+
+  template <int N, typename T /*= int*/> struct Point;
+  template <int N, typename T /*= int*/> struct Rect;
+
+  // a PackedRTree is a static spatial index over labeled rectangles - all the
+  //  rectangles are added up front and then bulk-loaded (sort-tile-recursive)
+  //  into a tree whose leaves each hold up to FANOUT rectangles and whose
+  //  inner nodes each hold the bounding boxes of up to FANOUT children, so a
+  //  query only visits the parts of the tree whose bounds it overlaps
+  // rectangles may be added after a tree is constructed, but it must be
+  //  constructed again before it is queried
+  template <int N, typename T, typename LT>
+  class PackedRTree {
+  public:
+    static const size_t FANOUT = 16;
+
+    PackedRTree(void);
+
+    bool empty(void) const;
+    size_t size(void) const;
+
+    // empty rectangles are ignored
+    void add_rect(const Rect<N,T>& r, LT label);
+
+    template <typename RR>
+    void add_rects(const RR& rects, LT label);
+
+    void construct_tree(void);
+
+    // the bounding box of everything in the tree
+    const Rect<N,T>& get_bounds(void) const;
+
+    // calls marker.mark_overlap(entry_rect, entry_label) for each entry that
+    //  overlaps 'r' - the marker returns true to end the search early, in
+    //  which case test_rect also returns true
+    template <typename MARKER>
+    bool test_rect(const Rect<N,T>& r, MARKER& marker) const;
+
+    void test_rect(const Rect<N,T>& r, std::vector<bool>& labels_found) const;
+    void test_rect(const Rect<N,T>& r, std::set<LT>& labels_found) const;
+
+    template <typename RR, typename MARKER>
+    bool test_rects(const RR& rects, MARKER& marker) const;
+
+    template <typename RR>
+    void test_rects(const RR& rects, std::vector<bool>& labels_found) const;
+
+    template <typename RR>
+    void test_rects(const RR& rects, std::set<LT>& labels_found) const;
+
+    // same as test_rect for the rectangle holding only 'p'
+    template <typename MARKER>
+    bool test_point(const Point<N,T>& p, MARKER& marker) const;
+
+    bool overlaps_any(const Rect<N,T>& r) const;
+
+    struct Entry {
+      Rect<N,T> rect;
+      LT label;
+    };
+
+  protected:
+    void sort_tiles(size_t first, size_t last, int dim);
+
+    template <typename MARKER>
+    bool test_node(size_t level, size_t index,
+		   const Rect<N,T>& r, MARKER& marker) const;
+
+    // entries are in leaf order once the tree is constructed - the bounds
+    //  of leaf node i (in levels[0]) cover entries [i*FANOUT, (i+1)*FANOUT),
+    //  and those of node i in levels[k] cover nodes [i*FANOUT, (i+1)*FANOUT)
+    //  of levels[k-1]
+    std::vector<Entry> entries;
+    std::vector<std::vector<Rect<N,T> > > levels;
+    Rect<N,T> bounds;
+    bool constructed;
+  };
+
+};
+
+#include "realm/rtree.inl"
+
+#endif // ifndef REALM_RTREE_H
@@ -0,0 +1,292 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// templated N-dimensional packed R-tree
+
+// nop, but helps IDEs
+#include "realm/rtree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+namespace Realm {
+
+  namespace RTreeHelpers {
+
+    // orders entries by the centers of their rectangles in one dimension
+    //  (halving each bound first so that the sum can't overflow)
+    template <int N, typename T, typename LT>
+    class CenterSorter {
+    public:
+      CenterSorter(int _dim) : dim(_dim) {}
+      bool operator()(const typename PackedRTree<N,T,LT>::Entry& a,
+		      const typename PackedRTree<N,T,LT>::Entry& b) const
+      {
+	return ((a.rect.lo[dim] / 2 + a.rect.hi[dim] / 2) <
+		(b.rect.lo[dim] / 2 + b.rect.hi[dim] / 2));
+      }
+    protected:
+      int dim;
+    };
+
+    template <int N, typename T, typename LT>
+    class VectorMarker {
+    public:
+      VectorMarker(std::vector<bool>& _labels_found) : labels_found(_labels_found) {}
+      bool mark_overlap(const Rect<N,T>& r, LT label)
+      {
+	size_t idx = label;
+	if(idx >= labels_found.size())
+	  labels_found.resize(idx + 1, false);
+	labels_found[idx] = true;
+	return false;
+      }
+    protected:
+      std::vector<bool>& labels_found;
+    };
+
+    template <int N, typename T, typename LT>
+    class SetMarker {
+    public:
+      SetMarker(std::set<LT>& _labels_found) : labels_found(_labels_found) {}
+      bool mark_overlap(const Rect<N,T>& r, LT label)
+      {
+	labels_found.insert(label);
+	return false;
+      }
+    protected:
+      std::set<LT>& labels_found;
+    };
+
+    template <int N, typename T, typename LT>
+    class AnyMarker {
+    public:
+      bool mark_overlap(const Rect<N,T>& r, LT label) { return true; }
+    };
+
+  };
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class PackedRTree<N,T,LT>
+
+  template <int N, typename T, typename LT>
+  /*static*/ const size_t PackedRTree<N,T,LT>::FANOUT;
+
+  template <int N, typename T, typename LT>
+  inline PackedRTree<N,T,LT>::PackedRTree(void)
+    : bounds(Rect<N,T>::make_empty()), constructed(true)
+  {}
+
+  template <int N, typename T, typename LT>
+  inline bool PackedRTree<N,T,LT>::empty(void) const
+  {
+    return entries.empty();
+  }
+
+  template <int N, typename T, typename LT>
+  inline size_t PackedRTree<N,T,LT>::size(void) const
+  {
+    return entries.size();
+  }
+
+  template <int N, typename T, typename LT>
+  inline void PackedRTree<N,T,LT>::add_rect(const Rect<N,T>& r, LT label)
+  {
+    if(r.empty())
+      return;
+    Entry e;
+    e.rect = r;
+    e.label = label;
+    entries.push_back(e);
+    bounds = bounds.union_bbox(r);
+    constructed = false;
+  }
+
+  template <int N, typename T, typename LT>
+  template <typename RR>
+  inline void PackedRTree<N,T,LT>::add_rects(const RR& rects, LT label)
+  {
+    for(size_t i = 0; i < rects.size(); i++)
+      add_rect(rects[i], label);
+  }
+
+  // sort-tile-recursive: sort by centers in 'dim', cut into enough slabs that
+  //  each of the remaining dimensions gets an equal share of the cuts, and
+  //  then do the same within each slab for the next dimension
+  template <int N, typename T, typename LT>
+  void PackedRTree<N,T,LT>::sort_tiles(size_t first, size_t last, int dim)
+  {
+    size_t count = last - first;
+    if(count <= FANOUT)
+      return;
+
+    std::sort(entries.begin() + first, entries.begin() + last,
+	      RTreeHelpers::CenterSorter<N,T,LT>(dim));
+    if(dim == (N - 1))
+      return;
+
+    size_t leaves = (count + FANOUT - 1) / FANOUT;
+    size_t slabs = size_t(ceil(pow(double(leaves), 1.0 / (N - dim))));
+    size_t per_slab = ((leaves + slabs - 1) / slabs) * FANOUT;
+    for(size_t i = first; i < last; i += per_slab)
+      sort_tiles(i, std::min(i + per_slab, last), dim + 1);
+  }
+
+  template <int N, typename T, typename LT>
+  void PackedRTree<N,T,LT>::construct_tree(void)
+  {
+    levels.clear();
+    constructed = true;
+    if(entries.empty())
+      return;
+
+    sort_tiles(0, entries.size(), 0);
+
+    // leaf nodes first, then one level at a time until a single node's
+    //  worth of children is left
+    levels.resize(1);
+    levels[0].reserve((entries.size() + FANOUT - 1) / FANOUT);
+    for(size_t i = 0; i < entries.size(); i += FANOUT) {
+      Rect<N,T> nb = entries[i].rect;
+      size_t last = std::min(i + FANOUT, entries.size());
+      for(size_t j = i + 1; j < last; j++)
+	nb = nb.union_bbox(entries[j].rect);
+      levels[0].push_back(nb);
+    }
+
+    while(levels.back().size() > FANOUT) {
+      levels.resize(levels.size() + 1);
+      const std::vector<Rect<N,T> >& below = levels[levels.size() - 2];
+      std::vector<Rect<N,T> >& above = levels.back();
+      above.reserve((below.size() + FANOUT - 1) / FANOUT);
+      for(size_t i = 0; i < below.size(); i += FANOUT) {
+	Rect<N,T> nb = below[i];
+	size_t last = std::min(i + FANOUT, below.size());
+	for(size_t j = i + 1; j < last; j++)
+	  nb = nb.union_bbox(below[j]);
+	above.push_back(nb);
+      }
+    }
+  }
+
+  template <int N, typename T, typename LT>
+  inline const Rect<N,T>& PackedRTree<N,T,LT>::get_bounds(void) const
+  {
+    return bounds;
+  }
+
+  template <int N, typename T, typename LT>
+  template <typename MARKER>
+  bool PackedRTree<N,T,LT>::test_node(size_t level, size_t index,
+				      const Rect<N,T>& r, MARKER& marker) const
+  {
+    size_t first = index * FANOUT;
+    if(level == 0) {
+      size_t last = std::min(first + FANOUT, entries.size());
+      for(size_t i = first; i < last; i++)
+	if(entries[i].rect.overlaps(r) &&
+	   marker.mark_overlap(entries[i].rect, entries[i].label))
+	  return true;
+    } else {
+      const std::vector<Rect<N,T> >& below = levels[level - 1];
+      size_t last = std::min(first + FANOUT, below.size());
+      for(size_t i = first; i < last; i++)
+	if(below[i].overlaps(r) && test_node(level - 1, i, r, marker))
+	  return true;
+    }
+    return false;
+  }
+
+  template <int N, typename T, typename LT>
+  template <typename MARKER>
+  inline bool PackedRTree<N,T,LT>::test_rect(const Rect<N,T>& r,
+					     MARKER& marker) const
+  {
+    assert(constructed);
+    if(entries.empty() || !bounds.overlaps(r))
+      return false;
+
+    // the top level always fits in a single node
+    size_t top = levels.size() - 1;
+    for(size_t i = 0; i < levels[top].size(); i++)
+      if(levels[top][i].overlaps(r) && test_node(top, i, r, marker))
+	return true;
+    return false;
+  }
+
+  template <int N, typename T, typename LT>
+  inline void PackedRTree<N,T,LT>::test_rect(const Rect<N,T>& r,
+					     std::vector<bool>& labels_found) const
+  {
+    RTreeHelpers::VectorMarker<N,T,LT> marker(labels_found);
+    test_rect(r, marker);
+  }
+
+  template <int N, typename T, typename LT>
+  inline void PackedRTree<N,T,LT>::test_rect(const Rect<N,T>& r,
+					     std::set<LT>& labels_found) const
+  {
+    RTreeHelpers::SetMarker<N,T,LT> marker(labels_found);
+    test_rect(r, marker);
+  }
+
+  template <int N, typename T, typename LT>
+  template <typename RR, typename MARKER>
+  inline bool PackedRTree<N,T,LT>::test_rects(const RR& rects,
+					      MARKER& marker) const
+  {
+    for(size_t i = 0; i < rects.size(); i++)
+      if(test_rect(rects[i], marker))
+	return true;
+    return false;
+  }
+
+  template <int N, typename T, typename LT>
+  template <typename RR>
+  inline void PackedRTree<N,T,LT>::test_rects(const RR& rects,
+					      std::vector<bool>& labels_found) const
+  {
+    RTreeHelpers::VectorMarker<N,T,LT> marker(labels_found);
+    test_rects(rects, marker);
+  }
+
+  template <int N, typename T, typename LT>
+  template <typename RR>
+  inline void PackedRTree<N,T,LT>::test_rects(const RR& rects,
+					      std::set<LT>& labels_found) const
+  {
+    RTreeHelpers::SetMarker<N,T,LT> marker(labels_found);
+    test_rects(rects, marker);
+  }
+
+  template <int N, typename T, typename LT>
+  template <typename MARKER>
+  inline bool PackedRTree<N,T,LT>::test_point(const Point<N,T>& p,
+					      MARKER& marker) const
+  {
+    return test_rect(Rect<N,T>(p, p), marker);
+  }
+
+  template <int N, typename T, typename LT>
+  inline bool PackedRTree<N,T,LT>::overlaps_any(const Rect<N,T>& r) const
+  {
+    RTreeHelpers::AnyMarker<N,T,LT> marker;
+    return test_rect(r, marker);
+  }
+
+};
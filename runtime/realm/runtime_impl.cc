@@ -19,6 +19,7 @@
 
 #include "realm/proc_impl.h"
 #include "realm/mem_impl.h"
+#include "realm/mem_defrag.h"
 #include "realm/inst_impl.h"
 
 #include "realm/activemsg.h"
@@ -143,19 +144,22 @@ namespace Realm {
 	GenEventImpl *e = n->events.lookup_entry(j, i/*node*/);
 	AutoHSLLock a2(e->mutex);
 	
+	std::vector<EventWaiter *> current_waiters;
+	e->get_local_waiters(e->generation + 1, current_waiters);
+
 	// print anything with either local or remote waiters
-	if(e->current_local_waiters.empty() &&
+	if(current_waiters.empty() &&
 	   e->future_local_waiters.empty() &&
 	   e->remote_waiters.empty())
 	  continue;
 
 	os << "Event " << e->me <<": gen=" << e->generation
 	   << " subscr=" << e->gen_subscribed
-	   << " local=" << e->current_local_waiters.size()
+	   << " local=" << current_waiters.size()
 	   << "+" << e->future_local_waiters.size()
 	   << " remote=" << e->remote_waiters.size() << "\n";
-	for(std::vector<EventWaiter *>::const_iterator it = e->current_local_waiters.begin();
-	    it != e->current_local_waiters.end();
+	for(std::vector<EventWaiter *>::const_iterator it = current_waiters.begin();
+	    it != current_waiters.end();
 	    it++) {
 	  os << "  [" << (e->generation+1) << "] L:" << (*it) << " - ";
 	  (*it)->print(os);
@@ -898,6 +902,66 @@ namespace Realm {
 	}
     }
 
+    // parses -ll:alloc, a comma-separated list of "first" or "best" (the
+    //  policy for all memories) and/or "<KIND>=first|best" (e.g.
+    //  "GPU_FB_MEM=first") to choose the policy for one kind of memory
+    static void parse_alloc_policy(const std::string& spec)
+    {
+      static const char *kind_names[] = {
+#define KIND_NAMES(name, desc) #name,
+	REALM_MEMORY_KINDS(KIND_NAMES)
+#undef KIND_NAMES
+      };
+      size_t pos = 0;
+      while(pos <= spec.size()) {
+	size_t end = spec.find(',', pos);
+	if(end == std::string::npos)
+	  end = spec.size();
+	std::string item = spec.substr(pos, end - pos);
+	pos = end + 1;
+
+	std::string kind_name, policy_name = item;
+	size_t eq = item.find('=');
+	if(eq != std::string::npos) {
+	  kind_name = item.substr(0, eq);
+	  policy_name = item.substr(eq + 1);
+	}
+	bool first_fit;
+	if(policy_name == "first")
+	  first_fit = true;
+	else if(policy_name == "best")
+	  first_fit = false;
+	else {
+	  fprintf(stderr, "ERROR: unknown allocation policy '%s' (expected first or best)\n",
+		  policy_name.c_str());
+	  exit(1);
+	}
+
+	if(kind_name.empty()) {
+	  Config::mem_alloc_policy = (first_fit ?
+				        BasicRangeAllocator<size_t, RegionInstance>::FIRST_FIT :
+				        BasicRangeAllocator<size_t, RegionInstance>::BEST_FIT);
+	  continue;
+	}
+	unsigned mask = 0;
+	for(size_t k = 0; k < sizeof(kind_names) / sizeof(kind_names[0]); k++)
+	  if(kind_name == kind_names[k])
+	    mask = 1U << k;
+	if(!mask) {
+	  fprintf(stderr, "ERROR: unknown memory kind '%s' in -ll:alloc\n",
+		  kind_name.c_str());
+	  exit(1);
+	}
+	if(first_fit) {
+	  Config::mem_first_fit_kinds |= mask;
+	  Config::mem_best_fit_kinds &= ~mask;
+	} else {
+	  Config::mem_best_fit_kinds |= mask;
+	  Config::mem_first_fit_kinds &= ~mask;
+	}
+      }
+    }
+
     bool RuntimeImpl::init(int *argc, char ***argv)
     {
       DetailedTimer::init_timers();
@@ -1120,7 +1184,39 @@ namespace Realm {
 #endif
 
       cp.add_option_int("-realm:eventloopcheck", Config::event_loop_detection_limit);
+      cp.add_option_int("-ll:event_fanout", Config::event_fanout_threads)
+	.add_option_int("-ll:event_fanout_min", Config::event_fanout_min_waiters);
+      cp.add_option_int("-ll:merge_fanout", Config::event_merge_fanout);
       cp.add_option_bool("-ll:force_kthreads", Config::force_kernel_threads);
+      cp.add_option_bool("-ll:steal", Config::task_stealing);
+      cp.add_option_int("-ll:ustack", Config::user_thread_stack_kb)
+	.add_option_int("-ll:stack_guard", Config::stack_guard_pages)
+	.add_option_int("-ll:stack_pool", Config::stack_pool_size);
+      // spinning can't help if the thread we'd be waiting for can't run at
+      //  the same time
+      if(sysconf(_SC_NPROCESSORS_ONLN) <= 1)
+	Config::lock_spin_iterations = Config::idle_spin_iterations = 0;
+      cp.add_option_int("-ll:lock_spin", Config::lock_spin_iterations)
+	.add_option_int("-ll:idle_spin", Config::idle_spin_iterations);
+      cp.add_option_int("-ll:memcpy_threads", Config::dma_memcpy_threads)
+	.add_option_int("-ll:numa_memcpy_threads", Config::dma_numa_memcpy_threads)
+	.add_option_int("-ll:memcpy_ring", Config::dma_memcpy_ring_depth)
+	.add_option_int("-ll:xd_aging", Config::dma_xd_aging_passes);
+      std::string aio_backend_name;
+      cp.add_option_string("-ll:aio", aio_backend_name)
+	.add_option_int("-ll:aio_depth", Config::aio_queue_depth)
+	.add_option_bool("-ll:aio_sqpoll", Config::aio_uring_sqpoll)
+	.add_option_bool("-ll:aio_regbufs", Config::aio_uring_fixed_buffers);
+      cp.add_option_int("-ll:ib_pool", Config::dma_ib_pool);
+      cp.add_option_int("-ll:copy_kernels", Config::dma_copy_kernels);
+      cp.add_option_int("-ll:path_cache", Config::dma_path_cache);
+      cp.add_option_int("-ll:fill_stream", Config::dma_fill_stream_threshold);
+      cp.add_option_int("-ll:compress_chunk", Config::file_compress_chunk)
+	.add_option_int("-ll:compress_level", Config::file_compress_level)
+	.add_option_int("-ll:compress_threads", Config::file_compress_threads);
+      std::string alloc_policy;
+      cp.add_option_string("-ll:alloc", alloc_policy);
+      cp.add_option_int("-ll:defrag", Config::mem_defrag_threshold);
 
       // these are actually parsed in activemsg.cc, but consume them here for now
       size_t dummy = 0;
@@ -1130,7 +1226,10 @@ namespace Realm {
 	.add_option_int("-ll:sdpsize", dummy)
 	.add_option_int("-ll:spillwarn", dummy)
 	.add_option_int("-ll:spillstep", dummy)
-	.add_option_int("-ll:spillstall", dummy);
+	.add_option_int("-ll:spillstall", dummy)
+	.add_option_int("-ll:shm", dummy)
+	.add_option_int("-ll:shm_ring", dummy)
+	.add_option_int("-ll:shm_arena", dummy);
 
       bool cmdline_ok = cp.parse_command_line(cmdline);
 
@@ -1139,6 +1238,24 @@ namespace Realm {
 	exit(1);
       }
 
+      // values match AsyncFileIOContext::Backend
+      if(!aio_backend_name.empty()) {
+	if(aio_backend_name == "posix")
+	  Config::aio_backend = 1;
+	else if(aio_backend_name == "kernel")
+	  Config::aio_backend = 2;
+	else if(aio_backend_name == "uring")
+	  Config::aio_backend = 3;
+	else {
+	  fprintf(stderr, "ERROR: unknown AIO backend '%s' (expected posix, kernel, or uring)\n",
+		  aio_backend_name.c_str());
+	  exit(1);
+	}
+      }
+
+      if(!alloc_policy.empty())
+	parse_alloc_policy(alloc_policy);
+
 #ifndef EVENT_TRACING
       if(!event_trace_file.empty()) {
 	fprintf(stderr, "WARNING: event tracing requested, but not enabled at compile time!\n");
@@ -1243,6 +1360,7 @@ namespace Realm {
       XferDesCreateMessage::Message::add_handler_entries("Create XferDes Request AM");
       XferDesDestroyMessage::Message::add_handler_entries("Destroy XferDes Request AM");
       NotifyXferDesCompleteMessage::Message::add_handler_entries("Notify XferDes Completion Request AM");
+      NotifyXferDesTimelineMessage::Message::add_handler_entries("Notify XferDes Timeline AM");
       UpdateBytesWriteMessage::Message::add_handler_entries("Update Bytes Write AM");
       UpdateBytesReadMessage::Message::add_handler_entries("Update Bytes Read AM");
       RegisterTaskMessage::Message::add_handler_entries("Register Task AM");
@@ -1358,6 +1476,14 @@ namespace Realm {
 
       PartitioningOpQueue::start_worker_threads(*core_reservations);
 
+      if(Config::event_fanout_threads > 0)
+	EventFanoutWorkers::start_worker_threads(*core_reservations);
+
+      Task::create_pool_gauges();
+
+      if(Config::mem_defrag_threshold > 0)
+	MemoryDefragmenter::start_worker_thread(*core_reservations);
+
 #ifdef EVENT_TRACING
       // Always initialize even if we won't dump to file, otherwise segfaults happen
       // when we try to save event info
@@ -2157,6 +2283,9 @@ namespace Realm {
       // Shutdown all the threads
 
       // threads that cause inter-node communication have to stop first
+      //  (the defragmenter uses the dma system, so it goes before that)
+      if(Config::mem_defrag_threshold > 0)
+	MemoryDefragmenter::stop_worker_thread();
       PartitioningOpQueue::stop_worker_threads();
       stop_dma_worker_threads();
       stop_dma_system();
@@ -2172,6 +2301,10 @@ namespace Realm {
 	  (*it)->shutdown();
       }
 
+      // nothing local should be triggering events any more
+      if(Config::event_fanout_threads > 0)
+	EventFanoutWorkers::stop_worker_threads();
+
 #ifdef EVENT_TRACING
       if(event_trace_file) {
 	printf("writing event trace to %s\n", event_trace_file);
@@ -2241,6 +2374,11 @@ namespace Realm {
 	module_registrar.unload_module_sofiles();
       }
 
+      // the task allocator's gauges go last - every thread that might
+      //  allocate a task (or flush its task cache on exit) has been joined
+      //  by now, including the ones that modules own
+      Task::destroy_pool_gauges();
+
 #ifndef USE_GASNET
       if(nongasnet_regmem_base != 0)
 	free(nongasnet_regmem_base);
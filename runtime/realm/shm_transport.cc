@@ -0,0 +1,629 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// active messages between processes on the same host, through POSIX
+//  shared memory
+
+#include "realm/shm_transport.h"
+
+#include "realm/logging.h"
+#include "realm/timers.h"
+#include "realm/parking.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+namespace Realm {
+
+  Logger log_shm("shm");
+
+  static const uint32_t SEGMENT_MAGIC = 0x5348524dU;  // "SHRM"
+  static const int MAX_WINDOWS = 16;
+  static const size_t BLOCK_ALIGN = 64;
+
+  enum {
+    SLOT_HAS_PAYLOAD = 1,
+    SLOT_IN_ARENA = 2,     // payload is in a block of the sender's arena
+    SLOT_PREWRITTEN = 4,   // payload is already at dstptr
+    SLOT_FRAGMENT = 8,     // no message - just copy to dstptr + frag_offset
+  };
+
+  struct ShmTransport::SegmentHeader {
+    volatile uint32_t magic;
+    int32_t rank, num_ranks;
+    uint32_t ring_slots;
+    uint64_t arena_bytes;
+    volatile int32_t num_windows;
+    struct {
+      uint64_t remote_base, bytes;
+    } windows[MAX_WINDOWS];
+  };
+
+  // head is only written by the sender and tail only by the receiver, so
+  //  they get their own cache lines
+  struct ShmTransport::RingHeader {
+    volatile uint64_t head;
+    char pad1[56];
+    volatile uint64_t tail;
+    char pad2[56];
+  };
+
+  struct ShmTransport::MessageSlot {
+    int32_t msgid;
+    uint32_t arglen;
+    uint32_t flags;
+    uint32_t pad1;
+    uint64_t block_offset;
+    uint64_t payload_len;
+    uint64_t dstptr;
+    uint64_t frag_offset;
+    char args[MAX_ARG_BYTES];
+    char pad2[16];
+  };
+
+  struct ShmTransport::BlockHeader {
+    enum { BUSY = 0, FREE = 1 };
+    uint64_t bytes;  // whole block, header included
+    volatile uint32_t state;
+    uint32_t pad;
+  };
+
+  static inline size_t round_up(size_t val, size_t align)
+  {
+    return ((val + align - 1) / align) * align;
+  }
+
+  // copies 'bytes' bytes, starting 'offset' bytes into the concatenation
+  //  of 'spans', to 'dest'
+  static void gather_copy(char *dest, const SpanList& spans,
+			  size_t offset, size_t bytes)
+  {
+    for(SpanList::const_iterator it = spans.begin();
+	(it != spans.end()) && (bytes > 0);
+	++it) {
+      if(offset >= it->second) {
+	offset -= it->second;
+	continue;
+      }
+      size_t amt = std::min(it->second - offset, bytes);
+      memcpy(dest, ((const char *)(it->first)) + offset, amt);
+      dest += amt;
+      bytes -= amt;
+      offset = 0;
+    }
+    assert(bytes == 0);
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmTransport
+  //
+
+  ShmTransport::Peer::Peer(void)
+    : segment(0), segment_size(0), windows_mapped(0)
+    , arena_alloc(0), arena_reclaim(0), recv_busy(0)
+  {}
+
+  ShmTransport::ShmTransport(const std::string& _key, int _my_rank, int _num_ranks,
+			     size_t _ring_slots, size_t _arena_bytes)
+    : messages_sent(0), bytes_sent(0), sends_stalled(0)
+    , key(_key), my_rank(_my_rank), num_ranks(_num_ranks)
+    , segment(0), windows_exported(0)
+  {
+    // names can't have slashes past the first character
+    std::replace(key.begin(), key.end(), '/', '_');
+
+    ring_slots = 2;
+    while(ring_slots < _ring_slots)
+      ring_slots <<= 1;
+    arena_bytes = round_up(_arena_bytes, BLOCK_ALIGN);
+    assert(arena_bytes >= (4 * BLOCK_ALIGN));
+
+    segment_size = (round_up(sizeof(SegmentHeader), 4096) +
+		    round_up(num_ranks * ring_bytes(), 4096) +
+		    (num_ranks * arena_bytes));
+
+    peers.resize(num_ranks);
+    for(int i = 0; i < num_ranks; i++)
+      peers[i] = new Peer;
+  }
+
+  ShmTransport::~ShmTransport(void)
+  {
+    for(int i = 0; i < num_ranks; i++) {
+      Peer *p = peers[i];
+      if(p->segment)
+	munmap(p->segment, p->segment_size);
+      // aliases added by the caller aren't ours to unmap
+      for(int j = 0; j < p->windows_mapped; j++)
+	munmap(p->windows[j].local_base, p->windows[j].bytes);
+      delete p;
+    }
+    if(segment) {
+      SegmentHeader *hdr = (SegmentHeader *)segment;
+      for(int i = 0; i < hdr->num_windows; i++)
+	munmap((void *)(hdr->windows[i].remote_base), hdr->windows[i].bytes);
+      munmap(segment, segment_size);
+    }
+  }
+
+  std::string ShmTransport::segment_name(int rank, int window /*= -1*/) const
+  {
+    char suffix[32];
+    if(window >= 0)
+      snprintf(suffix, sizeof(suffix), ".%d.w%d", rank, window);
+    else
+      snprintf(suffix, sizeof(suffix), ".%d", rank);
+    return "/realm." + key + suffix;
+  }
+
+  size_t ShmTransport::ring_bytes(void) const
+  {
+    return sizeof(RingHeader) + (ring_slots * sizeof(MessageSlot));
+  }
+
+  ShmTransport::RingHeader *ShmTransport::inbound_ring(char *base, int sender) const
+  {
+    return (RingHeader *)(base +
+			  round_up(sizeof(SegmentHeader), 4096) +
+			  (sender * ring_bytes()));
+  }
+
+  char *ShmTransport::outbound_arena(char *base, int target) const
+  {
+    return (base +
+	    round_up(sizeof(SegmentHeader), 4096) +
+	    round_up(num_ranks * ring_bytes(), 4096) +
+	    (target * arena_bytes));
+  }
+
+  // maps a named shared memory object, creating it if 'create' is set
+  static void *map_named(const std::string& name, size_t bytes, bool create)
+  {
+    int fd;
+    if(create) {
+      fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if((fd < 0) && (errno == EEXIST)) {
+	// left behind by a job that died with the same key
+	log_shm.info() << "removing stale shared memory object: " << name;
+	shm_unlink(name.c_str());
+	fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      }
+      if(fd < 0) {
+	log_shm.warning() << "shm_open(" << name << ") failed: " << strerror(errno);
+	return 0;
+      }
+      // the kernel hands out zeroed pages as they're touched
+      if(ftruncate(fd, bytes) != 0) {
+	log_shm.warning() << "ftruncate(" << name << ", " << bytes << ") failed: " << strerror(errno);
+	close(fd);
+	shm_unlink(name.c_str());
+	return 0;
+      }
+    } else {
+      fd = shm_open(name.c_str(), O_RDWR, 0);
+      if(fd < 0)
+	return 0;
+      struct stat st;
+      if((fstat(fd, &st) != 0) || ((size_t)st.st_size < bytes)) {
+	close(fd);
+	return 0;
+      }
+    }
+
+    void *base = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) {
+      log_shm.warning() << "mmap(" << name << ", " << bytes << ") failed: " << strerror(errno);
+      return 0;
+    }
+    return base;
+  }
+
+  bool ShmTransport::create_segment(void)
+  {
+    assert(segment == 0);
+    segment = (char *)map_named(segment_name(my_rank), segment_size, true);
+    if(!segment)
+      return false;
+
+    SegmentHeader *hdr = (SegmentHeader *)segment;
+    hdr->rank = my_rank;
+    hdr->num_ranks = num_ranks;
+    hdr->ring_slots = ring_slots;
+    hdr->arena_bytes = arena_bytes;
+    hdr->num_windows = 0;
+    // peers look for the magic number to know the rest is valid
+    __sync_synchronize();
+    hdr->magic = SEGMENT_MAGIC;
+
+    log_shm.info() << "created segment " << segment_name(my_rank)
+		   << ": " << segment_size << " bytes";
+    return true;
+  }
+
+  int ShmTransport::attach_peers(double timeout /*= 0*/)
+  {
+    int found = 0;
+    for(int i = 0; i < num_ranks; i++) {
+      if((i == my_rank) || peers[i]->segment)
+	continue;
+
+      double deadline = Clock::current_time() + timeout;
+      while(true) {
+	char *base = (char *)map_named(segment_name(i), segment_size, false);
+	if(base) {
+	  SegmentHeader *hdr = (SegmentHeader *)base;
+	  // the creator may not have filled in the header yet
+	  while((hdr->magic != SEGMENT_MAGIC) &&
+		(Clock::current_time() < deadline))
+	    usleep(1000);
+	  __sync_synchronize();
+	  if((hdr->magic == SEGMENT_MAGIC) &&
+	     (hdr->rank == i) &&
+	     (hdr->num_ranks == num_ranks) &&
+	     (hdr->ring_slots == ring_slots) &&
+	     (hdr->arena_bytes == arena_bytes)) {
+	    peers[i]->segment = base;
+	    peers[i]->segment_size = segment_size;
+	    found++;
+	  } else {
+	    log_shm.warning() << "ignoring mismatched segment " << segment_name(i);
+	    munmap(base, segment_size);
+	  }
+	  break;
+	}
+	if(Clock::current_time() >= deadline)
+	  break;
+	usleep(1000);
+      }
+    }
+
+    log_shm.info() << "rank " << my_rank << ": " << found << " co-located peers";
+    return found;
+  }
+
+  void ShmTransport::unlink_names(void)
+  {
+    shm_unlink(segment_name(my_rank).c_str());
+    AutoHSLLock al(window_mutex);
+    for(int i = 0; i < windows_exported; i++)
+      shm_unlink(segment_name(my_rank, i).c_str());
+  }
+
+  bool ShmTransport::is_colocated(int rank) const
+  {
+    return ((rank >= 0) && (rank < num_ranks) && (peers[rank]->segment != 0));
+  }
+
+  void *ShmTransport::export_window(size_t bytes)
+  {
+    assert(segment != 0);
+    AutoHSLLock al(window_mutex);
+    if(windows_exported >= MAX_WINDOWS) {
+      log_shm.warning() << "too many exported windows";
+      return 0;
+    }
+
+    int idx = windows_exported;
+    void *base = map_named(segment_name(my_rank, idx), bytes, true);
+    if(!base)
+      return 0;
+    windows_exported++;
+
+    SegmentHeader *hdr = (SegmentHeader *)segment;
+    hdr->windows[idx].remote_base = (uintptr_t)base;
+    hdr->windows[idx].bytes = bytes;
+    __sync_synchronize();
+    hdr->num_windows = idx + 1;
+    return base;
+  }
+
+  void ShmTransport::add_alias(int rank, const void *remote_base, void *local_base,
+			       size_t bytes)
+  {
+    Peer& p = *peers[rank];
+    AutoHSLLock al(p.send_mutex);
+    Window w;
+    w.remote_base = (uintptr_t)remote_base;
+    w.local_base = (char *)local_base;
+    w.bytes = bytes;
+    // keep the peer's exported windows at the front of the list
+    p.windows.push_back(w);
+  }
+
+  void *ShmTransport::find_alias(int rank, Peer& p, const void *remote_ptr, size_t bytes)
+  {
+    // map any windows the peer has exported since we last looked
+    SegmentHeader *hdr = (SegmentHeader *)(p.segment);
+    int num_windows = hdr->num_windows;
+    if(p.windows_mapped < num_windows) {
+      __sync_synchronize();
+      std::vector<Window> mapped;
+      for(int i = p.windows_mapped; i < num_windows; i++) {
+	Window w;
+	w.remote_base = hdr->windows[i].remote_base;
+	w.bytes = hdr->windows[i].bytes;
+	w.local_base = (char *)map_named(segment_name(rank, i), w.bytes, false);
+	if(!w.local_base) {
+	  // probably unlinked already - treat as unaliased
+	  log_shm.info() << "could not map window " << segment_name(rank, i);
+	  w.bytes = 0;
+	}
+	mapped.push_back(w);
+      }
+      p.windows.insert(p.windows.begin() + p.windows_mapped,
+		       mapped.begin(), mapped.end());
+      p.windows_mapped = num_windows;
+    }
+
+    uintptr_t ptr = (uintptr_t)remote_ptr;
+    for(std::vector<Window>::const_iterator it = p.windows.begin();
+	it != p.windows.end();
+	++it)
+      if((ptr >= it->remote_base) && ((ptr + bytes) <= (it->remote_base + it->bytes)))
+	return it->local_base + (ptr - it->remote_base);
+    return 0;
+  }
+
+  void *ShmTransport::translate(int rank, const void *remote_ptr, size_t bytes)
+  {
+    if(!is_colocated(rank))
+      return 0;
+    Peer& p = *peers[rank];
+    AutoHSLLock al(p.send_mutex);
+    return find_alias(rank, p, remote_ptr, bytes);
+  }
+
+  bool ShmTransport::alloc_block(int target, Peer& p, size_t bytes, uint64_t& offset)
+  {
+    char *arena = outbound_arena(segment, target);
+
+    // first take back any blocks the target has finished with - blocks can
+    //  be freed in any order, but are reclaimed in allocation order
+    while(p.arena_reclaim < p.arena_alloc) {
+      BlockHeader *blk = (BlockHeader *)(arena + (p.arena_reclaim % arena_bytes));
+      if(blk->state != BlockHeader::FREE)
+	break;
+      p.arena_reclaim += blk->bytes;
+    }
+
+    size_t needed = round_up(sizeof(BlockHeader) + bytes, BLOCK_ALIGN);
+    size_t pos = p.arena_alloc % arena_bytes;
+    // a block can't wrap around the end of the arena - pad to the start
+    //  instead
+    size_t padding = (((pos + needed) > arena_bytes) ? (arena_bytes - pos) : 0);
+    if((p.arena_alloc + padding + needed - p.arena_reclaim) > arena_bytes)
+      return false;
+
+    if(padding > 0) {
+      BlockHeader *pad = (BlockHeader *)(arena + pos);
+      pad->bytes = padding;
+      pad->state = BlockHeader::FREE;
+      p.arena_alloc += padding;
+      pos = 0;
+    }
+
+    BlockHeader *blk = (BlockHeader *)(arena + pos);
+    blk->bytes = needed;
+    blk->state = BlockHeader::BUSY;
+    p.arena_alloc += needed;
+    offset = pos;
+    return true;
+  }
+
+  bool ShmTransport::push_message(int target, int msgid, unsigned flags,
+				  const void *args, size_t arglen,
+				  const SpanList& payload, size_t offset, size_t bytes,
+				  size_t payload_len, void *dstptr)
+  {
+    Peer& p = *peers[target];
+    AutoHSLLock al(p.send_mutex);
+
+    RingHeader *ring = inbound_ring(p.segment, my_rank);
+    uint64_t head = ring->head;
+    if((head - ring->tail) >= ring_slots) {
+      __sync_fetch_and_add(&sends_stalled, 1);
+      return false;
+    }
+
+    uint64_t block_offset = 0;
+    if(bytes > 0) {
+      // a destination we can see gets written directly
+      char *dest = 0;
+      if((dstptr != 0) && !(flags & SLOT_FRAGMENT))
+	dest = (char *)find_alias(target, p, dstptr, bytes);
+      if(dest) {
+	flags |= SLOT_PREWRITTEN;
+      } else {
+	if(!alloc_block(target, p, bytes, block_offset)) {
+	  __sync_fetch_and_add(&sends_stalled, 1);
+	  return false;
+	}
+	dest = (outbound_arena(segment, target) + block_offset +
+		sizeof(BlockHeader));
+	flags |= SLOT_IN_ARENA;
+      }
+      gather_copy(dest, payload, offset, bytes);
+    }
+
+    MessageSlot *slot = (MessageSlot *)(((char *)ring) + sizeof(RingHeader) +
+					((head & (ring_slots - 1)) * sizeof(MessageSlot)));
+    slot->msgid = msgid;
+    slot->arglen = arglen;
+    slot->flags = flags;
+    slot->block_offset = block_offset;
+    slot->payload_len = payload_len;
+    slot->dstptr = (uintptr_t)dstptr;
+    slot->frag_offset = offset;
+    if(arglen > 0)
+      memcpy(slot->args, args, arglen);
+
+    // payload and slot both have to be visible before the new head is
+    __sync_synchronize();
+    ring->head = head + 1;
+    return true;
+  }
+
+  bool ShmTransport::send(int target, int msgid, const void *args, size_t arglen,
+			  const SpanList& payload, size_t payload_len, bool has_payload,
+			  void *dstptr /*= 0*/, void (*progress)(void) /*= 0*/)
+  {
+    assert(is_colocated(target));
+    assert(arglen <= MAX_ARG_BYTES);
+
+    unsigned flags = (has_payload ? SLOT_HAS_PAYLOAD : 0);
+
+    // anything up to a quarter of the arena goes in one block, so that a
+    //  few big messages can't starve everybody else
+    size_t max_block = max_block_bytes();
+    if((payload_len > max_block) &&
+       !((dstptr != 0) && translate(target, dstptr, payload_len))) {
+      if(dstptr == 0) {
+	// the receiver would have nowhere to put it
+	log_shm.fatal() << "payload of " << payload_len << " bytes too large for shm arena ("
+			<< arena_bytes << " bytes) with no destination";
+	assert(0);
+      }
+
+      size_t done = 0;
+      SpinBackoff backoff;
+      while(done < payload_len) {
+	size_t bytes = std::min(max_block, payload_len - done);
+	if(push_message(target, 0, SLOT_FRAGMENT, 0, 0,
+			payload, done, bytes, bytes, dstptr)) {
+	  done += bytes;
+	  continue;
+	}
+	// nothing's been sent yet, so the caller can still retry
+	if(done == 0)
+	  return false;
+	if(progress)
+	  (*progress)();
+	else if(backoff.pause() >= 64)
+	  sched_yield();
+      }
+
+      // and then the message itself, which finds its payload in place
+      while(!push_message(target, msgid, flags | SLOT_PREWRITTEN, args, arglen,
+			  payload, 0, 0, payload_len, dstptr)) {
+	if(progress)
+	  (*progress)();
+	else if(backoff.pause() >= 64)
+	  sched_yield();
+      }
+    } else {
+      if(!push_message(target, msgid, flags, args, arglen,
+		       payload, 0, payload_len, payload_len, dstptr))
+	return false;
+    }
+
+    __sync_fetch_and_add(&messages_sent, 1);
+    __sync_fetch_and_add(&bytes_sent, (uint64_t)payload_len);
+    return true;
+  }
+
+  int ShmTransport::poll(MessageHandler *handler, int max_messages /*= 0*/)
+  {
+    int delivered = 0;
+
+    for(int i = 0; i < num_ranks; i++) {
+      Peer& p = *peers[i];
+      if(!p.segment)
+	continue;
+
+      RingHeader *ring = inbound_ring(segment, i);
+      // cheap check before taking the lock
+      if(ring->tail == ring->head)
+	continue;
+
+      if(!__sync_bool_compare_and_swap(&p.recv_busy, 0, 1))
+	continue;
+      char *arena = outbound_arena(p.segment, my_rank);
+      int count = 0;
+      while((max_messages == 0) || (count < max_messages)) {
+	uint64_t tail = ring->tail;
+	if(tail == ring->head)
+	  break;
+	__sync_synchronize();
+
+	// copy the slot out so it can be reused right away
+	MessageSlot slot = *(MessageSlot *)(((char *)ring) + sizeof(RingHeader) +
+					    ((tail & (ring_slots - 1)) * sizeof(MessageSlot)));
+	__sync_synchronize();
+	ring->tail = tail + 1;
+
+	char *block_data = ((slot.flags & SLOT_IN_ARENA) ?
+			      (arena + slot.block_offset + sizeof(BlockHeader)) :
+			      0);
+	void *dstptr = (void *)(uintptr_t)(slot.dstptr);
+
+	if(slot.flags & SLOT_FRAGMENT) {
+	  memcpy(((char *)dstptr) + slot.frag_offset, block_data, slot.payload_len);
+	  release_payload(i, block_data);
+	  continue;
+	}
+
+	void *data = 0;
+	if(slot.flags & SLOT_IN_ARENA) {
+	  if(dstptr) {
+	    memcpy(dstptr, block_data, slot.payload_len);
+	    release_payload(i, block_data);
+	    data = dstptr;
+	  } else
+	    data = block_data;
+	} else if(slot.flags & SLOT_PREWRITTEN)
+	  data = dstptr;
+
+	handler->handle_message(i, slot.msgid, slot.args, slot.arglen,
+				data, slot.payload_len,
+				(slot.flags & SLOT_HAS_PAYLOAD) != 0);
+	count++;
+      }
+      __sync_synchronize();
+      p.recv_busy = 0;
+      delivered += count;
+    }
+
+    return delivered;
+  }
+
+  bool ShmTransport::release_payload(int sender, const void *payload)
+  {
+    if(!is_colocated(sender))
+      return false;
+    const char *arena = outbound_arena(peers[sender]->segment, my_rank);
+    if((payload < (const void *)arena) || (payload >= (const void *)(arena + arena_bytes)))
+      return false;
+
+    // everything the handler did with the payload has to happen before the
+    //  sender can reuse it
+    BlockHeader *blk = (BlockHeader *)(((char *)payload) - sizeof(BlockHeader));
+    __sync_synchronize();
+    blk->state = BlockHeader::FREE;
+    return true;
+  }
+
+}; // namespace Realm
@@ -0,0 +1,180 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// active messages between processes on the same host, through POSIX
+//  shared memory
+
+#ifndef REALM_SHM_TRANSPORT_H
+#define REALM_SHM_TRANSPORT_H
+
+#include "realm/activemsg.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace Realm {
+
+  // every rank creates one shared memory segment that holds:
+  //  - an inbound ring of message descriptors per sender - each ring has a
+  //     single producer (the sender process, which serializes its own
+  //     threads) and a single consumer, so neither side needs atomics
+  //     beyond ordered loads and stores
+  //  - an outbound payload arena per target - a sender copies a payload
+  //     into its arena once and the target reads it in place, marking the
+  //     block free when its handler is done with it
+  // ranks find each other's segments by name, so only ranks that share a
+  //  host (and therefore a /dev/shm) end up connected
+  //
+  // payloads headed for a known destination address (i.e. long messages)
+  //  are written there by the receiver on delivery, or directly by the
+  //  sender if the address lies in a window the target has exported (or
+  //  that was registered with add_alias)
+  class ShmTransport {
+  public:
+    static const size_t MAX_ARG_BYTES = 64;
+
+    // 'key' must be the same on every rank of a job and unique among jobs
+    //  running on the same host at the same time
+    ShmTransport(const std::string& _key, int _my_rank, int _num_ranks,
+		 size_t _ring_slots, size_t _arena_bytes);
+    ~ShmTransport(void);
+
+    // creates this rank's segment - every rank must do this before any
+    //  rank calls attach_peers
+    bool create_segment(void);
+
+    // maps the segments of any other ranks that created one (waiting up to
+    //  'timeout' seconds for each), returning the number found
+    int attach_peers(double timeout = 0);
+
+    // removes the names of this rank's segment and windows - mappings stay
+    //  valid, but nobody new can attach, and nothing is left behind if the
+    //  process dies
+    void unlink_names(void);
+
+    bool is_colocated(int rank) const;
+
+    // a region of memory that co-located peers can map - a remote write
+    //  into a window becomes a direct memcpy by the sender
+    void *export_window(size_t bytes);
+
+    // tells the transport that 'bytes' at 'remote_base' in the address
+    //  space of 'rank' are also mapped at 'local_base' in ours
+    void add_alias(int rank, const void *remote_base, void *local_base,
+		   size_t bytes);
+
+    // returns our address for [remote_ptr, remote_ptr + bytes) in 'rank', or
+    //  0 if it's not mapped here
+    void *translate(int rank, const void *remote_ptr, size_t bytes);
+
+    // sends a message whose payload is the concatenation of 'payload' (and
+    //  has to have one if 'has_payload' is set, even if it's empty)
+    // returns false without sending anything if the target's ring or our
+    //  arena for it is full - the caller should let the target make
+    //  progress and try again (or use another path)
+    // a payload bigger than max_block_bytes() must have a destination
+    //  pointer - unless the sender can write it there directly, it is sent
+    //  in pieces ahead of the message, and once the first piece is out, the
+    //  call waits for room for the rest, calling 'progress' (if given)
+    //  while it does
+    bool send(int target, int msgid, const void *args, size_t arglen,
+	      const SpanList& payload, size_t payload_len, bool has_payload,
+	      void *dstptr = 0, void (*progress)(void) = 0);
+
+    // the largest payload that's sent in one piece through the arena
+    size_t max_block_bytes(void) const { return arena_bytes / 4; }
+
+    class MessageHandler {
+    public:
+      virtual ~MessageHandler(void) {}
+
+      // 'payload' is either the message's destination pointer or a block
+      //  in the sender's arena, which must be returned with release_payload
+      //  once the handler is done with it
+      virtual void handle_message(int sender, int msgid,
+				  const void *args, size_t arglen,
+				  void *payload, size_t payload_len,
+				  bool has_payload) = 0;
+    };
+
+    // delivers up to 'max_messages' (0 = all) waiting messages from each
+    //  peer - returns the number delivered
+    int poll(MessageHandler *handler, int max_messages = 0);
+
+    // returns false if 'payload' isn't in a payload block from 'sender'
+    bool release_payload(int sender, const void *payload);
+
+    // counts of messages and payload bytes sent, and how many sends found
+    //  a full ring or arena
+    uint64_t messages_sent, bytes_sent, sends_stalled;
+
+  protected:
+    struct SegmentHeader;
+    struct RingHeader;
+    struct MessageSlot;
+    struct BlockHeader;
+
+    struct Window {
+      uintptr_t remote_base;
+      char *local_base;
+      size_t bytes;
+    };
+
+    struct Peer {
+      Peer(void);
+
+      // the peer's segment, or 0 if it's not co-located
+      char *segment;
+      size_t segment_size;
+      int windows_mapped;
+      std::vector<Window> windows;
+      // sender-side state for our ring in their segment and our arena for
+      //  them
+      GASNetHSL send_mutex;
+      uint64_t arena_alloc, arena_reclaim;
+      // set while somebody is draining their ring in our segment - other
+      //  pollers (including a handler that polls) skip the peer rather than
+      //  wait, which also keeps fragments ahead of the message they're for
+      volatile int recv_busy;
+    };
+
+    std::string segment_name(int rank, int window = -1) const;
+    size_t ring_bytes(void) const;
+    RingHeader *inbound_ring(char *base, int sender) const;
+    char *outbound_arena(char *base, int target) const;
+    // these require the peer's send_mutex
+    void *find_alias(int rank, Peer& p, const void *remote_ptr, size_t bytes);
+    bool alloc_block(int target, Peer& p, size_t bytes, uint64_t& offset);
+    bool push_message(int target, int msgid, unsigned flags,
+		      const void *args, size_t arglen,
+		      const SpanList& payload, size_t offset, size_t bytes,
+		      size_t payload_len, void *dstptr);
+
+    std::string key;
+    int my_rank, num_ranks;
+    size_t ring_slots, arena_bytes;
+    size_t segment_size;
+    char *segment;
+    std::vector<Peer *> peers;
+    GASNetHSL window_mutex;
+    int windows_exported;
+  };
+
+}; // namespace Realm
+
+#endif // ifndef REALM_SHM_TRANSPORT_H
@@ -24,12 +24,17 @@
 #define REALM_SPARSITY_H
 
 #include "realm/indexspace.h"
+#include "realm/rtree.h"
+
+#include <stdint.h>
+#include <vector>
 
 namespace Realm {
 
   template <int N, typename T /*= int*/> struct Point;
   template <int N, typename T /*= int*/> struct Rect;
   template <int N, typename T = int> class HierarchicalBitMap;
+  template <int N, typename T, typename LT> class PackedRTree;
 
   // a SparsityMap is a Realm handle to sparsity data for one or more index spaces - all
   //  SparsityMap's use the same ID namespace (i.e. regardless of N and T), but the
@@ -86,6 +91,78 @@ namespace Realm {
     HierarchicalBitMap<N,T> *bitmap;
   };
 
+  // a HierarchicalBitMap is a dense array of bits, one per point in its bounds
+  //  (linearized with the first dimension varying fastest), plus summary levels
+  //  in which each bit says whether a word of the level below might have any
+  //  bits set - searches use these to skip over empty regions, so a bitmap
+  //  with scattered points can be iterated without touching every word
+  // a clear summary bit always means an empty word below, but a set one may be
+  //  stale after bits are cleared (until rebuild_summary is called)
+  template <int N, typename T>
+  class HierarchicalBitMap {
+  public:
+    static const size_t NOT_FOUND = ~size_t(0);
+
+    HierarchicalBitMap(const Rect<N,T>& _bounds);
+
+    const Rect<N,T>& get_bounds(void) const;
+
+    bool is_set(const Point<N,T>& p) const;
+    void set_point(const Point<N,T>& p);
+    // 'r' is clipped to the bounds
+    void set_rect(const Rect<N,T>& r);
+    void clear_rect(const Rect<N,T>& r);
+
+    // set operations with another bitmap (whose bounds may differ from ours),
+    //  looking only at the points of 'other' within 'within' - for
+    //  intersection, everything of ours outside 'within' is cleared as well
+    void union_with(const HierarchicalBitMap<N,T>& other, const Rect<N,T>& within);
+    void intersect_with(const HierarchicalBitMap<N,T>& other, const Rect<N,T>& within);
+    void subtract(const HierarchicalBitMap<N,T>& other, const Rect<N,T>& within);
+
+    size_t count(void) const;
+    // how many rectangles a rectangle list would need (approximately - runs
+    //  that wrap from one line to the next are counted once)
+    size_t count_runs(void) const;
+    size_t bytes_used(void) const;
+
+    // finds the next maximal run of set points along the first dimension that
+    //  lies within 'within' at or after linear position 'pos', and advances
+    //  'pos' past it - returns false if there are no more
+    bool next_run(const Rect<N,T>& within, size_t& pos, Rect<N,T>& run) const;
+
+    // brings the summary levels back to exact after bits have been cleared
+    void rebuild_summary(void);
+
+    size_t linearize(const Point<N,T>& p) const;
+    Point<N,T> delinearize(size_t idx) const;
+
+  protected:
+    enum BitOp { OP_OR, OP_AND, OP_ANDNOT };
+
+    // level -1 is the bits themselves, 0 and up are summary levels
+    size_t find_next_set(int level, size_t pos) const;
+    size_t find_next_clear(size_t pos, size_t limit) const;
+    void mark_word(size_t word);
+    void set_bits(size_t start, size_t count);
+    void clear_bits(size_t start, size_t count);
+    void read_bits(size_t start, size_t count, uint64_t *dst) const;
+    void combine_bits(size_t start, size_t count, const uint64_t *src, BitOp op);
+    // steps 'p' to the start of the next line (i.e. dim 0 = r.lo[0]) in 'r'
+    static bool next_line(const Rect<N,T>& r, Point<N,T>& p);
+    // moves 'p' to the first point at or after it (in linear order) that's
+    //  in 'r', returning false if there isn't one
+    static bool advance_into(const Rect<N,T>& r, Point<N,T>& p);
+
+    Rect<N,T> bounds;
+    size_t strides[N];
+    size_t num_bits;
+    std::vector<uint64_t> bits;
+    // summary[0] has a bit per word of 'bits', summary[1] a bit per word of
+    //  summary[0], and so on up to a single word
+    std::vector<std::vector<uint64_t> > summary;
+  };
+
   template <int N, typename T>
   class SparsityMapPublicImpl {
   protected:
@@ -112,10 +189,19 @@ namespace Realm {
 
     const std::vector<Rect<N,T> >& get_approx_rects(void);
 
+    // a multi-dimensional sparsity map with many entries also has a spatial index
+    //  over them (labeled with each entry's position in the list) that is built the
+    //  first time it's asked for - this returns null for maps that don't need one, in
+    //  which case searching the entry list directly is at least as fast
+    static const size_t MIN_INDEXED_ENTRIES = 32;
+
+    const PackedRTree<N,T,size_t> *get_entry_index(void);
+
   protected:
     bool entries_valid, approx_valid;
     std::vector<SparsityMapEntry<N,T> > entries;
     std::vector<Rect<N,T> > approx_rects;
+    PackedRTree<N,T,size_t> * volatile entry_index;
   };
 
 }; // namespace Realm
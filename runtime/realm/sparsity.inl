@@ -20,6 +20,8 @@
 
 #include "realm/serialize.h"
 
+#include <assert.h>
+
 TEMPLATE_TYPE_IS_SERIALIZABLE2(int N, typename T, Realm::SparsityMap<N,T>);
 
 namespace Realm {
@@ -83,6 +85,458 @@ namespace Realm {
     return approx_rects;
   }
 
+  template <int N, typename T>
+  inline const PackedRTree<N,T,size_t> *SparsityMapPublicImpl<N,T>::get_entry_index(void)
+  {
+    // 1-D maps are kept sorted and searched with a bsearch instead
+    if(N == 1)
+      return 0;
+
+    PackedRTree<N,T,size_t> *index = entry_index;
+    if(index != 0)
+      return index;
+
+    const std::vector<SparsityMapEntry<N,T> >& e = get_entries();
+    if(e.size() < MIN_INDEXED_ENTRIES)
+      return 0;
+
+    // the entries never change once valid, so if two threads race to build the
+    //  index, either copy is fine - the loser just throws its own away
+    index = new PackedRTree<N,T,size_t>;
+    for(size_t i = 0; i < e.size(); i++)
+      index->add_rect(e[i].bounds, i);
+    index->construct_tree();
+    if(!__sync_bool_compare_and_swap(&entry_index, (PackedRTree<N,T,size_t> *)0, index)) {
+      delete index;
+      index = entry_index;
+    }
+    return index;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class HierarchicalBitMap<N,T>
+
+  template <int N, typename T>
+  inline HierarchicalBitMap<N,T>::HierarchicalBitMap(const Rect<N,T>& _bounds)
+    : bounds(_bounds)
+  {
+    num_bits = 1;
+    for(int i = 0; i < N; i++) {
+      strides[i] = num_bits;
+      if(bounds.hi[i] < bounds.lo[i]) {
+	num_bits = 0;
+	break;
+      }
+      num_bits *= size_t(bounds.hi[i] - bounds.lo[i]) + 1;
+    }
+    bits.resize((num_bits + 63) >> 6, 0);
+    size_t words = bits.size();
+    while(words > 1) {
+      words = (words + 63) >> 6;
+      summary.push_back(std::vector<uint64_t>(words, 0));
+    }
+  }
+
+  template <int N, typename T>
+  inline const Rect<N,T>& HierarchicalBitMap<N,T>::get_bounds(void) const
+  {
+    return bounds;
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::linearize(const Point<N,T>& p) const
+  {
+    size_t idx = 0;
+    for(int i = 0; i < N; i++)
+      idx += size_t(p[i] - bounds.lo[i]) * strides[i];
+    return idx;
+  }
+
+  template <int N, typename T>
+  inline Point<N,T> HierarchicalBitMap<N,T>::delinearize(size_t idx) const
+  {
+    Point<N,T> p;
+    for(int i = N - 1; i >= 0; i--) {
+      p[i] = bounds.lo[i] + T(idx / strides[i]);
+      idx = idx % strides[i];
+    }
+    return p;
+  }
+
+  template <int N, typename T>
+  inline bool HierarchicalBitMap<N,T>::is_set(const Point<N,T>& p) const
+  {
+    if(!bounds.contains(p))
+      return false;
+    size_t idx = linearize(p);
+    return ((bits[idx >> 6] >> (idx & 63)) & 1) != 0;
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::set_point(const Point<N,T>& p)
+  {
+    assert(bounds.contains(p));
+    size_t idx = linearize(p);
+    bits[idx >> 6] |= uint64_t(1) << (idx & 63);
+    mark_word(idx >> 6);
+  }
+
+  template <int N, typename T>
+  /*static*/ inline bool HierarchicalBitMap<N,T>::next_line(const Rect<N,T>& r,
+							    Point<N,T>& p)
+  {
+    p[0] = r.lo[0];
+    for(int i = 1; i < N; i++) {
+      if(p[i] < r.hi[i]) {
+	p[i]++;
+	return true;
+      }
+      p[i] = r.lo[i];
+    }
+    return false;
+  }
+
+  template <int N, typename T>
+  /*static*/ inline bool HierarchicalBitMap<N,T>::advance_into(const Rect<N,T>& r,
+							       Point<N,T>& p)
+  {
+    // work down from the most significant dimension
+    for(int i = N - 1; i >= 0; i--) {
+      if(p[i] < r.lo[i]) {
+	for(int j = i; j >= 0; j--)
+	  p[j] = r.lo[j];
+	return true;
+      }
+      if(p[i] > r.hi[i]) {
+	// everything at this level is past the rect - carry into the next one up
+	for(int j = i; j >= 0; j--)
+	  p[j] = r.lo[j];
+	for(int j = i + 1; j < N; j++) {
+	  if(p[j] < r.hi[j]) {
+	    p[j]++;
+	    return true;
+	  }
+	  p[j] = r.lo[j];
+	}
+	return false;
+      }
+    }
+    return true;
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::set_rect(const Rect<N,T>& r)
+  {
+    Rect<N,T> clip = r.intersection(bounds);
+    if(clip.empty()) return;
+    size_t len = size_t(clip.hi[0] - clip.lo[0]) + 1;
+    Point<N,T> p = clip.lo;
+    do {
+      set_bits(linearize(p), len);
+    } while(next_line(clip, p));
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::clear_rect(const Rect<N,T>& r)
+  {
+    Rect<N,T> clip = r.intersection(bounds);
+    if(clip.empty()) return;
+    size_t len = size_t(clip.hi[0] - clip.lo[0]) + 1;
+    Point<N,T> p = clip.lo;
+    do {
+      clear_bits(linearize(p), len);
+    } while(next_line(clip, p));
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::union_with(const HierarchicalBitMap<N,T>& other,
+						  const Rect<N,T>& within)
+  {
+    Rect<N,T> clip = within.intersection(bounds).intersection(other.bounds);
+    if(clip.empty()) return;
+    size_t len = size_t(clip.hi[0] - clip.lo[0]) + 1;
+    std::vector<uint64_t> buffer((len + 63) >> 6);
+    Point<N,T> p = clip.lo;
+    do {
+      other.read_bits(other.linearize(p), len, &buffer[0]);
+      combine_bits(linearize(p), len, &buffer[0], OP_OR);
+    } while(next_line(clip, p));
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::intersect_with(const HierarchicalBitMap<N,T>& other,
+						      const Rect<N,T>& within)
+  {
+    // build the result separately so that everything outside the overlap
+    //  is dropped and the summary comes out exact
+    HierarchicalBitMap<N,T> result(bounds);
+    Rect<N,T> clip = within.intersection(bounds).intersection(other.bounds);
+    if(!clip.empty()) {
+      size_t len = size_t(clip.hi[0] - clip.lo[0]) + 1;
+      size_t words = (len + 63) >> 6;
+      std::vector<uint64_t> mine(words), theirs(words);
+      Point<N,T> p = clip.lo;
+      do {
+	size_t idx = linearize(p);
+	read_bits(idx, len, &mine[0]);
+	other.read_bits(other.linearize(p), len, &theirs[0]);
+	for(size_t i = 0; i < words; i++)
+	  mine[i] &= theirs[i];
+	result.combine_bits(idx, len, &mine[0], OP_OR);
+      } while(next_line(clip, p));
+    }
+    bits.swap(result.bits);
+    summary.swap(result.summary);
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::subtract(const HierarchicalBitMap<N,T>& other,
+						const Rect<N,T>& within)
+  {
+    Rect<N,T> clip = within.intersection(bounds).intersection(other.bounds);
+    if(clip.empty()) return;
+    size_t len = size_t(clip.hi[0] - clip.lo[0]) + 1;
+    std::vector<uint64_t> buffer((len + 63) >> 6);
+    Point<N,T> p = clip.lo;
+    do {
+      other.read_bits(other.linearize(p), len, &buffer[0]);
+      combine_bits(linearize(p), len, &buffer[0], OP_ANDNOT);
+    } while(next_line(clip, p));
+    rebuild_summary();
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::count(void) const
+  {
+    size_t total = 0;
+    for(size_t i = 0; i < bits.size(); i++)
+      if(bits[i])
+	total += __builtin_popcountll(bits[i]);
+    return total;
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::count_runs(void) const
+  {
+    // a run starts at every set bit whose predecessor is clear
+    size_t runs = 0;
+    uint64_t carry = 0;
+    for(size_t i = 0; i < bits.size(); i++) {
+      uint64_t w = bits[i];
+      if(w)
+	runs += __builtin_popcountll(w & ~((w << 1) | carry));
+      carry = w >> 63;
+    }
+    return runs;
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::bytes_used(void) const
+  {
+    size_t words = bits.size();
+    for(size_t i = 0; i < summary.size(); i++)
+      words += summary[i].size();
+    return sizeof(*this) + (words * sizeof(uint64_t));
+  }
+
+  template <int N, typename T>
+  inline bool HierarchicalBitMap<N,T>::next_run(const Rect<N,T>& within,
+						size_t& pos, Rect<N,T>& run) const
+  {
+    Rect<N,T> clip = within.intersection(bounds);
+    if(clip.empty()) {
+      pos = num_bits;
+      return false;
+    }
+    // nothing before the first point of 'within' is interesting
+    size_t first = linearize(clip.lo);
+    if(pos < first)
+      pos = first;
+    while(pos < num_bits) {
+      size_t idx = find_next_set(-1, pos);
+      if(idx == NOT_FOUND)
+	break;
+      Point<N,T> p = delinearize(idx);
+      if(!clip.contains(p)) {
+	// skip ahead to the next point that's in 'within'
+	if(!advance_into(clip, p))
+	  break;
+	pos = linearize(p);
+	continue;
+      }
+      // extend the run to the first clear bit or the end of the line
+      size_t limit = idx + size_t(clip.hi[0] - p[0]) + 1;
+      size_t end = find_next_clear(idx + 1, limit);
+      run.lo = p;
+      run.hi = p;
+      run.hi[0] = p[0] + T(end - idx - 1);
+      pos = end;
+      return true;
+    }
+    pos = num_bits;
+    return false;
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::rebuild_summary(void)
+  {
+    const std::vector<uint64_t> *below = &bits;
+    for(size_t l = 0; l < summary.size(); l++) {
+      std::vector<uint64_t>& level = summary[l];
+      level.assign(level.size(), 0);
+      for(size_t i = 0; i < below->size(); i++)
+	if((*below)[i])
+	  level[i >> 6] |= uint64_t(1) << (i & 63);
+      below = &level;
+    }
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::find_next_set(int level, size_t pos) const
+  {
+    const std::vector<uint64_t>& words = ((level < 0) ? bits : summary[level]);
+    size_t word = pos >> 6;
+    if(word >= words.size())
+      return NOT_FOUND;
+    uint64_t mask = words[word] & (~uint64_t(0) << (pos & 63));
+    while(!mask) {
+      // ask the level above for the next word that might have something in it
+      if((level + 1) < (int)summary.size()) {
+	word = find_next_set(level + 1, word + 1);
+	if(word == NOT_FOUND)
+	  return NOT_FOUND;
+      } else {
+	if(++word >= words.size())
+	  return NOT_FOUND;
+      }
+      mask = words[word];
+    }
+    return (word << 6) + __builtin_ctzll(mask);
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::find_next_clear(size_t pos, size_t limit) const
+  {
+    while(pos < limit) {
+      size_t word = pos >> 6;
+      uint64_t mask = ~bits[word] & (~uint64_t(0) << (pos & 63));
+      if(mask) {
+	size_t idx = (word << 6) + __builtin_ctzll(mask);
+	return ((idx < limit) ? idx : limit);
+      }
+      pos = (word + 1) << 6;
+    }
+    return limit;
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::mark_word(size_t word)
+  {
+    for(size_t l = 0; l < summary.size(); l++) {
+      uint64_t bit = uint64_t(1) << (word & 63);
+      word >>= 6;
+      // a bit that's already set has all its ancestors set too
+      if(summary[l][word] & bit)
+	return;
+      summary[l][word] |= bit;
+    }
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::set_bits(size_t start, size_t count)
+  {
+    while(count > 0) {
+      size_t word = start >> 6;
+      size_t shift = start & 63;
+      size_t n = 64 - shift;
+      if(n > count) n = count;
+      uint64_t mask = ((n == 64) ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << shift;
+      bits[word] |= mask;
+      mark_word(word);
+      start += n;
+      count -= n;
+    }
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::clear_bits(size_t start, size_t count)
+  {
+    while(count > 0) {
+      size_t word = start >> 6;
+      size_t shift = start & 63;
+      size_t n = 64 - shift;
+      if(n > count) n = count;
+      uint64_t mask = ((n == 64) ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << shift;
+      bits[word] &= ~mask;
+      start += n;
+      count -= n;
+    }
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::read_bits(size_t start, size_t count,
+						 uint64_t *dst) const
+  {
+    size_t word = start >> 6;
+    size_t shift = start & 63;
+    size_t out_words = (count + 63) >> 6;
+    for(size_t i = 0; i < out_words; i++) {
+      uint64_t v = bits[word + i];
+      if(shift) {
+	v >>= shift;
+	if((word + i + 1) < bits.size())
+	  v |= bits[word + i + 1] << (64 - shift);
+      }
+      dst[i] = v;
+    }
+    if(count & 63)
+      dst[out_words - 1] &= (uint64_t(1) << (count & 63)) - 1;
+  }
+
+  template <int N, typename T>
+  inline void HierarchicalBitMap<N,T>::combine_bits(size_t start, size_t count,
+						    const uint64_t *src, BitOp op)
+  {
+    for(size_t i = 0; (i << 6) < count; i++) {
+      size_t n = count - (i << 6);
+      if(n > 64) n = 64;
+      uint64_t nmask = ((n == 64) ? ~uint64_t(0) : ((uint64_t(1) << n) - 1));
+      uint64_t v = src[i] & nmask;
+      size_t pos = start + (i << 6);
+      size_t word = pos >> 6;
+      size_t shift = pos & 63;
+      // the source word can straddle two destination words
+      for(int part = 0; part < 2; part++) {
+	uint64_t m, x;
+	if(part == 0) {
+	  m = nmask << shift;
+	  x = v << shift;
+	} else {
+	  if(!shift || ((shift + n) <= 64)) break;
+	  word++;
+	  m = nmask >> (64 - shift);
+	  x = v >> (64 - shift);
+	}
+	switch(op) {
+	case OP_OR:
+	  if(x) {
+	    bits[word] |= x;
+	    mark_word(word);
+	  }
+	  break;
+	case OP_AND:
+	  bits[word] &= (x | ~m);
+	  break;
+	case OP_ANDNOT:
+	  bits[word] &= ~x;
+	  break;
+	}
+      }
+    }
+  }
+
 
 }; // namespace Realm
 
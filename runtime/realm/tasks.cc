@@ -19,25 +19,252 @@
 
 #include "realm/runtime_impl.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
 namespace Realm {
 
   Logger log_task("task");
   Logger log_sched("sched");
 
+  namespace Config {
+    bool task_stealing = false;
+  };
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // TaskAllocator
+  //
+
+  // every Task is the same size, so they're carved out of slabs and kept
+  //  in per-thread free lists - a processor's tasks are usually freed by
+  //  its own workers, so this acts like a per-processor pool, and a thread
+  //  that runs dry (e.g. one that spawns a lot) or collects too many
+  //  trades a batch with a shared free list instead of going to malloc
+  // a thread's cache goes back to the shared list when the thread exits,
+  //  but slabs are never given back
+  namespace TaskAllocator {
+
+    struct FreeBlock {
+      FreeBlock *next;
+    };
+
+    static const int SLAB_BLOCKS = 64;
+    static const int BATCH_BLOCKS = 32;
+    static const int CACHE_MAX = 2 * BATCH_BLOCKS;
+    // allocations are counted locally and added to the gauge in batches
+    static const int COUNT_BATCH = 64;
+
+    static GASNetHSL shared_mutex;
+    static FreeBlock *shared_free = 0;
+    static int shared_count = 0;
+
+    static __thread FreeBlock *cache = 0;
+    static __thread int cache_size = 0;
+    static __thread int uncounted_allocs = 0;
+    static __thread bool exit_hook_set = false;
+
+    static ProfilingGauges::EventCounter<long long> *allocations = 0;
+    static ProfilingGauges::EventCounter<long long> *slabs = 0;
+    static ProfilingGauges::EventCounter<long long> *heap_args = 0;
+
+    // the only point of this key is its destructor, which runs at thread
+    //  exit for any thread that has given it a non-null value
+    static pthread_key_t exit_key;
+    static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+
+    static void flush_cache(void *)
+    {
+      if(cache) {
+	FreeBlock *tail = cache;
+	while(tail->next)
+	  tail = tail->next;
+
+	AutoHSLLock al(shared_mutex);
+	tail->next = shared_free;
+	shared_free = cache;
+	shared_count += cache_size;
+      }
+      cache = 0;
+      cache_size = 0;
+
+      if(uncounted_allocs > 0) {
+	if(allocations)
+	  (*allocations) += uncounted_allocs;
+	uncounted_allocs = 0;
+      }
+    }
+
+    static void create_exit_key(void)
+    {
+#ifndef NDEBUG
+      int ret =
+#endif
+	pthread_key_create(&exit_key, flush_cache);
+      assert(ret == 0);
+    }
+
+    static void set_exit_hook(void)
+    {
+      pthread_once(&exit_key_once, create_exit_key);
+      pthread_setspecific(exit_key, &exit_key);
+      exit_hook_set = true;
+    }
+
+    // takes a batch from the shared list, or a new slab if that's empty
+    static void refill_cache(void)
+    {
+      {
+	AutoHSLLock al(shared_mutex);
+	if(shared_free) {
+	  while(shared_free && (cache_size < BATCH_BLOCKS)) {
+	    FreeBlock *b = shared_free;
+	    shared_free = b->next;
+	    shared_count--;
+	    b->next = cache;
+	    cache = b;
+	    cache_size++;
+	  }
+	  return;
+	}
+      }
+
+      char *slab = (char *)malloc(SLAB_BLOCKS * sizeof(Task));
+      assert(slab != 0);
+      for(int i = SLAB_BLOCKS - 1; i >= 0; i--) {
+	FreeBlock *b = (FreeBlock *)(slab + (i * sizeof(Task)));
+	b->next = cache;
+	cache = b;
+	cache_size++;
+      }
+      if(slabs)
+	(*slabs) += 1;
+    }
+
+    // gives the oldest blocks in our cache back to the shared list
+    static void spill_cache(void)
+    {
+      FreeBlock *keep_tail = cache;
+      for(int i = 1; i < (cache_size - BATCH_BLOCKS); i++)
+	keep_tail = keep_tail->next;
+      FreeBlock *spill_head = keep_tail->next;
+      FreeBlock *spill_tail = spill_head;
+      while(spill_tail->next)
+	spill_tail = spill_tail->next;
+      keep_tail->next = 0;
+      int spilled = BATCH_BLOCKS;
+      cache_size -= spilled;
+
+      AutoHSLLock al(shared_mutex);
+      spill_tail->next = shared_free;
+      shared_free = spill_head;
+      shared_count += spilled;
+    }
+
+    static void *alloc_block(void)
+    {
+      if(!exit_hook_set)
+	set_exit_hook();
+      if(!cache)
+	refill_cache();
+      FreeBlock *b = cache;
+      cache = b->next;
+      cache_size--;
+
+      if(++uncounted_allocs >= COUNT_BATCH) {
+	if(allocations)
+	  (*allocations) += uncounted_allocs;
+	uncounted_allocs = 0;
+      }
+      return b;
+    }
+
+    static void free_block(void *ptr)
+    {
+      if(!exit_hook_set)
+	set_exit_hook();
+      FreeBlock *b = (FreeBlock *)ptr;
+      b->next = cache;
+      cache = b;
+      cache_size++;
+      if(cache_size > CACHE_MAX)
+	spill_cache();
+    }
+
+    void count_heap_args(void)
+    {
+      if(heap_args)
+	(*heap_args) += 1;
+    }
+
+  };
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class Task
   //
 
+  /*static*/ void *Task::operator new(size_t bytes)
+  {
+    // anything bigger than a Task (i.e. a subclass) uses the heap
+    if(bytes != sizeof(Task))
+      return ::operator new(bytes);
+    return TaskAllocator::alloc_block();
+  }
+
+  /*static*/ void Task::operator delete(void *ptr, size_t bytes)
+  {
+    if(bytes != sizeof(Task)) {
+      ::operator delete(ptr);
+      return;
+    }
+    TaskAllocator::free_block(ptr);
+  }
+
+  /*static*/ void Task::create_pool_gauges(void)
+  {
+    TaskAllocator::allocations = new ProfilingGauges::EventCounter<long long>("realm/tasks/allocations");
+    TaskAllocator::slabs = new ProfilingGauges::EventCounter<long long>("realm/tasks/slabs");
+    TaskAllocator::heap_args = new ProfilingGauges::EventCounter<long long>("realm/tasks/heap args");
+  }
+
+  /*static*/ void Task::destroy_pool_gauges(void)
+  {
+    // the pointers are cleared before anything is deleted, but the caller
+    //  still has to make sure no thread is in the middle of an update
+    ProfilingGauges::EventCounter<long long> *allocations = TaskAllocator::allocations;
+    ProfilingGauges::EventCounter<long long> *slabs = TaskAllocator::slabs;
+    ProfilingGauges::EventCounter<long long> *heap_args = TaskAllocator::heap_args;
+    TaskAllocator::allocations = 0;
+    TaskAllocator::slabs = 0;
+    TaskAllocator::heap_args = 0;
+    __sync_synchronize();
+    delete allocations;
+    delete slabs;
+    delete heap_args;
+  }
+
   Task::Task(Processor _proc, Processor::TaskFuncID _func_id,
 	     const void *_args, size_t _arglen,
 	     const ProfilingRequestSet &reqs,
 	     Event _before_event,
 	     Event _finish_event, int _priority)
     : Operation(_finish_event, reqs), proc(_proc), func_id(_func_id),
-      args(_args, _arglen), before_event(_before_event), priority(_priority),
-      executing_thread(0)
+      before_event(_before_event), priority(_priority),
+      next_ready(0), executing_thread(0)
   {
+    if(_arglen <= INLINE_ARG_BYTES) {
+      if(_arglen > 0)
+	memcpy(inline_args.bytes, _args, _arglen);
+      args.changeref(inline_args.bytes, _arglen);
+    } else {
+      heap_args.set(_args, _arglen);
+      args.changeref(heap_args.base(), _arglen);
+      TaskAllocator::count_heap_args();
+    }
+
     log_task.info() << "task " << (void *)this << " created: func=" << func_id
 		    << " proc=" << _proc << " arglen=" << _arglen
 		    << " before=" << _before_event << " after=" << _finish_event;
@@ -198,111 +425,244 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class StealableTaskQueue
+  //
+
+  StealableTaskQueue::StealableTaskQueue(ThreadedTaskScheduler *_owner)
+    : owner(_owner), inbox(0), num_bands(0), entries_in_queue(0)
+  {}
+
+  StealableTaskQueue::~StealableTaskQueue(void)
+  {
+    for(int i = 0; i < num_bands; i++)
+      delete bands[i].deque;
+  }
+
+  void StealableTaskQueue::set_gauge(ProfilingGauges::AbsoluteRangeGauge<int> *new_gauge)
+  {
+    entries_in_queue = new_gauge;
+  }
+
+  void StealableTaskQueue::put(Task *task)
+  {
+    if(entries_in_queue)
+      (*entries_in_queue) += 1;
+
+    Task *old_head;
+    do {
+      old_head = inbox;
+      task->next_ready = old_head;
+    } while(!__sync_bool_compare_and_swap(&inbox, old_head, task));
+
+    // if the inbox wasn't empty, whoever made it non-empty has already
+    //  woken everybody up, and nobody has emptied it since
+    if(!old_head)
+      notify_schedulers();
+  }
+
+  void StealableTaskQueue::notify_schedulers(void)
+  {
+    owner->work_counter.increment_counter();
+    for(std::vector<StealableTaskQueue *>::const_iterator it = peers.begin();
+	it != peers.end();
+	++it)
+      (*it)->owner->work_counter.increment_counter();
+  }
+
+  void StealableTaskQueue::move_to_deques(Task *list)
+  {
+    // the inbox is newest-first
+    Task *oldest_first = 0;
+    while(list) {
+      Task *next = list->next_ready;
+      list->next_ready = oldest_first;
+      oldest_first = list;
+      list = next;
+    }
+
+    while(oldest_first) {
+      Task *task = oldest_first;
+      oldest_first = task->next_ready;
+      task->next_ready = 0;
+
+      // same clamping as PriorityQueue
+      priority_t priority = task->priority;
+      if(priority > overflow.PRI_MAX_FINITE)
+	priority = overflow.PRI_MAX_FINITE;
+      else if(priority < overflow.PRI_MIN_FINITE)
+	priority = overflow.PRI_MIN_FINITE;
+
+      int band = 0;
+      while((band < num_bands) && (bands[band].priority != priority))
+	band++;
+      if(band == num_bands) {
+	if(band == MAX_BANDS) {
+	  overflow.put(task, priority);
+	  continue;
+	}
+	// peers read num_bands without our lock, so the band has to be set
+	//  up before it's counted
+	bands[band].priority = priority;
+	bands[band].deque = new WorkStealingDeque<Task *>;
+	__sync_synchronize();
+	num_bands = band + 1;
+      }
+      bands[band].deque->push(task);
+    }
+  }
+
+  StealableTaskQueue::priority_t StealableTaskQueue::refresh(void)
+  {
+    Task *list;
+    do {
+      list = inbox;
+    } while(list && !__sync_bool_compare_and_swap(&inbox, list, (Task *)0));
+    if(list)
+      move_to_deques(list);
+
+    priority_t highest = overflow.PRI_NEG_INF;
+    overflow.peek(&highest);
+    for(int i = 0; i < num_bands; i++)
+      if((bands[i].priority > highest) && !bands[i].deque->empty())
+	highest = bands[i].priority;
+    return highest;
+  }
+
+  Task *StealableTaskQueue::get(priority_t *task_priority, priority_t higher_than)
+  {
+    while(true) {
+      priority_t highest = refresh();
+      if(highest <= higher_than)
+	return 0;
+
+      priority_t overflow_priority = overflow.PRI_NEG_INF;
+      if(overflow.peek(&overflow_priority) && (overflow_priority == highest)) {
+	Task *task = overflow.get(0);
+	if(entries_in_queue)
+	  (*entries_in_queue) -= 1;
+	*task_priority = highest;
+	return task;
+      }
+
+      // a peer may have stolen it since we looked - if so, try again
+      Task *task = steal(highest);
+      if(task) {
+	*task_priority = highest;
+	return task;
+      }
+    }
+  }
+
+  StealableTaskQueue::priority_t StealableTaskQueue::scan_victim(StealableTaskQueue *victim)
+  {
+    // a busy victim won't have gotten to its inbox, so we take it (the
+    //  tasks are for the same group, so they can run here just as well)
+    if(victim->inbox) {
+      Task *list;
+      do {
+	list = victim->inbox;
+      } while(list && !__sync_bool_compare_and_swap(&victim->inbox, list, (Task *)0));
+      if(list)
+	move_to_deques(list);
+    }
+
+    priority_t highest = overflow.PRI_NEG_INF;
+    int count = victim->num_bands;
+    __sync_synchronize();
+    for(int i = 0; i < count; i++)
+      if((victim->bands[i].priority > highest) && !victim->bands[i].deque->empty())
+	highest = victim->bands[i].priority;
+    return highest;
+  }
+
+  Task *StealableTaskQueue::steal(priority_t priority)
+  {
+    int count = num_bands;
+    __sync_synchronize();
+    for(int i = 0; i < count; i++)
+      if(bands[i].priority == priority) {
+	Task *task;
+	if(!bands[i].deque->steal(task))
+	  return 0;
+	if(entries_in_queue)
+	  (*entries_in_queue) -= 1;
+	return task;
+      }
+    return 0;
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class ThreadedTaskScheduler::WorkCounter
   //
 
   ThreadedTaskScheduler::WorkCounter::WorkCounter(void)
-    : counter(0), wait_value(-1), condvar(mutex)
+    : counter(0), num_waiters(0), wake_seq(0), spin_count(0), park_count(0)
   {}
 
   ThreadedTaskScheduler::WorkCounter::~WorkCounter(void)
   {}
 
+  void ThreadedTaskScheduler::WorkCounter::set_gauges(ProfilingGauges::EventCounter<long long> *_spin_count,
+						      ProfilingGauges::EventCounter<long long> *_park_count)
+  {
+    spin_count = _spin_count;
+    park_count = _park_count;
+  }
+
   void ThreadedTaskScheduler::WorkCounter::increment_counter(void)
   {
     // common case is that we'll bump the counter and nobody cares, so do this without a lock
     // use __sync_* though to make sure memory ordering is preserved
-    long long old_value = __sync_fetch_and_add(&counter, 1);
-    long long wv_snapshot = __sync_fetch_and_add(&wait_value, 0);
+    __sync_fetch_and_add(&counter, 1);
 
-//define DEBUG_WORK_COUNTER
-#ifdef DEBUG_WORK_COUNTER
-    printf("WC(%p) increment %lld (%lld)\n", this, old_value, wv_snapshot);
-#endif
-
-    // if the wait value snapshot does not equal the old value, there are no waiters, and
-    //  there can be no new waiters, because they will retest the counter after setting the
-    //  wait value and must (due to __sync_* usage) observe our update of the counter, so
-    //  we're done
-    if(old_value != wv_snapshot) return;
-
-    // if there are waiters, broadcast to wake them all up
-    // because of the race condition with pthreads (i.e. a waiter may have decided to
-    //  wait but not actually called pthread_cond_wait), this must be done while holding
-    //  the mutex - we'll use that opportunity to retest the wait value and skip the
-    //  broadcast (and associated syscall) if it has changed
-    {
-      AutoHSLLock al(mutex);
-      long long wv_reread = __sync_fetch_and_add(&wait_value, 0);
-      if(old_value == wv_reread) {
-#ifdef DEBUG_WORK_COUNTER
-	printf("WC(%p) broadcast(1) %lld\n", this, old_value);
-#endif
-	condvar.broadcast();
-	__sync_bool_compare_and_swap(&wait_value, wv_reread, -1);
-      }
-    }
+    // a waiter announces itself before its last check of the counter, so if
+    //  we see no waiters here, any later waiter will see our increment and
+    //  not sleep
+    if(__sync_fetch_and_add(&num_waiters, 0) == 0) return;
 
-    // sanity-check: a wait value earlier than the number we just incremented
-    //  from should not be possible
-#ifndef NDEBUG
-    long long wv_check = __sync_fetch_and_add(&wait_value, 0);
-#endif
-    assert((wv_check == -1) || (wv_check > old_value));
+    // otherwise, change the word they sleep on (so that a waiter that's
+    //  about to sleep won't) and wake everybody already asleep
+    __sync_fetch_and_add(&wake_seq, 1);
+    FutexWord::wake(&wake_seq, FutexWord::WAKE_ALL);
   }
 
-  // waits until new work arrives - this will possibly take the counter lock and 
-  // sleep, so should not be called while holding another lock
+  // waits until new work arrives - this spins for a while (see
+  //  -ll:idle_spin) and then sleeps, so should not be called while
+  //  holding another lock
   void ThreadedTaskScheduler::WorkCounter::wait_for_work(long long old_counter)
   {
-    // we assume the caller tried check_for_work() before dropping
-    //  their locks and calling us, so take and hold the lock the entire time
-    AutoHSLLock al(mutex);
-
-    // an early out is still needed to make sure the counter hasn't moved on and somebody
-    //  isn't trying to wait on a later value
-    if(counter != old_counter)
-      return;
+    // new work often shows up within a few microseconds, which is much less
+    //  than the cost of a sleep/wake round trip
+    SpinBackoff backoff;
+    for(int spun = 0; spun < Config::idle_spin_iterations; spun += backoff.pause())
+      if(counter != old_counter) {
+	if(spin_count)
+	  (*spin_count) += 1;
+	return;
+      }
 
-    // first, see if we catch anybody waiting on an older version of the counter - they can
-    //  definitely be awakened
-    long long wv_read = wait_value;
-    if((wv_read >= 0) && (wv_read < old_counter)) {
-#ifdef DEBUG_WORK_COUNTER
-      printf("WC(%p) broadcast(2) %lld\n", this, wv_read);
-#endif
-      condvar.broadcast();
+    __sync_fetch_and_add(&num_waiters, 1);
+    bool slept = false;
+    while(true) {
+      int seq = __sync_fetch_and_add(&wake_seq, 0);
+      if(__sync_fetch_and_add(&counter, 0) != old_counter)
+	break;
+      FutexWord::wait(&wake_seq, seq);
+      slept = true;
     }
-    assert(wv_read <= old_counter);
-#ifndef NDEBUG
-    bool ok =
-#endif
-      __sync_bool_compare_and_swap(&wait_value, wv_read, old_counter);
-    assert(ok); // swap should never fail
+    __sync_fetch_and_sub(&num_waiters, 1);
 
-    // now that people know we're waiting, wait until the counter updates - check before
-    //  each wait
-    while(__sync_fetch_and_add(&counter, 0) == old_counter) {
-      // sanity-check
-#ifndef NDEBUG
-      long long wv_check =
-#endif
-	__sync_fetch_and_add(&wait_value, 0);
-#ifdef DEBUG_WORK_COUNTER
-      printf("WC(%p) wait %lld (%lld)\n", this, old_counter, wv_check);
-#endif
-      assert(wv_check == old_counter);
-      condvar.wait();
-      //while(counter == old_counter) { mutex.unlock(); Thread::yield(); mutex.lock(); }
-#ifdef DEBUG_WORK_COUNTER
-      printf("WC(%p) ready %lld\n", this, old_counter);
-#endif
+    if(slept) {
+      if(park_count)
+	(*park_count) += 1;
+    } else {
+      if(spin_count)
+	(*spin_count) += 1;
     }
-
-    // once we're done, clear the wait value, but only if it's for us
-    __sync_bool_compare_and_swap(&wait_value, old_counter, -1);
   }
 
 
@@ -315,6 +675,8 @@ namespace Realm {
     : shutdown_flag(false)
     , active_worker_count(0)
     , unassigned_worker_count(0)
+    , idle_spin_count(0)
+    , idle_park_count(0)
     , wcu_task_queues(this)
     , wcu_resume_queue(this)
     , cfg_reuse_workers(true)
@@ -332,6 +694,16 @@ namespace Realm {
     assert(active_worker_count == 0);
     assert(unassigned_worker_count == 0);
     assert(idle_workers.empty());
+
+    delete idle_spin_count;
+    delete idle_park_count;
+  }
+
+  void ThreadedTaskScheduler::create_idle_gauges(const std::string& prefix)
+  {
+    idle_spin_count = new ProfilingGauges::EventCounter<long long>(prefix + "/idle spins");
+    idle_park_count = new ProfilingGauges::EventCounter<long long>(prefix + "/idle parks");
+    work_counter.set_gauges(idle_spin_count, idle_park_count);
   }
 
   void ThreadedTaskScheduler::add_task_queue(TaskQueue *queue)
@@ -344,6 +716,61 @@ namespace Realm {
     queue->add_subscription(&wcu_task_queues);
   }
 
+  void ThreadedTaskScheduler::add_stealable_queue(StealableTaskQueue *queue)
+  {
+    AutoHSLLock al(lock);
+
+    stealable_queues.push_back(queue);
+  }
+
+  Task *ThreadedTaskScheduler::get_stealable_task(int *task_priority, int higher_than)
+  {
+    // look at the peers first, because that pulls over anything sitting in
+    //  their inboxes
+    int steal_priority = higher_than;
+    StealableTaskQueue *victim = 0;
+    for(std::vector<StealableTaskQueue *>::const_iterator it = stealable_queues.begin();
+	it != stealable_queues.end();
+	++it)
+      for(std::vector<StealableTaskQueue *>::const_iterator it2 = (*it)->peers.begin();
+	  it2 != (*it)->peers.end();
+	  ++it2) {
+	int p = (*it)->scan_victim(*it2);
+	if(p > steal_priority) {
+	  steal_priority = p;
+	  victim = *it2;
+	}
+      }
+
+    int own_priority = higher_than;
+    StealableTaskQueue *own = 0;
+    for(std::vector<StealableTaskQueue *>::const_iterator it = stealable_queues.begin();
+	it != stealable_queues.end();
+	++it) {
+      int p = (*it)->refresh();
+      if(p > own_priority) {
+	own_priority = p;
+	own = *it;
+      }
+    }
+
+    // our own work wins ties
+    if(victim && (steal_priority > own_priority)) {
+      Task *task = victim->steal(steal_priority);
+      if(task) {
+	log_sched.debug() << "task stolen: task=" << (void *)task
+			  << " sched=" << this << " from=" << victim->owner;
+	*task_priority = steal_priority;
+	return task;
+      }
+    }
+
+    if(own)
+      return own->get(task_priority, higher_than);
+
+    return 0;
+  }
+
   // helper for tracking/sanity-checking worker counts
   void ThreadedTaskScheduler::update_worker_count(int active_delta,
 						  int unassigned_delta,
@@ -567,6 +994,21 @@ namespace Realm {
 	  }
 	}
 
+	// in work-stealing mode, see if our own queues or our peers' have
+	//  anything better
+	if(!stealable_queues.empty()) {
+	  int new_priority;
+	  Task *new_task = get_stealable_task(&new_priority, task_priority);
+	  if(new_task) {
+	    if(task)
+	      task_source->put(task, task_priority, false); // back on front of list
+
+	    task = new_task;
+	    task_source = 0;
+	    task_priority = new_priority;
+	  }
+	}
+
 	// did we find work to do?
 	if(task) {
 	  // we've now got some assigned work, so fire up a new idle worker if we were the last
@@ -777,12 +1219,15 @@ namespace Realm {
       AutoHSLLock al(lock);
 
       if(active_workers.count(thread) == 0) {
-	// nope, sleep on a CV until we are
-	GASNetCondVar my_cv(lock);
-	sleeping_threads[thread] = &my_cv;
+	// nope, park until we are
+	ThreadParker parker;
+	sleeping_threads[thread] = &parker;
 
-	while(active_workers.count(thread) == 0)
-	  my_cv.wait();
+	while(active_workers.count(thread) == 0) {
+	  lock.unlock();
+	  parker.park(Config::idle_spin_iterations);
+	  lock.lock();
+	}
     
 	sleeping_threads.erase(thread);
       }
@@ -860,18 +1305,28 @@ namespace Realm {
       active_workers.erase(Thread::self());
     assert(count == 1);
 
-    GASNetCondVar my_cv(lock);
-    sleeping_threads[Thread::self()] = &my_cv;
+    ThreadParker parker;
+    sleeping_threads[Thread::self()] = &parker;
 
     // with kernel threads, sleeping and waking are separable actions
     if(switch_to)
       worker_wake(switch_to);
 
-    // now sleep until we're active again
-    while(active_workers.count(Thread::self()) == 0)
-      my_cv.wait();
+    // now sleep until we're active again - our wake comes while the waker
+    //  holds the lock, so that's dropped while we're parked
+    while(active_workers.count(Thread::self()) == 0) {
+      lock.unlock();
+      if(parker.park(Config::idle_spin_iterations)) {
+	if(idle_park_count)
+	  (*idle_park_count) += 1;
+      } else {
+	if(idle_spin_count)
+	  (*idle_spin_count) += 1;
+      }
+      lock.lock();
+    }
     
-    // awake again, unregister our (stack-allocated) CV
+    // awake again, unregister our (stack-allocated) parking spot
     sleeping_threads.erase(Thread::self());
   }
 
@@ -881,10 +1336,10 @@ namespace Realm {
     assert(active_workers.count(to_wake) == 0);
     active_workers.insert(to_wake);
 
-    // if they have a CV (they might not yet), poke that
-    std::map<Thread *, GASNetCondVar *>::const_iterator it = sleeping_threads.find(to_wake);
+    // if they have a parking spot (they might not yet), poke that
+    std::map<Thread *, ThreadParker *>::const_iterator it = sleeping_threads.find(to_wake);
     if(it != sleeping_threads.end())
-      it->second->signal();
+      it->second->unpark();
   }
 
   void KernelThreadTaskScheduler::worker_terminate(Thread *switch_to)
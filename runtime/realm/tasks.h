@@ -26,6 +26,8 @@
 
 #include "realm/threads.h"
 #include "realm/pri_queue.h"
+#include "realm/ws_deque.h"
+#include "realm/parking.h"
 #include "realm/bytearray.h"
 
 namespace Realm {
@@ -56,16 +58,109 @@ namespace Realm {
       
       void execute_on_processor(Processor p);
 
+      // Task objects are carved out of slabs and recycled through per-thread
+      //  caches rather than coming from malloc - see tasks.cc
+      static void *operator new(size_t bytes);
+      static void operator delete(void *ptr, size_t bytes);
+
+      // "realm/tasks/..." gauges for the pool - created once profiling is
+      //  set up
+      static void create_pool_gauges(void);
+      static void destroy_pool_gauges(void);
+
       Processor proc;
       Processor::TaskFuncID func_id;
-      ByteArray args;
+      // refers to 'inline_args' for small arguments and 'heap_args' otherwise
+      ByteArrayRef args;
       Event before_event;
       int priority;
 
+      // link used while the task is in a StealableTaskQueue's inbox
+      Task *next_ready;
+
     protected:
       virtual void mark_completed(void);
 
       Thread *executing_thread;
+
+      static const size_t INLINE_ARG_BYTES = 256;
+      // aligned for anything a task might cast its arguments to
+      union {
+	char bytes[INLINE_ARG_BYTES];
+	long long align_ll;
+	long double align_ld;
+	void *align_ptr;
+      } inline_args;
+      ByteArray heap_args;
+    };
+
+    class ThreadedTaskScheduler;
+
+    // the ready queue of one processor in work-stealing mode (-ll:steal) -
+    //  a processor has one for the tasks sent to it and one for each group
+    //  it's in, and the queues of a group's members are "peers" that steal
+    //  from each other when they run out of work
+    // any thread can add a task - it's pushed onto a lock-free inbox, which
+    //  the owning scheduler (holding its own lock) moves into a Chase-Lev
+    //  deque per priority, so the existing priority order (highest first,
+    //  FIFO within a priority) is kept
+    // a peer holding its own scheduler lock can steal the oldest task of a
+    //  given priority, or take a whole inbox that the owner hasn't gotten to
+    class StealableTaskQueue {
+    public:
+      typedef PriorityQueue<Task *, GASNetHSL>::priority_t priority_t;
+
+      StealableTaskQueue(ThreadedTaskScheduler *_owner);
+      ~StealableTaskQueue(void);
+
+      // any thread
+      void put(Task *task);
+
+      // owner only - moves newly arrived tasks into the deques and returns
+      //  the highest priority available (PRI_NEG_INF if none)
+      priority_t refresh(void);
+
+      // owner only - takes the oldest task of the highest priority, if it's
+      //  above 'higher_than'
+      Task *get(priority_t *task_priority, priority_t higher_than);
+
+      // owner of this queue, stealing from 'victim' (a peer) - returns the
+      //  highest priority the victim has available for stealing, after
+      //  moving anything in its inbox over here
+      priority_t scan_victim(StealableTaskQueue *victim);
+
+      // any thread - steals the oldest task of exactly 'priority', if any
+      Task *steal(priority_t priority);
+
+      void set_gauge(ProfilingGauges::AbsoluteRangeGauge<int> *new_gauge);
+
+      ThreadedTaskScheduler *owner;
+      // filled in before the queue is given to any scheduler and never
+      //  changed after
+      std::vector<StealableTaskQueue *> peers;
+
+    protected:
+      void move_to_deques(Task *list);
+
+      // schedulers whose work counters go up when a task arrives - the
+      //  owner and all of its peers
+      void notify_schedulers(void);
+
+      Task * volatile inbox;
+
+      // a fixed number of per-priority deques, created as new priorities are
+      //  seen - tasks at any other priority go in the owner-only overflow
+      //  queue (which peers can't steal from)
+      static const int MAX_BANDS = 8;
+      struct Band {
+	priority_t priority;
+	WorkStealingDeque<Task *> *deque;
+      };
+      Band bands[MAX_BANDS];
+      volatile int num_bands;
+      PriorityQueue<Task *, DummyLock> overflow;
+
+      ProfilingGauges::AbsoluteRangeGauge<int> *entries_in_queue;
     };
 
     // a task scheduler in which one or more worker threads execute tasks from one
@@ -80,10 +175,22 @@ namespace Realm {
 
       virtual ~ThreadedTaskScheduler(void);
 
+      // processors' ready queues use the lock-free bucketed implementation
+      //  if REALM_BUCKETED_TASK_QUEUES is defined
+#ifdef REALM_BUCKETED_TASK_QUEUES
+      typedef BucketedPriorityQueue<Task *, GASNetHSL> TaskQueue;
+#else
       typedef PriorityQueue<Task *, GASNetHSL> TaskQueue;
+#endif
 
       virtual void add_task_queue(TaskQueue *queue);
 
+      // creates "<prefix>/idle spins" and "<prefix>/idle parks" gauges
+      void create_idle_gauges(const std::string& prefix);
+
+      // work-stealing mode uses these instead (see StealableTaskQueue)
+      void add_stealable_queue(StealableTaskQueue *queue);
+
       virtual void start(void) = 0;
       virtual void shutdown(void) = 0;
 
@@ -109,8 +216,15 @@ namespace Realm {
       virtual void worker_wake(Thread *to_wake) = 0;
       virtual void worker_terminate(Thread *switch_to) = 0;
 
+      // looks through our stealable queues and then their peers' for a task
+      //  above 'higher_than' - lock should be held
+      Task *get_stealable_task(int *task_priority, int higher_than);
+
+      friend class StealableTaskQueue;
+
       GASNetHSL lock;
       std::vector<TaskQueue *> task_queues;
+      std::vector<StealableTaskQueue *> stealable_queues;
       std::vector<Thread *> idle_workers;
       std::set<Thread *> blocked_workers;
 
@@ -146,22 +260,35 @@ namespace Realm {
 	// this is non-blocking, and may be called while holding another lock
 	bool check_for_work(long long old_counter);
 
-	// waits until new work arrives - this will possibly take the counter lock and 
-	// sleep, so should not be called while holding another lock
+	// waits until new work arrives - this spins for a while (see
+	//  -ll:idle_spin) and then sleeps, so should not be called while
+	//  holding another lock
 	void wait_for_work(long long old_counter);
 
+	// counts of waits that were satisfied while spinning and that had to
+	//  sleep
+	void set_gauges(ProfilingGauges::EventCounter<long long> *_spin_count,
+			ProfilingGauges::EventCounter<long long> *_park_count);
+
       protected:
 	// 64-bit counters are used to avoid dealing with wrap-around cases
 	volatile long long counter;
-	volatile long long wait_value;
-	GASNetHSL mutex;
-	GASNetCondVar condvar;
+	// sleepers wait on 'wake_seq' (a futex word), which is bumped only
+	//  when an increment sees a nonzero 'num_waiters'
+	volatile int num_waiters;
+	volatile int wake_seq;
+	ProfilingGauges::EventCounter<long long> *spin_count;
+	ProfilingGauges::EventCounter<long long> *park_count;
       };
 	
       WorkCounter work_counter;
 
       virtual void wait_for_work(long long old_work_counter);
 
+      // gauges for how often idle workers spin and park
+      ProfilingGauges::EventCounter<long long> *idle_spin_count;
+      ProfilingGauges::EventCounter<long long> *idle_park_count;
+
       // most of our work counter updates are going to come from priority queues, so a little
       //  template-fu here...
       template <typename PQ>
@@ -236,7 +363,9 @@ namespace Realm {
       std::set<Thread *> all_workers;
       std::set<Thread *> active_workers;
       std::set<Thread *> terminating_workers;
-      std::map<Thread *, GASNetCondVar *> sleeping_threads;
+      // each sleeping worker parks on its own spot, so waking one doesn't
+      //  disturb the others
+      std::map<Thread *, ThreadParker *> sleeping_threads;
       GASNetCondVar shutdown_condvar;
     };
 
@@ -27,6 +27,7 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <unistd.h>
 // for PTHREAD_STACK_MIN
 #include <limits.h>
 #ifdef __MACH__
@@ -36,6 +37,7 @@
 
 #ifdef REALM_USE_USER_THREADS
 #include <ucontext.h>
+#include <sys/mman.h>
 #ifdef __MACH__
 // MacOS has (loudly) deprecated set/get/make/swapcontext,
 //  despite there being no POSIX replacement for them...
@@ -62,6 +64,7 @@ inline void makecontext_wrap(ucontext_t *u, void (*fn)(), int args, ...) { makec
 #include <signal.h>
 #include <string>
 #include <map>
+#include <vector>
 
 #ifdef __linux__
 // needed for scanning Linux's /sys
@@ -97,6 +100,12 @@ namespace Realm {
 
   Logger log_thread("threads");
 
+  namespace Config {
+    int user_thread_stack_kb = 2048;
+    int stack_guard_pages = 1;
+    int stack_pool_size = 16;
+  };
+
 #ifdef REALM_USE_PAPI
   Logger log_papi("papi");
   namespace PAPI {
@@ -760,6 +769,11 @@ namespace Realm {
       }
     }
 
+    if(Config::stack_guard_pages >= 0)
+      CHECK_PTHREAD( pthread_attr_setguardsize(&attr,
+					       (Config::stack_guard_pages *
+						sysconf(_SC_PAGESIZE))) );
+
     // TODO: actually use heap size
 
     update_state(STATE_STARTUP);
@@ -899,6 +913,105 @@ namespace Realm {
     return true;
   }
 
+  // user thread stacks are mmap'd with a PROT_NONE guard region below them
+  //  (stacks grow down) and only get backing pages as they're touched - a
+  //  freed stack is kept for the next user thread of the same size, and its
+  //  pages are handed back to the kernel lazily (MADV_FREE) so that reusing
+  //  it usually costs nothing
+  class StackPool {
+  public:
+    static StackPool& get_pool(void);
+
+    // 'size' is rounded up to a whole number of pages - the returned pointer
+    //  is the lowest usable address of the stack
+    void *alloc_stack(size_t& size);
+    void free_stack(void *base, size_t size);
+
+  protected:
+    StackPool(void);
+
+    static void release_pages(void *base, size_t size);
+
+    size_t page_size, guard_bytes;
+    GASNetHSL mutex;
+    std::map<size_t, std::vector<void *> > free_stacks;
+  };
+
+  StackPool::StackPool(void)
+  {
+    page_size = sysconf(_SC_PAGESIZE);
+    guard_bytes = ((Config::stack_guard_pages > 0) ?
+		     (Config::stack_guard_pages * page_size) :
+		     0);
+  }
+
+  /*static*/ StackPool& StackPool::get_pool(void)
+  {
+    // never destroyed - user threads may outlive static destructors
+    static StackPool *pool = new StackPool;
+    return *pool;
+  }
+
+  void *StackPool::alloc_stack(size_t& size)
+  {
+    size = ((size + page_size - 1) / page_size) * page_size;
+
+    {
+      AutoHSLLock al(mutex);
+      std::map<size_t, std::vector<void *> >::iterator it = free_stacks.find(size);
+      if((it != free_stacks.end()) && !it->second.empty()) {
+	void *base = it->second.back();
+	it->second.pop_back();
+	return base;
+      }
+    }
+
+    int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+#ifdef MAP_STACK
+    flags |= MAP_STACK;
+#endif
+    void *ptr = mmap(0, size + guard_bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if(ptr == MAP_FAILED) {
+      log_thread.fatal() << "failed to map user thread stack: size=" << size
+			 << " error=" << strerror(errno);
+      assert(0);
+    }
+    if(guard_bytes > 0)
+      CHECK_LIBC( mprotect(ptr, guard_bytes, PROT_NONE) );
+    log_thread.debug() << "new user thread stack: base=" << ((char *)ptr + guard_bytes)
+		       << " size=" << size;
+    return ((char *)ptr + guard_bytes);
+  }
+
+  void StackPool::free_stack(void *base, size_t size)
+  {
+    if(Config::stack_pool_size > 0) {
+      release_pages(base, size);
+
+      AutoHSLLock al(mutex);
+      std::vector<void *>& stacks = free_stacks[size];
+      if(stacks.size() < (size_t)Config::stack_pool_size) {
+	stacks.push_back(base);
+	return;
+      }
+    }
+
+    CHECK_LIBC( munmap((char *)base - guard_bytes, size + guard_bytes) );
+  }
+
+  /*static*/ void StackPool::release_pages(void *base, size_t size)
+  {
+#ifdef MADV_FREE
+    if(madvise(base, size, MADV_FREE) == 0)
+      return;
+    // kernels older than 4.5 don't have MADV_FREE
+#endif
+    madvise(base, size, MADV_DONTNEED);
+  }
+
   class UserThread : public Thread {
   public:
     UserThread(void *_target, void (*_entry_wrapper)(void *),
@@ -951,7 +1064,7 @@ namespace Realm {
     assert(!running);
 
     if(stack_base != 0)
-      free(stack_base);
+      StackPool::get_pool().free_stack(stack_base, stack_size);
   }
 
   namespace ThreadLocal {
@@ -1004,11 +1117,12 @@ namespace Realm {
       if(stack_size < (64 << 10))
 	stack_size = 64 << 10;
     } else {
-      stack_size = 2 << 20; // pick something - 2MB ?
+      stack_size = (size_t)Config::user_thread_stack_kb << 10;
+      if(stack_size < (64 << 10))
+	stack_size = 64 << 10;
     }
 
-    stack_base = malloc(stack_size);
-    assert(stack_base != 0);
+    stack_base = StackPool::get_pool().alloc_stack(stack_size);
 
     CHECK_LIBC( getcontext(&ctx) );
 
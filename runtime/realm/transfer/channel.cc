@@ -16,6 +16,7 @@
 
 #include "realm/transfer/channel.h"
 #include "realm/transfer/channel_disk.h"
+#include "realm/transfer/copy_kernels.h"
 #include "realm/transfer/transfer.h"
 
 TYPE_IS_SERIALIZABLE(Realm::XferOrder::Type);
@@ -27,10 +28,19 @@ namespace Realm {
     Logger log_request("request");
     Logger log_xd("xd");
 
+    namespace Config {
+      int dma_memcpy_threads = 0;
+      int dma_numa_memcpy_threads = 0;
+      int dma_memcpy_ring_depth = 256;
+      int dma_xd_aging_passes = 0;
+    };
+
       // TODO: currently we use dma_all_gpus to track the set of GPU* created
 #ifdef USE_CUDA
       std::vector<Cuda::GPU*> dma_all_gpus;
 #endif
+      // NUMA domains of local memories, filled in by the NUMA module
+      static std::map<Memory, int> dma_numa_mems;
       // we use a single queue for all xferDes
       static XferDesQueue *xferDes_queue = 0;
 
@@ -222,7 +232,13 @@ namespace Realm {
           src_ib_offset(_src_ib_offset), src_ib_size(_src_ib_size),
           max_req_size(_max_req_size), priority(_priority),
           guid(_guid), pre_xd_guid(_pre_xd_guid), next_xd_guid(_next_xd_guid),
-          kind (_kind), order(_order), channel(NULL), complete_fence(_complete_fence)
+          kind (_kind), order(_order), channel(NULL), complete_fence(_complete_fence),
+          sched_next(NULL), sched_prev(NULL), sched_bucket(-1),
+          record_timeline(false),
+          enqueue_time(XferTimeline::INVALID_TIMESTAMP),
+          first_byte_time(XferTimeline::INVALID_TIMESTAMP),
+          ib_wait_start(XferTimeline::INVALID_TIMESTAMP),
+          ib_wait_time(0), bytes_moved(0)
       {
         // size_t total_field_size = 0;
         // for (unsigned i = 0; i < oas_vec.size(); i++) {
@@ -278,13 +294,127 @@ namespace Realm {
 
         // notify owning DmaRequest upon completion of this XferDes
         //printf("complete XD = %lu\n", guid);
+        if (!record_timeline) {
+          if (launch_node == my_node_id)
+            complete_fence->mark_finished(true/*successful*/);
+          else
+            NotifyXferDesCompleteMessage::send_request(launch_node, complete_fence);
+          return;
+        }
+
+        XferTimeline::XferInterval rec;
+        rec.guid = guid;
+        rec.kind = kind;
+        rec.src_mem = src_mem->me;
+        rec.dst_mem = dst_mem->me;
+        rec.enqueue_time = enqueue_time;
+        rec.first_byte_time = first_byte_time;
+        rec.last_byte_time = Clock::current_time_in_nanoseconds();
+        rec.bytes = bytes_moved;
+        rec.ib_wait_time = ib_wait_time;
+
         if (launch_node == my_node_id) {
+          complete_fence->add_xfer_record(rec);
           complete_fence->mark_finished(true/*successful*/);
         } else {
-          NotifyXferDesCompleteMessage::send_request(launch_node, complete_fence);
+          NotifyXferDesTimelineMessage::send_request(launch_node, complete_fence, rec);
         }
       }
 
+      void XferDes::record_requests(Request** requests, long nr)
+      {
+        // bytes are always counted for the channel utilization gauges
+        if (nr > 0) {
+          for (long i = 0; i < nr; i++)
+            bytes_moved += requests[i]->nbytes * requests[i]->nlines * requests[i]->nplanes;
+          if (!record_timeline)
+            return;
+          if ((first_byte_time == XferTimeline::INVALID_TIMESTAMP) ||
+              (ib_wait_start != XferTimeline::INVALID_TIMESTAMP)) {
+            long long now = Clock::current_time_in_nanoseconds();
+            if (first_byte_time == XferTimeline::INVALID_TIMESTAMP)
+              first_byte_time = now;
+            if (ib_wait_start != XferTimeline::INVALID_TIMESTAMP) {
+              ib_wait_time += now - ib_wait_start;
+              ib_wait_start = XferTimeline::INVALID_TIMESTAMP;
+            }
+          }
+        } else {
+          // only an XferDes reading from or writing to an intermediate buffer
+          //  can be held up by its neighbors before its iteration is done
+          if (record_timeline && !iteration_completed &&
+              (ib_wait_start == XferTimeline::INVALID_TIMESTAMP) &&
+              (first_byte_time != XferTimeline::INVALID_TIMESTAMP) &&
+              ((pre_xd_guid != XFERDES_NO_GUID) ||
+               (next_xd_guid != XFERDES_NO_GUID)))
+            ib_wait_start = Clock::current_time_in_nanoseconds();
+        }
+      }
+
+      /*static*/ const char *XferDes::kind_name(XferKind kind)
+      {
+        switch (kind) {
+        case XFER_NONE: return "none";
+        case XFER_DISK_READ: return "disk_read";
+        case XFER_DISK_WRITE: return "disk_write";
+        case XFER_SSD_READ: return "ssd_read";
+        case XFER_SSD_WRITE: return "ssd_write";
+        case XFER_GPU_TO_FB: return "gpu_to_fb";
+        case XFER_GPU_FROM_FB: return "gpu_from_fb";
+        case XFER_GPU_IN_FB: return "gpu_in_fb";
+        case XFER_GPU_PEER_FB: return "gpu_peer_fb";
+        case XFER_MEM_CPY: return "mem_cpy";
+        case XFER_GASNET_READ: return "gasnet_read";
+        case XFER_GASNET_WRITE: return "gasnet_write";
+        case XFER_REMOTE_WRITE: return "remote_write";
+        case XFER_HDF_READ: return "hdf_read";
+        case XFER_HDF_WRITE: return "hdf_write";
+        case XFER_FILE_READ: return "file_read";
+        case XFER_FILE_WRITE: return "file_write";
+        }
+        return "unknown";
+      }
+
+      void XferDesFence::add_xfer_record(const ProfilingMeasurements::OperationTransferTimeline::XferInterval& rec)
+      {
+        static_cast<DmaRequest *>(op)->add_xfer_record(rec);
+      }
+
+      ChannelUtilization::ChannelUtilization(Channel *channel)
+        : busy_ns(gauge_name(channel, "busy_ns"))
+        , bytes_moved(gauge_name(channel, "bytes"))
+        , active_xds(gauge_name(channel, "active_xds"))
+        , busy_since(0)
+      {}
+
+      /*static*/ std::string ChannelUtilization::gauge_name(Channel *channel,
+                                                            const char *what)
+      {
+        std::string name("realm/dma/channel/");
+        name += XferDes::kind_name(channel->kind);
+        name += '/';
+        name += what;
+        return name;
+      }
+
+      void ChannelUtilization::xd_started(void)
+      {
+        if (active_xds == 0)
+          busy_since = Clock::current_time_in_nanoseconds();
+        active_xds += 1;
+      }
+
+      void ChannelUtilization::xd_finished(void)
+      {
+        // credit busy time on every completion rather than only when the
+        //  channel goes idle, so a channel that stays busy doesn't appear
+        //  idle to the sampler until it drains
+        long long now = Clock::current_time_in_nanoseconds();
+        busy_ns += (unsigned long long)(now - busy_since);
+        busy_since = now;
+        active_xds -= 1;
+      }
+
 #if 0
       static inline off_t calc_mem_loc_ib(off_t alloc_offset,
                                           off_t field_start,
@@ -1217,8 +1347,10 @@ namespace Realm {
 	if(_src_serdez_id != _dst_serdez_id)
 	  max_nr = 1;
         memcpy_reqs = (MemcpyRequest*) calloc(max_nr, sizeof(MemcpyRequest));
+        int numa_domain = ((MemcpyChannel*)channel)->get_memory_domain(_dst_mem);
         for (int i = 0; i < max_nr; i++) {
           memcpy_reqs[i].xd = this;
+          memcpy_reqs[i].numa_domain = numa_domain;
           enqueue_request(&memcpy_reqs[i]);
         }
       }
@@ -2220,6 +2352,20 @@ namespace Realm {
 	return 0;
       }
 
+      MemcpyThread::MemcpyThread(MemcpyChannel* _channel, int _index,
+                                 int _numa_domain,
+                                 size_t pending_depth, size_t finished_depth)
+        : channel(_channel), index(_index), numa_domain(_numa_domain)
+        , pending(pending_depth), finished(finished_depth)
+        , copies_done(0), copies_stolen(0)
+      {}
+
+      MemcpyThread::~MemcpyThread()
+      {
+        assert(pending.empty());
+        assert(finished.empty());
+      }
+
       /*static*/ void* MemcpyThread::start(void* arg)
       {
         MemcpyThread* worker = (MemcpyThread*) arg;
@@ -2227,34 +2373,38 @@ namespace Realm {
         return NULL;
       }
 
+      /*static*/ void MemcpyThread::perform_copy(MemcpyRequest* req)
+      {
+        // serdez copies are always performed inline by the DMA thread
+        assert(!req->xd->src_serdez_op && !req->xd->dst_serdez_op);
+        if (req->dim == Request::DIM_1D) {
+          memcpy(req->dst_base, req->src_base, req->nbytes);
+          return;
+        }
+        // 2-D requests have nplanes == 1, so the plane strides are ignored
+        CopyKernels::copy_3d(req->dst_base, req->src_base, req->nbytes,
+                             req->nlines, req->src_str, req->dst_str,
+                             req->nplanes, req->src_pstr, req->dst_pstr);
+      }
+
       void MemcpyThread::thread_loop()
       {
+        log_new_dma.info() << "memcpy worker " << index << " started: numa=" << numa_domain;
         while (!channel->is_stopped) {
-          channel->get_request(thread_queue);
-          if (channel->is_stopped)
-            break;
-          std::deque<MemcpyRequest*>::const_iterator it;
-          for (it = thread_queue.begin(); it != thread_queue.end(); it++) {
-            MemcpyRequest* req = *it;
-            //double starttime = Realm::Clock::current_time_in_microseconds();
-            if (req->dim == Request::DIM_1D) {
-              memcpy(req->dst_base, req->src_base, req->nbytes);
-            } else {
-              assert(req->dim == Request::DIM_2D);
-              const char *src = (const char *)(req->src_base);
-	      char *dst = (char *)(req->dst_base);
-              for (size_t i = 0; i < req->nlines; i++) {
-                memcpy(dst, src, req->nbytes);
-                src += req->src_str;
-                dst += req->dst_str;
-              }
-            }
-            //double stoptime = Realm::Clock::current_time_in_microseconds();
-            //fprintf(stderr, "t = %.2lfus, tp = %.2lfMB/s\n", stoptime - starttime, (req->nbytes / (stoptime - starttime)));
+          MemcpyRequest* req;
+          if (!channel->get_request(this, req)) {
+            channel->wait_for_requests(this);
+            continue;
           }
-          channel->return_request(thread_queue);
-          thread_queue.clear();
+          perform_copy(req);
+          copies_done++;
+          // the finished ring is sized to hold every request the channel
+          //  allows in flight, so this can't fail
+          bool ok = finished.try_push(req);
+          assert(ok);
         }
+        log_new_dma.info() << "memcpy worker " << index << " stopped: copies="
+                           << copies_done << " stolen=" << copies_stolen;
       }
 
       void MemcpyThread::stop()
@@ -2267,16 +2417,48 @@ namespace Realm {
 						    Memory::Z_COPY_MEM };
       static const size_t num_cpu_mem_kinds = sizeof(cpu_mem_kinds) / sizeof(cpu_mem_kinds[0]);
 
-      MemcpyChannel::MemcpyChannel(long max_nr)
+      MemcpyChannel::MemcpyChannel(long max_nr, int num_threads /*= 0*/,
+                                   size_t ring_depth /*= 256*/,
+                                   int numa_threads /*= 0*/)
 	: Channel(XferDes::XFER_MEM_CPY)
+        , is_stopped(false), capacity(max_nr), in_flight(0), next_worker(0)
+        , mem_domains(dma_numa_mems)
+        , sleep_cond(sleep_lock), num_sleepers(0)
       {
-        capacity = max_nr;
-        is_stopped = false;
-        sleep_threads = false;
-        pthread_mutex_init(&pending_lock, NULL);
-        pthread_mutex_init(&finished_lock, NULL);
-        pthread_cond_init(&pending_cond, NULL);
-        //cbs = (MemcpyRequest**) calloc(max_nr, sizeof(MemcpyRequest*));
+        std::vector<int> worker_domains(std::max(num_threads, 0), -1);
+        if (numa_threads > 0) {
+          std::set<int> domains;
+          get_registered_numa_domains(domains);
+          for (std::set<int>::const_iterator it = domains.begin();
+               it != domains.end();
+               ++it)
+            worker_domains.insert(worker_domains.end(), numa_threads, *it);
+        }
+        if (!worker_domains.empty()) {
+          // every request may end up on a single worker's ring (either
+          //  because of stealing or because the others are full), so the
+          //  finished rings have to be able to hold the whole capacity
+          size_t n = worker_domains.size();
+          size_t pending_depth = std::max(ring_depth,
+                                          (size_t)((max_nr + n - 1) / n));
+          for (size_t i = 0; i < n; i++) {
+            MemcpyThread *w = new MemcpyThread(this, i, worker_domains[i],
+                                               pending_depth, max_nr);
+            workers.push_back(w);
+            if (worker_domains[i] >= 0)
+              domain_workers[worker_domains[i]].push_back(w);
+          }
+          // steal from neighbors in the same domain first (starting with
+          //  the next one so that thieves spread out), then from the rest
+          for (size_t i = 0; i < n; i++)
+            for (int pass = 0; pass < 2; pass++)
+              for (size_t j = 1; j < n; j++) {
+                MemcpyThread *v = workers[(i + j) % n];
+                bool same = (v->numa_domain == workers[i]->numa_domain);
+                if (same == (pass == 0))
+                  workers[i]->victims.push_back(v);
+              }
+        }
 	unsigned bw = 0; // TODO
 	unsigned latency = 0;
 	// any combination of SYSTEM/REGDMA/Z_COPY_MEM
@@ -2289,10 +2471,8 @@ namespace Realm {
 
       MemcpyChannel::~MemcpyChannel()
       {
-        pthread_mutex_destroy(&pending_lock);
-        pthread_mutex_destroy(&finished_lock);
-        pthread_cond_destroy(&pending_cond);
-        //free(cbs);
+        for (size_t i = 0; i < workers.size(); i++)
+          delete workers[i];
       }
 
       bool MemcpyChannel::supports_path(Memory src_mem, Memory dst_mem,
@@ -2316,43 +2496,58 @@ namespace Realm {
 
       void MemcpyChannel::stop()
       {
-        pthread_mutex_lock(&pending_lock);
-        if (!is_stopped)
-          pthread_cond_broadcast(&pending_cond);
+        AutoHSLLock al(sleep_lock);
         is_stopped = true;
-        pthread_mutex_unlock(&pending_lock);
+        sleep_cond.broadcast();
       }
 
-      void MemcpyChannel::get_request(std::deque<MemcpyRequest*>& thread_queue)
+      int MemcpyChannel::get_memory_domain(Memory mem) const
       {
-        pthread_mutex_lock(&pending_lock);
-        while (pending_queue.empty() && !is_stopped) {
-          sleep_threads = true;
-          pthread_cond_wait(&pending_cond, &pending_lock);
-        }
-        if (!is_stopped) {
-          // TODO: enable the following optimization
-          //thread_queue.insert(thread_queue.end(), pending_queue.begin(), pending_queue.end());
-          thread_queue.push_back(pending_queue.front());
-          pending_queue.pop_front();
-          //fprintf(stderr, "[%d] thread_queue.size = %lu\n", gettid(), thread_queue.size());
-          //pending_queue.clear();
+        std::map<Memory, int>::const_iterator it = mem_domains.find(mem);
+        return ((it != mem_domains.end()) ? it->second : -1);
+      }
+
+      bool MemcpyChannel::get_request(MemcpyThread* worker, MemcpyRequest*& req)
+      {
+        if (worker->pending.try_pop(req))
+          return true;
+        // our own ring is empty - try to steal from the others, preferring
+        //  those in our own NUMA domain
+        for (size_t i = 0; i < worker->victims.size(); i++) {
+          if (worker->victims[i]->pending.try_pop(req)) {
+            worker->copies_stolen++;
+            return true;
+          }
         }
-        pthread_mutex_unlock(&pending_lock);
+        return false;
       }
 
-      void MemcpyChannel::return_request(std::deque<MemcpyRequest*>& thread_queue)
+      void MemcpyChannel::wait_for_requests(MemcpyThread* worker)
       {
-        pthread_mutex_lock(&finished_lock);
-        finished_queue.insert(finished_queue.end(), thread_queue.begin(), thread_queue.end());
-        pthread_mutex_unlock(&finished_lock);
+        // spin a little first - DMA threads tend to submit in bursts
+        for (int i = 0; i < 1000; i++) {
+          if (is_stopped) return;
+          for (size_t j = 0; j < workers.size(); j++)
+            if (!workers[j]->pending.empty())
+              return;
+        }
+        AutoHSLLock al(sleep_lock);
+        __sync_fetch_and_add(&num_sleepers, 1);
+        // re-check after advertising ourselves as a sleeper - a submitter
+        //  either sees num_sleepers > 0 or we see its request
+        bool empty = true;
+        for (size_t j = 0; j < workers.size(); j++)
+          if (!workers[j]->pending.empty()) {
+            empty = false;
+            break;
+          }
+        if (empty && !is_stopped)
+          sleep_cond.wait();
+        __sync_fetch_and_sub(&num_sleepers, 1);
       }
 
-      long MemcpyChannel::submit(Request** requests, long nr)
+      void MemcpyChannel::perform_request_inline(MemcpyRequest* req)
       {
-        MemcpyRequest** mem_cpy_reqs = (MemcpyRequest**) requests;
-        for (long i = 0; i < nr; i++) {
-          MemcpyRequest* req = mem_cpy_reqs[i];
 	  // handle 1-D, 2-D, and 3-D in a single loop
 	  switch(req->dim) {
 	  case Request::DIM_1D:
@@ -2773,61 +2968,91 @@ namespace Realm {
 	    }
 	  } else
 	      assert(rewind_src == 0);
-          req->xd->notify_request_read_done(req);
-          req->xd->notify_request_write_done(req);
-        }
-        return nr;
-        /*
-        pthread_mutex_lock(&pending_lock);
-        //if (nr > 0)
-          //printf("MemcpyChannel::submit[nr = %ld]\n", nr);
+      }
+
+      long MemcpyChannel::submit(Request** requests, long nr)
+      {
+        MemcpyRequest** mem_cpy_reqs = (MemcpyRequest**) requests;
+        bool wake_workers = false;
         for (long i = 0; i < nr; i++) {
-          pending_queue.push_back(mem_cpy_reqs[i]);
+          MemcpyRequest* req = mem_cpy_reqs[i];
+          // serdez copies manipulate the xd's iterators and byte counts, so
+          //  they have to stay on this thread
+          if (req->xd->src_serdez_op || req->xd->dst_serdez_op) {
+            perform_request_inline(req);
+            req->xd->notify_request_read_done(req);
+            req->xd->notify_request_write_done(req);
+            continue;
+          }
+          if (workers.empty()) {
+            MemcpyThread::perform_copy(req);
+            req->xd->notify_request_read_done(req);
+            req->xd->notify_request_write_done(req);
+            continue;
+          }
+          enqueue_request(req);
+          in_flight++;
+          wake_workers = true;
         }
-        if (sleep_threads) {
-          pthread_cond_broadcast(&pending_cond);
-          sleep_threads = false;
+        if (wake_workers) {
+          // pairs with the sleeper's increment/re-check in wait_for_requests
+          __sync_synchronize();
+          if (num_sleepers > 0) {
+            AutoHSLLock al(sleep_lock);
+            sleep_cond.broadcast();
+          }
         }
-        pthread_mutex_unlock(&pending_lock);
         return nr;
-        */
-        /*
-        for (int i = 0; i < nr; i++) {
-          push_request(mem_cpy_reqs[i]);
-          memcpy(mem_cpy_reqs[i]->dst_buf, mem_cpy_reqs[i]->src_buf, mem_cpy_reqs[i]->nbytes);
-          mem_cpy_reqs[i]->xd->notify_request_read_done(mem_cpy_reqs[i]);
-          mem_cpy_reqs[i]->xd->notify_request_write_done(mem_cpy_reqs[i]);
+      }
+
+      void MemcpyChannel::enqueue_request(MemcpyRequest* req)
+      {
+        // copies into a memory with known NUMA affinity go round-robin to
+        //  the workers in that domain, so that the destination is written
+        //  from local cores
+        if (req->numa_domain >= 0) {
+          std::map<int, std::vector<MemcpyThread*> >::iterator it =
+            domain_workers.find(req->numa_domain);
+          if (it != domain_workers.end()) {
+            size_t n = it->second.size();
+            size_t& next = next_domain_worker[req->numa_domain];
+            for (size_t j = 0; j < n; j++) {
+              MemcpyThread* w = it->second[next];
+              next = (next + 1) % n;
+              if (w->pending.try_push(req))
+                return;
+            }
+          }
         }
-        return nr;
-        */
+        // everything else (or if the domain's rings are all full) goes
+        //  round-robin over all the workers, skipping any that are full -
+        //  we never have more than 'capacity' requests in flight, which
+        //  all the rings together can hold
+        size_t n = workers.size();
+        for (size_t j = 0; j < n; j++) {
+          MemcpyThread* w = workers[next_worker];
+          next_worker = (next_worker + 1) % n;
+          if (w->pending.try_push(req))
+            return;
+        }
+        assert(0);
       }
 
       void MemcpyChannel::pull()
       {
-        pthread_mutex_lock(&finished_lock);
-        while (!finished_queue.empty()) {
-          MemcpyRequest* req = finished_queue.front();
-          finished_queue.pop_front();
-          req->xd->notify_request_read_done(req);
-          req->xd->notify_request_write_done(req);
-        }
-        pthread_mutex_unlock(&finished_lock);
-        /*
-        while (true) {
-          long np = worker->pull(cbs, capacity);
-          for (int i = 0; i < np; i++) {
-            cbs[i]->xd->notify_request_read_done(cbs[i]);
-            cbs[i]->xd->notify_request_write_done(cbs[i]);
+        for (size_t i = 0; i < workers.size(); i++) {
+          MemcpyRequest* req;
+          while (workers[i]->finished.try_pop(req)) {
+            in_flight--;
+            req->xd->notify_request_read_done(req);
+            req->xd->notify_request_write_done(req);
           }
-          if (np != capacity)
-            break;
         }
-        */
       }
 
       long MemcpyChannel::available()
       {
-        return capacity;
+        return capacity - in_flight;
       }
 
       GASNetChannel::GASNetChannel(long max_nr, XferDes::XferKind _kind)
@@ -3237,6 +3462,7 @@ namespace Realm {
 	size_t src_ib_offset = 0;
 	size_t src_ib_size = 0;
 	bool mark_started = false;
+	bool record_timeline = false;
 	TransferIterator *src_iter;
 	TransferIterator *dst_iter;
 	CustomSerdezID src_serdez_id = 0;
@@ -3258,6 +3484,7 @@ namespace Realm {
 		   (fbd >> src_ib_offset) &&
 		   (fbd >> src_ib_size) &&
 		   (fbd >> mark_started) &&
+		   (fbd >> record_timeline) &&
 		   (fbd >> max_req_size) &&
 		   (fbd >> max_nr) &&
 		   (fbd >> priority) &&
@@ -3281,7 +3508,7 @@ namespace Realm {
 			src_iter, dst_iter,
 			src_serdez_id, dst_serdez_id,
 			max_req_size, max_nr, priority,
-			order, kind, args.fence, args.inst);
+			order, kind, args.fence, record_timeline, args.inst);
 #endif
 #if 0
         switch(payload->domain.dim) {
@@ -3331,7 +3558,7 @@ namespace Realm {
 			       CustomSerdezID _src_serdez_id, CustomSerdezID _dst_serdez_id,
                                uint64_t max_req_size, long max_nr, int priority,
                                XferOrder::Type order, XferDes::XferKind kind,
-                               XferDesFence* fence,
+                               XferDesFence* fence, bool record_timeline,
 			       RegionInstance inst /*= RegionInstance::NO_INST*/)
       {
 #if 0
@@ -3365,6 +3592,7 @@ namespace Realm {
 		   (dbs << src_ib_offset) &&
 		   (dbs << src_ib_size) &&
 		   (dbs << mark_started) &&
+		   (dbs << record_timeline) &&
 		   (dbs << max_req_size) &&
 		   (dbs << max_nr) &&
 		   (dbs << priority) &&
@@ -3408,64 +3636,234 @@ namespace Realm {
 					      args.span_size);
       }
 
+      ////////////////////////////////////////////////////////////////////////
+      //
+      // class XferDesPriorityList
+      //
+
+      XferDesPriorityList::XferDesPriorityList(unsigned _aging_passes /*= 0*/)
+        : nonempty_mask(0), count(0), aging_passes(_aging_passes)
+      {
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+          heads[b] = tails[b] = NULL;
+          starved_passes[b] = 0;
+        }
+      }
+
+      XferDesPriorityList::~XferDesPriorityList()
+      {}
+
+      /*static*/ int XferDesPriorityList::bucket_index(int priority)
+      {
+        if (priority <= MIN_PRIORITY)
+          return 0;
+        if (priority >= (MIN_PRIORITY + NUM_BUCKETS - 1))
+          return NUM_BUCKETS - 1;
+        return priority - MIN_PRIORITY;
+      }
+
+      void XferDesPriorityList::insert(XferDes* xd)
+      {
+        push_back(xd, bucket_index(xd->priority));
+      }
+
+      void XferDesPriorityList::push_back(XferDes* xd, int b)
+      {
+        assert(xd->sched_bucket == -1);
+        xd->sched_bucket = b;
+        xd->sched_next = NULL;
+        xd->sched_prev = tails[b];
+        if (tails[b])
+          tails[b]->sched_next = xd;
+        else
+          heads[b] = xd;
+        tails[b] = xd;
+        nonempty_mask |= (1U << b);
+        count++;
+      }
+
+      void XferDesPriorityList::remove(XferDes* xd)
+      {
+        int b = xd->sched_bucket;
+        assert((b >= 0) && (b < NUM_BUCKETS));
+        if (xd->sched_prev)
+          xd->sched_prev->sched_next = xd->sched_next;
+        else
+          heads[b] = xd->sched_next;
+        if (xd->sched_next)
+          xd->sched_next->sched_prev = xd->sched_prev;
+        else
+          tails[b] = xd->sched_prev;
+        if (!heads[b]) {
+          nonempty_mask &= ~(1U << b);
+          starved_passes[b] = 0;
+        }
+        xd->sched_next = xd->sched_prev = NULL;
+        xd->sched_bucket = -1;
+        count--;
+      }
+
+      XferDes* XferDesPriorityList::first() const
+      {
+        return first_in_buckets_below(NUM_BUCKETS);
+      }
+
+      XferDes* XferDesPriorityList::next(const XferDes* xd) const
+      {
+        if (xd->sched_next)
+          return xd->sched_next;
+        return first_in_buckets_below(xd->sched_bucket);
+      }
+
+      XferDes* XferDesPriorityList::first_in_buckets_below(int bucket) const
+      {
+        unsigned mask = nonempty_mask & ((1U << bucket) - 1);
+        if (!mask)
+          return NULL;
+        // highest non-empty bucket below 'bucket'
+        return heads[(8 * sizeof(unsigned) - 1) - __builtin_clz(mask)];
+      }
+
+      void XferDesPriorityList::end_pass(XferDes* first_unserviced)
+      {
+        if (aging_passes == 0)
+          return;
+        int fb = (first_unserviced ? first_unserviced->sched_bucket : -1);
+        // walk from the top down so a promoted XferDes isn't considered
+        //  a second time in the same pass
+        for (int b = NUM_BUCKETS - 1; b >= 0; b--) {
+          if (!heads[b])
+            continue;
+          // a bucket was serviced if the pass reached its head
+          if ((b > fb) || ((b == fb) && (heads[b] != first_unserviced))) {
+            starved_passes[b] = 0;
+            continue;
+          }
+          if ((++starved_passes[b] >= aging_passes) && (b < (NUM_BUCKETS - 1))) {
+            XferDes* xd = heads[b];
+            log_new_dma.debug("aging XferDes : id(" IDFMT ") bucket %d -> %d",
+                              xd->guid, b, b + 1);
+            remove(xd);
+            push_back(xd, b + 1);
+            starved_passes[b] = 0;
+          }
+        }
+      }
+
+      ////////////////////////////////////////////////////////////////////////
+      //
+      // class DMAThread
+      //
+
+      void DMAThread::enqueue_xferDes(XferDes* xd)
+      {
+        if (xd->record_timeline)
+          xd->enqueue_time = Clock::current_time_in_nanoseconds();
+        XferDes* old_head;
+        do {
+          old_head = incoming;
+          xd->sched_next = old_head;
+        } while (!__sync_bool_compare_and_swap(&incoming, old_head, xd));
+        // the CAS is a full barrier, so either we see the sleep flag or the
+        //  DMA thread sees our XferDes before it goes to sleep
+        if (sleep) {
+          pthread_mutex_lock(&enqueue_lock);
+          pthread_cond_signal(&enqueue_cond);
+          pthread_mutex_unlock(&enqueue_lock);
+        }
+      }
+
+      void DMAThread::dequeue_xferDes(bool wait_on_empty)
+      {
+        if (wait_on_empty && (incoming == NULL)) {
+          pthread_mutex_lock(&enqueue_lock);
+          sleep = true;
+          __sync_synchronize();
+          while ((incoming == NULL) && !is_stopped)
+            pthread_cond_wait(&enqueue_cond, &enqueue_lock);
+          sleep = false;
+          pthread_mutex_unlock(&enqueue_lock);
+        }
+
+        XferDes* lifo = __sync_lock_test_and_set(&incoming, (XferDes*)NULL);
+        // the stack is in reverse order of arrival - flip it so that
+        //  XferDes of equal priority are serviced in FIFO order
+        XferDes* fifo = NULL;
+        while (lifo) {
+          XferDes* next = lifo->sched_next;
+          lifo->sched_next = fifo;
+          fifo = lifo;
+          lifo = next;
+        }
+        while (fifo) {
+          XferDes* next = fifo->sched_next;
+          fifo->sched_next = NULL;
+          std::map<Channel*, XferDesPriorityList*>::iterator it;
+          it = channel_to_xd_pool.find(fifo->channel);
+          assert(it != channel_to_xd_pool.end());
+          it->second->insert(fifo);
+          channel_to_util[fifo->channel]->xd_started();
+          fifo = next;
+        }
+      }
+
       void DMAThread::dma_thread_loop()
       {
         log_new_dma.info("start dma thread loop");
         while (!is_stopped) {
           bool is_empty = true;
-          std::map<Channel*, PriorityXferDesQueue*>::iterator it;
+          std::map<Channel*, XferDesPriorityList*>::iterator it;
           for (it = channel_to_xd_pool.begin(); it != channel_to_xd_pool.end(); it++) {
             if(!it->second->empty()) {
               is_empty = false;
               break;
             }
           }
-          xd_queue->dequeue_xferDes(this, is_empty);
+          dequeue_xferDes(is_empty);
 
           for (it = channel_to_xd_pool.begin(); it != channel_to_xd_pool.end(); it++) {
             it->first->pull();
             long nr = it->first->available();
             if (nr == 0)
               continue;
+            XferDesPriorityList* xd_list = it->second;
             std::vector<XferDes*> finish_xferdes;
-            PriorityXferDesQueue::iterator it2;
-            for (it2 = it->second->begin(); it2 != it->second->end(); it2++) {
-              assert((*it2)->channel == it->first);
+            XferDes* xd = xd_list->first();
+            while (xd) {
+              assert(xd->channel == it->first);
+              XferDes* next_xd = xd_list->next(xd);
               // If we haven't mark started and we are the first xd, mark start
-              if ((*it2)->mark_start) {
-                (*it2)->dma_request->mark_started();
-                (*it2)->mark_start = false;
+              if (xd->mark_start) {
+                xd->dma_request->mark_started();
+                xd->mark_start = false;
               }
-              // Do nothing for empty copies
-              // if ((*it2)->bytes_total ==0) {
-              //   finish_xferdes.push_back(*it2);
-              //   continue;
-              // }
-              long nr_got = (*it2)->get_requests(requests, std::min(nr, max_nr));
+              long nr_got = xd->get_requests(requests, std::min(nr, max_nr));
+              xd->record_requests(requests, nr_got);
               long nr_submitted = it->first->submit(requests, nr_got);
               nr -= nr_submitted;
               assert(nr_got == nr_submitted);
-              if ((*it2)->is_completed()) {
-                finish_xferdes.push_back(*it2);
-                //printf("finish_xferdes.size() = %lu\n", finish_xferdes.size());
+              if (xd->is_completed()) {
+                finish_xferdes.push_back(xd);
+                xd = next_xd;
 		continue;
               }
+              xd = next_xd;
               if (nr == 0)
                 break;
             }
+            // anything from 'xd' on didn't get a chance to run this pass
+            xd_list->end_pass(xd);
+            ChannelUtilization* util = channel_to_util[it->first];
             while(!finish_xferdes.empty()) {
               XferDes *xd = finish_xferdes.back();
               finish_xferdes.pop_back();
-              it->second->erase(xd);
+              xd_list->remove(xd);
               // We flush all changes into destination before mark this XferDes as completed
               xd->flush();
               log_new_dma.info("Finish XferDes : id(" IDFMT ")", xd->guid);
+              util->add_bytes(xd->bytes_moved);
+              util->xd_finished();
               xd->mark_completed();
-              /*bool need_to_delete_dma_request = xd->mark_completed();
-              if (need_to_delete_dma_request) {
-                DmaRequest* dma_request = xd->dma_request;
-                delete dma_request;
-              }*/
             }
           }
         }
@@ -3519,10 +3917,14 @@ namespace Realm {
 #endif
       }
 
-      MemcpyChannel* ChannelManager::create_memcpy_channel(long max_nr)
+      MemcpyChannel* ChannelManager::create_memcpy_channel(long max_nr,
+                                                           int num_threads /*= 0*/,
+                                                           size_t ring_depth /*= 256*/,
+                                                           int numa_threads /*= 0*/)
       {
         assert(memcpy_channel == NULL);
-        memcpy_channel = new MemcpyChannel(max_nr);
+        memcpy_channel = new MemcpyChannel(max_nr, num_threads, ring_depth,
+                                           numa_threads);
         return memcpy_channel;
       }
       GASNetChannel* ChannelManager::create_gasnet_read_channel(long max_nr) {
@@ -3577,6 +3979,21 @@ namespace Realm {
         dma_all_gpus.push_back(gpu);
       }
 #endif
+      void register_numa_mem_in_dma_systems(Memory mem, int numa_domain)
+      {
+        // startup only, so no locking needed
+        assert(xferDes_queue == 0);
+        dma_numa_mems[mem] = numa_domain;
+      }
+
+      void get_registered_numa_domains(std::set<int>& domains)
+      {
+        for (std::map<Memory, int>::const_iterator it = dma_numa_mems.begin();
+             it != dma_numa_mems.end();
+             ++it)
+          domains.insert(it->second);
+      }
+
       void start_channel_manager(int count, bool pinned, int max_nr,
                                  Realm::CoreReservationSet& crs)
       {
@@ -3584,14 +4001,18 @@ namespace Realm {
         channel_manager = new ChannelManager;
         xferDes_queue->start_worker(count, max_nr, channel_manager);
       }
-      FileChannel* ChannelManager::create_file_read_channel(long max_nr) {
+      FileChannel* ChannelManager::create_file_read_channel(long max_nr,
+                                                            int num_compress_threads) {
         assert(file_read_channel == NULL);
-        file_read_channel = new FileChannel(max_nr, XferDes::XFER_FILE_READ);
+        file_read_channel = new FileChannel(max_nr, XferDes::XFER_FILE_READ,
+                                            num_compress_threads);
         return file_read_channel;
       }
-      FileChannel* ChannelManager::create_file_write_channel(long max_nr) {
+      FileChannel* ChannelManager::create_file_write_channel(long max_nr,
+                                                             int num_compress_threads) {
         assert(file_write_channel == NULL);
-        file_write_channel = new FileChannel(max_nr, XferDes::XFER_FILE_WRITE);
+        file_write_channel = new FileChannel(max_nr, XferDes::XFER_FILE_WRITE,
+                                             num_compress_threads);
         return file_write_channel;
       }
       DiskChannel* ChannelManager::create_disk_read_channel(long max_nr) {
@@ -3621,7 +4042,10 @@ namespace Realm {
         dma_threads = (DMAThread**) calloc(count, sizeof(DMAThread*));
         // dma thread #1: memcpy
         std::vector<Channel*> channels;
-        MemcpyChannel* memcpy_channel = channel_manager->create_memcpy_channel(max_nr);
+        memcpy_channel = channel_manager->create_memcpy_channel(max_nr,
+                                                                num_memcpy_threads,
+                                                                Config::dma_memcpy_ring_depth,
+                                                                num_numa_memcpy_threads);
 	GASNetChannel* gasnet_read_channel = channel_manager->create_gasnet_read_channel(max_nr);
 	GASNetChannel* gasnet_write_channel = channel_manager->create_gasnet_write_channel(max_nr);
         channels.push_back(memcpy_channel);
@@ -3640,8 +4064,12 @@ namespace Realm {
 	RemoteWriteChannel *remote_channel = channel_manager->create_remote_write_channel(max_nr);
 	DiskChannel *disk_read_channel = channel_manager->create_disk_read_channel(max_nr);
 	DiskChannel *disk_write_channel = channel_manager->create_disk_write_channel(max_nr);
-	FileChannel *file_read_channel = channel_manager->create_file_read_channel(max_nr);
-	FileChannel *file_write_channel = channel_manager->create_file_write_channel(max_nr);
+	FileChannel *file_read_channel = channel_manager->create_file_read_channel(max_nr,
+										   num_compress_threads);
+	FileChannel *file_write_channel = channel_manager->create_file_write_channel(max_nr,
+										     num_compress_threads);
+        file_channels.push_back(file_read_channel);
+        file_channels.push_back(file_write_channel);
         channels.push_back(remote_channel);
 	channels.push_back(disk_read_channel);
 	channels.push_back(disk_write_channel);
@@ -3702,20 +4130,38 @@ namespace Realm {
           worker_threads.push_back(t);
         }
 
-#ifdef USE_DEDICATED_MEMCPY_THREADS
-        // Next we create memcpy threads
-        memcpy_threads =(MemcpyThread**) calloc(num_memcpy_threads, sizeof(MemcpyThread*));
-        for (int i = 0; i < num_memcpy_threads; i++) {
-          memcpy_threads[i] = new MemcpyThread(memcpy_channel);
+        // next we create the memcpy workers, if any - they hang off the
+        //  memcpy channel, which owns (and eventually deletes) them, and
+        //  each one runs in its NUMA domain's reservation if it has one
+        assert(memcpy_channel->num_workers() ==
+               (size_t)(num_memcpy_threads +
+                        num_numa_memcpy_threads * numa_memcpy_rsrvs.size()));
+        for (size_t i = 0; i < memcpy_channel->num_workers(); i++) {
+          int domain = memcpy_channel->get_worker_domain(i);
+          CoreReservation *rsrv = ((domain >= 0) ? numa_memcpy_rsrvs[domain] :
+                                                   memcpy_rsrv);
+          assert(rsrv != 0);
+          log_new_dma.info() << "Create a memcpy worker thread: numa=" << domain;
           Realm::Thread *t = Realm::Thread::create_kernel_thread<MemcpyThread,
-                                            &MemcpyThread::thread_loop>(memcpy_threads[i],
+                                            &MemcpyThread::thread_loop>(memcpy_channel->get_worker(i),
                                                                         tlp,
-                                                                        *core_rsrv,
+                                                                        *rsrv,
                                                                         0 /*default scheduler*/);
           worker_threads.push_back(t);
         }
-#endif
-        assert(worker_threads.size() == (size_t)(num_threads));
+
+        // and finally the file compression workers, which each file channel
+        //  owns
+        for (size_t i = 0; i < file_channels.size(); i++)
+          for (size_t j = 0; j < file_channels[i]->num_compress_workers(); j++) {
+            log_new_dma.info("Create a file compression worker thread");
+            Realm::Thread *t = Realm::Thread::create_kernel_thread<FileCompressThread,
+                                              &FileCompressThread::thread_loop>(file_channels[i]->get_compress_worker(j),
+                                                                                tlp,
+                                                                                *compress_rsrv,
+                                                                                0 /*default scheduler*/);
+            worker_threads.push_back(t);
+          }
       }
 
       void stop_channel_manager()
@@ -3728,8 +4174,10 @@ namespace Realm {
       void XferDesQueue::stop_worker() {
         for (int i = 0; i < num_threads; i++)
           dma_threads[i]->stop();
-        for (int i = 0; i < num_memcpy_threads; i++)
-          memcpy_threads[i]->stop();
+        if (memcpy_channel->num_workers() > 0)
+          memcpy_channel->stop();
+        for (size_t i = 0; i < file_channels.size(); i++)
+          file_channels[i]->stop();
         // reap all the threads
         for(std::vector<Realm::Thread *>::iterator it = worker_threads.begin();
             it != worker_threads.end();
@@ -3740,12 +4188,7 @@ namespace Realm {
         worker_threads.clear();
         for (int i = 0; i < num_threads; i++)
           delete dma_threads[i];
-        for (int i = 0; i < num_memcpy_threads; i++)
-          delete memcpy_threads[i];
         free(dma_threads);
-#ifdef USE_DEDICATED_MEMCPY_THREADS
-        free(memcpy_threads);
-#endif
       }
 
       class DeferredXDEnqueue : public Realm::EventWaiter {
@@ -3800,6 +4243,7 @@ namespace Realm {
                            XferOrder::Type _order,
                            XferDes::XferKind _kind,
                            XferDesFence* _complete_fence,
+                           bool _record_timeline,
                            RegionInstance inst)
       {
 	//if (ID(_src_buf.memory).memory.owner_node == my_node_id) {
@@ -3919,6 +4363,7 @@ namespace Realm {
           printf("_kind = %d\n", _kind);
           assert(false);
 	}
+	xd->record_timeline = _record_timeline;
 	// see if the newly-created xd's iterators needs metadata, and if so,
 	//   defer the enqueuing
 	Event src_iter_ready = _src_iter->request_metadata();
@@ -3948,7 +4393,8 @@ namespace Realm {
 					   _src_mem, _dst_mem, _src_iter, _dst_iter,
 					   _src_serdez_id, _dst_serdez_id,
                                            _max_req_size, max_nr, _priority,
-                                           _order, _kind, _complete_fence, inst);
+                                           _order, _kind, _complete_fence,
+                                           _record_timeline, inst);
       }
     }
 
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <map>
+#include <set>
 #include <vector>
 #include <deque>
 #include <queue>
@@ -34,6 +35,9 @@
 #include "realm/runtime_impl.h"
 #include "realm/mem_impl.h"
 #include "realm/inst_impl.h"
+#include "realm/mpmc_ring.h"
+#include "realm/utils.h"
+#include "realm/sampling.h"
 
 #ifdef USE_CUDA
 #include "realm/cuda/cuda_module.h"
@@ -211,6 +215,8 @@ namespace Realm {
       const void *src_base;
       void *dst_base;
       //size_t nbytes;
+      // NUMA domain of the destination memory, or -1 if not known
+      int numa_domain;
     };
 
     class GASNetRequest : public Request {
@@ -275,6 +281,9 @@ namespace Realm {
     	// ignored for now
       }
       virtual void print(std::ostream& os) const { os << "XferDesFence"; }
+
+      // hands the timeline of a finished XferDes to the owning DmaRequest
+      void add_xfer_record(const ProfilingMeasurements::OperationTransferTimeline::XferInterval& rec);
     };
 
     class XferDes {
@@ -346,6 +355,17 @@ namespace Realm {
       // default iterators provided to generate requests
       //Layouts::GenericLayoutIterator<DIM>* li;
       unsigned offset_idx;
+      // links used by the DMA thread's scheduler (see XferDesPriorityList)
+      XferDes *sched_next, *sched_prev;
+      int sched_bucket;
+      // timeline reported through OperationTransferTimeline - all of these
+      //  are only touched by the DMA thread that owns this XferDes, and the
+      //  timestamps are only taken if the copy asked for the timeline
+      typedef ProfilingMeasurements::OperationTransferTimeline XferTimeline;
+      bool record_timeline;
+      XferTimeline::timestamp_t enqueue_time, first_byte_time;
+      XferTimeline::timestamp_t ib_wait_start, ib_wait_time;
+      size_t bytes_moved;
     public:
       XferDes(DmaRequest* _dma_request, NodeID _launch_node,
               XferDesID _guid, XferDesID _pre_xd_guid, XferDesID _next_xd_guid,
@@ -380,6 +400,13 @@ namespace Realm {
 
       void mark_completed();
 
+      // called by the DMA thread after each get_requests call - tracks the
+      //  first byte, bytes moved, and time spent stalled on an intermediate
+      //  buffer (i.e. no requests available while the iteration isn't done)
+      void record_requests(Request** requests, long nr);
+
+      static const char *kind_name(XferKind kind);
+
 #if 0
       void update_pre_bytes_write(size_t new_val) {
         pthread_mutex_lock(&update_write_lock);
@@ -720,24 +747,48 @@ namespace Realm {
 
     class MemcpyChannel;
 
+    // a dedicated memcpy worker - each worker owns a bounded lock-free ring
+    //  of pending requests that the DMA thread fills round-robin, and steals
+    //  from its siblings' rings when its own runs dry
+    // a worker may be tied to a NUMA domain, in which case it runs on that
+    //  domain's cores and is preferred for copies into that domain's memory
     class MemcpyThread {
     public:
-      MemcpyThread(MemcpyChannel* _channel) : channel(_channel) {}
+      MemcpyThread(MemcpyChannel* _channel, int _index, int _numa_domain,
+                   size_t pending_depth, size_t finished_depth);
+      ~MemcpyThread();
       void thread_loop();
       static void* start(void* arg);
       void stop();
-    private:
+
+      // performs a plain (non-serdez) 1D/2D/3D copy
+      static void perform_copy(MemcpyRequest* req);
+
+    protected:
+      friend class MemcpyChannel;
+
       MemcpyChannel* channel;
-      std::deque<MemcpyRequest*> thread_queue;
+      int index;
+      int numa_domain;  // -1 if not tied to a domain
+      // siblings to steal from, same-domain ones first
+      std::vector<MemcpyThread*> victims;
+      // filled by the DMA thread, drained by this worker and thieves
+      MPMCRing<MemcpyRequest*> pending;
+      // filled by this worker only, drained by the DMA thread in pull()
+      MPMCRing<MemcpyRequest*> finished;
+      // per-worker counters, only written by the owning worker
+      size_t copies_done, copies_stolen;
     };
 
     class MemcpyChannel : public Channel {
     public:
-      MemcpyChannel(long max_nr);
+      // 'num_threads' workers are not tied to any NUMA domain, and
+      //  'numa_threads' are created for each domain with a registered
+      //  memory (see register_numa_mem_in_dma_systems)
+      MemcpyChannel(long max_nr, int num_threads = 0,
+                    size_t ring_depth = 256, int numa_threads = 0);
       ~MemcpyChannel();
       void stop();
-      void get_request(std::deque<MemcpyRequest*>& thread_queue);
-      void return_request(std::deque<MemcpyRequest*>& thread_queue);
       long submit(Request** requests, long nr);
       void pull();
       long available();
@@ -749,15 +800,42 @@ namespace Realm {
 				 unsigned *bw_ret = 0,
 				 unsigned *lat_ret = 0);
 
-      bool is_stopped;
+      size_t num_workers() const { return workers.size(); }
+      MemcpyThread* get_worker(size_t idx) { return workers[idx]; }
+      int get_worker_domain(size_t idx) const { return workers[idx]->numa_domain; }
+
+      // returns the NUMA domain a memory was registered with, or -1
+      int get_memory_domain(Memory mem) const;
+
+      // used by workers to find work - first their own ring, then others'
+      bool get_request(MemcpyThread* worker, MemcpyRequest*& req);
+      // puts an idle worker to sleep until more requests arrive
+      void wait_for_requests(MemcpyThread* worker);
+
+      volatile bool is_stopped;
     private:
-      std::deque<MemcpyRequest*> pending_queue, finished_queue;
-      pthread_mutex_t pending_lock, finished_lock;
-      pthread_cond_t pending_cond;
+      // performs a request on the calling thread (used for serdez copies
+      //  and when there are no dedicated workers)
+      void perform_request_inline(MemcpyRequest* req);
+
+      // picks a worker ring for a request and pushes it there
+      void enqueue_request(MemcpyRequest* req);
+
       long capacity;
-      bool sleep_threads;
-      //std::vector<MemcpyRequest*> available_cb;
-      //MemcpyRequest** cbs;
+      // only touched by the DMA thread that owns this channel
+      long in_flight;
+      size_t next_worker;
+      std::vector<MemcpyThread*> workers;
+      // workers tied to each NUMA domain, and the next one to use for that
+      //  domain (also only touched by the DMA thread)
+      std::map<int, std::vector<MemcpyThread*> > domain_workers;
+      std::map<int, size_t> next_domain_worker;
+      std::map<Memory, int> mem_domains;
+      // idle workers sleep here - submitters only take the lock if
+      //  num_sleepers is non-zero
+      GASNetHSL sleep_lock;
+      GASNetCondVar sleep_cond;
+      volatile int num_sleepers;
     };
 
     class GASNetChannel : public Channel {
@@ -835,14 +913,16 @@ namespace Realm {
 #endif
       }
       ~ChannelManager(void);
-      MemcpyChannel* create_memcpy_channel(long max_nr);
+      MemcpyChannel* create_memcpy_channel(long max_nr, int num_threads = 0,
+                                           size_t ring_depth = 256,
+                                           int numa_threads = 0);
       GASNetChannel* create_gasnet_read_channel(long max_nr);
       GASNetChannel* create_gasnet_write_channel(long max_nr);
       RemoteWriteChannel* create_remote_write_channel(long max_nr);
       DiskChannel* create_disk_read_channel(long max_nr);
       DiskChannel* create_disk_write_channel(long max_nr);
-      FileChannel* create_file_read_channel(long max_nr);
-      FileChannel* create_file_write_channel(long max_nr);
+      FileChannel* create_file_read_channel(long max_nr, int num_compress_threads = 0);
+      FileChannel* create_file_write_channel(long max_nr, int num_compress_threads = 0);
 #ifdef USE_CUDA
       GPUChannel* create_gpu_to_fb_channel(long max_nr, Cuda::GPU* src_gpu);
       GPUChannel* create_gpu_from_fb_channel(long max_nr, Cuda::GPU* src_gpu);
@@ -926,48 +1006,118 @@ namespace Realm {
 #endif
     };
 
-    class CompareXferDes {
+    // a per-channel list of XferDes waiting for service, ordered by priority
+    // - priorities are mapped into a fixed number of buckets, each of which
+    //  is an intrusive FIFO list threaded through the XferDes itself, so
+    //  insertion/removal never allocate
+    // - a list is only ever touched by the DMA thread that owns its channel,
+    //  so no locking is needed
+    // - if aging is enabled, a non-empty bucket that gets passed over for
+    //  'aging_passes' consecutive passes has its oldest XferDes promoted
+    //  one bucket, so low-priority bulk copies can't be starved forever
+    class XferDesPriorityList {
     public:
-      bool operator() (XferDes* a, XferDes* b) {
-        if(a->priority == b->priority)
-          return (a < b);
-        else 
-          return (a->priority < b->priority);
-      }
+      enum {
+        NUM_BUCKETS = 16,
+        // priorities in [MIN_PRIORITY, MIN_PRIORITY + NUM_BUCKETS) get their
+        //  own bucket, anything outside that is clamped
+        MIN_PRIORITY = -(NUM_BUCKETS / 2 - 1),
+      };
+
+      XferDesPriorityList(unsigned _aging_passes = 0);
+      ~XferDesPriorityList();
+
+      bool empty() const { return (count == 0); }
+      size_t size() const { return count; }
+
+      void insert(XferDes* xd);
+      void remove(XferDes* xd);
+
+      // iteration is highest-priority bucket first, FIFO within a bucket
+      XferDes* first() const;
+      XferDes* next(const XferDes* xd) const;
+
+      // called at the end of each pass over the list with the XferDes (if
+      //  any) that the pass stopped before - everything from there on was
+      //  not serviced
+      void end_pass(XferDes* first_unserviced);
+
+      static int bucket_index(int priority);
+
+    protected:
+      void push_back(XferDes* xd, int bucket);
+      XferDes* first_in_buckets_below(int bucket) const;
+
+      XferDes* heads[NUM_BUCKETS];
+      XferDes* tails[NUM_BUCKETS];
+      unsigned starved_passes[NUM_BUCKETS];
+      // bit i is set iff bucket i is non-empty
+      unsigned nonempty_mask;
+      size_t count;
+      unsigned aging_passes;
+    };
+
+    // utilization gauges for one channel, updated by the DMA thread that
+    //  services it - the running totals let a sampler turn any two samples
+    //  into a utilization (busy_ns) or bandwidth (bytes) over that interval
+    class ChannelUtilization {
+    public:
+      ChannelUtilization(Channel *channel);
+
+      // an XferDes was added to/removed from the channel's list
+      void xd_started(void);
+      void xd_finished(void);
+
+      void add_bytes(size_t bytes) { bytes_moved += bytes; }
+
+    protected:
+      static std::string gauge_name(Channel *channel, const char *what);
+
+      // time during which at least one XferDes was active on the channel
+      ProfilingGauges::AbsoluteGauge<unsigned long long> busy_ns;
+      ProfilingGauges::AbsoluteGauge<unsigned long long> bytes_moved;
+      ProfilingGauges::AbsoluteRangeGauge<int> active_xds;
+      long long busy_since;
     };
-    //typedef std::priority_queue<XferDes*, std::vector<XferDes*>, CompareXferDes> PriorityXferDesQueue;
-    typedef std::set<XferDes*, CompareXferDes> PriorityXferDesQueue;
 
     class XferDesQueue;
     class DMAThread {
     public:
       DMAThread(long _max_nr, XferDesQueue* _xd_queue, std::vector<Channel*>& _channels) {
         for (std::vector<Channel*>::iterator it = _channels.begin(); it != _channels.end(); it ++) {
-          channel_to_xd_pool[*it] = new PriorityXferDesQueue;
+          channel_to_xd_pool[*it] = new XferDesPriorityList(Config::dma_xd_aging_passes);
+          channel_to_util[*it] = new ChannelUtilization(*it);
         }
         xd_queue = _xd_queue;
         max_nr = _max_nr;
         is_stopped = false;
         requests = (Request**) calloc(max_nr, sizeof(Request*));
         sleep = false;
+        incoming = NULL;
         pthread_mutex_init(&enqueue_lock, NULL);
         pthread_cond_init(&enqueue_cond, NULL);
       }
       DMAThread(long _max_nr, XferDesQueue* _xd_queue, Channel* _channel) {
-        channel_to_xd_pool[_channel] = new PriorityXferDesQueue;
+        channel_to_xd_pool[_channel] = new XferDesPriorityList(Config::dma_xd_aging_passes);
+        channel_to_util[_channel] = new ChannelUtilization(_channel);
         xd_queue = _xd_queue;
         max_nr = _max_nr;
         is_stopped = false;
         requests = (Request**) calloc(max_nr, sizeof(Request*));
         sleep = false;
+        incoming = NULL;
         pthread_mutex_init(&enqueue_lock, NULL);
         pthread_cond_init(&enqueue_cond, NULL);
       }
       ~DMAThread() {
-        std::map<Channel*, PriorityXferDesQueue*>::iterator it;
+        std::map<Channel*, XferDesPriorityList*>::iterator it;
         for (it = channel_to_xd_pool.begin(); it != channel_to_xd_pool.end(); it++) {
           delete it->second;
         }
+        std::map<Channel*, ChannelUtilization*>::iterator it2;
+        for (it2 = channel_to_util.begin(); it2 != channel_to_util.end(); it2++) {
+          delete it2->second;
+        }
         free(requests);
         pthread_mutex_destroy(&enqueue_lock);
         pthread_cond_destroy(&enqueue_cond);
@@ -988,13 +1138,25 @@ namespace Realm {
         pthread_cond_signal(&enqueue_cond);
         pthread_mutex_unlock(&enqueue_lock);
       }
+
+      // hands a new XferDes to this thread - may be called from any thread
+      //  and only takes this thread's lock if it is asleep
+      void enqueue_xferDes(XferDes* xd);
+
+      // moves newly-enqueued XferDes into the per-channel lists, optionally
+      //  sleeping until some arrive
+      void dequeue_xferDes(bool wait_on_empty);
     public:
       pthread_mutex_t enqueue_lock;
       pthread_cond_t enqueue_cond;
-      std::map<Channel*, PriorityXferDesQueue*> channel_to_xd_pool;
-      bool sleep;
-      bool is_stopped;
+      std::map<Channel*, XferDesPriorityList*> channel_to_xd_pool;
+      std::map<Channel*, ChannelUtilization*> channel_to_util;
+      volatile bool sleep;
+      volatile bool is_stopped;
     private:
+      // lock-free stack of XferDes enqueued by other threads, linked
+      //  through XferDes::sched_next
+      XferDes* volatile incoming;
       // maximum allowed num of requests for a single
       long max_nr;
       Request** requests;
@@ -1023,6 +1185,33 @@ namespace Realm {
       }
     };
 
+    // same as above, but carries the finished XferDes' timeline (only sent
+    //  if the copy asked for an OperationTransferTimeline)
+    struct NotifyXferDesTimelineMessage {
+      struct RequestArgs : public BaseMedium {
+        XferDesFence* fence;
+      };
+
+      static void handle_request(RequestArgs args, const void *data, size_t datalen)
+      {
+        assert(datalen == sizeof(ProfilingMeasurements::OperationTransferTimeline::XferInterval));
+        args.fence->add_xfer_record(*static_cast<const ProfilingMeasurements::OperationTransferTimeline::XferInterval *>(data));
+        args.fence->mark_finished(true/*successful*/);
+      }
+
+      typedef ActiveMessageMediumNoReply<XFERDES_NOTIFY_TIMELINE_MSGID,
+                                         RequestArgs,
+                                         handle_request> Message;
+
+      static void send_request(NodeID target, XferDesFence* fence,
+                               const ProfilingMeasurements::OperationTransferTimeline::XferInterval& rec)
+      {
+        RequestArgs args;
+        args.fence = fence;
+        Message::request(target, args, &rec, sizeof(rec), PAYLOAD_COPY);
+      }
+    };
+
     struct XferDesRemoteWriteMessage {
       struct RequestArgs : public BaseMedium {
         //void *dst_buf;
@@ -1139,7 +1328,8 @@ namespace Realm {
 			       CustomSerdezID _src_serdez_id, CustomSerdezID _dst_serdez_id,
                                uint64_t max_req_size, long max_nr, int priority,
                                XferOrder::Type order, XferDes::XferKind kind,
-                               XferDesFence* fence, RegionInstance inst = RegionInstance::NO_INST);
+                               XferDesFence* fence, bool record_timeline,
+                               RegionInstance inst = RegionInstance::NO_INST);
     };
 
     struct XferDesDestroyMessage {
@@ -1209,6 +1399,12 @@ namespace Realm {
       }
     };
 
+    // records the NUMA domain of a local memory, so that copies into it can
+    //  be given to memcpy workers running in that domain - must be called
+    //  before the DMA system starts (i.e. from Module::create_dma_channels)
+    void register_numa_mem_in_dma_systems(Memory mem, int numa_domain);
+    void get_registered_numa_domains(std::set<int>& domains);
+
     class XferDesQueue {
     public:
       struct XferDesWithUpdates{
@@ -1234,25 +1430,64 @@ namespace Realm {
         } else {
           core_rsrv = new CoreReservation("DMA threads", crs, CoreReservationParameters());
         }
-        pthread_mutex_init(&queues_lock, NULL);
+        num_memcpy_threads = Config::dma_memcpy_threads;
+        memcpy_rsrv = NULL;
+        if (num_memcpy_threads > 0) {
+          CoreReservationParameters params;
+          if (pinned) {
+            params.set_num_cores(num_memcpy_threads);
+            params.set_alu_usage(params.CORE_USAGE_EXCLUSIVE);
+            params.set_fpu_usage(params.CORE_USAGE_EXCLUSIVE);
+            params.set_ldst_usage(params.CORE_USAGE_SHARED);
+          }
+          memcpy_rsrv = new CoreReservation("memcpy threads", crs, params);
+        }
+        // NUMA-local memcpy workers always run in their domain, and get
+        //  exclusive cores there if the DMA threads are pinned
+        num_numa_memcpy_threads = Config::dma_numa_memcpy_threads;
+        if (num_numa_memcpy_threads > 0) {
+          std::set<int> domains;
+          get_registered_numa_domains(domains);
+          for (std::set<int>::const_iterator it = domains.begin();
+               it != domains.end();
+               ++it) {
+            CoreReservationParameters params;
+            params.set_numa_domain(*it);
+            params.set_num_cores(num_numa_memcpy_threads);
+            if (pinned) {
+              params.set_alu_usage(params.CORE_USAGE_EXCLUSIVE);
+              params.set_fpu_usage(params.CORE_USAGE_EXCLUSIVE);
+              params.set_ldst_usage(params.CORE_USAGE_SHARED);
+            }
+            std::string name = stringbuilder() << "NUMA" << *it << " memcpy threads";
+            numa_memcpy_rsrvs[*it] = new CoreReservation(name, crs, params);
+          }
+        }
+        // file compression workers don't need dedicated cores - they spend
+        //  much of their time waiting on the file system
+        num_compress_threads = Config::file_compress_threads;
+        compress_rsrv = NULL;
+        if (num_compress_threads > 0)
+          compress_rsrv = new CoreReservation("file compression threads", crs,
+                                              CoreReservationParameters());
         pthread_rwlock_init(&guid_lock, NULL);
         // reserve the first several guid
         next_to_assign_idx = 10;
         num_threads = 0;
-        num_memcpy_threads = 0;
         dma_threads = NULL;
+        memcpy_channel = NULL;
       }
 
       ~XferDesQueue() {
         delete core_rsrv;
-        // clean up the priority queues
-        pthread_mutex_lock(&queues_lock);
-        std::map<Channel*, PriorityXferDesQueue*>::iterator it2;
-        for (it2 = queues.begin(); it2 != queues.end(); it2++) {
-          delete it2->second;
-        }
-        pthread_mutex_unlock(&queues_lock);
-        pthread_mutex_destroy(&queues_lock);
+        if (memcpy_rsrv)
+          delete memcpy_rsrv;
+        for (std::map<int, CoreReservation*>::iterator it = numa_memcpy_rsrvs.begin();
+             it != numa_memcpy_rsrvs.end();
+             ++it)
+          delete it->second;
+        if (compress_rsrv)
+          delete compress_rsrv;
         pthread_rwlock_destroy(&guid_lock);
       }
 
@@ -1328,13 +1563,11 @@ namespace Realm {
 
       void register_dma_thread(DMAThread* dma_thread)
       {
-        std::map<Channel*, PriorityXferDesQueue*>::iterator it;
-        pthread_mutex_lock(&queues_lock);
+        // only called during startup, before any XferDes are enqueued
+        std::map<Channel*, XferDesPriorityList*>::iterator it;
         for(it = dma_thread->channel_to_xd_pool.begin(); it != dma_thread->channel_to_xd_pool.end(); it++) {
           channel_to_dma_thread[it->first] = dma_thread;
-          queues[it->first] = new PriorityXferDesQueue;
         }
-        pthread_mutex_unlock(&queues_lock);
       }
 
       void destroy_xferDes(XferDesID guid) {
@@ -1366,54 +1599,7 @@ namespace Realm {
         std::map<Channel*, DMAThread*>::iterator it;
         it = channel_to_dma_thread.find(xd->channel);
         assert(it != channel_to_dma_thread.end());
-        DMAThread* dma_thread = it->second;
-        pthread_mutex_lock(&dma_thread->enqueue_lock);
-        pthread_mutex_lock(&queues_lock);
-        std::map<Channel*, PriorityXferDesQueue*>::iterator it2;
-        it2 = queues.find(xd->channel);
-        assert(it2 != queues.end());
-        // push ourself into the priority queue
-        it2->second->insert(xd);
-        pthread_mutex_unlock(&queues_lock);
-        if (dma_thread->sleep) {
-          dma_thread->sleep = false;
-          pthread_cond_signal(&dma_thread->enqueue_cond);
-        }
-        pthread_mutex_unlock(&dma_thread->enqueue_lock);
-      }
-
-      bool dequeue_xferDes(DMAThread* dma_thread, bool wait_on_empty) {
-        pthread_mutex_lock(&dma_thread->enqueue_lock);
-        std::map<Channel*, PriorityXferDesQueue*>::iterator it;
-        if (wait_on_empty) {
-          bool empty = true;
-          for(it = dma_thread->channel_to_xd_pool.begin(); it != dma_thread->channel_to_xd_pool.end(); it++) {
-            pthread_mutex_lock(&queues_lock);
-            std::map<Channel*, PriorityXferDesQueue*>::iterator it2;
-            it2 = queues.find(it->first);
-            assert(it2 != queues.end());
-            if (it2->second->size() > 0)
-              empty = false;
-            pthread_mutex_unlock(&queues_lock);
-          }
-
-          if (empty && !dma_thread->is_stopped) {
-            dma_thread->sleep = true;
-            pthread_cond_wait(&dma_thread->enqueue_cond, &dma_thread->enqueue_lock);
-          }
-        }
-
-        for(it = dma_thread->channel_to_xd_pool.begin(); it != dma_thread->channel_to_xd_pool.end(); it++) {
-          pthread_mutex_lock(&queues_lock);
-          std::map<Channel*, PriorityXferDesQueue*>::iterator it2;
-          it2 = queues.find(it->first);
-          assert(it2 != queues.end());
-          it->second->insert(it2->second->begin(), it2->second->end());
-          it2->second->clear();
-          pthread_mutex_unlock(&queues_lock);
-        }
-        pthread_mutex_unlock(&dma_thread->enqueue_lock);
-        return true;
+        it->second->enqueue_xferDes(xd);
       }
 
       void start_worker(int count, int max_nr, ChannelManager* channel_manager);
@@ -1422,15 +1608,19 @@ namespace Realm {
 
     protected:
       std::map<Channel*, DMAThread*> channel_to_dma_thread;
-      std::map<Channel*, PriorityXferDesQueue*> queues;
       std::map<XferDesID, XferDesWithUpdates> guid_to_xd;
-      pthread_mutex_t queues_lock;
       pthread_rwlock_t guid_lock;
       XferDesID next_to_assign_idx;
       CoreReservation* core_rsrv;
-      int num_threads, num_memcpy_threads;
+      CoreReservation* memcpy_rsrv;
+      // per-domain reservations for NUMA-local memcpy workers
+      std::map<int, CoreReservation*> numa_memcpy_rsrvs;
+      CoreReservation* compress_rsrv;
+      int num_threads, num_memcpy_threads, num_numa_memcpy_threads;
+      int num_compress_threads;
       DMAThread** dma_threads;
-      MemcpyThread** memcpy_threads;
+      MemcpyChannel* memcpy_channel;
+      std::vector<FileChannel*> file_channels;
       std::vector<Thread*> worker_threads;
     };
 
@@ -1453,7 +1643,8 @@ namespace Realm {
 			 CustomSerdezID _src_serdez_id, CustomSerdezID _dst_serdez_id,
                          uint64_t _max_req_size, long max_nr, int _priority,
                          XferOrder::Type _order, XferDes::XferKind _kind,
-                         XferDesFence* _complete_fence, RegionInstance inst = RegionInstance::NO_INST);
+                         XferDesFence* _complete_fence, bool _record_timeline,
+                         RegionInstance inst = RegionInstance::NO_INST);
 
     void destroy_xfer_des(XferDesID _guid);
 }; // namespace Realm
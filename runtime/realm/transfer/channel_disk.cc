@@ -18,6 +18,12 @@
 
 namespace Realm {
 
+    extern Logger log_new_dma;
+
+    namespace Config {
+      int file_compress_threads = 0;
+    };
+
     FileXferDes::FileXferDes(DmaRequest* _dma_request,
 			     NodeID _launch_node,
 			     XferDesID _guid,
@@ -46,10 +52,12 @@ namespace Realm {
 		_max_req_size, _priority,
                 _order, _kind, _complete_fence)
       , fd(-1) // defer file open
+      , cfile(0)
     {
       // grab the file's name from the instance metadata
       RegionInstanceImpl *impl = get_runtime()->get_instance_impl(inst);
       filename = impl->metadata.filename;
+      compression = (realm_file_compression_t)(impl->metadata.file_compression);
 
       //MemoryImpl* src_mem_impl = get_runtime()->get_memory_impl(_src_buf.memory);
       //MemoryImpl* dst_mem_impl = get_runtime()->get_memory_impl(_dst_buf.memory);
@@ -77,7 +85,7 @@ namespace Realm {
         default:
           assert(0);
       }
-      file_reqs = (FileRequest*) calloc(max_nr, sizeof(DiskRequest));
+      file_reqs = (FileRequest*) calloc(max_nr, sizeof(FileRequest));
       for (int i = 0; i < max_nr; i++) {
         file_reqs[i].xd = this;
         enqueue_request(&file_reqs[i]);
@@ -99,17 +107,17 @@ namespace Realm {
 	    assert(reqs[i]->mem_base != 0);
 
 	    // have we opened the file yet?
-	    if(fd == -1) {
-#ifdef REALM_USE_KERNEL_AIO
-	      int direct_flag = O_DIRECT;
-#else
-	      int direct_flag = 0;
-#endif
+	    if(compression != LEGION_FILE_COMPRESS_NONE) {
+	      if(!cfile)
+		cfile = CompressedFile::acquire(filename, false /*!writable*/);
+	    } else if(fd == -1) {
 	      fd = open(filename.c_str(),
-			O_RDONLY | direct_flag, 0777);
+			O_RDONLY, 0777);
 	      assert(fd >= 0);
+	      AsyncFileIOContext::get_singleton()->register_file(fd);
 	    }
 	    reqs[i]->fd = fd;
+	    reqs[i]->cfile = cfile;
           }
           break;
         }
@@ -123,17 +131,17 @@ namespace Realm {
             reqs[i]->file_off = reqs[i]->dst_off;
 
 	    // have we opened the file yet?
-	    if(fd == -1) {
-#ifdef REALM_USE_KERNEL_AIO
-	      int direct_flag = O_DIRECT;
-#else
-	      int direct_flag = 0;
-#endif
+	    if(compression != LEGION_FILE_COMPRESS_NONE) {
+	      if(!cfile)
+		cfile = CompressedFile::acquire(filename, true /*writable*/);
+	    } else if(fd == -1) {
 	      fd = open(filename.c_str(),
-			O_RDWR | direct_flag, 0777);
+			O_RDWR, 0777);
 	      assert(fd >= 0);
+	      AsyncFileIOContext::get_singleton()->register_file(fd);
 	    }
 	    reqs[i]->fd = fd;
+	    reqs[i]->cfile = cfile;
           }
           break;
         }
@@ -155,7 +163,13 @@ namespace Realm {
 
     void FileXferDes::flush()
     {
+      // the last user of a compressed file writes out its partial chunks
+      if(cfile) {
+	cfile->release();
+	cfile = 0;
+      }
       if(fd >= 0) {
+	AsyncFileIOContext::get_singleton()->unregister_file(fd);
 	close(fd);
 	fd = -1;
       }
@@ -271,9 +285,43 @@ namespace Realm {
 						    Memory::Z_COPY_MEM };
       static const size_t num_cpu_mem_kinds = sizeof(cpu_mem_kinds) / sizeof(cpu_mem_kinds[0]);
 
-    FileChannel::FileChannel(long max_nr, XferDes::XferKind _kind)
+    FileCompressThread::FileCompressThread(FileChannel *_channel, int _index)
+      : channel(_channel), index(_index), requests_done(0)
+    {}
+
+    void FileCompressThread::thread_loop(void)
+    {
+      log_new_dma.info() << "file compression worker " << index << " started";
+      while(true) {
+	FileRequest *req;
+	{
+	  AutoHSLLock al(channel->compress_lock);
+	  while(channel->compress_pending.empty() && !channel->compress_stopped)
+	    channel->compress_cond.wait();
+	  if(channel->compress_pending.empty())
+	    break;
+	  req = channel->compress_pending.front();
+	  channel->compress_pending.pop_front();
+	}
+	channel->perform_compressed(req);
+	requests_done++;
+	// completions are reported by the DMA thread, in pull()
+	AutoHSLLock al(channel->compress_lock);
+	channel->compress_finished.push_back(req);
+      }
+      log_new_dma.info() << "file compression worker " << index
+			 << " stopped: requests=" << requests_done;
+    }
+
+    FileChannel::FileChannel(long max_nr, XferDes::XferKind _kind,
+			     int num_compress_threads)
       : Channel(_kind)
+      , compress_cond(compress_lock)
+      , compress_stopped(false)
     {
+      for(int i = 0; i < num_compress_threads; i++)
+	compress_workers.push_back(new FileCompressThread(this, i));
+
       unsigned bw = 0; // TODO
       unsigned latency = 0;
       // any combination of SYSTEM/REGDMA/Z_COPY_MEM
@@ -290,14 +338,51 @@ namespace Realm {
 
     FileChannel::~FileChannel()
     {
+      assert(compress_pending.empty() && compress_finished.empty());
+      for(size_t i = 0; i < compress_workers.size(); i++)
+	delete compress_workers[i];
+    }
+
+    void FileChannel::stop(void)
+    {
+      AutoHSLLock al(compress_lock);
+      compress_stopped = true;
+      compress_cond.broadcast();
+    }
+
+    void FileChannel::perform_compressed(FileRequest *req)
+    {
+      switch (kind) {
+        case XferDes::XFER_FILE_READ:
+          req->cfile->read(req->file_off, req->mem_base, req->nbytes);
+          break;
+        case XferDes::XFER_FILE_WRITE:
+          req->cfile->write(req->file_off, req->mem_base, req->nbytes);
+          break;
+        default:
+          assert(0);
+      }
     }
 
     long FileChannel::submit(Request** requests, long nr)
     {
       AsyncFileIOContext* aio_ctx = AsyncFileIOContext::get_singleton();
+      bool wake_workers = false;
       for (long i = 0; i < nr; i++) {
         FileRequest* req = (FileRequest*) requests[i];
 	assert(!req->xd->src_serdez_op && !req->xd->dst_serdez_op); // no serdez support
+	if (req->cfile) {
+	  if (compress_workers.empty()) {
+	    perform_compressed(req);
+	    req->xd->notify_request_read_done(req);
+	    req->xd->notify_request_write_done(req);
+	  } else {
+	    AutoHSLLock al(compress_lock);
+	    compress_pending.push_back(req);
+	    wake_workers = true;
+	  }
+	  continue;
+	}
         switch (kind) {
           case XferDes::XFER_FILE_READ:
             aio_ctx->enqueue_read(req->fd, req->file_off,
@@ -311,12 +396,29 @@ namespace Realm {
             assert(0);
         }
       }
+      if (wake_workers) {
+	AutoHSLLock al(compress_lock);
+	compress_cond.broadcast();
+      }
       return nr;
     }
 
     void FileChannel::pull()
     {
       AsyncFileIOContext::get_singleton()->make_progress();
+      if (!compress_workers.empty()) {
+	std::deque<FileRequest *> finished;
+	{
+	  AutoHSLLock al(compress_lock);
+	  finished.swap(compress_finished);
+	}
+	while (!finished.empty()) {
+	  FileRequest *req = finished.front();
+	  finished.pop_front();
+	  req->xd->notify_request_read_done(req);
+	  req->xd->notify_request_write_done(req);
+	}
+      }
     }
 
     long FileChannel::available()
@@ -17,12 +17,16 @@
 #define LOWLEVEL_CHANNEL_DISK
 
 #include "realm/transfer/channel.h"
+#include "realm/transfer/compressed_file.h"
+
+#include <deque>
 
 namespace Realm {
 
     class FileRequest : public Request {
     public:
       int fd;
+      CompressedFile *cfile; // used instead of 'fd' for compressed files
       void *mem_base; // could be source or dest
       off_t file_off;
     };
@@ -60,6 +64,8 @@ namespace Realm {
       FileRequest* file_reqs;
       std::string filename;
       int fd; // The file that stores the physical instance
+      realm_file_compression_t compression;
+      CompressedFile *cfile; // if compressed, opened instead of 'fd'
       //const char *buf_base;
     };
 
@@ -91,13 +97,45 @@ namespace Realm {
       //const char *buf_base;
     };
 
+    class FileChannel;
+
+    // (de)compresses requests for compressed file instances so that the
+    //  DMA thread can keep the rest of its channels moving
+    class FileCompressThread {
+    public:
+      FileCompressThread(FileChannel *_channel, int _index);
+      void thread_loop(void);
+    protected:
+      FileChannel *channel;
+      int index;
+      size_t requests_done;
+    };
+
     class FileChannel : public Channel {
     public:
-      FileChannel(long max_nr, XferDes::XferKind _kind);
+      FileChannel(long max_nr, XferDes::XferKind _kind,
+                  int num_compress_threads = 0);
       ~FileChannel();
       long submit(Request** requests, long nr);
       void pull();
       long available();
+
+      size_t num_compress_workers(void) const { return compress_workers.size(); }
+      FileCompressThread *get_compress_worker(size_t i) { return compress_workers[i]; }
+      void stop(void);
+
+    protected:
+      friend class FileCompressThread;
+
+      void perform_compressed(FileRequest *req);
+
+      // requests for compressed files go through these queues when there
+      //  are workers - otherwise they're done inline by submit()
+      GASNetHSL compress_lock;
+      GASNetCondVar compress_cond;
+      std::deque<FileRequest *> compress_pending, compress_finished;
+      std::vector<FileCompressThread *> compress_workers;
+      bool compress_stopped;
     };
 
     class DiskChannel : public Channel {
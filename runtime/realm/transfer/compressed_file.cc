@@ -0,0 +1,530 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "realm/transfer/compressed_file.h"
+
+#include "realm/realm_config.h"
+#include "realm/logging.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace Realm {
+
+  Logger log_cfile("cfile");
+
+  namespace Config {
+    size_t file_compress_chunk = 1 << 20;
+    int file_compress_level = 1;
+  };
+
+  // the compressed files currently open, by name - transfers to and from
+  //  the same file share one CompressedFile so that they agree on the
+  //  chunk index and partially-written chunks
+  static std::map<std::string, CompressedFile *> open_compressed_files;
+  static GASNetHSL open_compressed_files_lock;
+
+  static void pread_all(int fd, void *dst, size_t bytes, off_t offset)
+  {
+    while(bytes > 0) {
+      ssize_t ret = pread(fd, dst, bytes, offset);
+      if(ret < 0) {
+	if(errno == EINTR) continue;
+	log_cfile.fatal() << "read failed: " << strerror(errno);
+	assert(0);
+      }
+      if(ret == 0) {
+	log_cfile.fatal() << "unexpected end of file at offset " << offset;
+	assert(0);
+      }
+      dst = ((char *)dst) + ret;
+      bytes -= ret;
+      offset += ret;
+    }
+  }
+
+  static void pwrite_all(int fd, const void *src, size_t bytes, off_t offset)
+  {
+    while(bytes > 0) {
+      ssize_t ret = pwrite(fd, src, bytes, offset);
+      if(ret < 0) {
+	if(errno == EINTR) continue;
+	log_cfile.fatal() << "write failed: " << strerror(errno);
+	assert(0);
+      }
+      src = ((const char *)src) + ret;
+      bytes -= ret;
+      offset += ret;
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class CompressedFile
+  //
+
+  /*static*/ void CompressedFile::create(const char *filename,
+					 size_t logical_size,
+					 realm_file_compression_t compression)
+  {
+#ifndef USE_ZLIB
+    if(compression == LEGION_FILE_COMPRESS_ZLIB) {
+      log_cfile.fatal() << "zlib compression requested for '" << filename
+			<< "', but Realm was built without USE_ZLIB";
+      assert(0);
+    }
+#endif
+    assert(compression != LEGION_FILE_COMPRESS_NONE);
+    assert(Config::file_compress_chunk > 0);
+
+    int fd = open(filename, O_CREAT | O_TRUNC | O_RDWR, 0777);
+    if(fd < 0) {
+      log_cfile.fatal() << "could not create '" << filename << "': "
+			<< strerror(errno);
+      assert(0);
+    }
+
+    FileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = FILE_MAGIC;
+    hdr.version = FORMAT_VERSION;
+    hdr.compression = compression;
+    hdr.chunk_size = Config::file_compress_chunk;
+    hdr.logical_size = logical_size;
+    pwrite_all(fd, &hdr, sizeof(hdr), 0);
+
+    int ret = close(fd);
+    assert(ret == 0);
+  }
+
+  /*static*/ CompressedFile *CompressedFile::acquire(const std::string& filename,
+						      bool writable)
+  {
+    AutoHSLLock al(open_compressed_files_lock);
+
+    std::map<std::string, CompressedFile *>::iterator it = open_compressed_files.find(filename);
+    if(it != open_compressed_files.end()) {
+      // a file opened for reading has to be reopened to be written, but
+      //  that can't happen while a read is still using it
+      assert(!writable || it->second->writable);
+      it->second->refcount++;
+      return it->second;
+    }
+
+    int fd = open(filename.c_str(), (writable ? O_RDWR : O_RDONLY), 0777);
+    if(fd < 0) {
+      log_cfile.fatal() << "could not open '" << filename << "': "
+			<< strerror(errno);
+      assert(0);
+    }
+
+    CompressedFile *cf = new CompressedFile(filename, fd, writable);
+    open_compressed_files[filename] = cf;
+    return cf;
+  }
+
+  void CompressedFile::release(void)
+  {
+    {
+      AutoHSLLock al(open_compressed_files_lock);
+      assert(refcount > 0);
+      if(--refcount > 0)
+	return;
+      open_compressed_files.erase(filename);
+    }
+    delete this;
+  }
+
+  CompressedFile::CompressedFile(const std::string& _filename, int _fd,
+				 bool _writable)
+    : filename(_filename), fd(_fd), writable(_writable), refcount(1)
+  {
+    load_index();
+  }
+
+  CompressedFile::~CompressedFile(void)
+  {
+    if(writable) {
+      flush_partial_chunks();
+      compact();
+    }
+    assert(partial_chunks.empty());
+    int ret = close(fd);
+    assert(ret == 0);
+  }
+
+  void CompressedFile::load_index(void)
+  {
+    FileHeader hdr;
+    pread_all(fd, &hdr, sizeof(hdr), 0);
+    if((hdr.magic != FILE_MAGIC) || (hdr.version != FORMAT_VERSION)) {
+      log_cfile.fatal() << "'" << filename << "' is not a compressed file instance";
+      assert(0);
+    }
+    compression = (realm_file_compression_t)(hdr.compression);
+#ifndef USE_ZLIB
+    if(compression == LEGION_FILE_COMPRESS_ZLIB) {
+      log_cfile.fatal() << "'" << filename << "' is zlib-compressed, but Realm was built without USE_ZLIB";
+      assert(0);
+    }
+#endif
+    chunk_size = hdr.chunk_size;
+    logical_size = hdr.logical_size;
+    assert(chunk_size > 0);
+
+    ChunkLocation empty;
+    empty.offset = 0;
+    empty.flags = 0;
+    empty.stored_bytes = 0;
+    chunks.assign((logical_size + chunk_size - 1) / chunk_size, empty);
+
+    off_t file_size = lseek(fd, 0, SEEK_END);
+    assert(file_size >= (off_t)sizeof(hdr));
+
+    // later records for a chunk replace earlier ones - a record cut short
+    //  (e.g. by a crash while appending) is ignored, along with anything
+    //  after it
+    off_t pos = sizeof(hdr);
+    size_t records = 0;
+    while((pos + (off_t)sizeof(RecordHeader)) <= file_size) {
+      RecordHeader rec;
+      pread_all(fd, &rec, sizeof(rec), pos);
+      if((rec.magic != RECORD_MAGIC) ||
+	 (rec.chunk_index >= chunks.size()) ||
+	 (rec.raw_bytes != chunk_bytes(rec.chunk_index)) ||
+	 ((pos + (off_t)sizeof(rec) + (off_t)rec.stored_bytes) > file_size)) {
+	log_cfile.warning() << "'" << filename << "': ignoring data after offset " << pos;
+	break;
+      }
+      ChunkLocation& loc = chunks[rec.chunk_index];
+      loc.offset = pos + sizeof(rec);
+      loc.flags = rec.flags;
+      loc.stored_bytes = rec.stored_bytes;
+      pos += sizeof(rec) + rec.stored_bytes;
+      records++;
+    }
+    append_offset = pos;
+
+    log_cfile.info() << "opened '" << filename << "': size=" << logical_size
+		     << " chunk=" << chunk_size << " records=" << records
+		     << " writable=" << writable;
+  }
+
+  size_t CompressedFile::chunk_bytes(size_t index) const
+  {
+    size_t start = index * chunk_size;
+    return std::min(chunk_size, logical_size - start);
+  }
+
+  void CompressedFile::read_chunk(size_t index, void *dst)
+  {
+    ChunkLocation loc;
+    {
+      AutoHSLLock al(mutex);
+      loc = chunks[index];
+    }
+    size_t bytes = chunk_bytes(index);
+
+    if(loc.stored_bytes == 0) {
+      // never written
+      memset(dst, 0, bytes);
+      return;
+    }
+
+    if((loc.flags & RECORD_STORED) != 0) {
+      assert(loc.stored_bytes == bytes);
+      pread_all(fd, dst, bytes, loc.offset);
+      return;
+    }
+
+    char *buffer = (char *)malloc(loc.stored_bytes);
+    assert(buffer != 0);
+    pread_all(fd, buffer, loc.stored_bytes, loc.offset);
+    switch(compression) {
+#ifdef USE_ZLIB
+    case LEGION_FILE_COMPRESS_ZLIB:
+      {
+	uLongf out_bytes = bytes;
+	int ret = uncompress((Bytef *)dst, &out_bytes,
+			     (const Bytef *)buffer, loc.stored_bytes);
+	if((ret != Z_OK) || (out_bytes != bytes)) {
+	  log_cfile.fatal() << "'" << filename << "': chunk " << index
+			    << " is corrupt (zlib error " << ret << ")";
+	  assert(0);
+	}
+	break;
+      }
+#endif
+    default:
+      assert(0);
+    }
+    free(buffer);
+  }
+
+  void CompressedFile::write_chunk(size_t index, const void *src)
+  {
+    size_t bytes = chunk_bytes(index);
+
+    // compress into a buffer with room for the record header in front so
+    //  that the whole record goes out in a single write
+    size_t bound = bytes;
+#ifdef USE_ZLIB
+    if(compression == LEGION_FILE_COMPRESS_ZLIB)
+      bound = compressBound(bytes);
+#endif
+    char *buffer = (char *)malloc(sizeof(RecordHeader) + bound);
+    assert(buffer != 0);
+    char *payload = buffer + sizeof(RecordHeader);
+
+    size_t stored_bytes = 0;
+    switch(compression) {
+#ifdef USE_ZLIB
+    case LEGION_FILE_COMPRESS_ZLIB:
+      {
+	uLongf out_bytes = bound;
+	int ret = compress2((Bytef *)payload, &out_bytes,
+			    (const Bytef *)src, bytes,
+			    Config::file_compress_level);
+	assert(ret == Z_OK);
+	stored_bytes = out_bytes;
+	break;
+      }
+#endif
+    default:
+      assert(0);
+    }
+
+    RecordHeader rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = RECORD_MAGIC;
+    rec.chunk_index = index;
+    rec.raw_bytes = bytes;
+    if(stored_bytes >= bytes) {
+      // didn't help - store it as is
+      memcpy(payload, src, bytes);
+      stored_bytes = bytes;
+      rec.flags |= RECORD_STORED;
+    }
+    rec.stored_bytes = stored_bytes;
+    memcpy(buffer, &rec, sizeof(rec));
+
+    // claim space at the end of the file - the index is updated right away
+    //  because nobody reads a chunk while it is being written
+    off_t pos;
+    {
+      AutoHSLLock al(mutex);
+      pos = append_offset;
+      append_offset += sizeof(rec) + stored_bytes;
+      ChunkLocation& loc = chunks[index];
+      loc.offset = pos + sizeof(rec);
+      loc.flags = rec.flags;
+      loc.stored_bytes = stored_bytes;
+    }
+    pwrite_all(fd, buffer, sizeof(rec) + stored_bytes, pos);
+    free(buffer);
+  }
+
+  void CompressedFile::read(size_t offset, void *dst, size_t bytes)
+  {
+    assert((offset + bytes) <= logical_size);
+
+    char *chunk_buffer = 0;
+    while(bytes > 0) {
+      size_t index = offset / chunk_size;
+      size_t rel = offset - (index * chunk_size);
+      size_t cbytes = chunk_bytes(index);
+      size_t amt = std::min(bytes, cbytes - rel);
+
+      // data that hasn't been compressed yet comes from the partial chunk
+      bool found = false;
+      {
+	AutoHSLLock al(mutex);
+	std::map<size_t, PartialChunk>::const_iterator it = partial_chunks.find(index);
+	if(it != partial_chunks.end()) {
+	  memcpy(dst, it->second.data + rel, amt);
+	  found = true;
+	}
+      }
+
+      if(!found) {
+	if(amt == cbytes) {
+	  // whole chunk - decompress straight into the destination
+	  read_chunk(index, dst);
+	} else {
+	  if(!chunk_buffer) {
+	    chunk_buffer = (char *)malloc(chunk_size);
+	    assert(chunk_buffer != 0);
+	  }
+	  read_chunk(index, chunk_buffer);
+	  memcpy(dst, chunk_buffer + rel, amt);
+	}
+      }
+
+      dst = ((char *)dst) + amt;
+      offset += amt;
+      bytes -= amt;
+    }
+    if(chunk_buffer)
+      free(chunk_buffer);
+  }
+
+  void CompressedFile::write(size_t offset, const void *src, size_t bytes)
+  {
+    assert(writable);
+    assert((offset + bytes) <= logical_size);
+
+    while(bytes > 0) {
+      size_t index = offset / chunk_size;
+      size_t rel = offset - (index * chunk_size);
+      size_t cbytes = chunk_bytes(index);
+      size_t amt = std::min(bytes, cbytes - rel);
+
+      if(amt == cbytes) {
+	// whole chunk - this supersedes any partial data we were holding
+	{
+	  AutoHSLLock al(mutex);
+	  std::map<size_t, PartialChunk>::iterator it = partial_chunks.find(index);
+	  if(it != partial_chunks.end()) {
+	    free(it->second.data);
+	    partial_chunks.erase(it);
+	  }
+	}
+	write_chunk(index, src);
+      } else {
+	// accumulate pieces of the chunk until all of it has been written -
+	//  the first piece starts from whatever is already in the file so
+	//  that a chunk that's only ever partially overwritten keeps the
+	//  rest of its contents
+	char *full = 0;
+	char *initial = 0;
+	while(true) {
+	  {
+	    AutoHSLLock al(mutex);
+	    std::map<size_t, PartialChunk>::iterator it = partial_chunks.find(index);
+	    if(it == partial_chunks.end() && initial) {
+	      PartialChunk pc;
+	      pc.data = initial;
+	      pc.bytes_written = 0;
+	      it = partial_chunks.insert(std::make_pair(index, pc)).first;
+	      initial = 0;
+	    }
+	    if(it != partial_chunks.end()) {
+	      memcpy(it->second.data + rel, src, amt);
+	      // overlapping writes can overcount, which just means the chunk is
+	      //  compressed (and maybe restarted from the file) a bit early
+	      it->second.bytes_written += amt;
+	      if(it->second.bytes_written >= cbytes) {
+		full = it->second.data;
+		partial_chunks.erase(it);
+	      }
+	      break;
+	    }
+	  }
+	  // nobody has started this chunk - read it in outside the lock (which
+	  //  read_chunk takes itself) and try again, since somebody else may
+	  //  start (or even finish) the chunk in the meantime
+	  initial = (char *)malloc(cbytes);
+	  assert(initial != 0);
+	  read_chunk(index, initial);
+	}
+	// lost the race to start the chunk
+	if(initial)
+	  free(initial);
+	if(full) {
+	  write_chunk(index, full);
+	  free(full);
+	}
+      }
+
+      src = ((const char *)src) + amt;
+      offset += amt;
+      bytes -= amt;
+    }
+  }
+
+  void CompressedFile::flush_partial_chunks(void)
+  {
+    // only called once all transfers using the file are done, so no lock
+    //  is needed
+    for(std::map<size_t, PartialChunk>::iterator it = partial_chunks.begin();
+	it != partial_chunks.end();
+	++it) {
+      write_chunk(it->first, it->second.data);
+      free(it->second.data);
+    }
+    partial_chunks.clear();
+  }
+
+  void CompressedFile::compact(void)
+  {
+    // like flush_partial_chunks, only called once the file is idle
+    off_t live_bytes = 0;
+    for(size_t i = 0; i < chunks.size(); i++)
+      if(chunks[i].stored_bytes > 0)
+	live_bytes += sizeof(RecordHeader) + chunks[i].stored_bytes;
+    off_t dead_bytes = append_offset - sizeof(FileHeader) - live_bytes;
+    if(dead_bytes <= live_bytes)
+      return;
+
+    log_cfile.info() << "compacting '" << filename << "': live=" << live_bytes
+		     << " dead=" << dead_bytes;
+
+    // write a new copy next to the old one and then rename it into place,
+    //  so that a failure part way through leaves the old file intact
+    std::string tmpname = filename + ".compact";
+    int new_fd = open(tmpname.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0777);
+    if(new_fd < 0) {
+      log_cfile.warning() << "could not compact '" << filename << "': "
+			  << strerror(errno);
+      return;
+    }
+
+    FileHeader hdr;
+    pread_all(fd, &hdr, sizeof(hdr), 0);
+    pwrite_all(new_fd, &hdr, sizeof(hdr), 0);
+
+    off_t pos = sizeof(hdr);
+    std::vector<char> buffer;
+    for(size_t i = 0; i < chunks.size(); i++) {
+      ChunkLocation& loc = chunks[i];
+      if(loc.stored_bytes == 0) continue;
+      // the record header sits right in front of the payload
+      size_t rec_bytes = sizeof(RecordHeader) + loc.stored_bytes;
+      buffer.resize(rec_bytes);
+      pread_all(fd, &buffer[0], rec_bytes, loc.offset - sizeof(RecordHeader));
+      pwrite_all(new_fd, &buffer[0], rec_bytes, pos);
+      loc.offset = pos + sizeof(RecordHeader);
+      pos += rec_bytes;
+    }
+    append_offset = pos;
+
+    int ret = rename(tmpname.c_str(), filename.c_str());
+    assert(ret == 0);
+    ret = close(fd);
+    assert(ret == 0);
+    fd = new_fd;
+  }
+
+}; // namespace Realm
@@ -0,0 +1,142 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// chunked, compressed storage for attached file instances
+
+#ifndef REALM_COMPRESSED_FILE_H
+#define REALM_COMPRESSED_FILE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "realm/realm_c.h"
+#include "realm/activemsg.h"
+
+namespace Realm {
+
+  // a compressed file holds the same logical bytes as an uncompressed file
+  //  instance, but split into fixed-size chunks that are compressed
+  //  independently:
+  //
+  //    file header | record | record | ...
+  //
+  // each record is a record header followed by the (possibly compressed)
+  //  contents of one chunk - records are only ever appended, and when a
+  //  chunk appears more than once the last record wins, so the chunk index
+  //  is rebuilt by scanning the record headers when the file is opened and
+  //  no separate index needs to be kept consistent (superseded records are
+  //  dropped when the file is closed, if they've come to outweigh the rest)
+  // chunks that have never been written read as zeros, and chunks that
+  //  don't compress are stored as-is
+  class CompressedFile {
+  public:
+    static const unsigned FILE_MAGIC = 0x5a4d4c52;   // "RLMZ"
+    static const unsigned RECORD_MAGIC = 0x4b435a52; // "RZCK"
+    static const unsigned FORMAT_VERSION = 1;
+
+    enum {
+      RECORD_STORED = 1,  // contents are not compressed
+    };
+
+    struct FileHeader {
+      unsigned magic;
+      unsigned version;
+      unsigned compression;  // realm_file_compression_t
+      unsigned chunk_size;
+      unsigned long long logical_size;
+    };
+
+    struct RecordHeader {
+      unsigned magic;
+      unsigned flags;
+      unsigned long long chunk_index;
+      unsigned raw_bytes;      // may be short for the last chunk
+      unsigned stored_bytes;
+    };
+
+    // creates (or truncates) 'filename' as an empty compressed file that
+    //  will hold 'logical_size' bytes
+    static void create(const char *filename, size_t logical_size,
+		       realm_file_compression_t compression);
+
+    // returns the open file shared by all transfers to/from 'filename',
+    //  opening it on first use - every acquire must be matched by a
+    //  release, and the last release writes out any partially-filled
+    //  chunks and closes the file
+    static CompressedFile *acquire(const std::string& filename, bool writable);
+    void release(void);
+
+    // these may be called concurrently (e.g. by several compression
+    //  workers) - compression and decompression happen outside the lock
+    void read(size_t offset, void *dst, size_t bytes);
+    void write(size_t offset, const void *src, size_t bytes);
+
+    size_t get_logical_size(void) const { return logical_size; }
+    size_t get_chunk_size(void) const { return chunk_size; }
+
+  protected:
+    CompressedFile(const std::string& _filename, int _fd, bool _writable);
+    ~CompressedFile(void);
+
+    // scans the records to build the chunk index
+    void load_index(void);
+
+    size_t chunk_bytes(size_t index) const;
+
+    // reads and decompresses one whole chunk - 'dst' must hold
+    //  chunk_bytes(index) bytes
+    void read_chunk(size_t index, void *dst);
+
+    // compresses one whole chunk and appends it to the file
+    void write_chunk(size_t index, const void *src);
+
+    void flush_partial_chunks(void);
+
+    // rewrites the file without superseded records, if they take up more
+    //  space than the live ones
+    void compact(void);
+
+    struct ChunkLocation {
+      off_t offset;           // of the record's payload
+      unsigned flags;
+      unsigned stored_bytes;
+    };
+
+    // a chunk that has been written in pieces - it's only compressed once
+    //  every byte has been written (or the file is closed)
+    struct PartialChunk {
+      char *data;
+      size_t bytes_written;
+    };
+
+    std::string filename;
+    int fd;
+    bool writable;
+    int refcount;
+    realm_file_compression_t compression;
+    size_t logical_size, chunk_size;
+    off_t append_offset;
+    GASNetHSL mutex;
+    std::vector<ChunkLocation> chunks;  // stored_bytes == 0 -> not written
+    std::map<size_t, PartialChunk> partial_chunks;
+  };
+
+}; // namespace Realm
+
+#endif // ifndef REALM_COMPRESSED_FILE_H
@@ -0,0 +1,914 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host-side kernels for strided (2-D/3-D) copies, fills and reductions
+
+#include "realm/realm_config.h"
+#include "realm/transfer/copy_kernels.h"
+#include "realm/logging.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+// the vector kernels use per-function target attributes, so the rest of
+//  the runtime doesn't need to be built with -mavx2/-mavx512f
+#if defined(__x86_64__) && defined(__GNUC__)
+#define REALM_COPY_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace Realm {
+
+  namespace Config {
+    int dma_copy_kernels = CopyKernels::LEVEL_AVX512;
+    size_t dma_fill_stream_threshold = 16 << 20;
+  };
+
+  Logger log_copy_kernels("copykernels");
+
+  namespace CopyKernels {
+
+    // copies a B x B tile of E-byte elements: element (r,c) of the source
+    //  (at src + r*sstride + c*E) goes to element (c,r) of the destination
+    typedef void (*TileFn)(char *dst, off_t dstride,
+			   const char *src, off_t sstride);
+
+    static volatile int active_level = -1;
+
+    Level get_level(void)
+    {
+      int level = active_level;
+      if(level >= 0)
+	return (Level)level;
+
+      level = Config::dma_copy_kernels;
+      if(level < LEVEL_MEMCPY) level = LEVEL_MEMCPY;
+      if(level > LEVEL_AVX512) level = LEVEL_AVX512;
+#ifdef REALM_COPY_KERNELS_X86
+      if((level >= LEVEL_AVX512) && !__builtin_cpu_supports("avx512f"))
+	level = LEVEL_AVX2;
+      if((level >= LEVEL_AVX2) && !__builtin_cpu_supports("avx2"))
+	level = LEVEL_SCALAR;
+#else
+      if(level > LEVEL_SCALAR)
+	level = LEVEL_SCALAR;
+#endif
+      // racing initializers all compute the same answer
+      active_level = level;
+      log_copy_kernels.info() << "copy kernels: " << level_name((Level)level);
+      return (Level)level;
+    }
+
+    const char *level_name(Level level)
+    {
+      switch(level) {
+      case LEVEL_MEMCPY: return "memcpy";
+      case LEVEL_SCALAR: return "scalar";
+      case LEVEL_AVX2: return "avx2";
+      case LEVEL_AVX512: return "avx512";
+      }
+      return "unknown";
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // scalar kernels
+    //
+    // a memcpy with a constant size compiles to plain (unaligned) loads and
+    //  stores, which is the whole point - a libc call per 4-byte element
+    //  costs far more than the copy itself
+
+    static void copy_lines(char *dst, const char *src, size_t bytes,
+			   size_t lines, off_t src_lstride, off_t dst_lstride,
+			   size_t planes, off_t src_pstride, off_t dst_pstride)
+    {
+      for(size_t j = 0; j < planes; j++) {
+	const char *s = src + j * src_pstride;
+	char *d = dst + j * dst_pstride;
+	for(size_t i = 0; i < lines; i++) {
+	  memcpy(d, s, bytes);
+	  s += src_lstride;
+	  d += dst_lstride;
+	}
+      }
+    }
+
+    template <size_t E>
+    static void copy_elements(char *dst, const char *src,
+			      size_t lines, off_t src_lstride, off_t dst_lstride,
+			      size_t planes, off_t src_pstride, off_t dst_pstride)
+    {
+      for(size_t j = 0; j < planes; j++) {
+	const char *s = src + j * src_pstride;
+	char *d = dst + j * dst_pstride;
+	if(dst_lstride == (off_t)E) {
+	  // gather
+	  for(size_t i = 0; i < lines; i++)
+	    memcpy(d + i * E, s + i * src_lstride, E);
+	} else if(src_lstride == (off_t)E) {
+	  // scatter
+	  for(size_t i = 0; i < lines; i++)
+	    memcpy(d + i * dst_lstride, s + i * E, E);
+	} else {
+	  for(size_t i = 0; i < lines; i++)
+	    memcpy(d + i * dst_lstride, s + i * src_lstride, E);
+	}
+      }
+    }
+
+    template <size_t E, size_t B>
+    static void tile_scalar(char *dst, off_t dstride,
+			    const char *src, off_t sstride)
+    {
+      for(size_t r = 0; r < B; r++)
+	for(size_t c = 0; c < B; c++)
+	  memcpy(dst + c * dstride + r * E, src + r * sstride + c * E, E);
+    }
+
+    // copies elements [r_lo,r_hi) x [c_lo,c_hi) of a transpose with
+    //  arbitrary element strides
+    template <size_t E>
+    static void transpose_block(char *dst, off_t drow, off_t dcol,
+				const char *src, off_t srow, off_t scol,
+				size_t r_lo, size_t r_hi,
+				size_t c_lo, size_t c_hi)
+    {
+      for(size_t r = r_lo; r < r_hi; r++)
+	for(size_t c = c_lo; c < c_hi; c++)
+	  memcpy(dst + c * drow + r * dcol, src + r * srow + c * scol, E);
+    }
+
+    // transposes a 'rows' x 'cols' matrix of E-byte elements: element (r,c)
+    //  at src + r*srow + c*scol goes to dst + c*drow + r*dcol
+    // the work is done in B x B tiles (with 'tile' if the elements are
+    //  packed on both sides), working through the columns in chunks so
+    //  that the destination rows being filled stay in cache from one band
+    //  of source rows to the next
+    template <size_t E>
+    static void transpose(char *dst, off_t drow, off_t dcol,
+			  const char *src, off_t srow, off_t scol,
+			  size_t rows, size_t cols, TileFn tile, size_t B)
+    {
+      const size_t CHUNK = 64;  // columns per chunk, a multiple of any B
+      if((scol != (off_t)E) || (dcol != (off_t)E))
+	tile = 0;
+      size_t rfull = rows - (rows % B);
+      for(size_t c_lo = 0; c_lo < cols; c_lo += CHUNK) {
+	size_t c_hi = c_lo + CHUNK;
+	if(c_hi > cols) c_hi = cols;
+	size_t cfull = c_hi - ((c_hi - c_lo) % B);
+	for(size_t r0 = 0; r0 < rfull; r0 += B) {
+	  if(tile) {
+	    for(size_t c0 = c_lo; c0 < cfull; c0 += B)
+	      (*tile)(dst + c0 * drow + r0 * E, drow,
+		      src + r0 * srow + c0 * E, srow);
+	  } else {
+	    for(size_t c0 = c_lo; c0 < cfull; c0 += B)
+	      transpose_block<E>(dst, drow, dcol, src, srow, scol,
+				 r0, r0 + B, c0, c0 + B);
+	  }
+	  // ragged columns
+	  transpose_block<E>(dst, drow, dcol, src, srow, scol,
+			     r0, r0 + B, cfull, c_hi);
+	}
+	// ragged rows
+	transpose_block<E>(dst, drow, dcol, src, srow, scol,
+			   rfull, rows, c_lo, c_hi);
+      }
+    }
+
+#ifdef REALM_COPY_KERNELS_X86
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // vector tile transposes - these only shuffle bits around, so using
+    //  the float/double flavors of the intrinsics is fine for any data
+
+    // 8x8 tile of 4-byte elements
+    __attribute__((target("avx2")))
+    static void tile_avx2_4(char *dst, off_t dstride,
+			    const char *src, off_t sstride)
+    {
+      __m256 r0 = _mm256_loadu_ps((const float *)(src + 0 * sstride));
+      __m256 r1 = _mm256_loadu_ps((const float *)(src + 1 * sstride));
+      __m256 r2 = _mm256_loadu_ps((const float *)(src + 2 * sstride));
+      __m256 r3 = _mm256_loadu_ps((const float *)(src + 3 * sstride));
+      __m256 r4 = _mm256_loadu_ps((const float *)(src + 4 * sstride));
+      __m256 r5 = _mm256_loadu_ps((const float *)(src + 5 * sstride));
+      __m256 r6 = _mm256_loadu_ps((const float *)(src + 6 * sstride));
+      __m256 r7 = _mm256_loadu_ps((const float *)(src + 7 * sstride));
+
+      // interleave pairs of rows
+      __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+      __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+      __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+      __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+      __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+      __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+      __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+      __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+
+      // gather 4-element columns within each 128-bit lane
+      __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0));
+      __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2));
+      __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0));
+      __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2));
+      __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1,0,1,0));
+      __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3,2,3,2));
+      __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1,0,1,0));
+      __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3,2,3,2));
+
+      // and finally combine the lanes of the top and bottom halves
+      _mm256_storeu_ps((float *)(dst + 0 * dstride), _mm256_permute2f128_ps(u0, u4, 0x20));
+      _mm256_storeu_ps((float *)(dst + 1 * dstride), _mm256_permute2f128_ps(u1, u5, 0x20));
+      _mm256_storeu_ps((float *)(dst + 2 * dstride), _mm256_permute2f128_ps(u2, u6, 0x20));
+      _mm256_storeu_ps((float *)(dst + 3 * dstride), _mm256_permute2f128_ps(u3, u7, 0x20));
+      _mm256_storeu_ps((float *)(dst + 4 * dstride), _mm256_permute2f128_ps(u0, u4, 0x31));
+      _mm256_storeu_ps((float *)(dst + 5 * dstride), _mm256_permute2f128_ps(u1, u5, 0x31));
+      _mm256_storeu_ps((float *)(dst + 6 * dstride), _mm256_permute2f128_ps(u2, u6, 0x31));
+      _mm256_storeu_ps((float *)(dst + 7 * dstride), _mm256_permute2f128_ps(u3, u7, 0x31));
+    }
+
+    // 4x4 tile of 8-byte elements
+    __attribute__((target("avx2")))
+    static void tile_avx2_8(char *dst, off_t dstride,
+			    const char *src, off_t sstride)
+    {
+      __m256d r0 = _mm256_loadu_pd((const double *)(src + 0 * sstride));
+      __m256d r1 = _mm256_loadu_pd((const double *)(src + 1 * sstride));
+      __m256d r2 = _mm256_loadu_pd((const double *)(src + 2 * sstride));
+      __m256d r3 = _mm256_loadu_pd((const double *)(src + 3 * sstride));
+
+      __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+      __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+      __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+      __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+      _mm256_storeu_pd((double *)(dst + 0 * dstride), _mm256_permute2f128_pd(t0, t2, 0x20));
+      _mm256_storeu_pd((double *)(dst + 1 * dstride), _mm256_permute2f128_pd(t1, t3, 0x20));
+      _mm256_storeu_pd((double *)(dst + 2 * dstride), _mm256_permute2f128_pd(t0, t2, 0x31));
+      _mm256_storeu_pd((double *)(dst + 3 * dstride), _mm256_permute2f128_pd(t1, t3, 0x31));
+    }
+
+    // 8x8 tile of 8-byte elements
+    __attribute__((target("avx512f")))
+    static void tile_avx512_8(char *dst, off_t dstride,
+			      const char *src, off_t sstride)
+    {
+      __m512d r0 = _mm512_loadu_pd((const double *)(src + 0 * sstride));
+      __m512d r1 = _mm512_loadu_pd((const double *)(src + 1 * sstride));
+      __m512d r2 = _mm512_loadu_pd((const double *)(src + 2 * sstride));
+      __m512d r3 = _mm512_loadu_pd((const double *)(src + 3 * sstride));
+      __m512d r4 = _mm512_loadu_pd((const double *)(src + 4 * sstride));
+      __m512d r5 = _mm512_loadu_pd((const double *)(src + 5 * sstride));
+      __m512d r6 = _mm512_loadu_pd((const double *)(src + 6 * sstride));
+      __m512d r7 = _mm512_loadu_pd((const double *)(src + 7 * sstride));
+
+      // 128-bit lane k of t0 holds { r0[2k], r1[2k] }, of t1 { r0[2k+1], r1[2k+1] }
+      // (these are _mm512_unpack{lo,hi}_pd, but some versions of gcc's
+      //  headers trip -Wuninitialized on those)
+      const __m512i unpack_lo = _mm512_set_epi64(14, 6, 12, 4, 10, 2, 8, 0);
+      const __m512i unpack_hi = _mm512_set_epi64(15, 7, 13, 5, 11, 3, 9, 1);
+      __m512d t0 = _mm512_permutex2var_pd(r0, unpack_lo, r1);
+      __m512d t1 = _mm512_permutex2var_pd(r0, unpack_hi, r1);
+      __m512d t2 = _mm512_permutex2var_pd(r2, unpack_lo, r3);
+      __m512d t3 = _mm512_permutex2var_pd(r2, unpack_hi, r3);
+      __m512d t4 = _mm512_permutex2var_pd(r4, unpack_lo, r5);
+      __m512d t5 = _mm512_permutex2var_pd(r4, unpack_hi, r5);
+      __m512d t6 = _mm512_permutex2var_pd(r6, unpack_lo, r7);
+      __m512d t7 = _mm512_permutex2var_pd(r6, unpack_hi, r7);
+
+      // lanes { 0, 2 } and { 1, 3 } of each pair of rows
+      const __m512i even_lanes = _mm512_set_epi64(13, 12, 5, 4, 9, 8, 1, 0);
+      const __m512i odd_lanes = _mm512_set_epi64(15, 14, 7, 6, 11, 10, 3, 2);
+      __m512d u0 = _mm512_permutex2var_pd(t0, even_lanes, t2); // cols 0, 4 of rows 0-3
+      __m512d u1 = _mm512_permutex2var_pd(t0, odd_lanes, t2);  // cols 2, 6
+      __m512d u2 = _mm512_permutex2var_pd(t1, even_lanes, t3); // cols 1, 5
+      __m512d u3 = _mm512_permutex2var_pd(t1, odd_lanes, t3);  // cols 3, 7
+      __m512d u4 = _mm512_permutex2var_pd(t4, even_lanes, t6); // same for rows 4-7
+      __m512d u5 = _mm512_permutex2var_pd(t4, odd_lanes, t6);
+      __m512d u6 = _mm512_permutex2var_pd(t5, even_lanes, t7);
+      __m512d u7 = _mm512_permutex2var_pd(t5, odd_lanes, t7);
+
+      // low halves form columns 0-3, high halves columns 4-7
+      const __m512i lo_halves = _mm512_set_epi64(11, 10, 9, 8, 3, 2, 1, 0);
+      const __m512i hi_halves = _mm512_set_epi64(15, 14, 13, 12, 7, 6, 5, 4);
+      _mm512_storeu_pd((double *)(dst + 0 * dstride), _mm512_permutex2var_pd(u0, lo_halves, u4));
+      _mm512_storeu_pd((double *)(dst + 1 * dstride), _mm512_permutex2var_pd(u2, lo_halves, u6));
+      _mm512_storeu_pd((double *)(dst + 2 * dstride), _mm512_permutex2var_pd(u1, lo_halves, u5));
+      _mm512_storeu_pd((double *)(dst + 3 * dstride), _mm512_permutex2var_pd(u3, lo_halves, u7));
+      _mm512_storeu_pd((double *)(dst + 4 * dstride), _mm512_permutex2var_pd(u0, hi_halves, u4));
+      _mm512_storeu_pd((double *)(dst + 5 * dstride), _mm512_permutex2var_pd(u2, hi_halves, u6));
+      _mm512_storeu_pd((double *)(dst + 6 * dstride), _mm512_permutex2var_pd(u1, hi_halves, u5));
+      _mm512_storeu_pd((double *)(dst + 7 * dstride), _mm512_permutex2var_pd(u3, hi_halves, u7));
+    }
+
+    // 4x4 tile of 16-byte elements, done as four 2x2 blocks - each pair of
+    //  rows swaps 128-bit halves
+    __attribute__((target("avx2")))
+    static void tile_avx2_16(char *dst, off_t dstride,
+			     const char *src, off_t sstride)
+    {
+      for(int rb = 0; rb < 4; rb += 2)
+	for(int cb = 0; cb < 4; cb += 2) {
+	  __m256i r0 = _mm256_loadu_si256((const __m256i *)(src + rb * sstride + cb * 16));
+	  __m256i r1 = _mm256_loadu_si256((const __m256i *)(src + (rb + 1) * sstride + cb * 16));
+	  _mm256_storeu_si256((__m256i *)(dst + cb * dstride + rb * 16),
+			      _mm256_permute2x128_si256(r0, r1, 0x20));
+	  _mm256_storeu_si256((__m256i *)(dst + (cb + 1) * dstride + rb * 16),
+			      _mm256_permute2x128_si256(r0, r1, 0x31));
+	}
+    }
+
+    // 4x4 tile of 16-byte elements - one row per register
+    __attribute__((target("avx512f")))
+    static void tile_avx512_16(char *dst, off_t dstride,
+			       const char *src, off_t sstride)
+    {
+      __m512i r0 = _mm512_loadu_si512((const void *)(src + 0 * sstride));
+      __m512i r1 = _mm512_loadu_si512((const void *)(src + 1 * sstride));
+      __m512i r2 = _mm512_loadu_si512((const void *)(src + 2 * sstride));
+      __m512i r3 = _mm512_loadu_si512((const void *)(src + 3 * sstride));
+
+      // columns 0-1 and 2-3 of each pair of rows
+      __m512i t0 = _mm512_shuffle_i64x2(r0, r1, _MM_SHUFFLE(1,0,1,0));
+      __m512i t1 = _mm512_shuffle_i64x2(r0, r1, _MM_SHUFFLE(3,2,3,2));
+      __m512i t2 = _mm512_shuffle_i64x2(r2, r3, _MM_SHUFFLE(1,0,1,0));
+      __m512i t3 = _mm512_shuffle_i64x2(r2, r3, _MM_SHUFFLE(3,2,3,2));
+
+      _mm512_storeu_si512((void *)(dst + 0 * dstride), _mm512_shuffle_i64x2(t0, t2, _MM_SHUFFLE(2,0,2,0)));
+      _mm512_storeu_si512((void *)(dst + 1 * dstride), _mm512_shuffle_i64x2(t0, t2, _MM_SHUFFLE(3,1,3,1)));
+      _mm512_storeu_si512((void *)(dst + 2 * dstride), _mm512_shuffle_i64x2(t1, t3, _MM_SHUFFLE(2,0,2,0)));
+      _mm512_storeu_si512((void *)(dst + 3 * dstride), _mm512_shuffle_i64x2(t1, t3, _MM_SHUFFLE(3,1,3,1)));
+    }
+#endif
+
+    // picks the widest tile kernel available for E-byte elements
+    template <size_t E>
+    static void transpose_dispatch(Level level,
+				   char *dst, off_t drow, off_t dcol,
+				   const char *src, off_t srow, off_t scol,
+				   size_t rows, size_t cols)
+    {
+      TileFn tile = &tile_scalar<E, 8>;
+      size_t B = 8;
+#ifdef REALM_COPY_KERNELS_X86
+      if((E == 4) && (level >= LEVEL_AVX2)) {
+	tile = &tile_avx2_4;
+      }
+      if(E == 8) {
+	if(level >= LEVEL_AVX512) {
+	  tile = &tile_avx512_8;
+	} else if(level >= LEVEL_AVX2) {
+	  tile = &tile_avx2_8;
+	  B = 4;
+	}
+      }
+      if((E == 16) && (level >= LEVEL_AVX2)) {
+	tile = ((level >= LEVEL_AVX512) ? &tile_avx512_16 : &tile_avx2_16);
+	B = 4;
+      }
+#endif
+      transpose<E>(dst, drow, dcol, src, srow, scol, rows, cols, tile, B);
+    }
+
+    static inline off_t abs_stride(off_t stride)
+    {
+      return ((stride < 0) ? -stride : stride);
+    }
+
+    template <size_t E>
+    static void copy_small(Level level, char *dst, const char *src,
+			   size_t lines, off_t src_lstride, off_t dst_lstride,
+			   size_t planes, off_t src_pstride, off_t dst_pstride)
+    {
+      if(planes > 1) {
+	// if the source and destination disagree on which dimension is the
+	//  faster-moving one, walking either one in order thrashes the cache
+	//  on the other side - transpose in tiles instead
+	bool src_lines_inner = (abs_stride(src_lstride) < abs_stride(src_pstride));
+	bool dst_lines_inner = (abs_stride(dst_lstride) < abs_stride(dst_pstride));
+	if(src_lines_inner && !dst_lines_inner) {
+	  transpose_dispatch<E>(level,
+				dst, dst_lstride, dst_pstride,
+				src, src_pstride, src_lstride,
+				planes, lines);
+	  return;
+	}
+	if(!src_lines_inner && dst_lines_inner) {
+	  transpose_dispatch<E>(level,
+				dst, dst_pstride, dst_lstride,
+				src, src_lstride, src_pstride,
+				lines, planes);
+	  return;
+	}
+      }
+      copy_elements<E>(dst, src, lines, src_lstride, dst_lstride,
+		       planes, src_pstride, dst_pstride);
+    }
+
+    void copy_3d(void *dst, const void *src, size_t bytes,
+		 size_t lines, off_t src_lstride, off_t dst_lstride,
+		 size_t planes, off_t src_pstride, off_t dst_pstride)
+    {
+      char *d = (char *)dst;
+      const char *s = (const char *)src;
+      if(lines < 1) lines = 1;
+      if(planes < 1) planes = 1;
+
+      Level level = get_level();
+      if(level == LEVEL_MEMCPY) {
+	copy_lines(d, s, bytes, lines, src_lstride, dst_lstride,
+		   planes, src_pstride, dst_pstride);
+	return;
+      }
+
+      // collapse any dimensions that are contiguous in both source and
+      //  destination
+      while(true) {
+	if((lines == 1) && (planes > 1)) {
+	  lines = planes;
+	  src_lstride = src_pstride;
+	  dst_lstride = dst_pstride;
+	  planes = 1;
+	  continue;
+	}
+	if((lines > 1) &&
+	   (src_lstride == (off_t)bytes) && (dst_lstride == (off_t)bytes)) {
+	  bytes *= lines;
+	  lines = 1;
+	  continue;
+	}
+	if((planes > 1) &&
+	   (src_pstride == (off_t)(src_lstride * lines)) &&
+	   (dst_pstride == (off_t)(dst_lstride * lines))) {
+	  lines *= planes;
+	  planes = 1;
+	  continue;
+	}
+	break;
+      }
+
+      if(lines == 1) {
+	memcpy(d, s, bytes);
+	return;
+      }
+
+      switch(bytes) {
+      case 1:
+	copy_small<1>(level, d, s, lines, src_lstride, dst_lstride,
+		      planes, src_pstride, dst_pstride);
+	break;
+      case 2:
+	copy_small<2>(level, d, s, lines, src_lstride, dst_lstride,
+		      planes, src_pstride, dst_pstride);
+	break;
+      case 4:
+	copy_small<4>(level, d, s, lines, src_lstride, dst_lstride,
+		      planes, src_pstride, dst_pstride);
+	break;
+      case 8:
+	copy_small<8>(level, d, s, lines, src_lstride, dst_lstride,
+		      planes, src_pstride, dst_pstride);
+	break;
+      case 16:
+	copy_small<16>(level, d, s, lines, src_lstride, dst_lstride,
+		       planes, src_pstride, dst_pstride);
+	break;
+      default:
+	copy_lines(d, s, bytes, lines, src_lstride, dst_lstride,
+		   planes, src_pstride, dst_pstride);
+      }
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // fills
+    //
+    // the line kernels take a 128-byte 'block' holding back-to-back copies
+    //  of a pattern whose size divides 64, so that the 64 bytes starting at
+    //  any offset within the first copy are a correctly phased run of the
+    //  pattern - that lets the kernels align the destination first
+
+    static void fill_line_scalar(char *dst, size_t bytes, const char *block)
+    {
+      while(bytes >= 64) {
+	memcpy(dst, block, 64);
+	dst += 64;
+	bytes -= 64;
+      }
+      memcpy(dst, block, bytes);
+    }
+
+    // any other pattern size - write one copy of the pattern and then keep
+    //  copying what's been written so far, in chunks small enough for the
+    //  source to stay in the L1
+    static void fill_line_doubling(char *dst, size_t bytes,
+				   const void *pattern, size_t pattern_size)
+    {
+      const size_t MAX_CHUNK = 4096;
+      size_t max_chunk = MAX_CHUNK - (MAX_CHUNK % pattern_size);
+      if(max_chunk == 0) max_chunk = pattern_size;
+      size_t done = ((pattern_size < bytes) ? pattern_size : bytes);
+      memcpy(dst, pattern, done);
+      while(done < bytes) {
+	size_t chunk = ((done < max_chunk) ? done : max_chunk);
+	if(chunk > (bytes - done)) chunk = bytes - done;
+	memcpy(dst + done, dst, chunk);
+	done += chunk;
+      }
+    }
+
+#ifdef REALM_COPY_KERNELS_X86
+    __attribute__((target("avx2")))
+    static void fill_line_avx2(char *dst, size_t bytes, const char *block,
+			       size_t pattern_size, bool stream)
+    {
+      size_t head = (0 - (uintptr_t)dst) & 31;
+      if(head > bytes) head = bytes;
+      memcpy(dst, block, head);
+      dst += head;
+      bytes -= head;
+      const char *phase = block + (head % pattern_size);
+      __m256i v0 = _mm256_loadu_si256((const __m256i *)phase);
+      __m256i v1 = _mm256_loadu_si256((const __m256i *)(phase + 32));
+      if(stream) {
+	while(bytes >= 64) {
+	  _mm256_stream_si256((__m256i *)dst, v0);
+	  _mm256_stream_si256((__m256i *)(dst + 32), v1);
+	  dst += 64;
+	  bytes -= 64;
+	}
+      } else {
+	while(bytes >= 64) {
+	  _mm256_store_si256((__m256i *)dst, v0);
+	  _mm256_store_si256((__m256i *)(dst + 32), v1);
+	  dst += 64;
+	  bytes -= 64;
+	}
+      }
+      memcpy(dst, phase, bytes);
+    }
+
+    __attribute__((target("avx512f")))
+    static void fill_line_avx512(char *dst, size_t bytes, const char *block,
+				 size_t pattern_size, bool stream)
+    {
+      size_t head = (0 - (uintptr_t)dst) & 63;
+      if(head > bytes) head = bytes;
+      memcpy(dst, block, head);
+      dst += head;
+      bytes -= head;
+      const char *phase = block + (head % pattern_size);
+      __m512i v = _mm512_loadu_si512((const void *)phase);
+      if(stream) {
+	while(bytes >= 64) {
+	  _mm512_stream_si512((__m512i *)dst, v);
+	  dst += 64;
+	  bytes -= 64;
+	}
+      } else {
+	while(bytes >= 64) {
+	  _mm512_store_si512((void *)dst, v);
+	  dst += 64;
+	  bytes -= 64;
+	}
+      }
+      memcpy(dst, phase, bytes);
+    }
+#endif
+
+    void fill_3d(void *dst, const void *pattern, size_t pattern_size,
+		 size_t bytes, size_t lines, off_t lstride,
+		 size_t planes, off_t pstride)
+    {
+      assert(pattern_size > 0);
+      if(lines < 1) lines = 1;
+      if(planes < 1) planes = 1;
+
+      // collapse contiguous dimensions
+      if((lines > 1) && (lstride == (off_t)bytes)) {
+	bytes *= lines;
+	lines = 1;
+      }
+      if((planes > 1) && (pstride == (off_t)(lstride * lines))) {
+	lines *= planes;
+	planes = 1;
+	if(lstride == (off_t)bytes) {
+	  bytes *= lines;
+	  lines = 1;
+	}
+      }
+
+      Level level = get_level();
+      if((level == LEVEL_MEMCPY) || ((64 % pattern_size) != 0)) {
+	for(size_t p = 0; p < planes; p++)
+	  for(size_t l = 0; l < lines; l++)
+	    fill_line_doubling((char *)dst + (p * pstride) + (l * lstride),
+			       bytes, pattern, pattern_size);
+	return;
+      }
+
+      char block[128];
+      for(size_t ofs = 0; ofs < sizeof(block); ofs += pattern_size)
+	memcpy(block + ofs, pattern, pattern_size);
+
+      size_t total = bytes * lines * planes;
+      bool stream = ((Config::dma_fill_stream_threshold > 0) &&
+		     (total >= Config::dma_fill_stream_threshold));
+
+      for(size_t p = 0; p < planes; p++)
+	for(size_t l = 0; l < lines; l++) {
+	  char *d = (char *)dst + (p * pstride) + (l * lstride);
+#ifdef REALM_COPY_KERNELS_X86
+	  if(level >= LEVEL_AVX512) {
+	    fill_line_avx512(d, bytes, block, pattern_size, stream);
+	    continue;
+	  }
+	  if(level >= LEVEL_AVX2) {
+	    fill_line_avx2(d, bytes, block, pattern_size, stream);
+	    continue;
+	  }
+#endif
+	  fill_line_scalar(d, bytes, block);
+	}
+
+#ifdef REALM_COPY_KERNELS_X86
+      // streaming stores are weakly ordered - make them visible before the
+      //  fill is reported complete
+      if(stream && (level >= LEVEL_AVX2))
+	_mm_sfence();
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // reductions
+    //
+    // the built-in ops have identical LHS and RHS types and apply == fold,
+    //  so one kernel per (op, type) covers both
+
+    template <class T, int OP>
+    static void reduce_scalar(T *lhs, const T *rhs, size_t count)
+    {
+      for(size_t i = 0; i < count; i++)
+	switch(OP) {
+	case ReductionOpUntyped::BUILTIN_SUM:
+	  lhs[i] = SumCombine<T>::combine(lhs[i], rhs[i]); break;
+	case ReductionOpUntyped::BUILTIN_PROD:
+	  lhs[i] = ProdCombine<T>::combine(lhs[i], rhs[i]); break;
+	case ReductionOpUntyped::BUILTIN_MIN:
+	  lhs[i] = MinCombine<T>::combine(lhs[i], rhs[i]); break;
+	case ReductionOpUntyped::BUILTIN_MAX:
+	  lhs[i] = MaxCombine<T>::combine(lhs[i], rhs[i]); break;
+	}
+    }
+
+#ifdef REALM_COPY_KERNELS_X86
+    // per-ISA, per-type vector operations - min(a, b) and max(a, b) keep
+    //  'a' unless 'b' compares less/greater, to match MinCombine/MaxCombine
+    //  bit for bit (including NaN handling)
+
+#define REALM_AVX2 __attribute__((target("avx2")))
+#define REALM_AVX512 __attribute__((target("avx512f")))
+
+    struct Avx2Float {
+      typedef float T;
+      typedef __m256 V;
+      enum { WIDTH = 8 };
+      REALM_AVX2 static V load(const T *p) { return _mm256_loadu_ps(p); }
+      REALM_AVX2 static void store(T *p, V v) { _mm256_storeu_ps(p, v); }
+      REALM_AVX2 static V sum(V a, V b) { return _mm256_add_ps(a, b); }
+      REALM_AVX2 static V prod(V a, V b) { return _mm256_mul_ps(a, b); }
+      REALM_AVX2 static V min(V a, V b) { return _mm256_min_ps(b, a); }
+      REALM_AVX2 static V max(V a, V b) { return _mm256_max_ps(b, a); }
+    };
+
+    struct Avx2Double {
+      typedef double T;
+      typedef __m256d V;
+      enum { WIDTH = 4 };
+      REALM_AVX2 static V load(const T *p) { return _mm256_loadu_pd(p); }
+      REALM_AVX2 static void store(T *p, V v) { _mm256_storeu_pd(p, v); }
+      REALM_AVX2 static V sum(V a, V b) { return _mm256_add_pd(a, b); }
+      REALM_AVX2 static V prod(V a, V b) { return _mm256_mul_pd(a, b); }
+      REALM_AVX2 static V min(V a, V b) { return _mm256_min_pd(b, a); }
+      REALM_AVX2 static V max(V a, V b) { return _mm256_max_pd(b, a); }
+    };
+
+    struct Avx2Int32 {
+      typedef int32_t T;
+      typedef __m256i V;
+      enum { WIDTH = 8 };
+      REALM_AVX2 static V load(const T *p) { return _mm256_loadu_si256((const __m256i *)p); }
+      REALM_AVX2 static void store(T *p, V v) { _mm256_storeu_si256((__m256i *)p, v); }
+      REALM_AVX2 static V sum(V a, V b) { return _mm256_add_epi32(a, b); }
+      REALM_AVX2 static V prod(V a, V b) { return _mm256_mullo_epi32(a, b); }
+      REALM_AVX2 static V min(V a, V b) { return _mm256_min_epi32(a, b); }
+      REALM_AVX2 static V max(V a, V b) { return _mm256_max_epi32(a, b); }
+    };
+
+    // AVX2 has no 64-bit multiply or min/max - the low 64 bits of a product
+    //  are lo(a)*lo(b) + ((hi(a)*lo(b) + lo(a)*hi(b)) << 32), and min/max
+    //  are a compare and blend
+    struct Avx2Int64 {
+      typedef int64_t T;
+      typedef __m256i V;
+      enum { WIDTH = 4 };
+      REALM_AVX2 static V load(const T *p) { return _mm256_loadu_si256((const __m256i *)p); }
+      REALM_AVX2 static void store(T *p, V v) { _mm256_storeu_si256((__m256i *)p, v); }
+      REALM_AVX2 static V sum(V a, V b) { return _mm256_add_epi64(a, b); }
+      REALM_AVX2 static V prod(V a, V b)
+      {
+	V cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+				   _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+	return _mm256_add_epi64(_mm256_mul_epu32(a, b),
+				_mm256_slli_epi64(cross, 32));
+      }
+      REALM_AVX2 static V min(V a, V b)
+      {
+	return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+      }
+      REALM_AVX2 static V max(V a, V b)
+      {
+	return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(b, a));
+      }
+    };
+
+    struct Avx512Float {
+      typedef float T;
+      typedef __m512 V;
+      enum { WIDTH = 16 };
+      REALM_AVX512 static V load(const T *p) { return _mm512_loadu_ps(p); }
+      REALM_AVX512 static void store(T *p, V v) { _mm512_storeu_ps(p, v); }
+      REALM_AVX512 static V sum(V a, V b) { return _mm512_add_ps(a, b); }
+      REALM_AVX512 static V prod(V a, V b) { return _mm512_mul_ps(a, b); }
+      REALM_AVX512 static V min(V a, V b) { return _mm512_min_ps(b, a); }
+      REALM_AVX512 static V max(V a, V b) { return _mm512_max_ps(b, a); }
+    };
+
+    struct Avx512Double {
+      typedef double T;
+      typedef __m512d V;
+      enum { WIDTH = 8 };
+      REALM_AVX512 static V load(const T *p) { return _mm512_loadu_pd(p); }
+      REALM_AVX512 static void store(T *p, V v) { _mm512_storeu_pd(p, v); }
+      REALM_AVX512 static V sum(V a, V b) { return _mm512_add_pd(a, b); }
+      REALM_AVX512 static V prod(V a, V b) { return _mm512_mul_pd(a, b); }
+      REALM_AVX512 static V min(V a, V b) { return _mm512_min_pd(b, a); }
+      REALM_AVX512 static V max(V a, V b) { return _mm512_max_pd(b, a); }
+    };
+
+    struct Avx512Int32 {
+      typedef int32_t T;
+      typedef __m512i V;
+      enum { WIDTH = 16 };
+      REALM_AVX512 static V load(const T *p) { return _mm512_loadu_si512((const void *)p); }
+      REALM_AVX512 static void store(T *p, V v) { _mm512_storeu_si512((void *)p, v); }
+      REALM_AVX512 static V sum(V a, V b) { return _mm512_add_epi32(a, b); }
+      REALM_AVX512 static V prod(V a, V b) { return _mm512_mullo_epi32(a, b); }
+      REALM_AVX512 static V min(V a, V b) { return _mm512_min_epi32(a, b); }
+      REALM_AVX512 static V max(V a, V b) { return _mm512_max_epi32(a, b); }
+    };
+
+    // (a native 64-bit multiply needs AVX512DQ, so emulate it as for AVX2)
+    struct Avx512Int64 {
+      typedef int64_t T;
+      typedef __m512i V;
+      enum { WIDTH = 8 };
+      REALM_AVX512 static V load(const T *p) { return _mm512_loadu_si512((const void *)p); }
+      REALM_AVX512 static void store(T *p, V v) { _mm512_storeu_si512((void *)p, v); }
+      REALM_AVX512 static V sum(V a, V b) { return _mm512_add_epi64(a, b); }
+      REALM_AVX512 static V prod(V a, V b)
+      {
+	V cross = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(a, 32), b),
+				   _mm512_mul_epu32(a, _mm512_srli_epi64(b, 32)));
+	return _mm512_add_epi64(_mm512_mul_epu32(a, b),
+				_mm512_slli_epi64(cross, 32));
+      }
+      REALM_AVX512 static V min(V a, V b) { return _mm512_min_epi64(a, b); }
+      REALM_AVX512 static V max(V a, V b) { return _mm512_max_epi64(a, b); }
+    };
+
+    template <class T> struct VectorOps;
+    template <> struct VectorOps<float> { typedef Avx2Float AVX2; typedef Avx512Float AVX512; };
+    template <> struct VectorOps<double> { typedef Avx2Double AVX2; typedef Avx512Double AVX512; };
+    template <> struct VectorOps<int32_t> { typedef Avx2Int32 AVX2; typedef Avx512Int32 AVX512; };
+    template <> struct VectorOps<int64_t> { typedef Avx2Int64 AVX2; typedef Avx512Int64 AVX512; };
+
+    // the two loops are identical except for the target attribute, which
+    //  can't be a template parameter
+#define REALM_REDUCE_VECTOR_LOOP \
+      typedef typename VOPS::T T; \
+      typedef typename VOPS::V V; \
+      size_t i = 0; \
+      for(; (i + VOPS::WIDTH) <= count; i += VOPS::WIDTH) { \
+	V a = VOPS::load(lhs + i); \
+	V b = VOPS::load(rhs + i); \
+	switch(OP) { \
+	case ReductionOpUntyped::BUILTIN_SUM: a = VOPS::sum(a, b); break; \
+	case ReductionOpUntyped::BUILTIN_PROD: a = VOPS::prod(a, b); break; \
+	case ReductionOpUntyped::BUILTIN_MIN: a = VOPS::min(a, b); break; \
+	case ReductionOpUntyped::BUILTIN_MAX: a = VOPS::max(a, b); break; \
+	} \
+	VOPS::store(lhs + i, a); \
+      } \
+      reduce_scalar<T, OP>(lhs + i, rhs + i, count - i)
+
+    template <class VOPS, int OP>
+    REALM_AVX2 static void reduce_avx2(typename VOPS::T *lhs,
+				       const typename VOPS::T *rhs,
+				       size_t count)
+    {
+      REALM_REDUCE_VECTOR_LOOP;
+    }
+
+    template <class VOPS, int OP>
+    REALM_AVX512 static void reduce_avx512(typename VOPS::T *lhs,
+					   const typename VOPS::T *rhs,
+					   size_t count)
+    {
+      REALM_REDUCE_VECTOR_LOOP;
+    }
+
+#undef REALM_REDUCE_VECTOR_LOOP
+#undef REALM_AVX2
+#undef REALM_AVX512
+#endif
+
+    template <class T, int OP>
+    static void reduce_op(Level level, void *lhs, const void *rhs, size_t count)
+    {
+#ifdef REALM_COPY_KERNELS_X86
+      if(level >= LEVEL_AVX512) {
+	reduce_avx512<typename VectorOps<T>::AVX512, OP>((T *)lhs, (const T *)rhs, count);
+	return;
+      }
+      if(level >= LEVEL_AVX2) {
+	reduce_avx2<typename VectorOps<T>::AVX2, OP>((T *)lhs, (const T *)rhs, count);
+	return;
+      }
+#endif
+      reduce_scalar<T, OP>((T *)lhs, (const T *)rhs, count);
+    }
+
+    template <class T>
+    static bool reduce_type(Level level, ReductionOpUntyped::BuiltinOp op,
+			    void *lhs, const void *rhs, size_t count)
+    {
+      switch(op) {
+      case ReductionOpUntyped::BUILTIN_SUM:
+	reduce_op<T, ReductionOpUntyped::BUILTIN_SUM>(level, lhs, rhs, count);
+	return true;
+      case ReductionOpUntyped::BUILTIN_PROD:
+	reduce_op<T, ReductionOpUntyped::BUILTIN_PROD>(level, lhs, rhs, count);
+	return true;
+      case ReductionOpUntyped::BUILTIN_MIN:
+	reduce_op<T, ReductionOpUntyped::BUILTIN_MIN>(level, lhs, rhs, count);
+	return true;
+      case ReductionOpUntyped::BUILTIN_MAX:
+	reduce_op<T, ReductionOpUntyped::BUILTIN_MAX>(level, lhs, rhs, count);
+	return true;
+      default:
+	return false;
+      }
+    }
+
+    bool reduce(const ReductionOpUntyped *redop,
+		void *lhs, const void *rhs, size_t count)
+    {
+      if(redop->builtin_op == ReductionOpUntyped::BUILTIN_NONE)
+	return false;
+      Level level = get_level();
+      if(level == LEVEL_MEMCPY)
+	return false;
+
+      switch(redop->builtin_type) {
+      case ReductionOpUntyped::BUILTIN_FLOAT:
+	return reduce_type<float>(level, redop->builtin_op, lhs, rhs, count);
+      case ReductionOpUntyped::BUILTIN_DOUBLE:
+	return reduce_type<double>(level, redop->builtin_op, lhs, rhs, count);
+      case ReductionOpUntyped::BUILTIN_INT32:
+	return reduce_type<int32_t>(level, redop->builtin_op, lhs, rhs, count);
+      case ReductionOpUntyped::BUILTIN_INT64:
+	return reduce_type<int64_t>(level, redop->builtin_op, lhs, rhs, count);
+      default:
+	return false;
+      }
+    }
+
+  }; // namespace CopyKernels
+
+}; // namespace Realm
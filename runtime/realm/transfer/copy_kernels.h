@@ -0,0 +1,76 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host-side kernels for strided (2-D/3-D) copies, fills and reductions
+
+#ifndef REALM_COPY_KERNELS_H
+#define REALM_COPY_KERNELS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "realm/redop.h"
+
+namespace Realm {
+
+  namespace CopyKernels {
+
+    // which instruction sets the kernels are allowed to use - set via
+    //  -ll:copy_kernels, and further limited by what the CPU supports
+    enum Level {
+      LEVEL_MEMCPY = 0,  // one memcpy per contiguous line (no kernels)
+      LEVEL_SCALAR = 1,  // element-typed loops and blocked transposes
+      LEVEL_AVX2   = 2,
+      LEVEL_AVX512 = 3,
+    };
+
+    // the level actually in use (i.e. the configured level clamped to what
+    //  the CPU can do) - determined on first use
+    Level get_level(void);
+    const char *level_name(Level level);
+
+    // copies 'planes' x 'lines' contiguous runs of 'bytes' bytes - this is
+    //  the shape of the 1-D/2-D/3-D requests built by the DMA channels
+    // contiguous dimensions are collapsed first, small element sizes
+    //  (1/2/4/8/16 bytes) use typed gather/scatter loops rather than a
+    //  memcpy call per element, and a 3-D copy in which the source and
+    //  destination disagree on the faster-moving dimension (e.g. between
+    //  Fortran- and C-ordered instances) is done as a cache-blocked tile
+    //  transpose, vectorized for packed 4- and 8-byte elements
+    void copy_3d(void *dst, const void *src, size_t bytes,
+		 size_t lines, off_t src_lstride, off_t dst_lstride,
+		 size_t planes, off_t src_pstride, off_t dst_pstride);
+
+    // fills 'planes' x 'lines' runs of 'bytes' bytes (a multiple of
+    //  'pattern_size') with copies of the pattern
+    // patterns whose size divides 64 bytes are written with full-width
+    //  vector stores, and fills larger than -ll:fill_stream bytes use
+    //  non-temporal stores so that they don't evict the rest of the cache
+    void fill_3d(void *dst, const void *pattern, size_t pattern_size,
+		 size_t bytes, size_t lines, off_t lstride,
+		 size_t planes, off_t pstride);
+
+    // applies (or folds - they're the same for the built-in ops) 'count'
+    //  elements of 'rhs' into 'lhs' non-atomically, if 'redop' is one of
+    //  the built-in arithmetic reductions - returns false (having done
+    //  nothing) otherwise, or if the kernels are disabled
+    bool reduce(const ReductionOpUntyped *redop,
+		void *lhs, const void *rhs, size_t count);
+
+  }; // namespace CopyKernels
+
+}; // namespace Realm
+
+#endif // ifndef REALM_COPY_KERNELS_H
@@ -19,6 +19,7 @@
 #include "realm/deppart/inst_helper.h"
 #include "realm/mem_impl.h"
 #include "realm/inst_impl.h"
+#include "realm/transfer/compressed_file.h"
 
 #include <sys/types.h>
 #include <time.h>
@@ -213,6 +214,21 @@ namespace Realm {
 							realm_file_mode_t file_mode,
 							const ProfilingRequestSet& prs,
 							Event wait_on /*= Event::NO_EVENT*/)
+  {
+    return create_file_instance(inst, file_name, space, field_ids, field_sizes,
+				file_mode, LEGION_FILE_COMPRESS_NONE, prs, wait_on);
+  }
+
+  template <int N, typename T>
+  /*static*/ Event RegionInstance::create_file_instance(RegionInstance& inst,
+							const char *file_name,
+							const IndexSpace<N,T>& space,
+							const std::vector<FieldID> &field_ids,
+							const std::vector<size_t> &field_sizes,
+							realm_file_mode_t file_mode,
+							realm_file_compression_t compression,
+							const ProfilingRequestSet& prs,
+							Event wait_on /*= Event::NO_EVENT*/)
   {
     // look up the local file memory
     Memory memory = Machine::MemoryQuery(Machine::get_machine())
@@ -255,7 +271,11 @@ namespace Realm {
     }
 
     // continue to support creating the file for now
-    if(file_mode == LEGION_FILE_CREATE) {
+    if((file_mode == LEGION_FILE_CREATE) &&
+       (compression != LEGION_FILE_COMPRESS_NONE)) {
+      // a compressed file starts out empty - unwritten chunks read as zeros
+      CompressedFile::create(file_name, file_ofs, compression);
+    } else if(file_mode == LEGION_FILE_CREATE) {
       int fd = open(file_name, O_CREAT | O_RDWR, 0777);
       assert(fd != -1);
       // resize the file to what we want
@@ -271,6 +291,7 @@ namespace Realm {
     // stuff the filename into the impl's metadata for now
     RegionInstanceImpl *impl = get_runtime()->get_instance_impl(inst);
     impl->metadata.filename = file_name;
+    impl->metadata.file_compression = compression;
 
     return e;
   }
@@ -283,6 +304,15 @@ namespace Realm {
 							   const std::vector<size_t>&, \
                                                            realm_file_mode_t, \
 							   const ProfilingRequestSet&, \
+							   Event); \
+  template Event RegionInstance::create_file_instance<N,T>(RegionInstance&, \
+							   const char *, \
+							   const IndexSpace<N,T>&, \
+							   const std::vector<FieldID>&, \
+							   const std::vector<size_t>&, \
+                                                           realm_file_mode_t, \
+							   realm_file_compression_t, \
+							   const ProfilingRequestSet&, \
 							   Event);
   FOREACH_NT(DOIT)
 
@@ -19,15 +19,21 @@
 #include "realm/transfer/channel.h"
 #include "realm/threads.h"
 #include "realm/transfer/transfer.h"
+#include "realm/transfer/copy_kernels.h"
 
 #include <errno.h>
 // included for file memory data transfer
 #include <unistd.h>
-#ifdef REALM_USE_KERNEL_AIO
+#include <aio.h>
+#ifdef __linux__
 #include <linux/aio_abi.h>
 #include <sys/syscall.h>
-#else
-#include <aio.h>
+#endif
+#ifdef REALM_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <climits>
 #endif
 
 #ifdef USE_CUDA
@@ -48,12 +54,22 @@
 
 #include "realm/timers.h"
 #include "realm/serialize.h"
+#include "realm/utils.h"
 
 TYPE_IS_SERIALIZABLE(Realm::OffsetsAndSize);
 TYPE_IS_SERIALIZABLE(Realm::CopySrcDstField);
 
 namespace Realm {
 
+  namespace Config {
+    int aio_backend = 0;  // AsyncFileIOContext::BACKEND_DEFAULT
+    int aio_queue_depth = 256;
+    bool aio_uring_sqpoll = false;
+    bool aio_uring_fixed_buffers = false;
+    bool dma_ib_pool = true;
+    bool dma_path_cache = true;
+  };
+
     Logger log_dma("dma");
     Logger log_ib_alloc("ib_alloc");
     //extern Logger log_new_dma;
@@ -88,17 +104,106 @@ namespace Realm {
       off_t ib_offset;
     };
 
+    // a cache of intermediate buffers for a single IB memory - freed buffers
+    //  are kept on per-size-class free lists and handed straight to the next
+    //  request of the same class instead of going back to the memory's
+    //  allocator
+    // sizes are rounded up to classes with 4 steps per power of two (so at
+    //  most 25% waste), and cached buffers are returned to the memory
+    //  whenever an allocation (of an intermediate buffer or an instance)
+    //  would otherwise fail - if the rounded size still doesn't fit, the
+    //  exact size is tried before giving up
+    // not thread-safe - the PendingIBQueue's mutex protects it
+    class IBBufferPool {
+    public:
+      IBBufferPool(MemoryImpl *_mem);
+      ~IBBufferPool(void);
+
+      // returns -1 if the memory has no room, even after trimming the cache
+      off_t alloc(size_t bytes);
+      void free(off_t offset, size_t bytes);
+
+      // releases all cached buffers back to the memory - returns true if
+      //  there were any
+      bool trim(void);
+
+      static size_t class_size(size_t bytes);
+
+      static const size_t MIN_CLASS_SIZE = 4096;
+
+    protected:
+      MemoryImpl *mem;
+      std::map<size_t, std::vector<off_t> > free_lists;
+      // actual size of each buffer that's handed out (usually the class size)
+      std::map<off_t, size_t> alloc_sizes;
+      size_t cached_bytes;
+      size_t total_hits, total_misses;  // reported when the pool goes away
+
+    public:
+      ProfilingGauges::AbsoluteGauge<size_t> bytes_in_use, bytes_cached;
+      ProfilingGauges::AbsoluteRangeGauge<int> requests_waiting;
+      // allocations satisfied from/outside the cache
+      ProfilingGauges::EventCounter<long long> pool_hits, pool_misses;
+    };
+
     class PendingIBQueue {
     public:
       PendingIBQueue();
+      ~PendingIBQueue();
 
       void enqueue_request(Memory tgt_mem, IBAllocRequest* req);
 
       void dequeue_request(Memory tgt_mem);
 
+      void free_buffer(Memory tgt_mem, off_t offset, size_t size);
+
+      // returns true if the memory got any cached buffers back
+      bool trim_pool(Memory tgt_mem);
+
     protected:
+      off_t alloc_buffer(Memory tgt_mem, size_t size);
+      IBBufferPool *get_pool(Memory tgt_mem);
+      void send_response(IBAllocRequest* req, off_t ib_offset);
+
       GASNetHSL queue_mutex;
       std::map<Memory, std::queue<IBAllocRequest*> *> queues;
+      std::map<Memory, IBBufferPool *> pools;
+    };
+
+    struct CopyPath {
+      std::vector<Memory> mem_path;
+      // channel kind for each hop, i.e. from mem_path[i] to mem_path[i+1]
+      std::vector<XferDes::XferKind> hop_kinds;
+      // serdez op the path and hop kinds were chosen for
+      CustomSerdezID serdez_id;
+
+      void build(Memory src_mem, Memory dst_mem, CustomSerdezID serdez_id);
+    };
+
+    // copies that are issued over and over between the same memories (e.g.
+    //  the same halo exchange every time step) would otherwise redo the
+    //  path search and channel selection every time - both depend only on
+    //  the source/destination memories and the serdez op, so the results
+    //  are kept for the life of the DMA system
+    class CopyPathCache {
+    public:
+      CopyPathCache(void);
+      ~CopyPathCache(void);
+
+      // the returned path is owned by the cache
+      const CopyPath *lookup(Memory src_mem, Memory dst_mem,
+			     CustomSerdezID serdez_id);
+
+    protected:
+      typedef std::pair<MemPair, CustomSerdezID> PathKey;
+
+      GASNetHSL mutex;
+      std::map<PathKey, CopyPath *> paths;
+      size_t total_hits, total_misses;  // reported when the cache goes away
+
+    public:
+      // lookups that did/didn't find a cached path
+      ProfilingGauges::EventCounter<long long> path_hits, path_misses;
     };
 
     class DmaRequest;
@@ -151,6 +256,8 @@ namespace Realm {
 
     DmaRequest::~DmaRequest(void)
     {
+      // requests that never ran still have to let go of their instances
+      unpin_instances();
       pthread_mutex_destroy(&request_lock);
     }
 
@@ -159,6 +266,57 @@ namespace Realm {
       os << "DmaRequest";
     }
 
+    void DmaRequest::add_xfer_record(const ProfilingMeasurements::OperationTransferTimeline::XferInterval& rec)
+    {
+      pthread_mutex_lock(&request_lock);
+      xfer_records.push_back(rec);
+      pthread_mutex_unlock(&request_lock);
+    }
+
+    bool DmaRequest::pin_instance(RegionInstance inst, bool just_check)
+    {
+      if(pinned_insts.count(inst))
+	return true;
+
+      RegionInstanceImpl *impl = get_runtime()->get_instance_impl(inst);
+      Event e = impl->try_pin();
+      if(!e.exists()) {
+	pinned_insts.insert(inst);
+	return true;
+      }
+
+      // instance is being moved by the defragmenter - try again once it's done
+      if(!just_check) {
+	log_dma.debug() << "request " << (void *)this << " - instance " << inst
+			<< " being relocated - sleeping on event " << e;
+	waiter.sleep_on_event(e);
+      }
+      return false;
+    }
+
+    void DmaRequest::unpin_instances(void)
+    {
+      for(std::set<RegionInstance>::const_iterator it = pinned_insts.begin();
+	  it != pinned_insts.end();
+	  ++it)
+	get_runtime()->get_instance_impl(*it)->unpin();
+      pinned_insts.clear();
+    }
+
+    void DmaRequest::mark_completed(void)
+    {
+      unpin_instances();
+
+      // every XferDes has finished (they're async work items), so nobody
+      //  else is touching xfer_records any more
+      if(measurements.wants_measurement<ProfilingMeasurements::OperationTransferTimeline>()) {
+	ProfilingMeasurements::OperationTransferTimeline timeline;
+	timeline.xfers.swap(xfer_records);
+	measurements.add_measurement(timeline);
+      }
+      Operation::mark_completed();
+    }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -174,38 +332,211 @@ namespace Realm {
     }
 
     static PendingIBQueue *ib_req_queue = 0;
+    static CopyPathCache *copy_path_cache = 0;
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class IBBufferPool
+  //
+
+    IBBufferPool::IBBufferPool(MemoryImpl *_mem)
+      : mem(_mem), cached_bytes(0), total_hits(0), total_misses(0)
+      , bytes_in_use(stringbuilder() << "realm/mem " << _mem->me << "/ib_pool/in_use")
+      , bytes_cached(stringbuilder() << "realm/mem " << _mem->me << "/ib_pool/cached")
+      , requests_waiting(stringbuilder() << "realm/mem " << _mem->me << "/ib_pool/waiting")
+      , pool_hits(stringbuilder() << "realm/mem " << _mem->me << "/ib_pool/hits")
+      , pool_misses(stringbuilder() << "realm/mem " << _mem->me << "/ib_pool/misses")
+    {}
+
+    IBBufferPool::~IBBufferPool(void)
+    {
+      log_ib_alloc.info() << "ib pool: mem=" << mem->me
+			  << " hits=" << total_hits
+			  << " misses=" << total_misses;
+      trim();
+    }
+
+    /*static*/ size_t IBBufferPool::class_size(size_t bytes)
+    {
+      if(bytes <= MIN_CLASS_SIZE)
+	return MIN_CLASS_SIZE;
+      // step is a quarter of the largest power of two <= bytes
+      size_t pow2 = MIN_CLASS_SIZE;
+      while((pow2 << 1) <= bytes) pow2 <<= 1;
+      size_t step = pow2 >> 2;
+      return ((bytes + step - 1) / step) * step;
+    }
+
+    off_t IBBufferPool::alloc(size_t bytes)
+    {
+      size_t csize = class_size(bytes);
+      // don't let rounding turn a request that would fit into one that can't
+      if(csize > mem->size)
+	csize = bytes;
+
+      std::map<size_t, std::vector<off_t> >::iterator it = free_lists.find(csize);
+      if((it != free_lists.end()) && !it->second.empty()) {
+	off_t offset = it->second.back();
+	it->second.pop_back();
+	cached_bytes -= csize;
+	bytes_cached = cached_bytes;
+	bytes_in_use += csize;
+	alloc_sizes[offset] = csize;
+	total_hits++;
+	pool_hits += 1;
+	return offset;
+      }
+
+      total_misses++;
+      pool_misses += 1;
+      off_t offset = mem->alloc_bytes(csize);
+      if((offset < 0) && (cached_bytes > 0)) {
+	// give back everything we're holding on to and try again
+	log_ib_alloc.info() << "trimming ib pool: mem=" << mem->me
+			    << " cached=" << cached_bytes << " needed=" << csize;
+	trim();
+	offset = mem->alloc_bytes(csize);
+      }
+      if((offset < 0) && (csize != bytes)) {
+	// fragmentation may leave room for the exact size but not the
+	//  rounded one - with nothing in flight, no free would ever come
+	//  along to retry a queued request
+	csize = bytes;
+	offset = mem->alloc_bytes(csize);
+      }
+      if(offset >= 0) {
+	bytes_in_use += csize;
+	alloc_sizes[offset] = csize;
+      }
+      return offset;
+    }
+
+    void IBBufferPool::free(off_t offset, size_t bytes)
+    {
+      std::map<off_t, size_t>::iterator it = alloc_sizes.find(offset);
+      assert(it != alloc_sizes.end());
+      size_t csize = it->second;
+      alloc_sizes.erase(it);
+      bytes_in_use -= csize;
+      // an odd-sized buffer won't be asked for again - don't cache it
+      if(csize != class_size(bytes)) {
+	mem->free_bytes(offset, csize);
+	return;
+      }
+      free_lists[csize].push_back(offset);
+      cached_bytes += csize;
+      bytes_cached = cached_bytes;
+    }
+
+    bool IBBufferPool::trim(void)
+    {
+      bool released = (cached_bytes > 0);
+      for(std::map<size_t, std::vector<off_t> >::iterator it = free_lists.begin();
+	  it != free_lists.end();
+	  ++it)
+	for(std::vector<off_t>::const_iterator it2 = it->second.begin();
+	    it2 != it->second.end();
+	    ++it2)
+	  mem->free_bytes(*it2, it->first);
+      free_lists.clear();
+      cached_bytes = 0;
+      bytes_cached = 0;
+      return released;
+    }
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class PendingIBQueue
+  //
 
     PendingIBQueue::PendingIBQueue() {}
 
+    PendingIBQueue::~PendingIBQueue()
+    {
+      for(std::map<Memory, IBBufferPool *>::iterator it = pools.begin();
+	  it != pools.end();
+	  ++it)
+	delete it->second;
+    }
+
+    IBBufferPool *PendingIBQueue::get_pool(Memory tgt_mem)
+    {
+      std::map<Memory, IBBufferPool *>::iterator it = pools.find(tgt_mem);
+      if(it != pools.end())
+	return it->second;
+      IBBufferPool *pool = new IBBufferPool(get_runtime()->get_memory_impl(tgt_mem));
+      pools[tgt_mem] = pool;
+      return pool;
+    }
+
+    bool PendingIBQueue::trim_pool(Memory tgt_mem)
+    {
+      AutoHSLLock al(queue_mutex);
+      std::map<Memory, IBBufferPool *>::iterator it = pools.find(tgt_mem);
+      if(it == pools.end())
+	return false;
+      return it->second->trim();
+    }
+
+    off_t PendingIBQueue::alloc_buffer(Memory tgt_mem, size_t size)
+    {
+      if(Config::dma_ib_pool)
+	return get_pool(tgt_mem)->alloc(size);
+      else
+	return get_runtime()->get_memory_impl(tgt_mem)->alloc_bytes(size);
+    }
+
+    void PendingIBQueue::free_buffer(Memory tgt_mem, off_t offset, size_t size)
+    {
+      {
+	AutoHSLLock al(queue_mutex);
+	assert(ID(tgt_mem).memory.owner_node == my_node_id);
+	if(Config::dma_ib_pool)
+	  get_pool(tgt_mem)->free(offset, size);
+	else
+	  get_runtime()->get_memory_impl(tgt_mem)->free_bytes(offset, size);
+      }
+      dequeue_request(tgt_mem);
+    }
+
+    void PendingIBQueue::send_response(IBAllocRequest* req, off_t ib_offset)
+    {
+      if (req->owner == my_node_id) {
+	// local ib alloc request
+	CopyRequest* cr = (CopyRequest*) req->req;
+	RegionInstanceImpl *src_impl = get_runtime()->get_instance_impl(req->src_inst_id);
+	RegionInstanceImpl *dst_impl = get_runtime()->get_instance_impl(req->dst_inst_id);
+	InstPair inst_pair(src_impl->me, dst_impl->me);
+	cr->handle_ib_response(req->idx, inst_pair, req->ib_size, ib_offset);
+      } else {
+	// remote ib alloc request
+	RemoteIBAllocResponseAsync::send_request(req->owner, req->req, req->idx,
+						 req->src_inst_id, req->dst_inst_id, req->ib_size, ib_offset);
+      }
+      // Remember to free IBAllocRequest
+      delete req;
+    }
+
     void PendingIBQueue::enqueue_request(Memory tgt_mem, IBAllocRequest* req)
     {
       AutoHSLLock al(queue_mutex);
       assert(ID(tgt_mem).memory.owner_node == my_node_id);
-      // If we can allocate in target memory, no need to pend the request
-      off_t ib_offset = get_runtime()->get_memory_impl(tgt_mem)->alloc_bytes(req->ib_size);
-      if (ib_offset >= 0) {
-        if (req->owner == my_node_id) {
-          // local ib alloc request
-          CopyRequest* cr = (CopyRequest*) req->req;
-          RegionInstanceImpl *src_impl = get_runtime()->get_instance_impl(req->src_inst_id);
-          RegionInstanceImpl *dst_impl = get_runtime()->get_instance_impl(req->dst_inst_id);
-          InstPair inst_pair(src_impl->me, dst_impl->me);
-          cr->handle_ib_response(req->idx, inst_pair, req->ib_size, ib_offset);
-        } else {
-          // remote ib alloc request
-          RemoteIBAllocResponseAsync::send_request(req->owner, req->req, req->idx,
-              req->src_inst_id, req->dst_inst_id, req->ib_size, ib_offset); 
-        }
-        // Remember to free IBAllocRequest
-        delete req;
-
-        return;
+      std::map<Memory, std::queue<IBAllocRequest*> *>::iterator it = queues.find(tgt_mem);
+      // If nobody is waiting and we can allocate in target memory, no need
+      //  to pend the request - if others are waiting, we get in line behind
+      //  them so that large requests can't be starved by a stream of small
+      //  ones
+      if (it == queues.end()) {
+	off_t ib_offset = alloc_buffer(tgt_mem, req->ib_size);
+	if (ib_offset >= 0) {
+	  send_response(req, ib_offset);
+	  return;
+	}
       }
       log_ib_alloc.info("enqueue_request: src_inst(%llx) dst_inst(%llx) "
                         "no enough space in memory(%llx)", req->src_inst_id, req->dst_inst_id, tgt_mem.id);
       //log_ib_alloc.info() << " (" << req->src_inst_id << "," 
       //  << req->dst_inst_id << "): no enough space in memory" << tgt_mem;
-      std::map<Memory, std::queue<IBAllocRequest*> *>::iterator it = queues.find(tgt_mem);
       if (it == queues.end()) {
         std::queue<IBAllocRequest*> *q = new std::queue<IBAllocRequest*>;
         q->push(req);
@@ -215,6 +546,8 @@ namespace Realm {
         it->second->push(req);
         //log_ib_alloc.info("enqueue_request: queue_length(%lu)", it->second->size());
       }
+      if(Config::dma_ib_pool)
+	get_pool(tgt_mem)->requests_waiting += 1;
     }
 
     void PendingIBQueue::dequeue_request(Memory tgt_mem)
@@ -226,27 +559,16 @@ namespace Realm {
       if (it == queues.end()) return;
       while (!it->second->empty()) {
         IBAllocRequest* req = it->second->front();
-        off_t ib_offset = get_runtime()->get_memory_impl(tgt_mem)->alloc_bytes(req->ib_size);
+        off_t ib_offset = alloc_buffer(tgt_mem, req->ib_size);
         if (ib_offset < 0) break;
         //printf("req: src_inst_id(%llx) dst_inst_id(%llx) ib_size(%lu) idx(%d)\n", req->src_inst_id, req->dst_inst_id, req->ib_size, req->idx);
         // deal with the completed ib alloc request
         log_ib_alloc.info() << "IBAllocRequest (" << req->src_inst_id << "," 
           << req->dst_inst_id << "): completed!";
-        if (req->owner == my_node_id) {
-          // local ib alloc request
-          CopyRequest* cr = (CopyRequest*) req->req;
-          RegionInstanceImpl *src_impl = get_runtime()->get_instance_impl(req->src_inst_id);
-          RegionInstanceImpl *dst_impl = get_runtime()->get_instance_impl(req->dst_inst_id);
-          InstPair inst_pair(src_impl->me, dst_impl->me);
-          cr->handle_ib_response(req->idx, inst_pair, req->ib_size, ib_offset);
-        } else {
-          // remote ib alloc request
-          RemoteIBAllocResponseAsync::send_request(req->owner, req->req, req->idx,
-              req->src_inst_id, req->dst_inst_id, req->ib_size, ib_offset); 
-        }
         it->second->pop();
-        // Remember to free IBAllocRequest
-        delete req;
+	if(Config::dma_ib_pool)
+	  get_pool(tgt_mem)->requests_waiting -= 1;
+	send_response(req, ib_offset);
       }
       // if queue is empty, delete from list
       if(it->second->empty()) {
@@ -358,6 +680,7 @@ namespace Realm {
 			     int _priority)
       : DmaRequest(_priority, _after_copy),
 	oas_by_inst(0),
+	copy_path(0), owns_copy_path(false),
 	before_copy(_before_copy)
     {
       Serialization::FixedBufferDeserializer deserializer(data, datalen);
@@ -416,6 +739,7 @@ namespace Realm {
       : DmaRequest(_priority, _after_copy, reqs)
       , domain(_domain->clone())
       , oas_by_inst(_oas_by_inst)
+      , copy_path(0), owns_copy_path(false)
       , before_copy(_before_copy)
     {
       // <NEW_DMA>
@@ -445,6 +769,8 @@ namespace Realm {
         destroy_xfer_des(*it);
       }
       //</NEWDMA>
+      if(owns_copy_path)
+	delete copy_path;
       delete oas_by_inst;
       delete domain;
     }
@@ -575,8 +901,7 @@ namespace Realm {
     /*static*/ void RemoteIBFreeRequestAsync::handle_request(RequestArgs args)
     {
       assert(ID(args.memory).memory.owner_node == my_node_id);
-      get_runtime()->get_memory_impl(args.memory)->free_bytes(args.ib_offset, args.ib_size);
-      ib_req_queue->dequeue_request(args.memory);
+      ib_req_queue->free_buffer(args.memory, args.ib_offset, args.ib_size);
     }
 
     /*static*/ void RemoteIBFreeRequestAsync::send_request(NodeID target, Memory tgt_mem, off_t ib_offset, size_t ib_size)
@@ -596,8 +921,7 @@ namespace Realm {
       //CopyRequest* cr = (CopyRequest*) req;
       //AutoHSLLock al(cr->ib_mutex);
       if(ID(mem).memory.owner_node == my_node_id) {
-        get_runtime()->get_memory_impl(mem)->free_bytes(offset, size);
-        ib_req_queue->dequeue_request(mem);
+        ib_req_queue->free_buffer(mem, offset, size);
       } else {
         RemoteIBFreeRequestAsync::send_request(ID(mem).memory.owner_node,
             mem, offset, size);
@@ -723,6 +1047,12 @@ namespace Realm {
 	  }
 	}
 
+	// keep the instances where they are until we're done
+	for(OASByInst::iterator it = oas_by_inst->begin(); it != oas_by_inst->end(); it++)
+	  if(!pin_instance(it->first.first, just_check) ||
+	     !pin_instance(it->first.second, just_check))
+	    return false;
+
 	// if we got all the way through, we've got all the metadata we need
 	state = STATE_DST_FETCH;
       }
@@ -744,7 +1074,15 @@ namespace Realm {
         Memory src_mem = get_runtime()->get_instance_impl(oas_by_inst->begin()->first.first)->memory;
         Memory dst_mem = get_runtime()->get_instance_impl(oas_by_inst->begin()->first.second)->memory;
 	CustomSerdezID serdez_id = oas_by_inst->begin()->second[0].serdez_id;
-        find_shortest_path(src_mem, dst_mem, serdez_id, mem_path);
+	if(Config::dma_path_cache) {
+	  copy_path = copy_path_cache->lookup(src_mem, dst_mem, serdez_id);
+	} else {
+	  CopyPath *p = new CopyPath;
+	  p->build(src_mem, dst_mem, serdez_id);
+	  copy_path = p;
+	  owns_copy_path = true;
+	}
+	mem_path = copy_path->mem_path;
         // Pass 1: create IBInfo blocks
         for (OASByInst::iterator it = oas_by_inst->begin(); it != oas_by_inst->end(); it++) {
           AutoHSLLock al(ib_mutex);
@@ -875,7 +1213,7 @@ namespace Realm {
 
     static AsyncFileIOContext *aio_context = 0;
 
-#ifdef REALM_USE_KERNEL_AIO
+#ifdef __linux__
     inline int io_setup(unsigned nr, aio_context_t *ctxp)
     {
       return syscall(__NR_io_setup, nr, ctxp);
@@ -988,7 +1326,8 @@ namespace Realm {
     {
       return completed;
     }
-#else
+#endif
+
     class PosixAIOWrite : public AsyncFileIOContext::AIOOperation {
     public:
       PosixAIOWrite(int fd, size_t offset, size_t bytes,
@@ -1072,6 +1411,378 @@ namespace Realm {
       assert(ret == 0);
       return true;
     }
+
+#ifdef REALM_USE_IO_URING
+    inline int io_uring_setup(unsigned entries, struct io_uring_params *p)
+    {
+      return syscall(__NR_io_uring_setup, entries, p);
+    }
+
+    inline int io_uring_enter(int fd, unsigned to_submit,
+			      unsigned min_complete, unsigned flags)
+    {
+      return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		     flags, NULL, 0);
+    }
+
+    inline int io_uring_register(int fd, unsigned opcode,
+				 void *arg, unsigned nr_args)
+    {
+      return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+    }
+
+    // a thin wrapper around an io_uring instance - submission queue entries
+    //  are filled in as operations are launched but only handed to the
+    //  kernel (in one batch) by flush(), and completions are reaped straight
+    //  out of the shared completion ring without a system call
+    // all methods must be called with the AsyncFileIOContext's mutex held
+    class AsyncFileIOContext::UringQueue {
+    public:
+      UringQueue(unsigned _depth, bool _sqpoll);
+      ~UringQueue(void);
+
+      bool ok(void) const { return (ring_fd >= 0); }
+
+      // returns NULL if the submission ring is full
+      struct io_uring_sqe *get_sqe(void);
+      void flush(void);
+      void reap(void);
+
+      // these return -1 if the fd/buffer isn't registered
+      int fixed_file_index(int fd) const;
+      int fixed_buffer_index(const void *buffer, size_t bytes) const;
+
+      void add_buffer(void *base, size_t bytes);
+      void add_file(int fd);
+      void remove_file(int fd);
+
+      // number of slots in the registered file table
+      static const unsigned NUM_FIXED_FILES = 64;
+
+    protected:
+      void register_buffers(void);
+
+      int ring_fd;
+      bool sqpoll;
+      unsigned to_submit;  // entries filled in but not yet published
+      void *sq_ring, *cq_ring;
+      size_t sq_ring_size, cq_ring_size;
+      struct io_uring_sqe *sqes;
+      size_t sqes_size;
+      volatile unsigned *sq_head, *sq_tail, *sq_flags, *sq_array;
+      unsigned sq_mask, sq_entries;
+      volatile unsigned *cq_head, *cq_tail;
+      unsigned cq_mask;
+      struct io_uring_cqe *cqes;
+
+      bool buffers_registered;
+      std::vector<struct iovec> buffers;
+      bool files_registered;
+      std::map<int, unsigned> fixed_files;  // fd -> table slot
+      std::vector<unsigned> free_file_slots;
+    };
+
+    class UringAIOOp : public AsyncFileIOContext::AIOOperation {
+    public:
+      UringAIOOp(AsyncFileIOContext::UringQueue *_queue, bool _is_write,
+		 int _fd, size_t _offset, size_t _bytes,
+		 const void *_buffer, Request* request = NULL);
+      virtual void launch(void);
+      virtual bool check_completion(void);
+
+    public:
+      AsyncFileIOContext::UringQueue *queue;
+      bool is_write;
+      int fd;
+      size_t offset, bytes;
+      const void *buffer;
+      int result;
+    };
+
+    AsyncFileIOContext::UringQueue::UringQueue(unsigned _depth, bool _sqpoll)
+      : ring_fd(-1), sqpoll(_sqpoll), to_submit(0)
+      , sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), sqes(0)
+      , buffers_registered(false), files_registered(false)
+    {
+      struct io_uring_params p;
+      memset(&p, 0, sizeof(p));
+      if(sqpoll) {
+	p.flags |= IORING_SETUP_SQPOLL;
+	p.sq_thread_idle = 1000; // ms
+      }
+      ring_fd = io_uring_setup(_depth, &p);
+      if(ring_fd < 0) {
+	log_aio.warning() << "io_uring_setup failed: " << strerror(errno);
+	return;
+      }
+
+      sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+      cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+      bool single_mmap = ((p.features & IORING_FEAT_SINGLE_MMAP) != 0);
+      if(single_mmap)
+	sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+      sq_ring = mmap(0, sq_ring_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+      if(single_mmap)
+	cq_ring = sq_ring;
+      else
+	cq_ring = mmap(0, cq_ring_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+      sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+      void *sqes_ptr = mmap(0, sqes_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+      if((sq_ring == MAP_FAILED) || (cq_ring == MAP_FAILED) ||
+	 (sqes_ptr == MAP_FAILED)) {
+	log_aio.warning() << "io_uring mmap failed: " << strerror(errno);
+	if(sqes_ptr != MAP_FAILED) munmap(sqes_ptr, sqes_size);
+	if((cq_ring != MAP_FAILED) && !single_mmap) munmap(cq_ring, cq_ring_size);
+	if(sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+	sq_ring = cq_ring = MAP_FAILED;
+	close(ring_fd);
+	ring_fd = -1;
+	return;
+      }
+      sqes = (struct io_uring_sqe *)sqes_ptr;
+
+      char *sq = (char *)sq_ring;
+      sq_head = (volatile unsigned *)(sq + p.sq_off.head);
+      sq_tail = (volatile unsigned *)(sq + p.sq_off.tail);
+      sq_flags = (volatile unsigned *)(sq + p.sq_off.flags);
+      sq_array = (volatile unsigned *)(sq + p.sq_off.array);
+      sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+      sq_entries = *(unsigned *)(sq + p.sq_off.ring_entries);
+
+      char *cq = (char *)cq_ring;
+      cq_head = (volatile unsigned *)(cq + p.cq_off.head);
+      cq_tail = (volatile unsigned *)(cq + p.cq_off.tail);
+      cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+      cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+      // start with an empty (sparse) file table that add_file fills in
+      std::vector<int> fds(NUM_FIXED_FILES, -1);
+      if(io_uring_register(ring_fd, IORING_REGISTER_FILES,
+			   &fds[0], NUM_FIXED_FILES) == 0) {
+	files_registered = true;
+	for(unsigned i = 0; i < NUM_FIXED_FILES; i++)
+	  free_file_slots.push_back(NUM_FIXED_FILES - 1 - i);
+      } else
+	log_aio.info() << "io_uring file registration unavailable: " << strerror(errno);
+
+      log_aio.info() << "io_uring created: entries=" << sq_entries
+		     << " sqpoll=" << sqpoll;
+    }
+
+    AsyncFileIOContext::UringQueue::~UringQueue(void)
+    {
+      if(ring_fd < 0) return;
+      munmap(sqes, sqes_size);
+      if(cq_ring != sq_ring)
+	munmap(cq_ring, cq_ring_size);
+      munmap(sq_ring, sq_ring_size);
+      // closing the ring also drops any registered files/buffers
+      close(ring_fd);
+    }
+
+    struct io_uring_sqe *AsyncFileIOContext::UringQueue::get_sqe(void)
+    {
+      // buffers are registered lazily so that all memories can be added first
+      if(!buffers_registered)
+	register_buffers();
+
+      // entries handed out since the last flush() aren't visible in the
+      //  shared tail yet
+      unsigned tail = *sq_tail + to_submit;
+      unsigned head = *sq_head;
+      __sync_synchronize();
+      if((tail - head) >= sq_entries)
+	return 0;
+      unsigned idx = tail & sq_mask;
+      struct io_uring_sqe *sqe = &sqes[idx];
+      memset(sqe, 0, sizeof(*sqe));
+      sq_array[idx] = idx;
+      to_submit++;
+      return sqe;
+    }
+
+    void AsyncFileIOContext::UringQueue::flush(void)
+    {
+      // publish all the new entries at once
+      if(to_submit > 0) {
+	__sync_synchronize();
+	*sq_tail = *sq_tail + to_submit;
+	__sync_synchronize();
+	to_submit = 0;
+      }
+
+      if(sqpoll) {
+	// the kernel thread picks them up on its own unless it has gone idle
+	if((*sq_flags & IORING_SQ_NEED_WAKEUP) != 0)
+	  io_uring_enter(ring_fd, 0, 0, IORING_ENTER_SQ_WAKEUP);
+	return;
+      }
+
+      // this includes anything a previous enter didn't manage to consume
+      unsigned unconsumed = *sq_tail - *sq_head;
+      if(unconsumed == 0) return;
+      int ret = io_uring_enter(ring_fd, unconsumed, 0, 0);
+      log_aio.debug("io_uring_enter: to_submit=%u ret=%d", unconsumed, ret);
+      // on a transient failure the entries stay in the ring for next time
+      assert((ret >= 0) ||
+	     (errno == EAGAIN) || (errno == EBUSY) || (errno == EINTR));
+    }
+
+    void AsyncFileIOContext::UringQueue::reap(void)
+    {
+      unsigned head = *cq_head;
+      unsigned tail = *cq_tail;
+      __sync_synchronize();
+      if(head == tail) return;
+      while(head != tail) {
+	struct io_uring_cqe *cqe = &cqes[head & cq_mask];
+	UringAIOOp *op = (UringAIOOp *)(uintptr_t)(cqe->user_data);
+	log_aio.debug("io_uring completion: op=%p res=%d", op, cqe->res);
+	op->result = cqe->res;
+	op->completed = true;
+	head++;
+      }
+      __sync_synchronize();
+      *cq_head = head;
+    }
+
+    int AsyncFileIOContext::UringQueue::fixed_file_index(int fd) const
+    {
+      std::map<int, unsigned>::const_iterator it = fixed_files.find(fd);
+      return ((it != fixed_files.end()) ? (int)(it->second) : -1);
+    }
+
+    int AsyncFileIOContext::UringQueue::fixed_buffer_index(const void *buffer,
+							   size_t bytes) const
+    {
+      if(!buffers_registered) return -1;
+      uintptr_t lo = (uintptr_t)buffer;
+      for(size_t i = 0; i < buffers.size(); i++) {
+	uintptr_t base = (uintptr_t)(buffers[i].iov_base);
+	if((lo >= base) && ((lo + bytes) <= (base + buffers[i].iov_len)))
+	  return i;
+      }
+      return -1;
+    }
+
+    void AsyncFileIOContext::UringQueue::add_buffer(void *base, size_t bytes)
+    {
+      if(buffers_registered) {
+	log_aio.warning() << "io_uring buffers already registered - ignoring "
+			  << base << "+" << bytes;
+	return;
+      }
+      // the kernel limits each registered buffer to 1GB
+      const size_t max_chunk = 1 << 30;
+      char *p = (char *)base;
+      while(bytes > 0) {
+	struct iovec iov;
+	iov.iov_base = p;
+	iov.iov_len = std::min(bytes, max_chunk);
+	buffers.push_back(iov);
+	p += iov.iov_len;
+	bytes -= iov.iov_len;
+      }
+    }
+
+    void AsyncFileIOContext::UringQueue::register_buffers(void)
+    {
+      buffers_registered = true;
+      if(buffers.empty()) return;
+      if(io_uring_register(ring_fd, IORING_REGISTER_BUFFERS,
+			   &buffers[0], buffers.size()) != 0) {
+	// usually RLIMIT_MEMLOCK - not fatal, we just don't use fixed buffers
+	log_aio.warning() << "io_uring buffer registration failed ("
+			  << strerror(errno) << ") - continuing without";
+	buffers.clear();
+      }
+    }
+
+    void AsyncFileIOContext::UringQueue::add_file(int fd)
+    {
+      if(!files_registered || free_file_slots.empty() ||
+	 (fixed_files.count(fd) > 0))
+	return;
+      unsigned slot = free_file_slots.back();
+      struct io_uring_files_update upd;
+      memset(&upd, 0, sizeof(upd));
+      upd.offset = slot;
+      upd.fds = (uintptr_t)&fd;
+      if(io_uring_register(ring_fd, IORING_REGISTER_FILES_UPDATE, &upd, 1) == 1) {
+	free_file_slots.pop_back();
+	fixed_files[fd] = slot;
+      }
+    }
+
+    void AsyncFileIOContext::UringQueue::remove_file(int fd)
+    {
+      std::map<int, unsigned>::iterator it = fixed_files.find(fd);
+      if(it == fixed_files.end()) return;
+      int empty_fd = -1;
+      struct io_uring_files_update upd;
+      memset(&upd, 0, sizeof(upd));
+      upd.offset = it->second;
+      upd.fds = (uintptr_t)&empty_fd;
+#ifndef NDEBUG
+      int ret =
+#endif
+	io_uring_register(ring_fd, IORING_REGISTER_FILES_UPDATE, &upd, 1);
+      assert(ret == 1);
+      free_file_slots.push_back(it->second);
+      fixed_files.erase(it);
+    }
+
+    UringAIOOp::UringAIOOp(AsyncFileIOContext::UringQueue *_queue, bool _is_write,
+			   int _fd, size_t _offset, size_t _bytes,
+			   const void *_buffer, Request* request)
+      : queue(_queue), is_write(_is_write), fd(_fd)
+      , offset(_offset), bytes(_bytes), buffer(_buffer), result(0)
+    {
+      completed = false;
+      req = request;
+    }
+
+    void UringAIOOp::launch(void)
+    {
+      // the context never launches more than max_depth operations, which is
+      //  also the size of the submission ring
+      struct io_uring_sqe *sqe = queue->get_sqe();
+      assert(sqe != 0);
+      assert(bytes <= (size_t)UINT_MAX);
+      int file_idx = queue->fixed_file_index(fd);
+      int buf_idx = queue->fixed_buffer_index(buffer, bytes);
+      if(buf_idx >= 0) {
+	sqe->opcode = (is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED);
+	sqe->buf_index = buf_idx;
+      } else
+	sqe->opcode = (is_write ? IORING_OP_WRITE : IORING_OP_READ);
+      if(file_idx >= 0) {
+	sqe->fd = file_idx;
+	sqe->flags |= IOSQE_FIXED_FILE;
+      } else
+	sqe->fd = fd;
+      sqe->off = offset;
+      sqe->addr = (uintptr_t)buffer;
+      sqe->len = bytes;
+      sqe->user_data = (uintptr_t)this;
+      log_aio.debug("%s queued: op=%p fd=%d fixed_file=%d fixed_buf=%d",
+		    (is_write ? "write" : "read"), this, fd, file_idx, buf_idx);
+    }
+
+    bool UringAIOOp::check_completion(void)
+    {
+      if(!completed) return false;
+      if(result < 0) {
+	log_aio.fatal() << (is_write ? "write" : "read") << " failed: fd=" << fd
+			<< " offset=" << offset << " bytes=" << bytes
+			<< " error=" << strerror(-result);
+	assert(0);
+      }
+      return true;
+    }
 #endif
 
     class AIOFence : public Operation::AsyncWorkItem {
@@ -1114,16 +1825,52 @@ namespace Realm {
       return true;
     }
 
-    AsyncFileIOContext::AsyncFileIOContext(int _max_depth)
-      : max_depth(_max_depth)
+    AsyncFileIOContext::AsyncFileIOContext(int _max_depth,
+					   Backend _backend /*= BACKEND_DEFAULT*/)
+      : backend(_backend), max_depth(_max_depth)
     {
+#ifdef REALM_USE_IO_URING
+      uring = 0;
+      if(backend == BACKEND_URING) {
+	uring = new UringQueue(max_depth, Config::aio_uring_sqpoll);
+	if(!uring->ok()) {
+	  log_aio.warning() << "io_uring unavailable - using default AIO backend";
+	  delete uring;
+	  uring = 0;
+	  backend = BACKEND_DEFAULT;
+	}
+      }
+#else
+      if(backend == BACKEND_URING) {
+	log_aio.warning() << "io_uring support not compiled in - using default AIO backend";
+	backend = BACKEND_DEFAULT;
+      }
+#endif
+#ifndef __linux__
+      if(backend == BACKEND_KERNEL) {
+	log_aio.warning() << "kernel AIO only supported on Linux - using POSIX AIO";
+	backend = BACKEND_POSIX;
+      }
+#endif
+      if(backend == BACKEND_DEFAULT) {
 #ifdef REALM_USE_KERNEL_AIO
+	backend = BACKEND_KERNEL;
+#else
+	backend = BACKEND_POSIX;
+#endif
+      }
+
+#ifdef __linux__
       aio_ctx = 0;
+      if(backend == BACKEND_KERNEL) {
+	aio_context_t ctx = 0;
 #ifndef NDEBUG
-      int ret =
+	int ret =
 #endif
-	io_setup(max_depth, &aio_ctx);
-      assert(ret == 0);
+	  io_setup(max_depth, &ctx);
+	assert(ret == 0);
+	aio_ctx = ctx;
+      }
 #endif
     }
 
@@ -1131,12 +1878,17 @@ namespace Realm {
     {
       assert(pending_operations.empty());
       assert(launched_operations.empty());
-#ifdef REALM_USE_KERNEL_AIO
+#ifdef __linux__
+      if(backend == BACKEND_KERNEL) {
 #ifndef NDEBUG
-      int ret =
+	int ret =
 #endif
-	io_destroy(aio_ctx);
-      assert(ret == 0);
+	  io_destroy(aio_ctx);
+	assert(ret == 0);
+      }
+#endif
+#ifdef REALM_USE_IO_URING
+      delete uring;
 #endif
     }
 
@@ -1144,12 +1896,22 @@ namespace Realm {
 					   size_t bytes, const void *buffer,
                                            Request* req)
     {
-#ifdef REALM_USE_KERNEL_AIO
-      KernelAIOWrite *op = new KernelAIOWrite(aio_ctx,
-					      fd, offset, bytes, buffer, req);
-#else
-      PosixAIOWrite *op = new PosixAIOWrite(fd, offset, bytes, buffer, req);
+      AIOOperation *op;
+      switch(backend) {
+#ifdef __linux__
+      case BACKEND_KERNEL:
+	op = new KernelAIOWrite(aio_ctx, fd, offset, bytes, buffer, req);
+	break;
+#endif
+#ifdef REALM_USE_IO_URING
+      case BACKEND_URING:
+	op = new UringAIOOp(uring, true /*write*/, fd, offset, bytes, buffer, req);
+	break;
 #endif
+      default:
+	op = new PosixAIOWrite(fd, offset, bytes, buffer, req);
+	break;
+      }
       {
 	AutoHSLLock al(mutex);
 	if(launched_operations.size() < (size_t)max_depth) {
@@ -1165,12 +1927,22 @@ namespace Realm {
 					  size_t bytes, void *buffer,
                                           Request* req)
     {
-#ifdef REALM_USE_KERNEL_AIO
-      KernelAIORead *op = new KernelAIORead(aio_ctx,
-					    fd, offset, bytes, buffer, req);
-#else
-      PosixAIORead *op = new PosixAIORead(fd, offset, bytes, buffer, req);
+      AIOOperation *op;
+      switch(backend) {
+#ifdef __linux__
+      case BACKEND_KERNEL:
+	op = new KernelAIORead(aio_ctx, fd, offset, bytes, buffer, req);
+	break;
+#endif
+#ifdef REALM_USE_IO_URING
+      case BACKEND_URING:
+	op = new UringAIOOp(uring, false /*!write*/, fd, offset, bytes, buffer, req);
+	break;
 #endif
+      default:
+	op = new PosixAIORead(fd, offset, bytes, buffer, req);
+	break;
+      }
       {
 	AutoHSLLock al(mutex);
 	if(launched_operations.size() < (size_t)max_depth) {
@@ -1196,6 +1968,36 @@ namespace Realm {
       }
     }
 
+    void AsyncFileIOContext::register_buffer(void *base, size_t bytes)
+    {
+#ifdef REALM_USE_IO_URING
+      if(uring) {
+	AutoHSLLock al(mutex);
+	uring->add_buffer(base, bytes);
+      }
+#endif
+    }
+
+    void AsyncFileIOContext::register_file(int fd)
+    {
+#ifdef REALM_USE_IO_URING
+      if(uring) {
+	AutoHSLLock al(mutex);
+	uring->add_file(fd);
+      }
+#endif
+    }
+
+    void AsyncFileIOContext::unregister_file(int fd)
+    {
+#ifdef REALM_USE_IO_URING
+      if(uring) {
+	AutoHSLLock al(mutex);
+	uring->remove_file(fd);
+      }
+#endif
+    }
+
     bool AsyncFileIOContext::empty(void)
     {
       AutoHSLLock al(mutex);
@@ -1213,8 +2015,8 @@ namespace Realm {
       AutoHSLLock al(mutex);
 
       // first, reap as many events as we can - oldest first
-#ifdef REALM_USE_KERNEL_AIO
-      while(true) {
+#ifdef __linux__
+      while(backend == BACKEND_KERNEL) {
 	struct io_event events[8];
 	struct timespec ts;
 	ts.tv_sec = 0;
@@ -1224,11 +2026,25 @@ namespace Realm {
 	log_aio.debug("io_getevents returned %d events", ret);
 	for(int i = 0; i < ret; i++) {
 	  AIOOperation *op = (AIOOperation *)(events[i].data);
-	  log_aio.debug("io_getevents: event[%d] = %p", i, op);
+	  log_aio.debug("io_getevents: event[%d] = %p res=%lld", i, op,
+			(long long)(events[i].res));
+	  if(events[i].res < 0) {
+	    log_aio.fatal() << "kernel AIO operation failed: op=" << op
+			    << " error=" << strerror(-events[i].res);
+	    assert(0);
+	  }
 	  op->completed = true;
 	}
       }
 #endif
+#ifdef REALM_USE_IO_URING
+      // hand anything launched since the last call to the kernel in one
+      //  batch, then pick up completions
+      if(uring) {
+	uring->flush();
+	uring->reap();
+      }
+#endif
 
       // now actually mark events completed in oldest-first order
       while(!launched_operations.empty()) {
@@ -1254,6 +2070,10 @@ namespace Realm {
 	op->launch();
 	launched_operations.push_back(op);
       }
+#ifdef REALM_USE_IO_URING
+      if(uring)
+	uring->flush();
+#endif
     }
 
     /*static*/
@@ -1556,6 +2376,67 @@ namespace Realm {
       assert(0);
     }
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class CopyPath
+  //
+
+    void CopyPath::build(Memory src_mem, Memory dst_mem,
+			 CustomSerdezID _serdez_id)
+    {
+      serdez_id = _serdez_id;
+      find_shortest_path(src_mem, dst_mem, serdez_id, mem_path);
+      // only the first hop serializes and only the last one deserializes
+      size_t hops = mem_path.size() - 1;
+      hop_kinds.resize(hops);
+      for(size_t i = 0; i < hops; i++)
+	hop_kinds[i] = get_xfer_des(mem_path[i], mem_path[i + 1],
+				    ((i == 0) ? serdez_id : 0),
+				    ((i == (hops - 1)) ? serdez_id : 0),
+				    0);
+    }
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class CopyPathCache
+  //
+
+    CopyPathCache::CopyPathCache(void)
+      : total_hits(0), total_misses(0)
+      , path_hits("realm/dma/path_cache/hits")
+      , path_misses("realm/dma/path_cache/misses")
+    {}
+
+    CopyPathCache::~CopyPathCache(void)
+    {
+      log_dma.info() << "copy path cache: paths=" << paths.size()
+		     << " hits=" << total_hits
+		     << " misses=" << total_misses;
+      for(std::map<PathKey, CopyPath *>::iterator it = paths.begin();
+	  it != paths.end();
+	  ++it)
+	delete it->second;
+    }
+
+    const CopyPath *CopyPathCache::lookup(Memory src_mem, Memory dst_mem,
+					  CustomSerdezID serdez_id)
+    {
+      PathKey key(MemPair(src_mem, dst_mem), serdez_id);
+      AutoHSLLock al(mutex);
+      std::map<PathKey, CopyPath *>::const_iterator it = paths.find(key);
+      if(it != paths.end()) {
+	total_hits++;
+	path_hits += 1;
+	return it->second;
+      }
+      total_misses++;
+      path_misses += 1;
+      CopyPath *p = new CopyPath;
+      p->build(src_mem, dst_mem, serdez_id);
+      paths[key] = p;
+      return p;
+    }
+
 
   class WrappingFIFOIterator : public TransferIterator {
   public:
@@ -1789,11 +2670,18 @@ namespace Realm {
 	      next_max_rw_gap = ibvec[idx - 1].size;
 	    }
 
-            XferDes::XferKind kind = get_xfer_des(mem_path[idx - 1],
-						  mem_path[idx],
-						  xd_src_serdez_id,
-						  xd_dst_serdez_id,
-						  0);
+	    // the path was chosen with the first field's serdez op - if this
+	    //  instance pair's fields use a different one, pick the channel
+	    //  for this hop again
+            XferDes::XferKind kind;
+	    if(serdez_id == copy_path->serdez_id)
+	      kind = copy_path->hop_kinds[idx - 1];
+	    else
+	      kind = get_xfer_des(mem_path[idx - 1],
+				  mem_path[idx],
+				  xd_src_serdez_id,
+				  xd_dst_serdez_id,
+				  0);
 	    assert(kind != XferDes::XFER_NONE);
 
 	    // special case: gasnet reads must always be done from the node that
@@ -1829,7 +2717,9 @@ namespace Realm {
 			    xd_src_mem, xd_dst_mem, xd_src_iter, xd_dst_iter,
 			    xd_src_serdez_id, xd_dst_serdez_id,
 			    16 * 1024 * 1024/*max_req_size*/, 100/*max_nr*/,
-			    priority, order, kind, complete_fence, attach_inst);
+			    priority, order, kind, complete_fence,
+			    measurements.wants_measurement<ProfilingMeasurements::OperationTransferTimeline>(),
+			    attach_inst);
             //pre_buf = cur_buf;
             //oasvec = oasvec_dst;
           }
@@ -2021,6 +2911,15 @@ namespace Realm {
 	  }
 	}
 
+	// keep the instances where they are until we're done
+	for(std::vector<CopySrcDstField>::iterator it = srcs.begin();
+	    it != srcs.end();
+	    it++)
+	  if(!pin_instance(it->inst, just_check))
+	    return false;
+	if(!pin_instance(dst.inst, just_check))
+	  return false;
+
 	// if we got all the way through, we've got all the metadata we need
 	state = STATE_BEFORE_EVENT;
       }
@@ -2202,10 +3101,15 @@ namespace Realm {
 	  void *dst_ptr = dst_mem->get_direct_ptr(dst_info.base_offset,
 						  dst_info.bytes_per_chunk);
 	  if(dst_ptr) {
-	    if(red_fold)
-	      redop->fold(dst_ptr, src_ptr, num_elems, false /*!excl*/);
+	    // the built-in ops have vectorized kernels, but those can only
+	    //  be used if the caller promised exclusive access
+	    if(dst.red_exclusive &&
+	       CopyKernels::reduce(redop, dst_ptr, src_ptr, num_elems)) {
+	      // done
+	    } else if(red_fold)
+	      redop->fold(dst_ptr, src_ptr, num_elems, dst.red_exclusive);
 	    else
-	      redop->apply(dst_ptr, src_ptr, num_elems, false /*!excl*/);
+	      redop->apply(dst_ptr, src_ptr, num_elems, dst.red_exclusive);
 	  } else {
 	    // case 3: fallback - use get_bytes/put_bytes combo
 
@@ -2220,7 +3124,9 @@ namespace Realm {
 	    dst_mem->get_bytes(dst_info.base_offset,
 			       dst_scratch_buffer,
 			       dst_info.bytes_per_chunk);
-	    if(red_fold)
+	    if(CopyKernels::reduce(redop, dst_scratch_buffer, src_ptr, num_elems)) {
+	      // done
+	    } else if(red_fold)
 	      redop->fold(dst_scratch_buffer, src_ptr, num_elems, true/*excl*/);
 	    else
 	      redop->apply(dst_scratch_buffer, src_ptr, num_elems, true/*excl*/);
@@ -2399,6 +3305,10 @@ namespace Realm {
 	  }
 	}
 
+	// keep the destination where it is until we're done
+	if(!pin_instance(dst.inst, just_check))
+	  return false;
+
         state = STATE_BEFORE_EVENT;
       }
 
@@ -2484,6 +3394,22 @@ namespace Realm {
 	size_t act_bytes = iter->step(max_bytes, info, flags);
 	assert(act_bytes >= 0);
 
+	// if the destination is directly accessible, the fill kernels can
+	//  write the pattern in place (unless they've been disabled)
+	if(CopyKernels::get_level() != CopyKernels::LEVEL_MEMCPY) {
+	  size_t extent = (((info.num_planes - 1) * info.plane_stride) +
+			   ((info.num_lines - 1) * info.line_stride) +
+			   info.bytes_per_chunk);
+	  void *dst_ptr = mem_impl->get_direct_ptr(info.base_offset, extent);
+	  if(dst_ptr) {
+	    CopyKernels::fill_3d(dst_ptr, fill_buffer, fill_size,
+				 info.bytes_per_chunk,
+				 info.num_lines, info.line_stride,
+				 info.num_planes, info.plane_stride);
+	    continue;
+	  }
+	}
+
 	// decide whether to use the original fill buffer or one that
 	//  repeats the data several times
 	const void *use_buffer = fill_buffer;
@@ -2623,9 +3549,31 @@ namespace Realm {
                           CoreReservationSet& crs)
     {
       //log_dma.add_stream(&std::cerr, Logger::LEVEL_DEBUG, false, false);
-      aio_context = new AsyncFileIOContext(256);
+      aio_context = new AsyncFileIOContext(Config::aio_queue_depth,
+					   (AsyncFileIOContext::Backend)Config::aio_backend);
+      if(Config::aio_uring_fixed_buffers) {
+	// register the local CPU memories that file I/O can target
+	const std::vector<MemoryImpl *>& local_mems = get_runtime()->nodes[my_node_id].memories;
+	for(size_t i = 0; i < local_mems.size(); i++) {
+	  Memory::Kind k = local_mems[i]->lowlevel_kind;
+	  if((k != Memory::SYSTEM_MEM) && (k != Memory::REGDMA_MEM) &&
+	     (k != Memory::Z_COPY_MEM))
+	    continue;
+	  void *base = local_mems[i]->get_direct_ptr(0, local_mems[i]->size);
+	  if(base)
+	    aio_context->register_buffer(base, local_mems[i]->size);
+	}
+      }
       start_channel_manager(count, pinned, max_nr, crs);
       ib_req_queue = new PendingIBQueue();
+      copy_path_cache = new CopyPathCache;
+    }
+
+    bool trim_ib_buffer_pool(Memory mem)
+    {
+      if(!ib_req_queue || !Config::dma_ib_pool)
+	return false;
+      return ib_req_queue->trim_pool(mem);
     }
 
     void stop_dma_system(void)
@@ -2633,6 +3581,8 @@ namespace Realm {
       stop_channel_manager();
       delete ib_req_queue;
       ib_req_queue = 0;
+      delete copy_path_cache;
+      copy_path_cache = 0;
       delete aio_context;
       aio_context = 0;
     }
@@ -87,6 +87,10 @@ namespace Realm {
     void find_shortest_path(Memory src_mem, Memory dst_mem,
 			    CustomSerdezID serdez_id, std::vector<Memory>& path);
 
+    // a copy's memory path and the channel used for each hop - defined in
+    //  lowlevel_dma.cc, where these are cached per memory pair
+    struct CopyPath;
+
     struct RemoteCopyArgs : public BaseMedium {
       ReductionOpID redop_id;
       bool red_fold;
@@ -123,6 +127,10 @@ namespace Realm {
 
     extern void stop_dma_system(void);
 
+    // gives any intermediate buffers cached for 'mem' back to it - returns
+    //  true if there were any (i.e. a failed allocation is worth retrying)
+    extern bool trim_ib_buffer_pool(Memory mem);
+
     /*
     extern Event enqueue_dma(IndexSpace idx,
 			     RegionInstance src, 
@@ -205,6 +213,24 @@ namespace Realm {
       Event tgt_fetch_completion;
       // </NEWDMA>
 
+      // called (from any thread) as each XferDes finishes - the records are
+      //  reported as an OperationTransferTimeline if it was requested
+      void add_xfer_record(const ProfilingMeasurements::OperationTransferTimeline::XferInterval& rec);
+
+    protected:
+      virtual void mark_completed(void);
+
+      // instances used by a request are pinned (so the memory defragmenter
+      //  won't move them) from when their metadata is available until the
+      //  request completes - returns false if an instance is being moved,
+      //  in which case (unless just_check) the request sleeps until it's done
+      bool pin_instance(RegionInstance inst, bool just_check);
+      void unpin_instances(void);
+
+      std::vector<ProfilingMeasurements::OperationTransferTimeline::XferInterval> xfer_records;
+      std::set<RegionInstance> pinned_insts;
+    public:
+
       class Waiter : public EventWaiter {
       public:
         Waiter(void);
@@ -220,6 +246,9 @@ namespace Realm {
 	virtual void print(std::ostream& os) const;
 	virtual Event get_finish_event(void) const;
       };
+
+    protected:
+      Waiter waiter; // if we need to wait on events
     };
 
     void free_intermediate_buffer(DmaRequest* req, Memory mem, off_t offset, size_t size);
@@ -331,10 +360,12 @@ namespace Realm {
       };
 
       std::vector<Memory> mem_path;
+      // where mem_path came from - normally owned by the path cache
+      const CopyPath *copy_path;
+      bool owns_copy_path;
       // </NEW_DMA>
 
       Event before_copy;
-      Waiter waiter; // if we need to wait on events
     };
 
     class ReduceRequest : public DmaRequest {
@@ -379,7 +410,6 @@ namespace Realm {
       ReductionOpID redop_id;
       bool red_fold;
       Event before_copy;
-      Waiter waiter; // if we need to wait on events
     };
 
     class FillRequest : public DmaRequest {
@@ -422,7 +452,6 @@ namespace Realm {
       void *fill_buffer;
       size_t fill_size;
       Event before_fill;
-      Waiter waiter;
     };
 
     // each DMA "channel" implements one of these to describe (implicitly) which copies it
@@ -455,7 +484,16 @@ namespace Realm {
 
     class AsyncFileIOContext {
     public:
-      AsyncFileIOContext(int _max_depth);
+      // the OS interface used to perform the I/O - the values match
+      //  Config::aio_backend
+      enum Backend {
+	BACKEND_DEFAULT = 0, // kernel AIO if REALM_USE_KERNEL_AIO, else POSIX
+	BACKEND_POSIX = 1,   // aio_read/aio_write
+	BACKEND_KERNEL = 2,  // Linux io_submit/io_getevents
+	BACKEND_URING = 3,   // Linux io_uring (requires REALM_USE_IO_URING)
+      };
+
+      AsyncFileIOContext(int _max_depth, Backend _backend = BACKEND_DEFAULT);
       ~AsyncFileIOContext(void);
 
       void enqueue_write(int fd, size_t offset, size_t bytes, const void *buffer, Request* req = NULL);
@@ -466,6 +504,16 @@ namespace Realm {
       long available(void);
       void make_progress(void);
 
+      // long-lived buffers (i.e. CPU memories) that file I/O will target can
+      //  be registered up front so that backends that support it (io_uring)
+      //  don't have to pin the pages on every request
+      void register_buffer(void *base, size_t bytes);
+
+      // likewise for files that will see many requests - a registered file
+      //  descriptor must be unregistered before it is closed
+      void register_file(int fd);
+      void unregister_file(int fd);
+
       static AsyncFileIOContext* get_singleton(void);
 
       class AIOOperation {
@@ -477,11 +525,16 @@ namespace Realm {
         void* req;
       };
 
+      Backend backend;
       int max_depth;
       std::deque<AIOOperation *> launched_operations, pending_operations;
       GASNetHSL mutex;
-#ifdef REALM_USE_KERNEL_AIO
-      aio_context_t aio_ctx;
+#ifdef __linux__
+      unsigned long aio_ctx; // really an aio_context_t
+#endif
+#ifdef REALM_USE_IO_URING
+      class UringQueue;
+      UringQueue *uring;
 #endif
     };
 };
@@ -0,0 +1,80 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// templated work-stealing deque
+
+#ifndef REALM_WS_DEQUE_H
+#define REALM_WS_DEQUE_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace Realm {
+
+  // a Chase-Lev work-stealing deque - a single owner adds items at the
+  //  bottom, and any number of threads (including the owner) take items
+  //  from the top without a lock, so items come out in the order they went
+  //  in
+  // the owner's pushes must be serialized by the caller (e.g. with a lock
+  //  that only the owner side takes)
+  // the circular buffer grows when it fills - old buffers are kept until the
+  //  deque is destroyed because a thief may still be reading from one
+  // T is copied with operator= and should be cheap to copy (e.g. a pointer)
+  template <typename T>
+  class WorkStealingDeque {
+  public:
+    WorkStealingDeque(size_t _init_capacity = 64);
+    ~WorkStealingDeque(void);
+
+    typedef T ITEMTYPE;
+
+    // both of these are racy snapshots - only useful as hints
+    bool empty(void) const;
+    size_t size(void) const;
+
+    // owner only
+    void push(const T& val);
+
+    // any thread - returns false if the deque was empty (a take that loses
+    //  a race with another one just tries again)
+    bool steal(T& val);
+
+  protected:
+    // not copyable
+    WorkStealingDeque(const WorkStealingDeque<T>& copy_from);
+    WorkStealingDeque<T>& operator=(const WorkStealingDeque<T>& copy_from);
+
+    struct Buffer {
+      size_t mask;
+      T *items;
+    };
+
+    Buffer *grow(Buffer *old_buf, long long t, long long b);
+
+    // keep the thieves' counter away from the owner's
+    static const size_t PAD_BYTES = 64;
+
+    volatile long long top;
+    char pad0[PAD_BYTES - sizeof(long long)];
+    volatile long long bottom;
+    Buffer * volatile buffer;
+    std::vector<Buffer *> retired;
+  };
+
+}; // namespace Realm
+
+#include "realm/ws_deque.inl"
+
+#endif // ifndef REALM_WS_DEQUE_H
@@ -0,0 +1,120 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// templated work-stealing deque
+
+// nop, but helps IDEs
+#include "realm/ws_deque.h"
+
+#include <assert.h>
+
+namespace Realm {
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class WorkStealingDeque<T>
+
+  template <typename T>
+  inline WorkStealingDeque<T>::WorkStealingDeque(size_t _init_capacity /*= 64*/)
+    : top(0), bottom(0)
+  {
+    size_t capacity = 2;
+    while(capacity < _init_capacity)
+      capacity <<= 1;
+    Buffer *buf = new Buffer;
+    buf->mask = capacity - 1;
+    buf->items = new T[capacity];
+    buffer = buf;
+  }
+
+  template <typename T>
+  inline WorkStealingDeque<T>::~WorkStealingDeque(void)
+  {
+    delete[] buffer->items;
+    delete buffer;
+    for(typename std::vector<Buffer *>::iterator it = retired.begin();
+	it != retired.end();
+	++it) {
+      delete[] (*it)->items;
+      delete *it;
+    }
+  }
+
+  template <typename T>
+  inline bool WorkStealingDeque<T>::empty(void) const
+  {
+    return (bottom <= top);
+  }
+
+  template <typename T>
+  inline size_t WorkStealingDeque<T>::size(void) const
+  {
+    long long n = bottom - top;
+    return ((n > 0) ? n : 0);
+  }
+
+  template <typename T>
+  typename WorkStealingDeque<T>::Buffer *WorkStealingDeque<T>::grow(Buffer *old_buf,
+								      long long t,
+								      long long b)
+  {
+    size_t capacity = 2 * (old_buf->mask + 1);
+    Buffer *new_buf = new Buffer;
+    new_buf->mask = capacity - 1;
+    new_buf->items = new T[capacity];
+    for(long long i = t; i < b; i++)
+      new_buf->items[i & new_buf->mask] = old_buf->items[i & old_buf->mask];
+    // the copy has to be visible before anybody can find the new buffer
+    __sync_synchronize();
+    buffer = new_buf;
+    retired.push_back(old_buf);
+    return new_buf;
+  }
+
+  template <typename T>
+  inline void WorkStealingDeque<T>::push(const T& val)
+  {
+    long long b = bottom;
+    long long t = __sync_fetch_and_add(&top, 0);
+    Buffer *buf = buffer;
+    if((b - t) > (long long)(buf->mask))
+      buf = grow(buf, t, b);
+    buf->items[b & buf->mask] = val;
+    // the item has to be visible before the new bottom is
+    __sync_synchronize();
+    bottom = b + 1;
+  }
+
+  template <typename T>
+  inline bool WorkStealingDeque<T>::steal(T& val)
+  {
+    while(true) {
+      long long t = __sync_fetch_and_add(&top, 0);
+      long long b = bottom;
+      if(t >= b)
+	return false;
+      // read the buffer after bottom - a buffer that's been replaced still
+      //  holds every item below the bottom we saw
+      __sync_synchronize();
+      Buffer *buf = buffer;
+      T item = buf->items[t & buf->mask];
+      if(__sync_bool_compare_and_swap(&top, t, t + 1)) {
+	val = item;
+	return true;
+      }
+    }
+  }
+
+}; // namespace Realm
@@ -172,6 +172,12 @@ LEGION_LD_FLAGS += -ldl -Wl,-export_dynamic
 endif
 endif
 
+# lock-free bucketed priority queues for processor task queues
+REALM_BUCKETED_TASK_QUEUES ?= 0
+ifeq ($(strip $(REALM_BUCKETED_TASK_QUEUES)),1)
+CC_FLAGS += -DREALM_BUCKETED_TASK_QUEUES
+endif
+
 USE_LLVM ?= 0
 ifeq ($(strip $(USE_LLVM)),1)
   # prefer known-working versions, if they can be named explicitly
@@ -469,6 +475,8 @@ REALM_SRC 	+= $(LG_RT_DIR)/realm/runtime_impl.cc \
 	           $(LG_RT_DIR)/realm/transfer/transfer.cc \
 	           $(LG_RT_DIR)/realm/transfer/channel.cc \
 	           $(LG_RT_DIR)/realm/transfer/channel_disk.cc \
+	           $(LG_RT_DIR)/realm/transfer/compressed_file.cc \
+	           $(LG_RT_DIR)/realm/transfer/copy_kernels.cc \
 	           $(LG_RT_DIR)/realm/transfer/lowlevel_dma.cc \
 	           $(LG_RT_DIR)/realm/module.cc \
 	           $(LG_RT_DIR)/realm/threads.cc \
@@ -482,10 +490,14 @@ REALM_SRC 	+= $(LG_RT_DIR)/realm/runtime_impl.cc \
 	           $(LG_RT_DIR)/realm/deppart/preimage.cc \
 	           $(LG_RT_DIR)/realm/deppart/byfield.cc \
 	           $(LG_RT_DIR)/realm/deppart/setops.cc \
+	           $(LG_RT_DIR)/realm/deppart/scan_kernels.cc \
 		   $(LG_RT_DIR)/realm/event_impl.cc \
 		   $(LG_RT_DIR)/realm/rsrv_impl.cc \
 		   $(LG_RT_DIR)/realm/proc_impl.cc \
 		   $(LG_RT_DIR)/realm/mem_impl.cc \
+		   $(LG_RT_DIR)/realm/mem_defrag.cc \
+		   $(LG_RT_DIR)/realm/parking.cc \
+		   $(LG_RT_DIR)/realm/shm_transport.cc \
 		   $(LG_RT_DIR)/realm/inst_impl.cc \
 		   $(LG_RT_DIR)/realm/inst_layout.cc \
 		   $(LG_RT_DIR)/realm/machine_impl.cc \
@@ -0,0 +1,269 @@
+/* Copyright 2018 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// replays an instance create/destroy trace against the instance allocator
+//  (BasicRangeAllocator) with each allocation policy and reports the time
+//  per operation, allocation failures, and how fragmented the free space
+//  gets - the trace is either read from a file (-trace) or generated: a
+//  mix of short-lived temporaries and long-lived instances of varied
+//  sizes, kept at a target fill level, which is what a memory looks like
+//  after a long-running application has been creating and destroying
+//  instances for a while
+//
+// trace format - one operation per line:
+//   a <id> <bytes> <alignment>     (create)
+//   f <id>                         (destroy)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <queue>
+#include <map>
+
+#include <realm/cmdline.h>
+#include <realm/timers.h>
+#include <realm/mem_impl.h>
+
+using namespace Realm;
+
+namespace TestConfig {
+  size_t capacity = 1 << 30;   // bytes managed by the allocator
+  int num_ops = 200000;        // operations in a generated trace
+  double fill = 0.85;          // target fraction of capacity that is live
+  double short_frac = 0.8;     // fraction of creates that are temporaries
+  int short_life = 50;         // mean lifetime (in ops) of a temporary
+  int long_life = 20000;       // mean lifetime of everything else
+  int seed = 12345;
+  std::string trace_file;      // replay this instead of generating one
+  std::string dump_file;       // write the generated trace here
+};
+
+struct TraceOp {
+  bool alloc;
+  int id;
+  size_t bytes, alignment;
+};
+
+typedef BasicRangeAllocator<size_t, int> Allocator;
+
+static unsigned short rng_state[3];
+
+static double rand_unit(void)
+{
+  return erand48(rng_state);
+}
+
+// exponentially-distributed lifetime with the given mean
+static int rand_lifetime(int mean)
+{
+  return 1 + (int)(-log(1.0 - rand_unit()) * mean);
+}
+
+// sizes look like regions: a log-uniform element count times a field size
+static size_t rand_size(void)
+{
+  static const size_t field_sizes[] = { 4, 8, 8, 12, 16, 24, 32 };
+  size_t elements = (size_t)exp(log(64.0) + rand_unit() * (log((double)(1 << 20)) - log(64.0)));
+  size_t fsize = field_sizes[(int)(rand_unit() * (sizeof(field_sizes) / sizeof(field_sizes[0])))];
+  size_t bytes = elements * fsize;
+  size_t limit = TestConfig::capacity / 64;
+  return ((bytes < limit) ? bytes : limit);
+}
+
+static void generate_trace(std::vector<TraceOp>& trace)
+{
+  // (death time, id) of live allocations, earliest first
+  typedef std::pair<int, int> Death;
+  std::priority_queue<Death, std::vector<Death>, std::greater<Death> > deaths;
+  std::map<int, size_t> live;
+  size_t live_bytes = 0;
+  size_t target = (size_t)(TestConfig::capacity * TestConfig::fill);
+  int next_id = 0;
+
+  for(int now = 0; (int)trace.size() < TestConfig::num_ops; now++) {
+    // retire everything whose time has come
+    while(!deaths.empty() && (deaths.top().first <= now)) {
+      TraceOp op;
+      op.alloc = false;
+      op.id = deaths.top().second;
+      op.bytes = op.alignment = 0;
+      trace.push_back(op);
+      live_bytes -= live[op.id];
+      live.erase(op.id);
+      deaths.pop();
+    }
+
+    TraceOp op;
+    op.alloc = true;
+    op.id = next_id++;
+    op.bytes = rand_size();
+    op.alignment = (rand_unit() < 0.9) ? 256 : 16;
+
+    // stay under the fill target by retiring early if needed
+    while(((live_bytes + op.bytes) > target) && !deaths.empty()) {
+      TraceOp f;
+      f.alloc = false;
+      f.id = deaths.top().second;
+      f.bytes = f.alignment = 0;
+      trace.push_back(f);
+      live_bytes -= live[f.id];
+      live.erase(f.id);
+      deaths.pop();
+    }
+
+    trace.push_back(op);
+    live[op.id] = op.bytes;
+    live_bytes += op.bytes;
+    bool temporary = (rand_unit() < TestConfig::short_frac);
+    deaths.push(Death(now + rand_lifetime(temporary ? TestConfig::short_life :
+					                 TestConfig::long_life),
+		      op.id));
+  }
+}
+
+static bool read_trace(const char *filename, std::vector<TraceOp>& trace)
+{
+  FILE *f = fopen(filename, "r");
+  if(!f) {
+    perror(filename);
+    return false;
+  }
+  char line[256];
+  while(fgets(line, sizeof(line), f)) {
+    TraceOp op;
+    unsigned long long bytes, alignment;
+    if(sscanf(line, "a %d %llu %llu", &op.id, &bytes, &alignment) == 3) {
+      op.alloc = true;
+      op.bytes = bytes;
+      op.alignment = alignment;
+    } else if(sscanf(line, "f %d", &op.id) == 1) {
+      op.alloc = false;
+      op.bytes = op.alignment = 0;
+    } else
+      continue;  // comments, blank lines
+    trace.push_back(op);
+  }
+  fclose(f);
+  return true;
+}
+
+static void write_trace(const char *filename, const std::vector<TraceOp>& trace)
+{
+  FILE *f = fopen(filename, "w");
+  if(!f) {
+    perror(filename);
+    return;
+  }
+  for(size_t i = 0; i < trace.size(); i++)
+    if(trace[i].alloc)
+      fprintf(f, "a %d %zd %zd\n", trace[i].id, trace[i].bytes, trace[i].alignment);
+    else
+      fprintf(f, "f %d\n", trace[i].id);
+  fclose(f);
+}
+
+static void replay(const char *name, Allocator::Policy policy,
+		   const std::vector<TraceOp>& trace)
+{
+  Allocator alloc(policy);
+  alloc.add_range(0, TestConfig::capacity);
+
+  // frees of failed allocations are skipped
+  std::vector<bool> failed;
+  size_t allocs = 0, failures = 0, peak_free_ranges = 0;
+  double frag_sum = 0;
+  size_t frag_samples = 0;
+  long long max_op_ns = 0;
+
+  long long start = Clock::current_time_in_nanoseconds();
+  for(size_t i = 0; i < trace.size(); i++) {
+    const TraceOp& op = trace[i];
+    long long t1 = Clock::current_time_in_nanoseconds();
+    if(op.alloc) {
+      if(op.id >= (int)failed.size())
+	failed.resize(op.id + 1, false);
+      size_t offset;
+      allocs++;
+      if(!alloc.allocate(op.id, op.bytes, op.alignment, offset)) {
+	failed[op.id] = true;
+	failures++;
+      }
+    } else {
+      if(!failed[op.id])
+	alloc.deallocate(op.id);
+    }
+    long long t2 = Clock::current_time_in_nanoseconds();
+    if((t2 - t1) > max_op_ns)
+      max_op_ns = t2 - t1;
+
+    if((i % 1000) == 999) {
+      Allocator::Stats stats;
+      alloc.get_stats(stats);
+      if(stats.free_ranges > peak_free_ranges)
+	peak_free_ranges = stats.free_ranges;
+      frag_sum += stats.fragmentation();
+      frag_samples++;
+    }
+  }
+  long long elapsed = Clock::current_time_in_nanoseconds() - start;
+
+  Allocator::Stats stats;
+  alloc.get_stats(stats);
+  printf("%-10s ops=%zd ns/op=%.1f max_ns=%lld failed=%zd/%zd"
+	 " free_ranges=%zd (peak %zd) largest_free=%.1fMB"
+	 " frag=%.3f (avg %.3f)\n",
+	 name, trace.size(), (double)elapsed / trace.size(), max_op_ns,
+	 failures, allocs,
+	 stats.free_ranges, peak_free_ranges, stats.largest_free / 1048576.0,
+	 stats.fragmentation(),
+	 (frag_samples ? (frag_sum / frag_samples) : 0.0));
+}
+
+int main(int argc, const char **argv)
+{
+  CommandLineParser cp;
+  cp.add_option_int("-cap", TestConfig::capacity)
+    .add_option_int("-n", TestConfig::num_ops)
+    .add_option_int("-short", TestConfig::short_life)
+    .add_option_int("-long", TestConfig::long_life)
+    .add_option_int("-seed", TestConfig::seed)
+    .add_option_string("-trace", TestConfig::trace_file)
+    .add_option_string("-dump", TestConfig::dump_file);
+  bool ok = cp.parse_command_line(argc, argv);
+  assert(ok);
+
+  std::vector<TraceOp> trace;
+  if(!TestConfig::trace_file.empty()) {
+    if(!read_trace(TestConfig::trace_file.c_str(), trace))
+      return 1;
+  } else {
+    rng_state[0] = TestConfig::seed;
+    rng_state[1] = TestConfig::seed >> 16;
+    rng_state[2] = 0x330e;
+    generate_trace(trace);
+    if(!TestConfig::dump_file.empty())
+      write_trace(TestConfig::dump_file.c_str(), trace);
+  }
+  printf("replaying %zd operations on %.1f MB\n",
+	 trace.size(), TestConfig::capacity / 1048576.0);
+
+  replay("first_fit", Allocator::FIRST_FIT, trace);
+  replay("best_fit", Allocator::BEST_FIT, trace);
+
+  return 0;
+}
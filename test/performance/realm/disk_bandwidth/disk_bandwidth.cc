@@ -0,0 +1,206 @@
+/* Copyright 2018 Stanford University
+ * Copyright 2018 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// measures file write/read bandwidth through the DMA system's file channels
+//  - run with different values of -ll:aio (or use the 'run_sweep' make
+//  target) to compare the async file I/O backends, or with -compress 1 (see
+//  the 'run_compress' make target) to compare compressed file instances
+//  against uncompressed ones
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <realm.h>
+#include <realm/cmdline.h>
+
+using namespace Realm;
+
+namespace TestConfig {
+  size_t size_mb = 64;            // size of the file in MB
+  int reps = 4;                   // number of times to write and read it
+  int num_files = 4;              // number of files written concurrently
+  std::string dir = ".";          // where to put the files
+  std::string backend = "default";  // just for reporting - parsed by Realm
+  int compress = 0;               // realm_file_compression_t for the files
+};
+
+// TASK IDs
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+Logger log_app("app");
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  Memory m = Machine::MemoryQuery(Machine::get_machine())
+    .has_affinity_to(p)
+    .only_kind(Memory::SYSTEM_MEM)
+    .first();
+  assert(m.exists());
+
+  int nf = TestConfig::num_files;
+  size_t elements = (TestConfig::size_mb << 20) / sizeof(double);
+  IndexSpace<1> is = Rect<1>(0, elements - 1);
+  std::vector<size_t> field_sizes(1, sizeof(double));
+  std::vector<FieldID> field_ids(1, 0);
+
+  if((2 * nf * (TestConfig::size_mb << 20)) > m.capacity()) {
+    log_app.fatal() << "insufficient memory capacity - increase -ll:csize";
+    exit(1);
+  }
+
+  std::vector<RegionInstance> mem_insts(nf), chk_insts(nf), file_insts(nf);
+  std::vector<std::string> filenames(nf);
+  std::vector<std::vector<CopySrcDstField> > mem_fields(nf), chk_fields(nf), file_fields(nf);
+  for(int i = 0; i < nf; i++) {
+    char name[256];
+    snprintf(name, sizeof(name), "%s/disk_bandwidth_%d_%d.dat",
+	     TestConfig::dir.c_str(), (int)getpid(), i);
+    filenames[i] = name;
+
+    RegionInstance::create_instance(mem_insts[i], m, is, field_sizes,
+				    0 /*SOA*/, ProfilingRequestSet()).wait();
+    RegionInstance::create_instance(chk_insts[i], m, is, field_sizes,
+				    0 /*SOA*/, ProfilingRequestSet()).wait();
+    RegionInstance::create_file_instance(file_insts[i], filenames[i].c_str(),
+					 is, field_ids, field_sizes,
+					 LEGION_FILE_CREATE,
+					 (realm_file_compression_t)TestConfig::compress,
+					 ProfilingRequestSet()).wait();
+
+    mem_fields[i].resize(1);
+    mem_fields[i][0].inst = mem_insts[i];
+    mem_fields[i][0].field_id = 0;
+    mem_fields[i][0].size = sizeof(double);
+    chk_fields[i] = mem_fields[i];
+    chk_fields[i][0].inst = chk_insts[i];
+    file_fields[i] = mem_fields[i];
+    file_fields[i][0].inst = file_insts[i];
+
+    // give every file a different pattern so mixups are caught
+    AffineAccessor<double, 1> acc(mem_insts[i], 0);
+    for(size_t j = 0; j < elements; j++)
+      acc[j] = i * 1e9 + j;
+  }
+
+  double write_time = 0, read_time = 0;
+  for(int r = 0; r < TestConfig::reps; r++) {
+    std::set<Event> events;
+    double t1 = Clock::current_time();
+    for(int i = 0; i < nf; i++)
+      events.insert(is.copy(mem_fields[i], file_fields[i],
+			    ProfilingRequestSet()));
+    Event::merge_events(events).wait();
+    double t2 = Clock::current_time();
+    events.clear();
+    for(int i = 0; i < nf; i++)
+      events.insert(is.copy(file_fields[i], chk_fields[i],
+			    ProfilingRequestSet()));
+    Event::merge_events(events).wait();
+    double t3 = Clock::current_time();
+    write_time += (t2 - t1);
+    read_time += (t3 - t2);
+  }
+
+  int errors = 0;
+  for(int i = 0; i < nf; i++) {
+    AffineAccessor<double, 1> acc(chk_insts[i], 0);
+    for(size_t j = 0; j < elements; j++)
+      if(acc[j] != (i * 1e9 + j)) {
+	if(errors++ < 10)
+	  log_app.error() << "mismatch: file=" << i << " elem=" << j
+			  << " exp=" << (i * 1e9 + j) << " act=" << acc[j];
+      }
+  }
+
+  // compressed files grow with every rewrite of a chunk, so this is the
+  //  size after all the reps, not the size of a single copy
+  double file_mb = 0;
+  for(int i = 0; i < nf; i++) {
+    struct stat st;
+    if(stat(filenames[i].c_str(), &st) == 0)
+      file_mb += st.st_size / 1048576.0;
+  }
+
+  double total_mb = (double)TestConfig::size_mb * nf * TestConfig::reps;
+  log_app.print() << "aio=" << TestConfig::backend
+		  << " compress=" << TestConfig::compress
+		  << " files=" << nf << " size=" << TestConfig::size_mb << " MB"
+		  << " reps=" << TestConfig::reps
+		  << " write=" << (total_mb / write_time) << " MB/s"
+		  << " read=" << (total_mb / read_time) << " MB/s"
+		  << " on_disk=" << file_mb << " MB";
+
+  for(int i = 0; i < nf; i++) {
+    file_insts[i].destroy();
+    mem_insts[i].destroy();
+    chk_insts[i].destroy();
+    unlink(filenames[i].c_str());
+  }
+
+  if(errors > 0) {
+    log_app.fatal() << errors << " errors found";
+    exit(1);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  // remember the backend for reporting before Realm eats it
+  for(int i = 1; i < argc - 1; i++)
+    if(!strcmp(argv[i], "-ll:aio"))
+      TestConfig::backend = argv[i + 1];
+
+  Runtime r;
+
+  bool ok = r.init(&argc, &argv);
+  assert(ok);
+
+  CommandLineParser cp;
+  cp.add_option_int("-size", TestConfig::size_mb)
+    .add_option_int("-reps", TestConfig::reps)
+    .add_option_int("-files", TestConfig::num_files)
+    .add_option_int("-compress", TestConfig::compress)
+    .add_option_string("-dir", TestConfig::dir);
+  ok = cp.parse_command_line(argc, (const char **)argv);
+  assert(ok);
+
+  r.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  // select a processor to run the top level task on
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = r.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  r.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  r.wait_for_shutdown();
+
+  return 0;
+}
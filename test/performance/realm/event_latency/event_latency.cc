@@ -84,6 +84,7 @@ void top_level_task(const void *args, size_t arglen,
                     const void *userdata, size_t userlen, Processor p)
 {
   int depth = DEFAULT_DEPTH;
+  int width = 0;
   // Parse the input arguments
 #define INT_ARG(argname, varname) do { \
         if(!strcmp((argv)[i], argname)) {		\
@@ -102,8 +103,10 @@ void top_level_task(const void *args, size_t arglen,
     for (int i = 1; i < inputs.argc; i++)
     {
       INT_ARG("-d", depth);
+      INT_ARG("-w", width);
     }
     assert(depth > 0);
+    assert(width >= 0);
   }
 #undef INT_ARG
 #undef BOOL_ARG
@@ -152,6 +155,34 @@ void top_level_task(const void *args, size_t arglen,
     fprintf(stdout,"Total time: %7.3f us\n", latency);
     fprintf(stdout,"Average trigger time: %7.3f us\n", latency/depth);
   }
+
+  // Optionally, a single trigger that fans out to a large number of waiters
+  //  whose events are then merged back into one
+  if (width > 0)
+  {
+    fprintf(stdout,"Initializing fan-out/fan-in experiment with a width of %d events...\n",width);
+    UserEvent fan_start = UserEvent::create_user_event();
+    std::set<Event> fan_events;
+    for (int i = 0; i < width; i++)
+    {
+      UserEvent fan_event = UserEvent::create_user_event();
+      // each of these is a waiter on the start event
+      fan_event.trigger(fan_start);
+      fan_events.insert(fan_event);
+    }
+    Event fan_final = Event::merge_events(fan_events);
+
+    fprintf(stdout,"Running experiment...\n");
+    double start, stop;
+    start = Realm::Clock::current_time_in_microseconds();
+    fan_start.trigger();
+    fan_final.wait();
+    stop = Realm::Clock::current_time_in_microseconds();
+
+    double latency = stop - start;
+    fprintf(stdout,"Fan-out/fan-in time: %7.3f us\n", latency);
+    fprintf(stdout,"Average time per waiter: %7.3f us\n", latency/width);
+  }
   
   fprintf(stdout,"Cleaning up...\n");
 }
@@ -129,6 +129,7 @@ void top_level_task(const void *args, size_t arglen,
   int levels = DEFAULT_LEVELS;
   int tracks = DEFAULT_TRACKS;
   int fanout = DEFAULT_FANOUT;
+  int width = 0;
   // Parse the input arguments
 #define INT_ARG(argname, varname) do { \
         if(!strcmp((argv)[i], argname)) {		\
@@ -149,10 +150,12 @@ void top_level_task(const void *args, size_t arglen,
       INT_ARG("-l", levels);
       INT_ARG("-t", tracks);
       INT_ARG("-f", fanout);
+      INT_ARG("-w", width);
     }
     assert(levels > 0);
     assert(tracks > 0);
     assert(fanout > 0);
+    assert(width >= 0);
   }
 #undef INT_ARG
 #undef BOOL_ARG
@@ -210,6 +213,41 @@ void top_level_task(const void *args, size_t arglen,
     fprintf(stdout,"Triggers throughput: %7.3f Thousands/s\n",(double(total_triggers)/latency));
   }
 
+  // Optionally, launch a wide set of tasks that all wait on one event (like
+  //  an index launch with a shared precondition) and merge their finish
+  //  events back into one
+  if (width > 0)
+  {
+    fprintf(stdout,"Initializing fan-out/fan-in experiment with %d tasks...\n",width);
+    fflush(stdout);
+    Realm::Machine machine = Realm::Machine::get_machine();
+    std::set<Processor> all_procs;
+    machine.get_all_processors(all_procs);
+    UserEvent fan_start = UserEvent::create_user_event();
+    std::set<Event> fan_events;
+    std::set<Processor>::const_iterator it = all_procs.begin();
+    for (int i = 0; i < width; i++)
+    {
+      fan_events.insert(it->spawn(DUMMY_TASK,NULL,0,fan_start));
+      it++;
+      if (it == all_procs.end())
+        it = all_procs.begin();
+    }
+    Event fan_finish = Event::merge_events(fan_events);
+
+    fprintf(stdout,"Running experiment...\n");
+    double start, stop;
+    start = Realm::Clock::current_time_in_microseconds();
+    fan_start.trigger();
+    fan_finish.wait();
+    stop = Realm::Clock::current_time_in_microseconds();
+
+    double latency = (stop - start) * 0.001;
+    fprintf(stdout,"Total time: %7.3f ms\n", latency);
+    fprintf(stdout,"Waiters woken: %d\n", width);
+    fprintf(stdout,"Wakeup throughput: %7.3f Thousands/s\n",(double(width)/latency));
+  }
+
   fprintf(stdout,"Cleaning up...\n");
 }
 
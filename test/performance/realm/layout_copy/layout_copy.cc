@@ -0,0 +1,271 @@
+/* Copyright 2018 Stanford University
+ * Copyright 2018 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// measures the bandwidth of local copies between instances with different
+//  layouts (SOA/AOS and Fortran/C dimension order) for a range of field
+//  sizes, and checks the copied data - run with different values of
+//  -ll:copy_kernels (or use the 'run_sweep' make target) to compare the
+//  strided copy kernels against a memcpy per contiguous line
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+
+#include <realm.h>
+#include <realm/cmdline.h>
+
+using namespace Realm;
+
+namespace TestConfig {
+  int size = 512;            // instances are size x size points
+  int num_fields = 4;        // fields per instance
+  int reps = 10;             // timed copies per layout pair
+  int field_size = 0;        // bytes per field (0 = sweep 4, 8, 16)
+  int copy_kernels = -1;     // just for reporting - parsed by Realm
+};
+
+// TASK IDs
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+Logger log_app("app");
+
+template <size_t BYTES>
+struct FieldValue {
+  unsigned char bytes[BYTES];
+};
+
+struct LayoutDesc {
+  const char *name;
+  bool aos;
+  bool c_order;  // last dimension varies fastest
+};
+
+static const LayoutDesc layouts[] = {
+  { "soa_f", false, false },
+  { "aos_f", true,  false },
+  { "soa_c", false, true },
+  { "aos_c", true,  true },
+};
+
+// (src, dst) indices into 'layouts'
+static const int layout_pairs[][2] = {
+  { 0, 0 },  // SOA -> SOA (contiguous baseline)
+  { 1, 0 },  // AOS -> SOA (gather)
+  { 0, 1 },  // SOA -> AOS (scatter)
+  { 0, 2 },  // Fortran -> C order (transpose)
+  { 2, 0 },  // C -> Fortran order (transpose)
+  { 1, 3 },  // AOS Fortran -> AOS C order
+};
+
+static RegionInstance create_layout(Memory m, IndexSpace<2> is,
+				    const LayoutDesc& desc, size_t field_size)
+{
+  std::map<FieldID, size_t> field_sizes;
+  for(int i = 0; i < TestConfig::num_fields; i++)
+    field_sizes[i] = field_size;
+  InstanceLayoutConstraints ilc(field_sizes, desc.aos ? 1 : 0);
+  int dim_order[2];
+  dim_order[0] = desc.c_order ? 1 : 0;
+  dim_order[1] = desc.c_order ? 0 : 1;
+  InstanceLayoutGeneric *ilg = InstanceLayoutGeneric::choose_instance_layout<2,int>(is, ilc, dim_order);
+
+  RegionInstance inst;
+  RegionInstance::create_instance(inst, m, ilg, ProfilingRequestSet()).wait();
+  assert(inst.exists());
+  return inst;
+}
+
+static unsigned char expected_byte(const Point<2>& p, int field, size_t byte)
+{
+  return (unsigned char)((p.x * 131) + (p.y * 31) + (field * 7) + byte);
+}
+
+template <size_t BYTES>
+static void fill_instance(RegionInstance inst, IndexSpace<2> is)
+{
+  for(int f = 0; f < TestConfig::num_fields; f++) {
+    AffineAccessor<FieldValue<BYTES>, 2> acc(inst, f);
+    for(PointInRectIterator<2,int> pir(is.bounds); pir.valid; pir.step()) {
+      FieldValue<BYTES> v;
+      for(size_t b = 0; b < BYTES; b++)
+	v.bytes[b] = expected_byte(pir.p, f, b);
+      acc.write(pir.p, v);
+    }
+  }
+}
+
+template <size_t BYTES>
+static size_t check_instance(RegionInstance inst, IndexSpace<2> is)
+{
+  size_t errors = 0;
+  for(int f = 0; f < TestConfig::num_fields; f++) {
+    AffineAccessor<FieldValue<BYTES>, 2> acc(inst, f);
+    for(PointInRectIterator<2,int> pir(is.bounds); pir.valid; pir.step()) {
+      FieldValue<BYTES> v = acc.read(pir.p);
+      for(size_t b = 0; b < BYTES; b++)
+	if(v.bytes[b] != expected_byte(pir.p, f, b)) {
+	  if(errors++ < 10)
+	    log_app.error() << "mismatch: point=" << pir.p << " field=" << f
+			    << " byte=" << b;
+	  break;
+	}
+    }
+  }
+  return errors;
+}
+
+template <size_t BYTES>
+static bool run_test(Memory m, const LayoutDesc& src_desc,
+		     const LayoutDesc& dst_desc)
+{
+  IndexSpace<2> is = Rect<2>(Point<2>(0, 0),
+			     Point<2>(TestConfig::size - 1, TestConfig::size - 1));
+
+  RegionInstance src = create_layout(m, is, src_desc, BYTES);
+  RegionInstance dst = create_layout(m, is, dst_desc, BYTES);
+
+  std::vector<CopySrcDstField> src_fields(TestConfig::num_fields);
+  std::vector<CopySrcDstField> dst_fields(TestConfig::num_fields);
+  for(int i = 0; i < TestConfig::num_fields; i++) {
+    src_fields[i].inst = src;
+    src_fields[i].field_id = i;
+    src_fields[i].size = BYTES;
+    dst_fields[i].inst = dst;
+    dst_fields[i].field_id = i;
+    dst_fields[i].size = BYTES;
+  }
+
+  // fill the source with a pattern, and clear the destination (which also
+  //  faults its pages in)
+  fill_instance<BYTES>(src, is);
+  {
+    FieldValue<BYTES> zero;
+    memset(&zero, 0, sizeof(zero));
+    is.fill(dst_fields, ProfilingRequestSet(), &zero, sizeof(zero)).wait();
+  }
+
+  // warm up once, then time back-to-back copies
+  double t_start = 0;
+  for(int r = -1; r < TestConfig::reps; r++) {
+    if(r == 0)
+      t_start = Clock::current_time();
+    is.copy(src_fields, dst_fields, ProfilingRequestSet()).wait();
+  }
+  double t_end = Clock::current_time();
+
+  size_t errors = check_instance<BYTES>(dst, is);
+
+  double elapsed = t_end - t_start;
+  double total_bytes = ((double)TestConfig::reps * is.volume() *
+			TestConfig::num_fields * BYTES);
+  log_app.print() << "copy_kernels=" << TestConfig::copy_kernels
+		  << " layout=" << src_desc.name << "->" << dst_desc.name
+		  << " field_size=" << BYTES
+		  << " fields=" << TestConfig::num_fields
+		  << " points=" << is.volume()
+		  << " elapsed=" << elapsed << " s"
+		  << " bw=" << (total_bytes / elapsed * 1e-9) << " GB/s"
+		  << (errors ? " ERRORS" : "");
+
+  src.destroy();
+  dst.destroy();
+  return (errors == 0);
+}
+
+static bool run_layouts(Memory m, size_t field_size)
+{
+  bool ok = true;
+  for(size_t i = 0; i < sizeof(layout_pairs) / sizeof(layout_pairs[0]); i++) {
+    const LayoutDesc& src_desc = layouts[layout_pairs[i][0]];
+    const LayoutDesc& dst_desc = layouts[layout_pairs[i][1]];
+    switch(field_size) {
+    case 4: ok = run_test<4>(m, src_desc, dst_desc) && ok; break;
+    case 8: ok = run_test<8>(m, src_desc, dst_desc) && ok; break;
+    case 16: ok = run_test<16>(m, src_desc, dst_desc) && ok; break;
+    default:
+      log_app.fatal() << "unsupported field size: " << field_size;
+      assert(0);
+    }
+  }
+  return ok;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  Memory m = Machine::MemoryQuery(Machine::get_machine())
+    .has_affinity_to(p)
+    .only_kind(Memory::SYSTEM_MEM)
+    .first();
+  assert(m.exists());
+
+  bool ok = true;
+  if(TestConfig::field_size > 0) {
+    ok = run_layouts(m, TestConfig::field_size);
+  } else {
+    static const size_t sizes[] = { 4, 8, 16 };
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+      ok = run_layouts(m, sizes[i]) && ok;
+  }
+
+  if(!ok) {
+    log_app.error() << "copied data did not match";
+    exit(1);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  // remember the kernel level for reporting before Realm eats it
+  for(int i = 1; i < argc - 1; i++)
+    if(!strcmp(argv[i], "-ll:copy_kernels"))
+      TestConfig::copy_kernels = atoi(argv[i + 1]);
+
+  Runtime r;
+
+  bool ok = r.init(&argc, &argv);
+  assert(ok);
+
+  CommandLineParser cp;
+  cp.add_option_int("-size", TestConfig::size)
+    .add_option_int("-fields", TestConfig::num_fields)
+    .add_option_int("-reps", TestConfig::reps)
+    .add_option_int("-field_size", TestConfig::field_size);
+  ok = cp.parse_command_line(argc, (const char **)argv);
+  assert(ok);
+
+  r.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  // select a processor to run the top level task on
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = r.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  r.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  r.wait_for_shutdown();
+
+  return 0;
+}
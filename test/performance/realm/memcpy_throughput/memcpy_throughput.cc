@@ -0,0 +1,177 @@
+/* Copyright 2018 Stanford University
+ * Copyright 2018 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// measures local memcpy throughput (copies/sec and GB/s) for many
+//  concurrent small-to-medium copies, the pattern produced by halo
+//  exchanges - run with different values of -ll:memcpy_threads (or use
+//  the 'run_sweep' make target) to see how it scales with the number of
+//  dedicated memcpy workers
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+
+#include <realm.h>
+#include <realm/cmdline.h>
+
+using namespace Realm;
+
+namespace TestConfig {
+  int num_pairs = 64;        // number of independent src/dst instance pairs
+  int reps = 20;             // number of times to copy every pair
+  size_t copy_size = 0;      // bytes per copy (0 = sweep sizes below)
+  int memcpy_threads = 0;    // just for reporting - parsed by Realm
+};
+
+// TASK IDs
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+Logger log_app("app");
+
+static void run_test(Memory m, size_t copy_size)
+{
+  size_t elements = copy_size / sizeof(double);
+  assert(elements > 0);
+  IndexSpace<1> is = Rect<1>(0, elements - 1);
+  std::vector<size_t> field_sizes(1, sizeof(double));
+
+  std::vector<RegionInstance> srcs(TestConfig::num_pairs);
+  std::vector<RegionInstance> dsts(TestConfig::num_pairs);
+  std::vector<std::vector<CopySrcDstField> > src_fields(TestConfig::num_pairs);
+  std::vector<std::vector<CopySrcDstField> > dst_fields(TestConfig::num_pairs);
+  {
+    std::set<Event> events;
+    double fill_value = 1.0;
+    for(int i = 0; i < TestConfig::num_pairs; i++) {
+      RegionInstance::create_instance(srcs[i], m, is, field_sizes,
+				      0 /*SOA*/, ProfilingRequestSet()).wait();
+      RegionInstance::create_instance(dsts[i], m, is, field_sizes,
+				      0 /*SOA*/, ProfilingRequestSet()).wait();
+      assert(srcs[i].exists() && dsts[i].exists());
+
+      src_fields[i].resize(1);
+      src_fields[i][0].inst = srcs[i];
+      src_fields[i][0].field_id = 0;
+      src_fields[i][0].size = sizeof(double);
+      dst_fields[i].resize(1);
+      dst_fields[i][0].inst = dsts[i];
+      dst_fields[i][0].field_id = 0;
+      dst_fields[i][0].size = sizeof(double);
+
+      // fill both instances, which also faults the pages in
+      events.insert(is.fill(src_fields[i], ProfilingRequestSet(),
+			    &fill_value, sizeof(fill_value)));
+      events.insert(is.fill(dst_fields[i], ProfilingRequestSet(),
+			    &fill_value, sizeof(fill_value)));
+    }
+    Event::merge_events(events).wait();
+  }
+
+  // warm up once, then time all pairs copying concurrently
+  double t_start = 0;
+  for(int r = -1; r < TestConfig::reps; r++) {
+    if(r == 0)
+      t_start = Clock::current_time();
+    std::set<Event> events;
+    for(int i = 0; i < TestConfig::num_pairs; i++)
+      events.insert(is.copy(src_fields[i], dst_fields[i],
+			    ProfilingRequestSet()));
+    Event::merge_events(events).wait();
+  }
+  double t_end = Clock::current_time();
+
+  double elapsed = t_end - t_start;
+  size_t total_copies = (size_t)TestConfig::num_pairs * TestConfig::reps;
+  double total_bytes = (double)total_copies * elements * sizeof(double);
+  log_app.print() << "memcpy_threads=" << TestConfig::memcpy_threads
+		  << " size=" << (elements * sizeof(double))
+		  << " pairs=" << TestConfig::num_pairs
+		  << " copies=" << total_copies
+		  << " elapsed=" << elapsed << " s"
+		  << " rate=" << (total_copies / elapsed) << " copies/s"
+		  << " bw=" << (total_bytes / elapsed * 1e-9) << " GB/s";
+
+  for(int i = 0; i < TestConfig::num_pairs; i++) {
+    srcs[i].destroy();
+    dsts[i].destroy();
+  }
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  Memory m = Machine::MemoryQuery(Machine::get_machine())
+    .has_affinity_to(p)
+    .only_kind(Memory::SYSTEM_MEM)
+    .first();
+  assert(m.exists());
+
+  if(TestConfig::copy_size > 0) {
+    run_test(m, TestConfig::copy_size);
+  } else {
+    static const size_t sizes[] = { 4 << 10, 64 << 10, 1 << 20 };
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      // make sure all the instances fit in the memory
+      if((2 * sizes[i] * TestConfig::num_pairs) > m.capacity()) {
+	log_app.warning() << "skipping size " << sizes[i] << " - insufficient capacity";
+	continue;
+      }
+      run_test(m, sizes[i]);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  // remember the memcpy thread count for reporting before Realm eats it
+  for(int i = 1; i < argc - 1; i++)
+    if(!strcmp(argv[i], "-ll:memcpy_threads"))
+      TestConfig::memcpy_threads = atoi(argv[i + 1]);
+
+  Runtime r;
+
+  bool ok = r.init(&argc, &argv);
+  assert(ok);
+
+  CommandLineParser cp;
+  cp.add_option_int("-pairs", TestConfig::num_pairs)
+    .add_option_int("-reps", TestConfig::reps)
+    .add_option_int("-size", TestConfig::copy_size);
+  ok = cp.parse_command_line(argc, (const char **)argv);
+  assert(ok);
+
+  r.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  // select a processor to run the top level task on
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = r.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  r.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  r.wait_for_shutdown();
+
+  return 0;
+}
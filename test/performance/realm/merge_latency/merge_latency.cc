@@ -0,0 +1,221 @@
+/* Copyright 2018 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// measures the cost of Event::merge_events at a range of widths - run with
+//  and without -ll:merge_fanout to compare flat and tree-structured merges
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include <realm.h>
+#include <realm/timers.h>
+
+using namespace Realm;
+
+// TASK IDs
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  TRIGGER_TASK   = Processor::TASK_ID_FIRST_AVAILABLE+1,
+};
+
+// the inputs are triggered by tasks on every local processor, so that the
+//  merger sees triggers from several threads at once
+struct TriggerArgs {
+  const UserEvent *inputs;
+  int first, count;
+};
+
+void trigger_task(const void *args, size_t arglen,
+                  const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen == sizeof(TriggerArgs));
+  const TriggerArgs& targs = *(const TriggerArgs *)args;
+  for (int i = 0; i < targs.count; i++)
+    targs.inputs[targs.first + i].trigger();
+}
+
+struct InputArgs {
+  int argc;
+  char **argv;
+};
+
+InputArgs& get_input_args(void)
+{
+  static InputArgs args;
+  return args;
+}
+
+void top_level_task(const void *args, size_t arglen,
+                    const void *userdata, size_t userlen, Processor p)
+{
+  int min_width = 2;
+  int max_width = 100000;
+  int reps = 3;
+  int dups = 1;
+  // Parse the input arguments
+#define INT_ARG(argname, varname) do { \
+        if(!strcmp((argv)[i], argname)) {		\
+          varname = atoi((argv)[++i]);		\
+          continue;					\
+        } } while(0)
+  {
+    InputArgs &inputs = get_input_args();
+    char **argv = inputs.argv;
+    for (int i = 1; i < inputs.argc; i++)
+    {
+      INT_ARG("-min", min_width);
+      INT_ARG("-max", max_width);
+      INT_ARG("-r", reps);
+      INT_ARG("-dup", dups);
+    }
+    assert(min_width >= 2);
+    assert(max_width >= min_width);
+    assert(reps > 0);
+    assert(dups > 0);
+  }
+#undef INT_ARG
+
+  // one trigger task per local CPU
+  std::vector<Processor> trigger_procs;
+  {
+    std::set<Processor> all_procs;
+    Machine::get_machine().get_all_processors(all_procs);
+    for (std::set<Processor>::const_iterator it = all_procs.begin();
+          it != all_procs.end(); it++)
+      if ((it->kind() == Processor::LOC_PROC) &&
+          (it->address_space() == p.address_space()))
+        trigger_procs.push_back(*it);
+  }
+
+  fprintf(stdout,"Merge latency: widths %d to %d, %d repetitions, each input listed %d time(s), %d triggering processors\n",
+          min_width, max_width, reps, dups, (int)trigger_procs.size());
+  fprintf(stdout,"%8s %12s %12s %12s %12s\n",
+          "width", "merge(us)", "trigger(us)", "wait(us)", "done(us)");
+
+  // widths go 2, 5, 10, 20, 50, 100, ...
+  std::vector<int> widths;
+  for (int w = min_width; w <= max_width; )
+  {
+    widths.push_back(w);
+    int next = w;
+    for (int base = 1; next == w; base *= 10)
+    {
+      if (w < 2 * base) next = 2 * base;
+      else if (w < 5 * base) next = 5 * base;
+      else if (w < 10 * base) next = 10 * base;
+    }
+    w = next;
+  }
+
+  for (size_t wi = 0; wi < widths.size(); wi++)
+  {
+    int width = widths[wi];
+    double t_merge = 0, t_trigger = 0, t_wait = 0, t_done = 0;
+    for (int r = 0; r < reps; r++)
+    {
+      std::vector<UserEvent> inputs(width);
+      std::vector<Event> wait_for;
+      wait_for.reserve(width * dups);
+      for (int i = 0; i < width; i++)
+        inputs[i] = UserEvent::create_user_event();
+      for (int d = 0; d < dups; d++)
+        for (int i = 0; i < width; i++)
+          wait_for.push_back(inputs[i]);
+
+      // time to build the merge
+      double t0 = Realm::Clock::current_time_in_microseconds();
+      Event merged = Event::merge_events(wait_for);
+      double t1 = Realm::Clock::current_time_in_microseconds();
+
+      // time to trigger every input, and then for the merged event to
+      //  follow the last one
+      std::set<Event> triggered;
+      int per_proc = (width + trigger_procs.size() - 1) / trigger_procs.size();
+      for (size_t pi = 0; pi < trigger_procs.size(); pi++)
+      {
+        TriggerArgs targs;
+        targs.inputs = &inputs[0];
+        targs.first = pi * per_proc;
+        targs.count = std::min(per_proc, width - targs.first);
+        if (targs.count <= 0) break;
+        triggered.insert(trigger_procs[pi].spawn(TRIGGER_TASK, &targs, sizeof(targs)));
+      }
+      Event::merge_events(triggered).wait();
+      double t2 = Realm::Clock::current_time_in_microseconds();
+      merged.wait();
+      double t3 = Realm::Clock::current_time_in_microseconds();
+
+      // merging inputs that have all triggered should be nearly free
+      Event again = Event::merge_events(wait_for);
+      double t4 = Realm::Clock::current_time_in_microseconds();
+      assert(!again.exists());
+
+      t_merge += t1 - t0;
+      t_trigger += t2 - t1;
+      t_wait += t3 - t2;
+      t_done += t4 - t3;
+    }
+    fprintf(stdout,"%8d %12.1f %12.1f %12.1f %12.1f\n", width,
+            t_merge / reps, t_trigger / reps, t_wait / reps, t_done / reps);
+    fflush(stdout);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Runtime r;
+
+  bool ok = r.init(&argc, &argv);
+  assert(ok);
+
+  r.register_task(TOP_LEVEL_TASK, top_level_task);
+  r.register_task(TRIGGER_TASK, trigger_task);
+
+  // Set the input args
+  get_input_args().argv = argv;
+  get_input_args().argc = argc;
+
+  // select a processor to run the top level task on
+  Processor p = Processor::NO_PROC;
+  {
+    std::set<Processor> all_procs;
+    Machine::get_machine().get_all_processors(all_procs);
+    for(std::set<Processor>::const_iterator it = all_procs.begin();
+	it != all_procs.end();
+	it++)
+      if(it->kind() == Processor::LOC_PROC) {
+	p = *it;
+	break;
+      }
+  }
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = r.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  r.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  r.wait_for_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,236 @@
+/* Copyright 2018 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// compares PriorityQueue and BucketedPriorityQueue with every local CPU
+//  putting and getting items on one shared queue
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+
+#include <vector>
+#include <set>
+
+#include <realm.h>
+#include <realm/timers.h>
+#include <realm/activemsg.h>
+#include <realm/pri_queue.h>
+
+using namespace Realm;
+
+// TASK IDs
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  WORKER_TASK    = Processor::TASK_ID_FIRST_AVAILABLE+1,
+};
+
+typedef PriorityQueue<void *, GASNetHSL> MapQueue;
+typedef BucketedPriorityQueue<void *, GASNetHSL> BucketQueue;
+
+// queues are shared by all the workers, and have a subscriber like the
+//  task scheduler's so that the notification path is exercised too
+template <typename PQ>
+class CountingSubscriber : public PQ::NotificationCallback {
+public:
+  CountingSubscriber(void) : count(0) {}
+  virtual bool item_available(void *item, typename PQ::priority_t priority)
+  {
+    __sync_fetch_and_add(&count, 1);
+    return false;
+  }
+  int count;
+};
+
+MapQueue map_queue;
+BucketQueue bucket_queue;
+
+struct WorkerArgs {
+  bool bucketed;
+  int ops;
+  int priorities;
+  int depth;
+};
+
+template <typename PQ>
+static void hammer_queue(PQ& pq, const WorkerArgs& wargs, Processor p)
+{
+  // each worker keeps 'depth' items of its own in the queue, so that
+  //  gets usually find something
+  int seed = (int)(p.id & 0xffff);
+  for(int i = 0; i < wargs.depth; i++)
+    pq.put((void *)(intptr_t)(i + 1), (seed + i) % wargs.priorities);
+
+  // a get that races with a put may not see the new item yet, so gets
+  //  retry until they find one
+  for(int i = 0; i < wargs.ops; i++) {
+    pq.put((void *)(intptr_t)(i + 1), (seed + i) % wargs.priorities);
+    typename PQ::priority_t pri;
+    while(pq.get(&pri) == 0) {}
+  }
+
+  for(int i = 0; i < wargs.depth; i++)
+    while(pq.get(0) == 0) {}
+}
+
+void worker_task(const void *args, size_t arglen,
+                 const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen == sizeof(WorkerArgs));
+  const WorkerArgs& wargs = *(const WorkerArgs *)args;
+  if(wargs.bucketed)
+    hammer_queue(bucket_queue, wargs, p);
+  else
+    hammer_queue(map_queue, wargs, p);
+}
+
+struct InputArgs {
+  int argc;
+  char **argv;
+};
+
+InputArgs& get_input_args(void)
+{
+  static InputArgs args;
+  return args;
+}
+
+void top_level_task(const void *args, size_t arglen,
+                    const void *userdata, size_t userlen, Processor p)
+{
+  int ops = 1000000;
+  int priorities = 4;
+  int depth = 16;
+  // Parse the input arguments
+#define INT_ARG(argname, varname) do { \
+        if(!strcmp((argv)[i], argname)) {		\
+          varname = atoi((argv)[++i]);		\
+          continue;					\
+        } } while(0)
+  {
+    InputArgs &inputs = get_input_args();
+    char **argv = inputs.argv;
+    for (int i = 1; i < inputs.argc; i++)
+    {
+      INT_ARG("-ops", ops);
+      INT_ARG("-p", priorities);
+      INT_ARG("-d", depth);
+    }
+    assert(ops > 0);
+    assert(priorities > 0);
+    assert(depth >= 0);
+  }
+#undef INT_ARG
+
+  std::vector<Processor> procs;
+  {
+    std::set<Processor> all_procs;
+    Machine::get_machine().get_all_processors(all_procs);
+    for (std::set<Processor>::const_iterator it = all_procs.begin();
+          it != all_procs.end(); it++)
+      if ((it->kind() == Processor::LOC_PROC) &&
+          (it->address_space() == p.address_space()))
+        procs.push_back(*it);
+  }
+
+  CountingSubscriber<MapQueue> map_sub;
+  CountingSubscriber<BucketQueue> bucket_sub;
+  map_queue.add_subscription(&map_sub);
+  bucket_queue.add_subscription(&bucket_sub);
+
+  fprintf(stdout,"Priority queue contention: %d put/get pairs per processor, %d priorities, %d items per processor queued\n",
+          ops, priorities, depth);
+  fprintf(stdout,"%8s %10s %12s %14s %14s\n",
+          "procs", "queue", "time(ms)", "Mops/s", "notifications");
+
+  // 1, 2, 4, ... processors (the one running this task included)
+  for (size_t count = 1; ; count *= 2)
+  {
+    if (count > procs.size()) count = procs.size();
+    for (int b = 0; b < 2; b++)
+    {
+      WorkerArgs wargs;
+      wargs.bucketed = (b == 1);
+      wargs.ops = ops;
+      wargs.priorities = priorities;
+      wargs.depth = depth;
+
+      int notifications_before = (wargs.bucketed ? bucket_sub.count : map_sub.count);
+      UserEvent start = UserEvent::create_user_event();
+      std::set<Event> done;
+      for (size_t i = 0; i < count; i++)
+        done.insert(procs[i].spawn(WORKER_TASK, &wargs, sizeof(wargs), start));
+
+      double t1 = Realm::Clock::current_time_in_microseconds();
+      start.trigger();
+      Event::merge_events(done).wait();
+      double t2 = Realm::Clock::current_time_in_microseconds();
+
+      assert(wargs.bucketed ? bucket_queue.empty() : map_queue.empty());
+      int notifications = ((wargs.bucketed ? bucket_sub.count : map_sub.count) -
+                           notifications_before);
+      double total_ops = 2.0 * ops * count;
+      fprintf(stdout,"%8d %10s %12.1f %14.2f %14d\n", (int)count,
+              (wargs.bucketed ? "bucketed" : "map"),
+              (t2 - t1) * 1e-3, total_ops / (t2 - t1), notifications);
+      fflush(stdout);
+    }
+    if (count == procs.size()) break;
+  }
+
+  map_queue.remove_subscription(&map_sub);
+  bucket_queue.remove_subscription(&bucket_sub);
+}
+
+int main(int argc, char **argv)
+{
+  Runtime r;
+
+  bool ok = r.init(&argc, &argv);
+  assert(ok);
+
+  r.register_task(TOP_LEVEL_TASK, top_level_task);
+  r.register_task(WORKER_TASK, worker_task);
+
+  // Set the input args
+  get_input_args().argv = argv;
+  get_input_args().argc = argc;
+
+  // select a processor to run the top level task on
+  Processor p = Processor::NO_PROC;
+  {
+    std::set<Processor> all_procs;
+    Machine::get_machine().get_all_processors(all_procs);
+    for(std::set<Processor>::const_iterator it = all_procs.begin();
+	it != all_procs.end();
+	it++)
+      if(it->kind() == Processor::LOC_PROC) {
+	p = *it;
+	break;
+      }
+  }
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = r.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  r.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  r.wait_for_shutdown();
+
+  return 0;
+}
@@ -19,6 +19,7 @@
 #include <cassert>
 #include <cstring>
 #include <set>
+#include <algorithm>
 #include <time.h>
 
 #include <realm.h>
@@ -42,6 +43,8 @@ enum {
 // reduction op IDs
 enum {
   REDOP_BUCKET_ADD = 1,
+  // the DMA benchmark uses REDOP_DMA_FIRST and up
+  REDOP_DMA_FIRST = 100,
 };
 
 Logger log_app("appl");
@@ -163,6 +166,193 @@ static Memory farthest_memory(Processor p)
   return m;
 }
 
+// hides the type of a built-in reduction op from the DMA system, so that
+//  it is applied with the per-element callbacks rather than the kernels
+template <class REDOP>
+struct OpaqueReduction : public REDOP {};
+
+static const char *dma_op_names[] = { "sum", "prod", "min", "max" };
+
+// redop IDs for a DMA benchmark type: 4 built-in ops followed by 4 opaque
+//  ones
+template <class T>
+static void register_dma_redops(Runtime& r, ReductionOpID base)
+{
+  r.register_reduction(base + 0, ReductionOpUntyped::create_reduction_op<SumReduction<T> >());
+  r.register_reduction(base + 1, ReductionOpUntyped::create_reduction_op<ProdReduction<T> >());
+  r.register_reduction(base + 2, ReductionOpUntyped::create_reduction_op<MinReduction<T> >());
+  r.register_reduction(base + 3, ReductionOpUntyped::create_reduction_op<MaxReduction<T> >());
+  r.register_reduction(base + 4, ReductionOpUntyped::create_reduction_op<OpaqueReduction<SumReduction<T> > >());
+  r.register_reduction(base + 5, ReductionOpUntyped::create_reduction_op<OpaqueReduction<ProdReduction<T> > >());
+  r.register_reduction(base + 6, ReductionOpUntyped::create_reduction_op<OpaqueReduction<MinReduction<T> > >());
+  r.register_reduction(base + 7, ReductionOpUntyped::create_reduction_op<OpaqueReduction<MaxReduction<T> > >());
+}
+
+template <class T>
+static Event fill_field(IndexSpace<1, coord_t> is, RegionInstance inst, T value)
+{
+  std::vector<CopySrcDstField> fld(1);
+  fld[0].inst = inst;
+  fld[0].field_id = 0;
+  fld[0].size = sizeof(T);
+  return is.fill(fld, ProfilingRequestSet(), &value, sizeof(T));
+}
+
+// times 'reps' reduction copies of a 'src' instance into a 'dst' instance
+//  and checks the result - the source holds 2 and the destination starts
+//  at 1 (sum, prod) or 3 (min, max), so after any number of reductions
+//  each element should be: 1 + 2*reps, 2^reps, 2, 3
+template <class T>
+static bool run_dma_reduce(const char *type_name, ReductionOpID base,
+			   IndexSpace<1, coord_t> is, Memory m, int reps)
+{
+  bool ok = true;
+  std::vector<size_t> field_sizes(1, sizeof(T));
+  RegionInstance src_inst, dst_inst;
+  RegionInstance::create_instance(src_inst, m, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+  RegionInstance::create_instance(dst_inst, m, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+  assert(src_inst.exists() && dst_inst.exists());
+
+  std::vector<CopySrcDstField> src(1), dst(1);
+  src[0].inst = src_inst;
+  src[0].field_id = 0;
+  src[0].size = sizeof(T);
+  dst[0].inst = dst_inst;
+  dst[0].field_id = 0;
+  dst[0].size = sizeof(T);
+
+  fill_field<T>(is, src_inst, 2).wait();
+
+  // (kernels, exclusive): the old path applies atomically, the callbacks
+  //  can also be run non-atomically, and the kernels need exclusivity
+  static const bool variants[3][2] = { { false, false },
+				       { false, true },
+				       { true, true } };
+  static const char *variant_names[3] = { "callback", "callback_excl",
+					  "kernel_excl" };
+
+  for(int op = 0; op < 4; op++) {
+    T init = ((op < 2) ? 1 : 3);
+    // products double each time, so don't overflow the integer types
+    int op_reps = ((op == 1) ? std::min(reps, 30) : reps);
+    T expected = init;
+    for(int i = 0; i < op_reps; i++)
+      switch(op) {
+      case 0: expected += 2; break;
+      case 1: expected *= 2; break;
+      case 2: expected = 2; break;
+      case 3: break;
+      }
+
+    for(int v = 0; v < 3; v++) {
+      ReductionOpID redop_id = base + op + (variants[v][0] ? 0 : 4);
+      dst[0].red_exclusive = variants[v][1];
+
+      fill_field<T>(is, dst_inst, init).wait();
+
+      double start_time = Realm::Clock::current_time_in_microseconds();
+      Event e = Event::NO_EVENT;
+      for(int i = 0; i < op_reps; i++)
+	e = is.copy(src, dst, ProfilingRequestSet(), e,
+		    redop_id, false /*!fold*/);
+      e.wait();
+      double end_time = Realm::Clock::current_time_in_microseconds();
+
+      size_t errors = 0;
+      AffineAccessor<T, 1, coord_t> acc(dst_inst, 0);
+      for(coord_t i = is.bounds.lo; i <= is.bounds.hi; i++)
+	if(acc[i] != expected)
+	  errors++;
+      if(errors > 0) {
+	log_app.error() << "dma reduce " << type_name << " " << dma_op_names[op]
+			<< " " << variant_names[v] << ": " << errors << " errors";
+	ok = false;
+      }
+
+      // each reduction reads both instances and writes the destination
+      double bytes = 3.0 * sizeof(T) * is.volume() * op_reps;
+      printf("DMA_REDUCE(%s,%s,%s) = %f GB/s\n",
+	     type_name, dma_op_names[op], variant_names[v],
+	     bytes / (end_time - start_time) * 1e-3);
+    }
+  }
+
+  src_inst.destroy();
+  dst_inst.destroy();
+  return ok;
+}
+
+template <size_t BYTES>
+struct FillPattern {
+  unsigned char bytes[BYTES];
+};
+
+template <size_t BYTES>
+static bool run_dma_fill(IndexSpace<1, coord_t> is, Memory m, int reps)
+{
+  std::vector<size_t> field_sizes(1, BYTES);
+  RegionInstance inst;
+  RegionInstance::create_instance(inst, m, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+  assert(inst.exists());
+
+  std::vector<CopySrcDstField> fld(1);
+  fld[0].inst = inst;
+  fld[0].field_id = 0;
+  fld[0].size = BYTES;
+  FillPattern<BYTES> value;
+  for(size_t i = 0; i < BYTES; i++)
+    value.bytes[i] = i + 1;
+
+  // first fill faults the pages in
+  is.fill(fld, ProfilingRequestSet(), &value, BYTES).wait();
+
+  double start_time = Realm::Clock::current_time_in_microseconds();
+  Event e = Event::NO_EVENT;
+  for(int i = 0; i < reps; i++)
+    e = is.fill(fld, ProfilingRequestSet(), &value, BYTES, e);
+  e.wait();
+  double end_time = Realm::Clock::current_time_in_microseconds();
+
+  size_t errors = 0;
+  AffineAccessor<FillPattern<BYTES>, 1, coord_t> acc(inst, 0);
+  for(coord_t i = is.bounds.lo; i <= is.bounds.hi; i++)
+    if(memcmp(&acc[i], &value, BYTES))
+      errors++;
+  if(errors > 0)
+    log_app.error() << "dma fill " << BYTES << ": " << errors << " errors";
+
+  double bytes = (double)BYTES * is.volume() * reps;
+  printf("DMA_FILL(%zd) = %f GB/s\n",
+	 BYTES, bytes / (end_time - start_time) * 1e-3);
+
+  inst.destroy();
+  return (errors == 0);
+}
+
+// measures the bandwidth of DMA reductions and fills - compare the built-in
+//  ops ("kernel_excl") against the callback path, and run with
+//  -ll:copy_kernels 0 to get the old fill path
+static bool run_dma_benchmark(Processor p, int size, int reps)
+{
+  Memory m = closest_memory(p);
+  IndexSpace<1, coord_t> is = Rect<1, coord_t>(0, size - 1);
+
+  bool ok = true;
+  ok = run_dma_reduce<float>("float", REDOP_DMA_FIRST + 0, is, m, reps) && ok;
+  ok = run_dma_reduce<double>("double", REDOP_DMA_FIRST + 8, is, m, reps) && ok;
+  ok = run_dma_reduce<int32_t>("int32", REDOP_DMA_FIRST + 16, is, m, reps) && ok;
+  ok = run_dma_reduce<int64_t>("int64", REDOP_DMA_FIRST + 24, is, m, reps) && ok;
+
+  ok = run_dma_fill<4>(is, m, reps) && ok;
+  ok = run_dma_fill<8>(is, m, reps) && ok;
+  ok = run_dma_fill<12>(is, m, reps) && ok;
+  ok = run_dma_fill<16>(is, m, reps) && ok;
+  return ok;
+}
+
 static void run_case(const char *name, int task_id,
 		     HistBatchArgs<BucketType>& hbargs, int num_batches,
 		     bool use_lock)
@@ -224,6 +414,8 @@ void top_level_task(const void *args, size_t arglen,
   int seed1 = 12345;
   int seed2 = 54321;
   int do_slow = 0;
+  int dma_size = 4 << 20;
+  int dma_reps = 10;
 
   // Parse the input arguments
 #define INT_ARG(argname, varname) do { \
@@ -246,6 +438,8 @@ void top_level_task(const void *args, size_t arglen,
       INT_ARG("-buckets", buckets);
       INT_ARG("-batches", num_batches);
       INT_ARG("-bsize", batch_size);
+      INT_ARG("-dmasize", dma_size);
+      INT_ARG("-dmareps", dma_reps);
     }
   }
 #undef INT_ARG
@@ -283,6 +477,11 @@ void top_level_task(const void *args, size_t arglen,
   if(do_slow)
     run_case("redsingle", HIST_BATCH_REDSINGLE_TASK, hbargs, num_batches, false);
 
+  if(dma_size > 0) {
+    if(!run_dma_benchmark(p, dma_size, dma_reps))
+      exit(1);
+  }
+
 #if 0
   {
     RegionInstanceAccessor<BucketType,AccessorGeneric> ria = hist_inst.get_accessor();
@@ -541,6 +740,10 @@ int main(int argc, char **argv)
   r.register_task(HIST_BATCH_REDLIST_TASK, hist_batch_redlist_task<BucketReduction>);
   r.register_task(HIST_BATCH_REDSINGLE_TASK, hist_batch_redsingle_task<BucketReduction>);
   r.register_reduction(REDOP_BUCKET_ADD, ReductionOpUntyped::create_reduction_op<BucketReduction>());
+  register_dma_redops<float>(r, REDOP_DMA_FIRST + 0);
+  register_dma_redops<double>(r, REDOP_DMA_FIRST + 8);
+  register_dma_redops<int32_t>(r, REDOP_DMA_FIRST + 16);
+  register_dma_redops<int64_t>(r, REDOP_DMA_FIRST + 24);
 
   // Set the input args
   get_input_args().argv = argv;
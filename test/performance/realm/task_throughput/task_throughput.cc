@@ -33,6 +33,7 @@ namespace TestConfig {
   int task_argument_size = 0;
   bool remote_tasks = false;
   bool with_profiling = false;
+  bool group_tasks = false;
 };
 
 // TASK IDs
@@ -175,6 +176,43 @@ void task_launcher(const void *args, size_t arglen,
   la.start_barrier.arrive();
 }
 
+// spawns the same number of tasks per processor onto processor groups made
+//  of the first 1, 2, 4, ... local CPUs - the tasks are dealt out among the
+//  members (and stolen between them with -ll:steal), so this measures how
+//  the scheduler scales with core count rather than per-processor rates
+void group_throughput(const std::vector<Processor>& procs)
+{
+  TestTaskArgs tta;
+  tta.which_task = MIDDLE_TASK;
+  tta.instance = RegionInstance::NO_INST;
+  tta.finish_barrier = Barrier::NO_BARRIER;
+
+  for(size_t count = 1; ; count *= 2) {
+    if(count > procs.size())
+      count = procs.size();
+    std::vector<Processor> members(procs.begin(), procs.begin() + count);
+    Processor group = Processor::create_group(members);
+
+    int total_tasks = count * TestConfig::tasks_per_processor;
+    UserEvent start = UserEvent::create_user_event();
+    std::vector<Event> events;
+    events.reserve(total_tasks);
+    for(int i = 0; i < total_tasks; i++)
+      events.push_back(group.spawn(DUMMY_TASK, &tta, sizeof(tta), start));
+
+    double t1 = Clock::current_time();
+    start.trigger();
+    Event::merge_events(events).wait();
+    double t2 = Clock::current_time();
+
+    log_app.print() << "group of " << count << " procs: "
+		    << (total_tasks / (t2 - t1)) << " tasks/s";
+
+    if(count == procs.size())
+      break;
+  }
+}
+
 void top_level_task(const void *args, size_t arglen, 
 		    const void *userdata, size_t userlen, Processor p)
 {
@@ -259,6 +297,9 @@ void top_level_task(const void *args, size_t arglen,
 
   // all done - wait for everything to finish via the finish_barrier
   launch_args.finish_barrier.wait();
+
+  if(TestConfig::group_tasks)
+    group_throughput(loc_procs[p.address_space()]);
 }
 
 int main(int argc, char **argv)
@@ -273,7 +314,8 @@ int main(int argc, char **argv)
     .add_option_int("-lp", TestConfig::launching_processors)
     .add_option_int("-args", TestConfig::task_argument_size)
     .add_option_bool("-remote", TestConfig::remote_tasks)
-    .add_option_bool("-prof", TestConfig::with_profiling);
+    .add_option_bool("-prof", TestConfig::with_profiling)
+    .add_option_bool("-group", TestConfig::group_tasks);
   ok = cp.parse_command_line(argc, (const char **)argv);
   assert(ok);
 
@@ -19,6 +19,7 @@ enum {
   SLEEP_TEST_TASK,
   PRIORITY_MASTER_TASK,
   PRIORITY_CHILD_TASK,
+  CHURN_TEST_TASK,
 };
 
 // we're going to use alarm() as a watchdog to detect deadlocks
@@ -88,6 +89,23 @@ void sleep_task(const void *args, size_t arglen,
 #endif
 }
 
+struct ChurnTestArgs {
+  Barrier all_blocked;
+  Event wait_on;
+};
+
+// every churn task blocks, so the processor needs a new (or recycled)
+//  worker for each one
+void churn_task(const void *args, size_t arglen,
+		const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen == sizeof(ChurnTestArgs));
+  const ChurnTestArgs& c_args = *(const ChurnTestArgs *)args;
+
+  c_args.all_blocked.arrive();
+  c_args.wait_on.wait();
+}
+
 struct PriorityTestArgs {
   int *counter;
   int exp_val1, exp_val2;
@@ -216,6 +234,8 @@ static int num_iterations = 100000;
 static int timeout_seconds = 10;
 static int sleep_useconds = 500000;
 static int concurrent_io = 1;
+static int churn_tasks = 8;
+static int churn_rounds = 50;
 
 void top_level_task(const void *args, size_t arglen, 
 		    const void *userdata, size_t userlen, Processor p)
@@ -324,6 +344,39 @@ void top_level_task(const void *args, size_t arglen,
 	}
       }
 
+      // worker churn test - rounds of tasks that all block at once, forcing
+      //  the processor to create (or reuse) a worker (and stack) per task
+      if(churn_rounds > 0) {
+        // set the watchdog timeout before we do anything that could get stuck
+        alarm(timeout_seconds);
+
+	double t_start = Clock::current_time();
+	for(int r = 0; r < churn_rounds; r++) {
+	  ChurnTestArgs c_args;
+	  c_args.all_blocked = Barrier::create_barrier(churn_tasks);
+	  UserEvent go = UserEvent::create_user_event();
+	  c_args.wait_on = go;
+
+	  std::set<Event> finish_events;
+	  for(int i = 0; i < churn_tasks; i++)
+	    finish_events.insert(pp.spawn(CHURN_TEST_TASK, &c_args, sizeof(c_args)));
+
+	  c_args.all_blocked.wait();
+	  go.trigger();
+	  Event::merge_events(finish_events).wait();
+	  c_args.all_blocked.destroy_barrier();
+	}
+	double t_end = Clock::current_time();
+
+	// turn off the watchdog timer
+	alarm(0);
+
+	double elapsed = t_end - t_start;
+	double ns_per_worker = 1e9 * elapsed / churn_rounds / churn_tasks;
+	printf("churn: proc " IDFMT " (kind=%d) finished: elapsed=%5.2fs time/blocked task=%6.0fns\n",
+               pp.id, k, elapsed, ns_per_worker);
+      }
+
       // test task prioritization on this processor kind
       {
 	Event e = pp.spawn(PRIORITY_MASTER_TASK, 0, 0);
@@ -362,6 +415,16 @@ int main(int argc, char **argv)
       continue;
     }
 
+    if(!strcmp(argv[i], "-w")) {
+      churn_tasks = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-r")) {
+      churn_rounds = atoi(argv[++i]);
+      continue;
+    }
+
     if(!strcmp(argv[i], "-s")) {
       sleep_useconds = atoi(argv[++i]);
       continue;
@@ -379,6 +442,7 @@ int main(int argc, char **argv)
   rt.register_task(SLEEP_TEST_TASK, sleep_task);
   rt.register_task(PRIORITY_MASTER_TASK, priority_master_task);
   rt.register_task(PRIORITY_CHILD_TASK, priority_child_task);
+  rt.register_task(CHURN_TEST_TASK, churn_task);
 
   signal(SIGALRM, sigalrm_handler);
 
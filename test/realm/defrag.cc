@@ -0,0 +1,154 @@
+#include "realm.h"
+
+#include <vector>
+#include <string>
+#include <cstring>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+// the system memory is limited to this many MB (see main), and filled with
+//  one fewer 1MB instances - every other one is then destroyed, which leaves
+//  no free range bigger than 2MB, so a 4MB allocation only succeeds if the
+//  defragmenter moves some of the survivors
+int num_instances = 15;
+size_t inst_elements = (1 << 20) / sizeof(long long);
+
+static long long pattern(int inst, size_t idx)
+{
+  return (((long long)inst) << 32) + idx;
+}
+
+static void *base_of(RegionInstance inst)
+{
+  AffineAccessor<long long, 1> acc(inst, 0);
+  return &acc[0];
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  Memory m = Machine::MemoryQuery(Machine::get_machine())
+    .only_kind(Memory::SYSTEM_MEM)
+    .has_affinity_to(p)
+    .first();
+  assert(m.exists());
+  log_app.print() << "memory defrag test: mem=" << m << " capacity=" << m.capacity();
+
+  std::vector<size_t> field_sizes(1, sizeof(long long));
+  Rect<1> bounds(0, inst_elements - 1);
+
+  std::vector<RegionInstance> insts(num_instances);
+  for(int i = 0; i < num_instances; i++) {
+    RegionInstance::create_instance(insts[i], m, bounds, field_sizes,
+				    0 /*SOA*/, ProfilingRequestSet()).wait();
+    AffineAccessor<long long, 1> acc(insts[i], 0);
+    for(size_t j = 0; j < inst_elements; j++)
+      acc[j] = pattern(i, j);
+    // this task doesn't hold on to raw pointers across the defrag pass
+    //  (except for the pinned one below)
+    insts[i].set_relocatable(true);
+  }
+
+  for(int i = 0; i < num_instances; i += 2) {
+    insts[i].destroy();
+    insts[i] = RegionInstance::NO_INST;
+  }
+
+  // pin one of the survivors - it must not move
+  int pinned = num_instances / 2;
+  if(!insts[pinned].exists()) pinned++;
+  insts[pinned].increment_accessor_count();
+  void *pinned_base = base_of(insts[pinned]);
+
+  std::vector<void *> old_bases(num_instances, (void *)0);
+  for(int i = 0; i < num_instances; i++)
+    if(insts[i].exists())
+      old_bases[i] = base_of(insts[i]);
+
+  RegionInstance big;
+  Event e = RegionInstance::create_instance(big, m,
+					    Rect<1>(0, 4 * inst_elements - 1),
+					    field_sizes,
+					    0 /*SOA*/, ProfilingRequestSet());
+  bool poisoned = false;
+  e.wait_faultaware(poisoned);
+  assert(!poisoned);
+  log_app.info() << "large instance created: " << big;
+
+  // the survivors' contents must have followed them
+  int moved = 0;
+  for(int i = 0; i < num_instances; i++) {
+    if(!insts[i].exists()) continue;
+    if(base_of(insts[i]) != old_bases[i]) moved++;
+    AffineAccessor<long long, 1> acc(insts[i], 0);
+    for(size_t j = 0; j < inst_elements; j++)
+      if(acc[j] != pattern(i, j)) {
+	log_app.fatal() << "mismatch: inst=" << insts[i] << " idx=" << j
+			<< " exp=" << pattern(i, j) << " act=" << acc[j];
+	assert(0);
+      }
+  }
+  assert(base_of(insts[pinned]) == pinned_base);
+  assert(moved > 0);
+  log_app.print() << "instances moved: " << moved;
+
+  // the large instance must be usable too
+  {
+    AffineAccessor<long long, 1> acc(big, 0);
+    for(size_t j = 0; j < 4 * inst_elements; j++)
+      acc[j] = j;
+  }
+
+  insts[pinned].decrement_accessor_count();
+  big.destroy();
+  for(int i = 0; i < num_instances; i++)
+    if(insts[i].exists())
+      insts[i].destroy();
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  // this test needs a small system memory and the defragmenter (only
+  //  on allocation failure)
+  std::vector<char *> args(argv, argv + argc);
+  std::string csize_val = "16";
+  std::string defrag_val = "100";
+  char csize_arg[] = "-ll:csize";
+  char defrag_arg[] = "-ll:defrag";
+  args.push_back(csize_arg);
+  args.push_back(&csize_val[0]);
+  args.push_back(defrag_arg);
+  args.push_back(&defrag_val[0]);
+  args.push_back(0);
+  int new_argc = args.size() - 1;
+  char **new_argv = &args[0];
+
+  rt.init(&new_argc, &new_argv);
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  rt.wait_for_shutdown();
+
+  return 0;
+}
@@ -1841,6 +1841,1028 @@ public:
   }
 };
 
+// a 2-D grid whose points are scattered pseudo-randomly among the pieces -
+//  each piece fills its bounding box densely but has no rectangular structure
+//  to speak of, which is what bitmap sparsity maps are for (run with
+//  "-dp:bitmaprects 0" to compare against rectangle lists)
+class ScatterTest : public TestInterface {
+public:
+  // grid config parameters
+  WithDefault<int, 256> grid_x;
+  WithDefault<int, 256> grid_y;
+  WithDefault<int,   4> num_pieces;
+  WithDefault<int, 101> check_stride;
+
+  ScatterTest(int argc, const char *argv[])
+  {
+#define INT_ARG(s, v) if(!strcmp(argv[i], s)) { v = atoi(argv[++i]); continue; }
+    for(int i = 1; i < argc; i++) {
+      INT_ARG("-gx", grid_x)
+      INT_ARG("-gy", grid_y)
+      INT_ARG("-p",  num_pieces)
+      INT_ARG("-stride", check_stride)
+      if(!strcmp(argv[i], "-g")) { int v = atoi(argv[++i]); grid_x = grid_y = v; continue; }
+    }
+#undef INT_ARG
+  }
+
+  enum PRNGStreams {
+    POINT_PIECE_STREAM,
+  };
+
+  int random_point_piece(const Point<2>& p)
+  {
+    int idx = p.y * grid_x + p.x;
+    return Philox_2x32<>::rand_int(random_seed, idx, POINT_PIECE_STREAM, num_pieces);
+  }
+
+  IndexSpace<2> is_grid;
+  std::vector<RegionInstance> ri_pieces;
+  std::vector<FieldDataDescriptor<IndexSpace<2>, int> > piece_field_data;
+  // each piece, the union of each piece with the next, and that union
+  //  intersected with and minus the original piece
+  std::vector<IndexSpace<2> > p_pieces, p_pairs, p_isects, p_diffs;
+
+  virtual void print_info(void)
+  {
+    printf("Realm dependent partitioning test - scatter: %d x %d grid, %d pieces\n",
+	   (int)grid_x, (int)grid_y, (int)num_pieces);
+  }
+
+  virtual Event initialize_data(const std::vector<Memory>& memories,
+				const std::vector<Processor>& procs)
+  {
+    is_grid = Rect<2>(Point<2>(0, 0), Point<2>(grid_x - 1, grid_y - 1));
+
+    // the grid is split into bands of rows, one per memory
+    size_t num_insts = memories.size();
+    std::vector<size_t> field_sizes(1, sizeof(int));
+    ri_pieces.resize(num_insts);
+    piece_field_data.resize(num_insts);
+
+    for(size_t i = 0; i < num_insts; i++) {
+      int y_lo = grid_y * i / num_insts;
+      int y_hi = grid_y * (i + 1) / num_insts - 1;
+      IndexSpace<2> is_band(Rect<2>(Point<2>(0, y_lo), Point<2>(grid_x - 1, y_hi)));
+
+      RegionInstance ri;
+      RegionInstance::create_instance(ri,
+				      memories[i],
+				      is_band,
+				      field_sizes,
+				      0 /*SOA*/,
+				      Realm::ProfilingRequestSet()).wait();
+      ri_pieces[i] = ri;
+
+      AffineAccessor<int,2> a_piece(ri, 0 /* offset */);
+      for(PointInRectIterator<2,int> pir(is_band.bounds); pir.valid; pir.step())
+	a_piece.write(pir.p, random_point_piece(pir.p));
+
+      piece_field_data[i].index_space = is_band;
+      piece_field_data[i].inst = ri;
+      piece_field_data[i].field_offset = 0;
+    }
+
+    return Event::NO_EVENT;
+  }
+
+  virtual Event perform_partitioning(void)
+  {
+    std::vector<int> colors(num_pieces);
+    for(int i = 0; i < num_pieces; i++)
+      colors[i] = i;
+
+    Event e1 = is_grid.create_subspaces_by_field(piece_field_data,
+						 colors,
+						 p_pieces,
+						 Realm::ProfilingRequestSet());
+    if(wait_on_events) e1.wait();
+
+    std::vector<IndexSpace<2> > p_next(num_pieces);
+    for(int i = 0; i < num_pieces; i++)
+      p_next[i] = p_pieces[(i + 1) % num_pieces];
+
+    Event e2 = IndexSpace<2>::compute_unions(p_pieces, p_next, p_pairs,
+					     Realm::ProfilingRequestSet(),
+					     e1);
+    if(wait_on_events) e2.wait();
+
+    Event e3 = IndexSpace<2>::compute_intersections(p_pairs, p_pieces, p_isects,
+						    Realm::ProfilingRequestSet(),
+						    e2);
+    if(wait_on_events) e3.wait();
+
+    Event e4 = IndexSpace<2>::compute_differences(p_pairs, p_pieces, p_diffs,
+						  Realm::ProfilingRequestSet(),
+						  e2);
+    if(wait_on_events) e4.wait();
+
+    return Event::merge_events(e3, e4);
+  }
+
+  virtual int perform_dynamic_checks(void)
+  {
+    return 0;
+  }
+
+  // walks the rectangles of 'is' and compares them point by point with
+  //  what 'expected' says, and spot-checks contains() as well
+  int check_space(const char *name, int idx, IndexSpace<2> is,
+		  const std::vector<int>& point_pieces, int piece1, int piece2)
+  {
+    int errors = 0;
+    std::vector<char> seen(point_pieces.size(), 0);
+    size_t iter_volume = 0;
+    for(IndexSpaceIterator<2> it(is); it.valid; it.step()) {
+      iter_volume += it.rect.volume();
+      for(PointInRectIterator<2,int> pir(it.rect); pir.valid; pir.step()) {
+	size_t pidx = pir.p.y * grid_x + pir.p.x;
+	if(!is_grid.contains(pir.p) || seen[pidx]) {
+	  if(errors++ < 10)
+	    log_app.error() << name << "[" << idx << "]: bad or repeated point " << pir.p;
+	  continue;
+	}
+	seen[pidx] = 1;
+      }
+    }
+
+    size_t exp_volume = 0;
+    for(size_t pidx = 0; pidx < point_pieces.size(); pidx++) {
+      bool exp = ((point_pieces[pidx] == piece1) || (point_pieces[pidx] == piece2));
+      if(exp) exp_volume++;
+      if(exp != (seen[pidx] != 0)) {
+	if(errors++ < 10)
+	  log_app.error() << name << "[" << idx << "]: point " << Point<2>(pidx % grid_x, pidx / grid_x)
+			  << " expected=" << exp << " actual=" << (seen[pidx] != 0);
+      }
+      if((pidx % check_stride) == 0) {
+	Point<2> p(pidx % grid_x, pidx / grid_x);
+	if(is.contains(p) != exp) {
+	  if(errors++ < 10)
+	    log_app.error() << name << "[" << idx << "]: contains(" << p << ") != " << exp;
+	}
+      }
+    }
+
+    if((is.volume() != exp_volume) || (iter_volume != exp_volume)) {
+      log_app.error() << name << "[" << idx << "]: volume=" << is.volume()
+		      << " iterated=" << iter_volume << " expected=" << exp_volume;
+      errors++;
+    }
+    return errors;
+  }
+
+  virtual int check_partitioning(void)
+  {
+    int errors = 0;
+
+    std::vector<int> point_pieces(grid_x * grid_y);
+    for(PointInRectIterator<2,int> pir(is_grid.bounds); pir.valid; pir.step())
+      point_pieces[pir.p.y * grid_x + pir.p.x] = random_point_piece(pir.p);
+
+    size_t bitmaps = 0;
+    for(int i = 0; i < num_pieces; i++) {
+      int next = (i + 1) % num_pieces;
+      errors += check_space("piece", i, p_pieces[i], point_pieces, i, i);
+      errors += check_space("pair", i, p_pairs[i], point_pieces, i, next);
+      errors += check_space("isect", i, p_isects[i], point_pieces, i, i);
+      errors += check_space("diff", i, p_diffs[i], point_pieces,
+			    ((next != i) ? next : -1), ((next != i) ? next : -1));
+
+      if(p_pieces[i].sparsity.exists()) {
+	const std::vector<SparsityMapEntry<2,int> >& entries = p_pieces[i].sparsity.impl()->get_entries();
+	if((entries.size() == 1) && entries[0].bitmap)
+	  bitmaps++;
+      }
+    }
+    log_app.print() << bitmaps << " of " << num_pieces << " pieces stored as bitmaps";
+
+    return errors;
+  }
+};
+
+// one big 1-D instance holding a color field (in runs of equal colors) and
+//  a pointer field that scatters the points across the whole range - large
+//  instances are split into chunks that the partitioning workers scan in
+//  parallel, so this measures how the by-field and image operations scale
+//  (compare e.g. "-dp:workers 1" against "-dp:workers 8", and use
+//  "-dp:chunks" / "-dp:chunksize" to control the splitting)
+class ChunkedTest : public TestInterface {
+public:
+  WithDefault<int, 4194304> num_points;
+  WithDefault<int,      16> num_pieces;
+  WithDefault<int,      32> run_length;
+  WithDefault<int,     997> check_stride;
+
+  ChunkedTest(int argc, const char *argv[])
+  {
+#define INT_ARG(s, v) if(!strcmp(argv[i], s)) { v = atoi(argv[++i]); continue; }
+    for(int i = 1; i < argc; i++) {
+      INT_ARG("-n", num_points)
+      INT_ARG("-p", num_pieces)
+      INT_ARG("-run", run_length)
+      INT_ARG("-stride", check_stride)
+    }
+#undef INT_ARG
+
+    // the pointer field multiplies by something coprime to the number of
+    //  points, so every point is pointed at exactly once
+    multiplier = num_points / 3;
+    while(gcd(multiplier, num_points) != 1)
+      multiplier++;
+  }
+
+  enum PRNGStreams {
+    RUN_COLOR_STREAM,
+  };
+
+  static long long gcd(long long a, long long b)
+  {
+    while(b != 0) {
+      long long t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+  }
+
+  int point_color(int p)
+  {
+    return Philox_2x32<>::rand_int(random_seed, p / run_length, RUN_COLOR_STREAM, num_pieces);
+  }
+
+  int point_target(int p)
+  {
+    return ((long long)p * multiplier) % num_points;
+  }
+
+  long long multiplier;
+  IndexSpace<1> is_points;
+  RegionInstance ri_points;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, int> > color_field_data;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, Point<1> > > ptr_field_data;
+  std::vector<IndexSpace<1> > p_colors, p_images;
+
+  virtual void print_info(void)
+  {
+    printf("Realm dependent partitioning test - chunked: %d points, %d pieces, runs of %d\n",
+	   (int)num_points, (int)num_pieces, (int)run_length);
+  }
+
+  virtual Event initialize_data(const std::vector<Memory>& memories,
+				const std::vector<Processor>& procs)
+  {
+    is_points = Rect<1>(0, num_points - 1);
+
+    // everything goes in a single instance, which is the case chunking is for
+    std::vector<size_t> field_sizes;
+    field_sizes.push_back(sizeof(int));
+    field_sizes.push_back(sizeof(Point<1>));
+    RegionInstance::create_instance(ri_points,
+				    memories[0],
+				    is_points,
+				    field_sizes,
+				    0 /*SOA*/,
+				    Realm::ProfilingRequestSet()).wait();
+
+    AffineAccessor<int,1> a_color(ri_points, 0 /* offset */);
+    AffineAccessor<Point<1>,1> a_ptr(ri_points, sizeof(int) /* offset */);
+    for(int p = 0; p < num_points; p++) {
+      a_color.write(p, point_color(p));
+      a_ptr.write(p, Point<1>(point_target(p)));
+    }
+
+    color_field_data.resize(1);
+    color_field_data[0].index_space = is_points;
+    color_field_data[0].inst = ri_points;
+    color_field_data[0].field_offset = 0;
+
+    ptr_field_data.resize(1);
+    ptr_field_data[0].index_space = is_points;
+    ptr_field_data[0].inst = ri_points;
+    ptr_field_data[0].field_offset = sizeof(int);
+
+    return Event::NO_EVENT;
+  }
+
+  virtual Event perform_partitioning(void)
+  {
+    std::vector<int> colors(num_pieces);
+    for(int i = 0; i < num_pieces; i++)
+      colors[i] = i;
+
+    Event e1 = is_points.create_subspaces_by_field(color_field_data,
+						   colors,
+						   p_colors,
+						   Realm::ProfilingRequestSet());
+    if(wait_on_events) e1.wait();
+
+    Event e2 = is_points.create_subspaces_by_image(ptr_field_data,
+						   p_colors,
+						   p_images,
+						   Realm::ProfilingRequestSet(),
+						   e1);
+    if(wait_on_events) e2.wait();
+
+    return e2;
+  }
+
+  virtual int perform_dynamic_checks(void)
+  {
+    return 0;
+  }
+
+  // compares the rectangles of 'is' point by point with 'point_pieces' and
+  //  spot-checks contains() as well
+  int check_space(const char *name, int idx, IndexSpace<1> is,
+		  const std::vector<int>& point_pieces)
+  {
+    int errors = 0;
+    std::vector<char> seen(point_pieces.size(), 0);
+    size_t iter_volume = 0;
+    for(IndexSpaceIterator<1> it(is); it.valid; it.step()) {
+      iter_volume += it.rect.volume();
+      for(int p = it.rect.lo.x; p <= it.rect.hi.x; p++) {
+	if(!is_points.contains(p) || seen[p]) {
+	  if(errors++ < 10)
+	    log_app.error() << name << "[" << idx << "]: bad or repeated point " << p;
+	  continue;
+	}
+	seen[p] = 1;
+      }
+    }
+
+    size_t exp_volume = 0;
+    for(size_t p = 0; p < point_pieces.size(); p++) {
+      bool exp = (point_pieces[p] == idx);
+      if(exp) exp_volume++;
+      if(exp != (seen[p] != 0)) {
+	if(errors++ < 10)
+	  log_app.error() << name << "[" << idx << "]: point " << p
+			  << " expected=" << exp << " actual=" << (seen[p] != 0);
+      }
+      if((p % check_stride) == 0) {
+	if(is.contains(Point<1>(p)) != exp) {
+	  if(errors++ < 10)
+	    log_app.error() << name << "[" << idx << "]: contains(" << p << ") != " << exp;
+	}
+      }
+    }
+
+    if((is.volume() != exp_volume) || (iter_volume != exp_volume)) {
+      log_app.error() << name << "[" << idx << "]: volume=" << is.volume()
+		      << " iterated=" << iter_volume << " expected=" << exp_volume;
+      errors++;
+    }
+    return errors;
+  }
+
+  virtual int check_partitioning(void)
+  {
+    int errors = 0;
+
+    std::vector<int> point_colors(num_points), target_colors(num_points);
+    for(int p = 0; p < num_points; p++) {
+      point_colors[p] = point_color(p);
+      target_colors[point_target(p)] = point_colors[p];
+    }
+
+    for(int i = 0; i < num_pieces; i++) {
+      errors += check_space("color", i, p_colors[i], point_colors);
+      errors += check_space("image", i, p_images[i], target_colors);
+    }
+
+    return errors;
+  }
+};
+
+// a benchmark for the run scans in the by-field and image operations: a
+//  dense 1-D coloring in blocks of equal colors, a pointer field in which
+//  each block points (consecutively) at some other block, and a range field
+//  in which every point of a block holds the whole target block - compare
+//  "-dp:scankernels 0" (point by point) against the default, which finds
+//  the runs a vector at a time
+class ScanTest : public TestInterface {
+public:
+  WithDefault<int, 16777216> num_points;
+  WithDefault<int,       16> num_pieces;
+  WithDefault<int,      256> block_size;
+  WithDefault<int,        4> repeat;
+  WithDefault<int,      997> check_stride;
+
+  ScanTest(int argc, const char *argv[])
+  {
+#define INT_ARG(s, v) if(!strcmp(argv[i], s)) { v = atoi(argv[++i]); continue; }
+    for(int i = 1; i < argc; i++) {
+      INT_ARG("-n", num_points)
+      INT_ARG("-p", num_pieces)
+      INT_ARG("-b", block_size)
+      INT_ARG("-repeat", repeat)
+      INT_ARG("-stride", check_stride)
+    }
+#undef INT_ARG
+
+    num_blocks = (num_points + block_size - 1) / block_size;
+    num_points = num_blocks * block_size;
+    // a multiplier coprime to the number of blocks makes a permutation
+    multiplier = num_blocks / 3 + 1;
+    while(ChunkedTest::gcd(multiplier, num_blocks) != 1)
+      multiplier++;
+  }
+
+  enum PRNGStreams {
+    BLOCK_COLOR_STREAM,
+  };
+
+  int point_color(int p)
+  {
+    return Philox_2x32<>::rand_int(random_seed, p / block_size, BLOCK_COLOR_STREAM, num_pieces);
+  }
+
+  Rect<1> target_block(int p)
+  {
+    int b = ((long long)(p / block_size) * multiplier) % num_blocks;
+    return Rect<1>(b * block_size, (b + 1) * block_size - 1);
+  }
+
+  int num_blocks;
+  long long multiplier;
+  IndexSpace<1> is_points;
+  RegionInstance ri_points;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, int> > color_field_data;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, Point<1> > > ptr_field_data;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, Rect<1> > > rng_field_data;
+  std::vector<IndexSpace<1> > p_colors, p_images, p_ranges;
+
+  virtual void print_info(void)
+  {
+    printf("Realm dependent partitioning test - scan: %d points, %d pieces, blocks of %d, %d repeats\n",
+	   (int)num_points, (int)num_pieces, (int)block_size, (int)repeat);
+  }
+
+  virtual Event initialize_data(const std::vector<Memory>& memories,
+				const std::vector<Processor>& procs)
+  {
+    is_points = Rect<1>(0, num_points - 1);
+
+    std::vector<size_t> field_sizes;
+    field_sizes.push_back(sizeof(int));
+    field_sizes.push_back(sizeof(Point<1>));
+    field_sizes.push_back(sizeof(Rect<1>));
+    RegionInstance::create_instance(ri_points,
+				    memories[0],
+				    is_points,
+				    field_sizes,
+				    0 /*SOA*/,
+				    Realm::ProfilingRequestSet()).wait();
+
+    size_t ptr_offset = sizeof(int);
+    size_t rng_offset = ptr_offset + sizeof(Point<1>);
+    AffineAccessor<int,1> a_color(ri_points, 0 /* offset */);
+    AffineAccessor<Point<1>,1> a_ptr(ri_points, ptr_offset);
+    AffineAccessor<Rect<1>,1> a_rng(ri_points, rng_offset);
+    for(int p = 0; p < num_points; p++) {
+      Rect<1> tgt = target_block(p);
+      a_color.write(p, point_color(p));
+      a_ptr.write(p, Point<1>(tgt.lo.x + (p % block_size)));
+      a_rng.write(p, tgt);
+    }
+
+    color_field_data.resize(1);
+    color_field_data[0].index_space = is_points;
+    color_field_data[0].inst = ri_points;
+    color_field_data[0].field_offset = 0;
+
+    ptr_field_data.resize(1);
+    ptr_field_data[0].index_space = is_points;
+    ptr_field_data[0].inst = ri_points;
+    ptr_field_data[0].field_offset = ptr_offset;
+
+    rng_field_data.resize(1);
+    rng_field_data[0].index_space = is_points;
+    rng_field_data[0].inst = ri_points;
+    rng_field_data[0].field_offset = rng_offset;
+
+    return Event::NO_EVENT;
+  }
+
+  virtual Event perform_partitioning(void)
+  {
+    std::vector<int> colors(num_pieces);
+    for(int i = 0; i < num_pieces; i++)
+      colors[i] = i;
+
+    // each operation is timed on its own, and repeated to get past the
+    //  noise - only the last results are kept
+    Event e = Event::NO_EVENT;
+    for(int r = 0; r < repeat; r++) {
+      if(r > 0) {
+	for(int i = 0; i < num_pieces; i++) {
+	  p_colors[i].destroy();
+	  p_images[i].destroy();
+	  p_ranges[i].destroy();
+	}
+	p_colors.clear();
+	p_images.clear();
+	p_ranges.clear();
+      }
+
+      {
+	Realm::TimeStamp ts("by-field", true, &log_app);
+	is_points.create_subspaces_by_field(color_field_data,
+					    colors,
+					    p_colors,
+					    Realm::ProfilingRequestSet(),
+					    e).wait();
+      }
+
+      {
+	Realm::TimeStamp ts("image (pointers)", true, &log_app);
+	is_points.create_subspaces_by_image(ptr_field_data,
+					    p_colors,
+					    p_images,
+					    Realm::ProfilingRequestSet()).wait();
+      }
+
+      {
+	Realm::TimeStamp ts("image (ranges)", true, &log_app);
+	e = is_points.create_subspaces_by_image(rng_field_data,
+						p_colors,
+						p_ranges,
+						Realm::ProfilingRequestSet());
+	e.wait();
+      }
+    }
+
+    return e;
+  }
+
+  virtual int perform_dynamic_checks(void)
+  {
+    return 0;
+  }
+
+  // compares each of 'spaces' point by point with 'point_pieces'
+  int check_spaces(const char *name, const std::vector<IndexSpace<1> >& spaces,
+		   const std::vector<int>& point_pieces)
+  {
+    int errors = 0;
+    std::vector<int> seen(num_points, -1);
+    for(int i = 0; i < num_pieces; i++) {
+      for(IndexSpaceIterator<1> it(spaces[i]); it.valid; it.step())
+	for(int p = it.rect.lo.x; p <= it.rect.hi.x; p++) {
+	  if(!is_points.contains(p) || (seen[p] != -1)) {
+	    if(errors++ < 10)
+	      log_app.error() << name << "[" << i << "]: bad or repeated point " << p;
+	    continue;
+	  }
+	  seen[p] = i;
+	}
+    }
+
+    for(int p = 0; p < num_points; p++) {
+      if(seen[p] != point_pieces[p]) {
+	if(errors++ < 10)
+	  log_app.error() << name << ": point " << p << " expected in "
+			  << point_pieces[p] << ", found in " << seen[p];
+      }
+      if((p % check_stride) == 0) {
+	if(!spaces[point_pieces[p]].contains(Point<1>(p))) {
+	  if(errors++ < 10)
+	    log_app.error() << name << "[" << point_pieces[p] << "]: doesn't contain " << p;
+	}
+      }
+    }
+    return errors;
+  }
+
+  virtual int check_partitioning(void)
+  {
+    std::vector<int> point_colors(num_points), target_colors(num_points);
+    for(int p = 0; p < num_points; p++) {
+      point_colors[p] = point_color(p);
+      target_colors[target_block(p).lo.x + (p % block_size)] = point_colors[p];
+    }
+
+    int errors = 0;
+    errors += check_spaces("color", p_colors, point_colors);
+    errors += check_spaces("image", p_images, target_colors);
+    errors += check_spaces("range", p_ranges, target_colors);
+    return errors;
+  }
+};
+
+// a slowly changing coloring, as in a particle code: every step moves a small
+//  window of points to the next piece (and repoints them), and the by-field
+//  and image partitions are updated from the previous ones rather than
+//  recomputed - the final results are checked against the final field data
+class IncrementalTest : public TestInterface {
+public:
+  WithDefault<int, 1048576> num_points;
+  WithDefault<int,      16> num_pieces;
+  WithDefault<int,       8> num_steps;
+  WithDefault<int,    1000> num_changes;  // per step
+  WithDefault<int,     997> check_stride;
+
+  IncrementalTest(int argc, const char *argv[])
+  {
+#define INT_ARG(s, v) if(!strcmp(argv[i], s)) { v = atoi(argv[++i]); continue; }
+    for(int i = 1; i < argc; i++) {
+      INT_ARG("-n", num_points)
+      INT_ARG("-p", num_pieces)
+      INT_ARG("-steps", num_steps)
+      INT_ARG("-changes", num_changes)
+      INT_ARG("-stride", check_stride)
+    }
+#undef INT_ARG
+
+    if(num_changes > num_points)
+      num_changes = num_points;
+  }
+
+  enum PRNGStreams {
+    WINDOW_STREAM,
+  };
+
+  IndexSpace<1> is_points;
+  RegionInstance ri_points;
+  std::vector<int> point_colors, point_targets;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, int> > color_field_data;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, Point<1> > > ptr_field_data;
+  std::vector<IndexSpace<1> > p_colors, p_images;
+
+  virtual void print_info(void)
+  {
+    printf("Realm dependent partitioning test - incremental: %d points, %d pieces, %d steps of %d changes\n",
+	   (int)num_points, (int)num_pieces, (int)num_steps, (int)num_changes);
+  }
+
+  virtual Event initialize_data(const std::vector<Memory>& memories,
+				const std::vector<Processor>& procs)
+  {
+    is_points = Rect<1>(0, num_points - 1);
+
+    std::vector<size_t> field_sizes;
+    field_sizes.push_back(sizeof(int));
+    field_sizes.push_back(sizeof(Point<1>));
+    RegionInstance::create_instance(ri_points,
+				    memories[0],
+				    is_points,
+				    field_sizes,
+				    0 /*SOA*/,
+				    Realm::ProfilingRequestSet()).wait();
+
+    // pieces start out as contiguous blocks, each pointing at the next one
+    point_colors.resize(num_points);
+    point_targets.resize(num_points);
+    AffineAccessor<int,1> a_color(ri_points, 0 /* offset */);
+    AffineAccessor<Point<1>,1> a_ptr(ri_points, sizeof(int) /* offset */);
+    for(int p = 0; p < num_points; p++) {
+      point_colors[p] = (long long)p * num_pieces / num_points;
+      point_targets[p] = (p + num_points / num_pieces) % num_points;
+      a_color.write(p, point_colors[p]);
+      a_ptr.write(p, Point<1>(point_targets[p]));
+    }
+
+    color_field_data.resize(1);
+    color_field_data[0].index_space = is_points;
+    color_field_data[0].inst = ri_points;
+    color_field_data[0].field_offset = 0;
+
+    ptr_field_data.resize(1);
+    ptr_field_data[0].index_space = is_points;
+    ptr_field_data[0].inst = ri_points;
+    ptr_field_data[0].field_offset = sizeof(int);
+
+    return Event::NO_EVENT;
+  }
+
+  virtual Event perform_partitioning(void)
+  {
+    std::vector<int> colors(num_pieces);
+    for(int i = 0; i < num_pieces; i++)
+      colors[i] = i;
+
+    {
+      Realm::TimeStamp ts("full partitioning", true, &log_app);
+      is_points.create_subspaces_by_field(color_field_data,
+					  colors,
+					  p_colors,
+					  Realm::ProfilingRequestSet()).wait();
+      is_points.create_subspaces_by_image(ptr_field_data,
+					  p_colors,
+					  p_images,
+					  Realm::ProfilingRequestSet()).wait();
+    }
+
+    AffineAccessor<int,1> a_color(ri_points, 0 /* offset */);
+    AffineAccessor<Point<1>,1> a_ptr(ri_points, sizeof(int) /* offset */);
+    for(int step = 0; step < num_steps; step++) {
+      // move a window of points to the next piece and point them elsewhere
+      int start = Philox_2x32<>::rand_int(random_seed, step, WINDOW_STREAM,
+					  num_points - num_changes + 1);
+      std::vector<Point<1> > changed_points;
+      for(int p = start; p < start + num_changes; p++) {
+	point_colors[p] = (point_colors[p] + 1) % num_pieces;
+	point_targets[p] = (point_targets[p] + num_points / 2) % num_points;
+	a_color.write(p, point_colors[p]);
+	a_ptr.write(p, Point<1>(point_targets[p]));
+	changed_points.push_back(Point<1>(p));
+      }
+
+      Realm::TimeStamp ts("incremental step", true, &log_app);
+
+      // alternate between the list and index space forms
+      std::vector<IndexSpace<1> > new_colors, new_images;
+      Event e1;
+      if((step % 2) == 0)
+	e1 = is_points.update_subspaces_by_field(color_field_data,
+						 colors,
+						 p_colors,
+						 changed_points,
+						 new_colors,
+						 Realm::ProfilingRequestSet());
+      else
+	e1 = is_points.update_subspaces_by_field(color_field_data,
+						 colors,
+						 p_colors,
+						 IndexSpace<1>(Rect<1>(start, start + num_changes - 1)),
+						 new_colors,
+						 Realm::ProfilingRequestSet());
+      if(wait_on_events) e1.wait();
+
+      Event e2 = is_points.update_subspaces_by_image(ptr_field_data,
+						     p_colors,
+						     p_images,
+						     new_colors,
+						     IndexSpace<1>(Rect<1>(start, start + num_changes - 1)),
+						     new_images,
+						     Realm::ProfilingRequestSet(),
+						     e1);
+      // the field data can't change again until this step is done
+      e2.wait();
+
+      p_colors.swap(new_colors);
+      p_images.swap(new_images);
+    }
+
+    return Event::NO_EVENT;
+  }
+
+  virtual int perform_dynamic_checks(void)
+  {
+    return 0;
+  }
+
+  // compares each of 'spaces' point by point with 'point_sets', which lists
+  //  the pieces each point should be in
+  int check_spaces(const char *name, const std::vector<IndexSpace<1> >& spaces,
+		   const std::vector<std::set<int> >& point_sets)
+  {
+    int errors = 0;
+    for(int i = 0; i < num_pieces; i++) {
+      std::vector<char> seen(num_points, 0);
+      for(IndexSpaceIterator<1> it(spaces[i]); it.valid; it.step())
+	for(int p = it.rect.lo.x; p <= it.rect.hi.x; p++) {
+	  if(!is_points.contains(p) || seen[p]) {
+	    if(errors++ < 10)
+	      log_app.error() << name << "[" << i << "]: bad or repeated point " << p;
+	    continue;
+	  }
+	  seen[p] = 1;
+	}
+
+      for(int p = 0; p < num_points; p++) {
+	bool exp = (point_sets[p].count(i) > 0);
+	if(exp != (seen[p] != 0)) {
+	  if(errors++ < 10)
+	    log_app.error() << name << "[" << i << "]: point " << p
+			    << " expected=" << exp << " actual=" << (seen[p] != 0);
+	}
+	if((p % check_stride) == 0) {
+	  if(spaces[i].contains(Point<1>(p)) != exp) {
+	    if(errors++ < 10)
+	      log_app.error() << name << "[" << i << "]: contains(" << p << ") != " << exp;
+	  }
+	}
+      }
+    }
+    return errors;
+  }
+
+  virtual int check_partitioning(void)
+  {
+    std::vector<std::set<int> > color_sets(num_points), image_sets(num_points);
+    for(int p = 0; p < num_points; p++) {
+      color_sets[p].insert(point_colors[p]);
+      image_sets[point_targets[p]].insert(point_colors[p]);
+    }
+
+    int errors = 0;
+    errors += check_spaces("color", p_colors, color_sets);
+    errors += check_spaces("image", p_images, image_sets);
+    return errors;
+  }
+};
+
+// an AMR-like mesh: the grid is cut into blocks, each of which belongs to one
+//  of many (sparse) subregions, and every point points at its neighbor in
+//  the first dimension - the image and preimage of each subregion are then
+//  just that subregion shifted by one, but computing them has to find which
+//  of the subregions each point and pointer falls in
+template <int N>
+class AmrTest : public TestInterface {
+public:
+  // grid config parameters
+  WithDefault<int,    0> grid_size;   // per dimension - 0 picks one by N
+  WithDefault<int,    0> num_blocks;  // per dimension - 0 picks one by -p
+  WithDefault<int, 1024> num_pieces;
+  WithDefault<int,  997> check_stride;
+
+  AmrTest(int argc, const char *argv[])
+  {
+#define INT_ARG(s, v) if(!strcmp(argv[i], s)) { v = atoi(argv[++i]); continue; }
+    for(int i = 1; i < argc; i++) {
+      INT_ARG("-g", grid_size)
+      INT_ARG("-b", num_blocks)
+      INT_ARG("-p", num_pieces)
+      INT_ARG("-stride", check_stride)
+    }
+#undef INT_ARG
+
+    // about a quarter million points by default
+    if(grid_size == 0)
+      grid_size = ((N == 1) ? 262144 : (N == 2) ? 512 : 64);
+    // and roughly four blocks per subregion
+    if(num_blocks == 0) {
+      num_blocks = int(ceil(pow(4.0 * num_pieces, 1.0 / N)));
+      if(num_blocks > grid_size)
+	num_blocks = grid_size;
+    }
+  }
+
+  enum PRNGStreams {
+    BLOCK_PIECE_STREAM,
+  };
+
+  int point_piece(const Point<N>& p)
+  {
+    int idx = 0;
+    for(int d = N - 1; d >= 0; d--)
+      idx = (idx * num_blocks) + ((long long)p[d] * num_blocks / grid_size);
+    return Philox_2x32<>::rand_int(random_seed, idx, BLOCK_PIECE_STREAM, num_pieces);
+  }
+
+  Point<N> neighbor(const Point<N>& p, int delta)
+  {
+    Point<N> n = p;
+    n[0] = (p[0] + grid_size + delta) % grid_size;
+    return n;
+  }
+
+  IndexSpace<N> is_grid;
+  std::vector<RegionInstance> ri_insts;
+  std::vector<FieldDataDescriptor<IndexSpace<N>, Point<N> > > ptr_field_data;
+  std::vector<FieldDataDescriptor<IndexSpace<N>, int> > piece_field_data;
+  std::vector<IndexSpace<N> > p_pieces, p_images, p_preimages;
+
+  virtual void print_info(void)
+  {
+    printf("Realm dependent partitioning test - amr: %d-D, %d^%d grid, %d^%d blocks, %d pieces\n",
+	   N, (int)grid_size, N, (int)num_blocks, N, (int)num_pieces);
+  }
+
+  virtual Event initialize_data(const std::vector<Memory>& memories,
+				const std::vector<Processor>& procs)
+  {
+    Rect<N> r;
+    for(int d = 0; d < N; d++) {
+      r.lo[d] = 0;
+      r.hi[d] = grid_size - 1;
+    }
+    is_grid = r;
+
+    // the grid is split into slabs along the last dimension, one per memory
+    size_t num_insts = memories.size();
+    std::vector<size_t> field_sizes;
+    field_sizes.push_back(sizeof(Point<N>));
+    field_sizes.push_back(sizeof(int));
+    ri_insts.resize(num_insts);
+    ptr_field_data.resize(num_insts);
+    piece_field_data.resize(num_insts);
+
+    for(size_t i = 0; i < num_insts; i++) {
+      Rect<N> slab = r;
+      slab.lo[N - 1] = grid_size * i / num_insts;
+      slab.hi[N - 1] = grid_size * (i + 1) / num_insts - 1;
+      IndexSpace<N> is_slab(slab);
+
+      RegionInstance ri;
+      RegionInstance::create_instance(ri,
+				      memories[i],
+				      is_slab,
+				      field_sizes,
+				      0 /*SOA*/,
+				      Realm::ProfilingRequestSet()).wait();
+      ri_insts[i] = ri;
+
+      AffineAccessor<Point<N>,N> a_ptr(ri, 0 /* offset */);
+      AffineAccessor<int,N> a_piece(ri, sizeof(Point<N>) /* offset */);
+      for(PointInRectIterator<N,int> pir(slab); pir.valid; pir.step()) {
+	a_ptr.write(pir.p, neighbor(pir.p, 1));
+	a_piece.write(pir.p, point_piece(pir.p));
+      }
+
+      ptr_field_data[i].index_space = is_slab;
+      ptr_field_data[i].inst = ri;
+      ptr_field_data[i].field_offset = 0;
+      piece_field_data[i].index_space = is_slab;
+      piece_field_data[i].inst = ri;
+      piece_field_data[i].field_offset = sizeof(Point<N>);
+    }
+
+    // the subregions themselves are part of the setup, not the benchmark
+    std::vector<int> colors(num_pieces);
+    for(int i = 0; i < num_pieces; i++)
+      colors[i] = i;
+
+    return is_grid.create_subspaces_by_field(piece_field_data,
+					     colors,
+					     p_pieces,
+					     Realm::ProfilingRequestSet());
+  }
+
+  virtual Event perform_partitioning(void)
+  {
+    Event e1 = is_grid.create_subspaces_by_image(ptr_field_data,
+						 p_pieces,
+						 p_images,
+						 Realm::ProfilingRequestSet());
+    if(wait_on_events) e1.wait();
+
+    Event e2 = is_grid.create_subspaces_by_preimage(ptr_field_data,
+						    p_pieces,
+						    p_preimages,
+						    Realm::ProfilingRequestSet());
+    if(wait_on_events) e2.wait();
+
+    return Event::merge_events(e1, e2);
+  }
+
+  virtual int perform_dynamic_checks(void)
+  {
+    return 0;
+  }
+
+  virtual int check_partitioning(void)
+  {
+    int errors = 0;
+
+    // a subregion's image overlaps it if any of its points has its left
+    //  neighbor in the same subregion
+    std::vector<bool> self_overlap(num_pieces, false);
+    for(PointInRectIterator<N,int> pir(is_grid.bounds); pir.valid; pir.step()) {
+      int piece = point_piece(pir.p);
+      if(point_piece(neighbor(pir.p, -1)) == piece)
+	self_overlap[piece] = true;
+    }
+
+    for(int i = 0; i < num_pieces; i++) {
+      size_t vol = p_pieces[i].volume();
+      if((p_images[i].volume() != vol) || (p_preimages[i].volume() != vol)) {
+	log_app.error() << "piece " << i << ": volume=" << vol
+			<< " image=" << p_images[i].volume()
+			<< " preimage=" << p_preimages[i].volume();
+	errors++;
+      }
+
+      if(p_images[i].overlaps(p_pieces[i]) != self_overlap[i]) {
+	log_app.error() << "piece " << i << ": image overlap != " << self_overlap[i];
+	errors++;
+      }
+    }
+
+    // spot-check contains() on every subregion for a sample of the points
+    size_t idx = 0;
+    for(PointInRectIterator<N,int> pir(is_grid.bounds); pir.valid; pir.step(), idx++) {
+      if((idx % check_stride) != 0) continue;
+      int piece = point_piece(pir.p);
+      int img_piece = point_piece(neighbor(pir.p, -1));
+      int pre_piece = point_piece(neighbor(pir.p, 1));
+      for(int i = 0; i < num_pieces; i++) {
+	if((p_pieces[i].contains(pir.p) != (i == piece)) ||
+	   (p_images[i].contains(pir.p) != (i == img_piece)) ||
+	   (p_preimages[i].contains(pir.p) != (i == pre_piece))) {
+	  if(errors++ < 10)
+	    log_app.error() << "piece " << i << ": wrong membership for " << pir.p;
+	}
+      }
+    }
+
+    return errors;
+  }
+};
+
 template <typename PRNG = Philox_2x32<> >
 class RandStream {
 public:
@@ -2242,6 +3264,41 @@ int main(int argc, char **argv)
       break;
     }
 
+    if(!strcmp(argv[i], "scatter")) {
+      testcfg = new ScatterTest(argc-i, const_cast<const char **>(argv+i));
+      break;
+    }
+
+    if(!strcmp(argv[i], "chunked")) {
+      testcfg = new ChunkedTest(argc-i, const_cast<const char **>(argv+i));
+      break;
+    }
+
+    if(!strcmp(argv[i], "scan")) {
+      testcfg = new ScanTest(argc-i, const_cast<const char **>(argv+i));
+      break;
+    }
+
+    if(!strcmp(argv[i], "incremental")) {
+      testcfg = new IncrementalTest(argc-i, const_cast<const char **>(argv+i));
+      break;
+    }
+
+    if(!strcmp(argv[i], "amr")) {
+      // the dimension has to be known before the test is created
+      int dim = 2;
+      for(int j = i + 1; j < argc - 1; j++)
+	if(!strcmp(argv[j], "-d"))
+	  dim = atoi(argv[j + 1]);
+      if(dim == 1)
+	testcfg = new AmrTest<1>(argc-i, const_cast<const char **>(argv+i));
+      else if(dim == 3)
+	testcfg = new AmrTest<3>(argc-i, const_cast<const char **>(argv+i));
+      else
+	testcfg = new AmrTest<2>(argc-i, const_cast<const char **>(argv+i));
+      break;
+    }
+
     if(!strcmp(argv[i], "random")) {
       testcfg = new RandomTest<1,int,2,int,int>(argc-i, const_cast<const char **>(argv+i));
       break;
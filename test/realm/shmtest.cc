@@ -0,0 +1,319 @@
+// tests the shared-memory active message transport with several processes
+//  on this machine - no network or Realm runtime involved
+
+#include "realm/shm_transport.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+
+#include <unistd.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+using namespace Realm;
+
+static const int MAX_RANKS = 16;
+
+enum {
+  MSG_SHORT = 1,
+  MSG_MEDIUM,
+  MSG_WINDOW,
+  MSG_BIG,
+};
+
+static int num_ranks = 4;
+static int num_messages = 2000;
+static size_t big_bytes = 1 << 20;
+// every window message gets its own spot, since the sender writes it
+//  directly and nothing stops a later one from overwriting it
+static const size_t WINDOW_SPOT = 1040;
+static size_t window_slice(void) { return num_messages * WINDOW_SPOT; }
+
+// set up before the fork, so every rank sees the same one
+struct SharedState {
+  int barrier_count;
+  uintptr_t window_base[MAX_RANKS];
+  uintptr_t big_buffer[MAX_RANKS];
+};
+static SharedState *shared = 0;
+
+static void barrier(int phase)
+{
+  __sync_fetch_and_add(&shared->barrier_count, 1);
+  while(*(volatile int *)&shared->barrier_count < (phase * num_ranks))
+    sched_yield();
+}
+
+struct MsgArgs {
+  int sender;
+  int seq;
+};
+
+static inline char pattern(int sender, int seq, size_t i)
+{
+  return (char)((sender * 31) + (seq * 7) + i);
+}
+
+static bool check_pattern(const void *data, size_t bytes, int sender, int seq)
+{
+  for(size_t i = 0; i < bytes; i++)
+    if(((const char *)data)[i] != pattern(sender, seq, i))
+      return false;
+  return true;
+}
+
+static size_t medium_bytes(int seq) { return 1 + ((seq * 97) % 4096); }
+static size_t window_bytes(int seq) { return 8 + ((seq * 13) % 1024); }
+
+class TestHandler : public ShmTransport::MessageHandler {
+public:
+  TestHandler(ShmTransport *_shm, int _my_rank)
+    : shm(_shm), my_rank(_my_rank), errors(0), received(0)
+  {
+    memset(next_seq, 0, sizeof(next_seq));
+  }
+
+  virtual void handle_message(int sender, int msgid,
+			      const void *args, size_t arglen,
+			      void *payload, size_t payload_len,
+			      bool has_payload)
+  {
+    assert(arglen == sizeof(MsgArgs));
+    const MsgArgs& a = *(const MsgArgs *)args;
+    if(a.sender != sender) {
+      printf("rank %d: message from %d claims to be from %d\n", my_rank, sender, a.sender);
+      errors++;
+    }
+    // messages from a given sender arrive in order
+    int exp_seq = next_seq[sender][msgid]++;
+    if(a.seq != exp_seq) {
+      printf("rank %d: msg %d from %d: seq %d, expected %d\n",
+	     my_rank, msgid, sender, a.seq, exp_seq);
+      errors++;
+    }
+
+    switch(msgid) {
+    case MSG_SHORT:
+      if(has_payload) errors++;
+      break;
+
+    case MSG_MEDIUM:
+      if(!has_payload || (payload_len != medium_bytes(a.seq)) ||
+	 !check_pattern(payload, payload_len, sender, a.seq)) {
+	printf("rank %d: bad medium payload %d from %d\n", my_rank, a.seq, sender);
+	errors++;
+      }
+      if(!shm->release_payload(sender, payload)) {
+	printf("rank %d: medium payload not in an arena\n", my_rank);
+	errors++;
+      }
+      break;
+
+    case MSG_WINDOW:
+      {
+	// should have been written directly into our window
+	void *exp_ptr = ((char *)(shared->window_base[my_rank]) +
+			 (sender * window_slice()) + (a.seq * WINDOW_SPOT));
+	if((payload != exp_ptr) || (payload_len != window_bytes(a.seq)) ||
+	   !check_pattern(payload, payload_len, sender, a.seq)) {
+	  printf("rank %d: bad window payload %d from %d\n", my_rank, a.seq, sender);
+	  errors++;
+	}
+	break;
+      }
+
+    case MSG_BIG:
+      {
+	void *exp_ptr = (void *)(shared->big_buffer[my_rank]);
+	if((payload != exp_ptr) || (payload_len != big_bytes) ||
+	   !check_pattern(payload, payload_len, sender, a.seq)) {
+	  printf("rank %d: bad big payload %d from %d\n", my_rank, a.seq, sender);
+	  errors++;
+	}
+	break;
+      }
+
+    default:
+      printf("rank %d: unknown message %d from %d\n", my_rank, msgid, sender);
+      errors++;
+    }
+    received++;
+  }
+
+  ShmTransport *shm;
+  int my_rank;
+  int errors;
+  int received;
+  int next_seq[MAX_RANKS][MSG_BIG + 1];
+};
+
+static ShmTransport *shm = 0;
+static TestHandler *handler = 0;
+
+static void make_progress(void)
+{
+  if(shm->poll(handler) == 0)
+    sched_yield();
+}
+
+static void send_message(int target, int msgid, int seq,
+			 const void *data, size_t bytes, bool has_payload,
+			 void *dstptr)
+{
+  MsgArgs a;
+  a.sender = handler->my_rank;
+  a.seq = seq;
+  SpanList spans;
+  if(bytes > 0)
+    spans.push_back(SpanListEntry(data, bytes));
+  while(!shm->send(target, msgid, &a, sizeof(a), spans, bytes, has_payload,
+		   dstptr, make_progress))
+    make_progress();
+}
+
+static int run_rank(int rank, const std::string& key)
+{
+  // small rings and arenas, so that senders stall and big payloads have
+  //  to be split up
+  shm = new ShmTransport(key, rank, num_ranks, 64, 256 << 10);
+  handler = new TestHandler(shm, rank);
+
+  if(!shm->create_segment()) {
+    printf("rank %d: could not create segment\n", rank);
+    return 1;
+  }
+  void *window = shm->export_window(num_ranks * window_slice());
+  assert(window != 0);
+  shared->window_base[rank] = (uintptr_t)window;
+  // a private buffer that peers can only reach through the arena
+  char *big_buffer = (char *)malloc(big_bytes);
+  shared->big_buffer[rank] = (uintptr_t)big_buffer;
+  barrier(1);
+
+  int peers = shm->attach_peers(10.0);
+  if(peers != (num_ranks - 1)) {
+    printf("rank %d: found %d peers, expected %d\n", rank, peers, num_ranks - 1);
+    return 1;
+  }
+  barrier(2);
+
+  char *data = (char *)malloc(big_bytes);
+  int expected = 0;
+  for(int seq = 0; seq < num_messages; seq++) {
+    for(int t = 0; t < num_ranks; t++) {
+      if(t == rank) continue;
+
+      send_message(t, MSG_SHORT, seq, 0, 0, false, 0);
+
+      size_t bytes = medium_bytes(seq);
+      for(size_t i = 0; i < bytes; i++) data[i] = pattern(rank, seq, i);
+      send_message(t, MSG_MEDIUM, seq, data, bytes, true, 0);
+
+      // our slice of the target's window
+      bytes = window_bytes(seq);
+      for(size_t i = 0; i < bytes; i++) data[i] = pattern(rank, seq, i);
+      void *dst = ((char *)(shared->window_base[t]) +
+		   (rank * window_slice()) + (seq * WINDOW_SPOT));
+      send_message(t, MSG_WINDOW, seq, data, bytes, true, dst);
+    }
+    expected += 3 * (num_ranks - 1);
+    make_progress();
+  }
+
+  // one rank at a time sends everybody a payload bigger than the arena,
+  //  since they all land in the same buffer
+  for(int r = 0; r < num_ranks; r++) {
+    if(r == rank) {
+      for(size_t i = 0; i < big_bytes; i++) data[i] = pattern(rank, 0, i);
+      for(int t = 0; t < num_ranks; t++)
+	if(t != rank)
+	  send_message(t, MSG_BIG, 0, data, big_bytes, true,
+		       (void *)(shared->big_buffer[t]));
+    } else
+      expected++;
+    while(handler->received < expected)
+      make_progress();
+    barrier(3 + r);
+  }
+
+  printf("rank %d: received %d messages, sent %llu (%llu bytes), %llu stalls, %d errors\n",
+	 rank, handler->received,
+	 (unsigned long long)shm->messages_sent,
+	 (unsigned long long)shm->bytes_sent,
+	 (unsigned long long)shm->sends_stalled, handler->errors);
+  fflush(stdout);
+
+  // everybody has to be done with our names before they go away
+  barrier(3 + num_ranks);
+  shm->unlink_names();
+  int errors = handler->errors;
+  delete handler;
+  delete shm;
+  free(data);
+  free(big_buffer);
+  return (errors ? 1 : 0);
+}
+
+int main(int argc, char **argv)
+{
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-n")) {
+      num_ranks = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-m")) {
+      num_messages = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-b")) {
+      big_bytes = ((size_t)atoi(argv[++i])) << 10;
+      continue;
+    }
+  }
+  assert((num_ranks > 1) && (num_ranks <= MAX_RANKS));
+
+  printf("shm transport test: %d ranks, %d messages of each kind per pair, %zd KB big payloads\n",
+	 num_ranks, num_messages, big_bytes >> 10);
+  fflush(stdout);
+
+  shared = (SharedState *)mmap(0, sizeof(SharedState), PROT_READ | PROT_WRITE,
+			       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  assert(shared != MAP_FAILED);
+  memset(shared, 0, sizeof(SharedState));
+
+  char key[64];
+  snprintf(key, sizeof(key), "shmtest.%d", (int)getpid());
+
+  std::vector<pid_t> children;
+  for(int r = 0; r < num_ranks; r++) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0) {
+      // the watchdog catches a rank stuck waiting on a dead peer
+      alarm(120);
+      _exit(run_rank(r, key));
+    }
+    children.push_back(pid);
+  }
+
+  int errors = 0;
+  for(size_t i = 0; i < children.size(); i++) {
+    int status;
+    waitpid(children[i], &status, 0);
+    if(!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+      printf("rank %zd failed (status = %d)\n", i, status);
+      errors++;
+    }
+  }
+
+  if(errors) {
+    printf("Exiting with errors\n");
+    exit(1);
+  }
+  printf("all done!\n");
+  return 0;
+}
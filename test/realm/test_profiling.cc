@@ -198,6 +198,33 @@ void response_task(const void *args, size_t arglen,
   } else
     printf("no instance timeline\n");
 
+  if(pr.has_measurement<OperationTransferTimeline>()) {
+    OperationTransferTimeline *op_xfers = pr.get_measurement<OperationTransferTimeline>();
+    printf("op transfers = %zd", op_xfers->xfers.size());
+    size_t total_bytes = 0;
+    if(!op_xfers->xfers.empty()) {
+      printf(" [");
+      for(std::vector<OperationTransferTimeline::XferInterval>::const_iterator it = op_xfers->xfers.begin();
+	  it != op_xfers->xfers.end();
+	  it++) {
+	printf(" (%llx %d %zd %lld %lld %lld %lld)",
+	       it->guid, it->kind, it->bytes,
+	       it->enqueue_time, it->first_byte_time, it->last_byte_time,
+	       it->ib_wait_time);
+	assert(it->enqueue_time <= it->last_byte_time);
+	total_bytes += it->bytes;
+      }
+      printf(" ]\n");
+    } else
+      printf("\n");
+    // the copy test moves 32 8-byte elements
+    if(total_bytes != 32 * 8) {
+      printf("transfer byte count mismatch: %zd\n", total_bytes);
+      exit(1);
+    }
+    delete op_xfers;
+  }
+
   if(pr.user_data_size() > 0) {
     printf("user data = %zd (", pr.user_data_size());
     unsigned char *data = (unsigned char *)(pr.user_data());
@@ -263,8 +290,9 @@ void top_level_task(const void *args, size_t arglen,
     .add_measurement<OperationEventWaits>()
     .add_measurement<OperationBacktrace>();
 
-  // we expect (exactly) 7 responses for tasks + 2 for instances
-  expected_responses_remaining = 9;
+  // we expect (exactly) 7 responses for tasks + 2 for instances + 1 for
+  //  a copy
+  expected_responses_remaining = 10;
   response_counter = Barrier::create_barrier(expected_responses_remaining);
 
   // give ourselves 15 seconds for the tasks, and their profiling responses, to finish
@@ -364,6 +392,37 @@ void top_level_task(const void *args, size_t arglen,
     inst.destroy(e);
   }
 
+  // copy profiling - per-transfer timelines
+  {
+    Rect<1> is(0, 31);
+    Memory mem = Machine::MemoryQuery(machine).only_kind(Memory::SYSTEM_MEM).first();
+    assert(mem.exists());
+    RegionInstance src_inst, dst_inst;
+    RegionInstance::create_instance(src_inst, mem, is,
+				    std::vector<size_t>(1, 8),
+				    0, // SOA
+				    ProfilingRequestSet()).wait();
+    RegionInstance::create_instance(dst_inst, mem, is,
+				    std::vector<size_t>(1, 8),
+				    0, // SOA
+				    ProfilingRequestSet()).wait();
+    std::vector<CopySrcDstField> srcs(1), dsts(1);
+    srcs[0].inst = src_inst;
+    srcs[0].field_id = 0;
+    srcs[0].size = 8;
+    dsts[0].inst = dst_inst;
+    dsts[0].field_id = 0;
+    dsts[0].size = 8;
+    ProfilingRequestSet prs;
+    prs.add_request(profile_cpu, RESPONSE_TASK)
+      .add_measurement<OperationTimeline>()
+      .add_measurement<OperationMemoryUsage>()
+      .add_measurement<OperationTransferTimeline>();
+    IndexSpace<1>(is).copy(srcs, dsts, prs).wait();
+    src_inst.destroy();
+    dst_inst.destroy();
+  }
+
   printf("waiting for profiling responses...\n");
   response_counter.wait();
   printf("all profiling responses received\n");
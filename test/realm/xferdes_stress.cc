@@ -0,0 +1,140 @@
+// stress test for the DMA system's XferDes scheduling - issues a large number
+//  of tiny copies (each of which becomes its own XferDes) in overlapping
+//  batches and checks that every one of them lands
+
+#include "realm.h"
+#include "realm/cmdline.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <vector>
+#include <set>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+namespace TestConfig {
+  int num_copies = 200000;  // total number of copies (i.e. XferDes) to issue
+  int num_pairs = 256;      // number of independent src/dst instance pairs
+  int elements = 4;         // elements per instance
+};
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "xferdes stress: copies=" << TestConfig::num_copies
+		  << " pairs=" << TestConfig::num_pairs
+		  << " elements=" << TestConfig::elements;
+
+  Memory m = Machine::MemoryQuery(Machine::get_machine())
+    .only_kind(Memory::SYSTEM_MEM)
+    .has_affinity_to(p)
+    .first();
+  assert(m.exists());
+
+  IndexSpace<1> is(Rect<1>(0, TestConfig::elements - 1));
+  std::vector<size_t> field_sizes(1, sizeof(int));
+
+  int np = TestConfig::num_pairs;
+  std::vector<RegionInstance> srcs(np), dsts(np);
+  std::vector<std::vector<CopySrcDstField> > src_fields(np), dst_fields(np);
+  for(int i = 0; i < np; i++) {
+    RegionInstance::create_instance(srcs[i], m, is, field_sizes,
+				    0 /*SOA*/, ProfilingRequestSet()).wait();
+    RegionInstance::create_instance(dsts[i], m, is, field_sizes,
+				    0 /*SOA*/, ProfilingRequestSet()).wait();
+    src_fields[i].resize(1);
+    src_fields[i][0].inst = srcs[i];
+    src_fields[i][0].field_id = 0;
+    src_fields[i][0].size = sizeof(int);
+    dst_fields[i].resize(1);
+    dst_fields[i][0].inst = dsts[i];
+    dst_fields[i][0].field_id = 0;
+    dst_fields[i][0].size = sizeof(int);
+  }
+
+  // each round fills every source with a new value and copies it to the
+  //  destination - the previous round's copy into the same destination is
+  //  a precondition so that rounds can overlap with each other
+  std::vector<Event> last_copy(np, Event::NO_EVENT);
+  int rounds = (TestConfig::num_copies + np - 1) / np;
+  double t_start = Clock::current_time();
+  for(int r = 0; r < rounds; r++) {
+    int value = r + 1;
+    for(int i = 0; i < np; i++) {
+      Event filled = is.fill(src_fields[i], ProfilingRequestSet(),
+			     &value, sizeof(value), last_copy[i]);
+      last_copy[i] = is.copy(src_fields[i], dst_fields[i],
+			     ProfilingRequestSet(), filled);
+    }
+    // don't let too many rounds pile up
+    if((r % 16) == 15)
+      last_copy[0].wait();
+  }
+  Event::merge_events(std::set<Event>(last_copy.begin(), last_copy.end())).wait();
+  double t_end = Clock::current_time();
+
+  int errors = 0;
+  for(int i = 0; i < np; i++) {
+    AffineAccessor<int, 1> acc(dsts[i], 0);
+    for(int j = 0; j < TestConfig::elements; j++)
+      if(acc[j] != rounds) {
+	if(errors++ < 10)
+	  log_app.error() << "mismatch: pair=" << i << " elem=" << j
+			  << " exp=" << rounds << " act=" << acc[j];
+      }
+  }
+
+  for(int i = 0; i < np; i++) {
+    srcs[i].destroy();
+    dsts[i].destroy();
+  }
+
+  long total = (long)rounds * np;
+  log_app.print() << "issued " << total << " copies in " << (t_end - t_start)
+		  << " s (" << (total / (t_end - t_start)) << " copies/s)";
+
+  if(errors > 0) {
+    log_app.fatal() << errors << " errors found";
+    exit(1);
+  }
+  log_app.print() << "PASSED";
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, &argv);
+
+  CommandLineParser cp;
+  cp.add_option_int("-copies", TestConfig::num_copies)
+    .add_option_int("-pairs", TestConfig::num_pairs)
+    .add_option_int("-elements", TestConfig::elements);
+  bool ok = cp.parse_command_line(argc, (const char **)argv);
+  assert(ok);
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  int result = rt.wait_for_shutdown();
+  return result;
+}
@@ -674,6 +674,13 @@ class Channel(object):
             return self.src.__repr__() + ' to ' + self.dst.__repr__() + ' Channel'
 
     def __cmp__(a, b):
+        # XferDes channels go after all the memory-to-memory ones
+        a_xfer = isinstance(a, XferChannel)
+        b_xfer = isinstance(b, XferChannel)
+        if a_xfer or b_xfer:
+            if a_xfer and b_xfer:
+                return cmp((a.node, a.kind), (b.node, b.kind))
+            return 1 if a_xfer else -1
         if a.dst:
             if b.dst:
                 return cmp(a.dst, b.dst)
@@ -685,6 +692,34 @@ class Channel(object):
             else:
                 return 0
 
+# Realm's XferDes::XferKind
+xfer_kinds = [
+    "none", "disk_read", "disk_write", "ssd_read", "ssd_write",
+    "gpu_to_fb", "gpu_from_fb", "gpu_in_fb", "gpu_peer_fb", "mem_cpy",
+    "gasnet_read", "gasnet_write", "remote_write", "hdf_read", "hdf_write",
+    "file_read", "file_write",
+]
+
+def xfer_kind_name(kind):
+    if kind < len(xfer_kinds):
+        return xfer_kinds[kind]
+    return "kind " + str(kind)
+
+# one of the Realm DMA channels (an XferKind on one node) that the
+# individual hops of copies are performed by
+class XferChannel(Channel):
+    def __init__(self, node, kind):
+        Channel.__init__(self, None, None)
+        self.node = node
+        self.kind = kind
+
+    def get_short_text(self):
+        return "XferDes Channel"
+
+    def __repr__(self):
+        return 'XferDes ' + xfer_kind_name(self.kind) + ' Channel (node ' + \
+            str(self.node) + ')'
+
 class WaitInterval(object):
     def __init__(self, start, ready, end):
         self.start = start
@@ -1212,6 +1247,21 @@ class Copy(Base, TimeRange, HasInitiationDependencies):
                                 prof_uid = self.prof_uid)
         tsv_file.write(tsv_line)
 
+# a single hop of a copy - it's 'ready' when it was handed to its channel,
+# and runs from the first byte it moved to the last
+class XferDes(Copy):
+    def __init__(self, src, dst, initiation_op, size, kind, xd_id,
+                 enqueue, start, stop, ib_wait):
+        Copy.__init__(self, src, dst, initiation_op, size,
+                      enqueue, enqueue, start, stop)
+        self.kind = kind
+        self.xd_id = xd_id
+        self.ib_wait = ib_wait
+
+    def __repr__(self):
+        return 'XferDes ' + xfer_kind_name(self.kind) + ' size=' + \
+            str(self.size) + ' ib_wait=' + str(self.ib_wait) + 'us'
+
 class Fill(Base, TimeRange, HasInitiationDependencies):
     def __init__(self, dst, initiation_op, create, ready, start, stop):
         Base.__init__(self)
@@ -1705,6 +1755,7 @@ class State(object):
             "TaskInfo": self.log_task_info,
             "MetaInfo": self.log_meta_info,
             "CopyInfo": self.log_copy_info,
+            "CopyXferInfo": self.log_copy_xfer_info,
             "FillInfo": self.log_fill_info,
             "InstCreateInfo": self.log_inst_create,
             "InstUsageInfo": self.log_inst_usage,
@@ -1747,6 +1798,19 @@ class State(object):
         channel = self.find_channel(src, dst)
         channel.add_copy(copy)
 
+    def log_copy_xfer_info(self, op_id, xd_id, kind, src, dst, size,
+                           enqueue, start, stop, ib_wait):
+        op = self.find_op(op_id)
+        src = self.find_memory(src)
+        dst = self.find_memory(dst)
+        xd = self.create_xferdes(src, dst, op, size, kind, xd_id,
+                                 enqueue, start, stop, ib_wait)
+        if stop > self.last_time:
+            self.last_time = stop
+        # the top 16 bits of an XferDes id are the node that executed it
+        channel = self.find_xfer_channel(int(xd_id >> 48), kind)
+        channel.add_copy(xd)
+
     def log_fill_info(self, op_id, dst, create, ready, start, stop):
         op = self.find_op(op_id)
         dst = self.find_memory(dst)
@@ -1955,6 +2019,12 @@ class State(object):
                 self.channels[None] = Channel(None,None)
             return self.channels[None]
 
+    def find_xfer_channel(self, node, kind):
+        key = ("xfer", node, kind)
+        if key not in self.channels:
+            self.channels[key] = XferChannel(node, kind)
+        return self.channels[key]
+
     def find_variant(self, task_id, variant_id):
         key = (task_id, variant_id)
         if key not in self.variants:
@@ -2004,6 +2074,14 @@ class State(object):
         self.prof_uid_map[copy.prof_uid] = copy
         return copy
 
+    def create_xferdes(self, src, dst, op, size, kind, xd_id,
+                       enqueue, start, stop, ib_wait):
+        xd = XferDes(src, dst, op, size, kind, xd_id,
+                     enqueue, start, stop, ib_wait)
+        # update prof_uid map
+        self.prof_uid_map[xd.prof_uid] = xd
+        return xd
+
     def create_fill(self, dst, op, create, ready, start, stop):
         fill = Fill(dst, op, create, ready, start, stop)
         # update prof_uid map
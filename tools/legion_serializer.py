@@ -79,6 +79,7 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "TaskInfo": re.compile(prefix + r'Prof Task Info (?P<op_id>[0-9]+) (?P<task_id>[0-9]+) (?P<variant_id>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<create>[0-9]+) (?P<ready>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "MetaInfo": re.compile(prefix + r'Prof Meta Info (?P<op_id>[0-9]+) (?P<lg_id>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<create>[0-9]+) (?P<ready>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "CopyInfo": re.compile(prefix + r'Prof Copy Info (?P<op_id>[0-9]+) (?P<src>[a-f0-9]+) (?P<dst>[a-f0-9]+) (?P<size>[0-9]+) (?P<create>[0-9]+) (?P<ready>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
+        "CopyXferInfo": re.compile(prefix + r'Prof Copy Xfer Info (?P<op_id>[0-9]+) (?P<xd_id>[0-9]+) (?P<kind>[0-9]+) (?P<src>[a-f0-9]+) (?P<dst>[a-f0-9]+) (?P<size>[0-9]+) (?P<enqueue>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+) (?P<ib_wait>[0-9]+)'),
         "FillInfo": re.compile(prefix + r'Prof Fill Info (?P<op_id>[0-9]+) (?P<dst>[a-f0-9]+) (?P<create>[0-9]+) (?P<ready>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "InstCreateInfo": re.compile(prefix + r'Prof Inst Create (?P<op_id>[0-9]+) (?P<inst_id>[a-f0-9]+) (?P<create>[0-9]+)'),
         "InstUsageInfo": re.compile(prefix + r'Prof Inst Usage (?P<op_id>[0-9]+) (?P<inst_id>[a-f0-9]+) (?P<mem_id>[a-f0-9]+) (?P<size>[0-9]+)'),
@@ -94,6 +95,7 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "op_id": long,
         "parent_id": long,
         "size": long,
+        "xd_id": long,
         "capacity": long,
         "variant_id": int,
         "lg_id": int,
@@ -117,6 +119,8 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "wait_start": read_time,
         "wait_ready": read_time,
         "wait_end": read_time,
+        "enqueue": read_time,
+        "ib_wait": read_time,
         "name": lambda x: x,
         "desc": lambda x: x
     }
@@ -266,8 +270,10 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
 
         # change the callbacks to be by id
         if not self.callbacks_translated:
+            # (older logs may not have every record type)
             new_callbacks = {LegionProfBinaryDeserializer.name_to_id[name]: callback 
-                               for name, callback in self.callbacks.iteritems()}
+                               for name, callback in self.callbacks.iteritems()
+                               if name in LegionProfBinaryDeserializer.name_to_id}
             self.callbacks = new_callbacks
             self.callbacks_translated = True
 
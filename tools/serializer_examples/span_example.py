@@ -80,6 +80,7 @@ callbacks = {
     "TaskInfo": log_task_info,
     "MetaInfo": log_meta_info,
     "CopyInfo": noop,
+    "CopyXferInfo": noop,
     "FillInfo": noop,
     "InstCreateInfo": noop,
     "InstUsageInfo": noop,